@@ -58,7 +58,22 @@ g++ -std=c++17 -O2 -Wall -Wextra -I .\src ^
     src\core\version.cpp ^
     src\core\crypto.cpp ^
     src\storage\file_manager.cpp ^
-    src\storage\metadata.cpp
+    src\storage\metadata.cpp ^
+    src\core\version_cache.cpp ^
+    src\core\sha256.cpp ^
+    src\storage\object_store.cpp ^
+    src\storage\mapped_file.cpp ^
+    src\storage\version_log.cpp ^
+    src\storage\pack.cpp ^
+    src\core\compress.cpp ^
+    src\api\server.cpp ^
+    src\core\thread_pool.cpp ^
+    src\cli\output_capture.cpp ^
+    src\core\arena.cpp ^
+    src\core\trace.cpp ^
+    src\core\delta.cpp ^
+    src\storage\search_index.cpp ^
+    src\storage\journal.cpp
 
 if errorlevel 1 (
     echo [ERROR] Build failed!
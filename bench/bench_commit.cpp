@@ -0,0 +1,109 @@
+// Commit latency as history grows. Each commit runs through a fresh Repo,
+// the way every CLI invocation does, so the cost of recovering HEAD is
+// included. Latency should stay flat instead of growing with the version count.
+// The second part imports the same revisions one commit at a time and with
+// one commitBatch call.
+
+#include "../src/core/repo.h"
+#include "../src/core/utils.h"
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static double millisSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+    const std::string repoPath = "./bench_repo_commit";
+    const int lineCount = 5000;
+    const std::vector<int> checkpoints = {100, 500, 1000, 2000};
+    const int window = 50;
+
+    std::vector<std::string> lines;
+    for (int i = 0; i < lineCount; ++i) {
+        lines.push_back("line " + std::to_string(i) + ": some document text that changes now and then");
+    }
+
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+    std::ostringstream sink;
+    std::streambuf* saved = std::cout.rdbuf(sink.rdbuf());
+    Repo(repoPath).init();
+    std::cout.rdbuf(saved);
+
+    std::cout << "Commit latency, " << lineCount << " line file, fresh Repo per commit\n";
+    std::cout << std::setw(10) << "versions" << std::setw(16) << "ms / commit" << std::setw(22) << "diff bytes / commit" << "\n";
+
+    int committed = 0;
+    unsigned seed = 99;
+    for (int checkpoint : checkpoints) {
+        double windowMs = 0;
+        size_t diffBytes = 0;
+        while (committed < checkpoint) {
+            seed = seed * 1103515245 + 12345;
+            lines[(seed >> 16) % lines.size()] += " edit " + std::to_string(committed);
+            std::string text = Utils::joinLines(lines);
+
+            std::cout.rdbuf(sink.rdbuf());
+            auto t0 = std::chrono::steady_clock::now();
+            Repo repo(repoPath);
+            repo.commit(text);
+            double ms = millisSince(t0);
+            std::cout.rdbuf(saved);
+            sink.str("");
+
+            if (checkpoint - committed <= window) {
+                windowMs += ms;
+                diffBytes += repo.getStore().size(repo.getVersions().back().diffObject);
+            }
+            ++committed;
+        }
+        std::cout << std::setw(10) << checkpoint << std::fixed << std::setprecision(3)
+                  << std::setw(16) << windowMs / window << std::setw(22) << diffBytes / window << "\n";
+    }
+
+    // Import throughput: per-revision commits against one batch
+    const int importCount = 500;
+    std::vector<std::string> revisions;
+    size_t importBytes = 0;
+    for (int i = 0; i < importCount; ++i) {
+        seed = seed * 1103515245 + 12345;
+        lines[(seed >> 16) % lines.size()] += " import " + std::to_string(i);
+        revisions.push_back(Utils::joinLines(lines));
+        importBytes += revisions.back().size();
+    }
+
+    std::cout << "\nImport of " << importCount << " revisions (" << importBytes / (1024 * 1024) << " MB)\n";
+    for (int batch = 0; batch < 2; ++batch) {
+        fs::remove_all(repoPath);
+        std::cout.rdbuf(sink.rdbuf());
+        Repo(repoPath).init();
+        auto t0 = std::chrono::steady_clock::now();
+        if (batch) {
+            size_t next = 0;
+            Repo(repoPath).commitBatch([&](std::string& text) {
+                if (next == revisions.size()) return false;
+                text = revisions[next++];
+                return true;
+            });
+        } else {
+            for (const auto& text : revisions) Repo(repoPath).commit(text);
+        }
+        double ms = millisSince(t0);
+        std::cout.rdbuf(saved);
+        sink.str("");
+        std::cout << std::left << std::setw(14) << (batch ? "commitBatch" : "commit x " + std::to_string(importCount))
+                  << std::right << std::setprecision(1) << std::setw(10) << ms << " ms" << std::setw(10)
+                  << importCount / (ms / 1000.0) << " revisions/s" << std::setw(10)
+                  << (importBytes / (1024.0 * 1024.0)) / (ms / 1000.0) << " MB/s\n";
+    }
+
+    fs::remove_all(repoPath);
+    return 0;
+}
@@ -0,0 +1,146 @@
+// Measures object compression on a synthetic history of prose and log-like
+// notes: bytes on disk, decompression throughput, and checkout latency for
+// raw objects, LZ objects, and LZ plus a dictionary trained at repack time.
+
+#include "../src/core/compress.h"
+#include "../src/core/patch.h"
+#include "../src/core/repo.h"
+#include "../src/core/utils.h"
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static double millisSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Deterministic notes: a growing journal where each version edits a few
+// lines and appends a log entry
+static std::vector<std::string> makeHistory(int versions) {
+    const char* words[] = {"deploy", "backup", "meeting", "review", "the", "service", "latency",
+                           "notes", "follow", "up", "with", "team", "about", "release", "plan"};
+    std::vector<std::string> lines;
+    std::vector<std::string> history;
+    unsigned seed = 12345;
+    auto next = [&]() { seed = seed * 1103515245 + 12345; return (seed >> 16) & 0x7fff; };
+
+    for (int v = 0; v < versions; ++v) {
+        for (int k = 0; k < 3; ++k) {
+            std::string line = "[2024-05-" + std::to_string(1 + v % 28) + "] INFO ";
+            for (int w = 0; w < 8; ++w) line += std::string(words[next() % 15]) + " ";
+            lines.push_back(line);
+        }
+        if (lines.size() > 10) lines[next() % lines.size()] += " (edited)";
+        history.push_back(Utils::joinLines(lines));
+    }
+    return history;
+}
+
+static size_t diskBytes(const std::string& repoPath) {
+    size_t total = 0;
+    for (const auto& entry : fs::recursive_directory_iterator(repoPath + "/objects")) {
+        if (entry.is_regular_file()) total += entry.file_size();
+    }
+    return total;
+}
+
+struct Result {
+    size_t bytes;
+    double readMBps;
+    double checkoutMs;
+};
+
+static Result measure(const std::string& repoPath, const std::vector<std::string>& history) {
+    Repo repo(repoPath);
+    repo.getLatestText();
+    const auto& versions = repo.getVersions();
+
+    // Read every diff object back (decode + decompress)
+    size_t contentBytes = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int round = 0; round < 5; ++round) {
+        for (const auto& v : versions) contentBytes += repo.readDiff(v).size();
+    }
+    double readMs = millisSince(t0);
+
+    // Cold checkout of the newest version
+    t0 = std::chrono::steady_clock::now();
+    bool ok = true;
+    for (int round = 0; round < 5; ++round) {
+        repo.getCache().clear();
+        ok = ok && Patch::reconstructVersion(repo, versions.back()) == history.back();
+    }
+    double checkoutMs = millisSince(t0) / 5;
+    if (!ok) std::cerr << "MISMATCH in " << repoPath << "\n";
+
+    return {diskBytes(repoPath), (contentBytes / (1024.0 * 1024.0)) / (readMs / 1000.0), checkoutMs};
+}
+
+static void build(const std::string& repoPath, const std::vector<std::string>& history, bool compression) {
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+    Repo repo(repoPath);
+    KeyframePolicy policy;
+    policy.interval = 32;
+    repo.setKeyframePolicy(policy);
+    repo.setCompression(compression);
+    repo.init();
+    for (const auto& text : history) repo.commit(text);
+}
+
+static void report(const std::string& name, const Result& r, size_t baseline) {
+    std::cout << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(14) << r.bytes << std::setw(10) << (100.0 * r.bytes / baseline) << "%"
+              << std::setw(14) << r.readMBps << std::setw(14) << r.checkoutMs << "\n";
+}
+
+int main() {
+    const int versionCount = 600;
+    std::vector<std::string> history = makeHistory(versionCount);
+
+    // Commit and repack chatter is not part of the measurement
+    std::ostringstream sink;
+    std::streambuf* saved = std::cout.rdbuf(sink.rdbuf());
+    build("./bench_repo_raw", history, false);
+    build("./bench_repo_lz", history, true);
+    build("./bench_repo_dict", history, true);
+    Repo("./bench_repo_dict").repack();
+    std::cout.rdbuf(saved);
+
+    Result raw = measure("./bench_repo_raw", history);
+    Result lz = measure("./bench_repo_lz", history);
+    Result dict = measure("./bench_repo_dict", history);
+
+    std::cout << "Compression benchmark, " << versionCount << " versions, final text "
+              << history.back().size() << " bytes\n";
+    std::cout << std::left << std::setw(22) << "objects" << std::right << std::setw(14) << "disk bytes"
+              << std::setw(11) << "of raw" << std::setw(14) << "read MB/s" << std::setw(14) << "checkout ms" << "\n";
+    report("raw (loose)", raw, raw.bytes);
+    report("lz (loose)", lz, raw.bytes);
+    report("lz+dict (packed)", dict, raw.bytes);
+
+    // Codec throughput on the largest object in isolation
+    std::string sample = history.back();
+    std::string block = Compress::compress(sample);
+    std::string out;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < 200; ++i) Compress::compress(sample);
+    double compressMs = millisSince(t0) / 200;
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < 200; ++i) Compress::decompress(block, sample.size(), out);
+    double decompressMs = millisSince(t0) / 200;
+    double mb = sample.size() / (1024.0 * 1024.0);
+    std::cout << "\nLZ on " << sample.size() << " bytes: ratio " << std::setprecision(2)
+              << (double)sample.size() / block.size() << "x, compress " << mb / (compressMs / 1000.0)
+              << " MB/s, decompress " << mb / (decompressMs / 1000.0) << " MB/s\n";
+
+    fs::remove_all("./bench_repo_raw");
+    fs::remove_all("./bench_repo_lz");
+    fs::remove_all("./bench_repo_dict");
+    return 0;
+}
@@ -0,0 +1,70 @@
+// Encryption at rest throughput in MB/s: the ChaCha20 key stream alone and
+// the chunked ChaCha20-Poly1305 format (Crypto::encrypt / decrypt), on each
+// ChaCha20 code path this CPU has, plus the one-off cost of deriving a key.
+
+#include "../src/core/crypto.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+template <typename Fn>
+static double megabytesPerSecond(size_t bytes, Fn op) {
+    // repeat until at least ~128 MB or 0.2 s have been processed
+    size_t rounds = std::max<size_t>(1, (128u << 20) / std::max<size_t>(bytes, 1));
+    auto start = std::chrono::steady_clock::now();
+    size_t done = 0;
+    double seconds = 0;
+    do {
+        for (size_t i = 0; i < rounds; ++i) op();
+        done += rounds;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (seconds < 0.2);
+    return (double)bytes * done / seconds / (1024.0 * 1024.0);
+}
+
+int main() {
+    const std::vector<size_t> sizes = {4096, 1u << 20, 16u << 20};
+    Crypto::Key key = Crypto::deriveKey("benchmark", "benchmark salt", 1);
+    const unsigned char nonce[Crypto::NONCE_BYTES] = {0};
+
+    std::cout << "Encryption throughput (MB/s)\n";
+    std::cout << std::left << std::setw(10) << "path" << std::setw(12) << "size" << std::right
+              << std::setw(12) << "chacha20" << std::setw(12) << "encrypt" << std::setw(12) << "decrypt" << "\n";
+
+    for (const char* impl : {"portable", "sse2", "avx2"}) {
+        if (!Crypto::useImplementation(impl)) {
+            std::cout << std::left << std::setw(10) << impl << "not available\n";
+            continue;
+        }
+        for (size_t size : sizes) {
+            std::string data(size, '\0');
+            for (size_t i = 0; i < size; ++i) data[i] = static_cast<char>('a' + (i * 7) % 26);
+            std::string out(size, '\0');
+            std::string stored = Crypto::encrypt(data, key);
+            std::string plain;
+
+            double stream = megabytesPerSecond(size, [&] {
+                Crypto::chacha20(key, nonce, 1, reinterpret_cast<const unsigned char*>(data.data()),
+                                 reinterpret_cast<unsigned char*>(&out[0]), size);
+            });
+            double encrypt = megabytesPerSecond(size, [&] { stored = Crypto::encrypt(data, key); });
+            double decrypt = megabytesPerSecond(size, [&] {
+                if (!Crypto::decrypt(stored, key, plain)) std::cerr << "Error: decrypt failed\n";
+            });
+
+            std::cout << std::left << std::setw(10) << impl << std::setw(12) << size << std::right << std::fixed
+                      << std::setprecision(1) << std::setw(12) << stream << std::setw(12) << encrypt
+                      << std::setw(12) << decrypt << "\n";
+        }
+    }
+
+    // Paid once per command on an encrypted repository
+    auto start = std::chrono::steady_clock::now();
+    Crypto::deriveKey("benchmark", "benchmark salt");
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "\nKey derivation (PBKDF2-HMAC-SHA256, " << Crypto::DEFAULT_ITERATIONS << " iterations): "
+              << std::setprecision(1) << ms << " ms\n";
+    return 0;
+}
@@ -0,0 +1,99 @@
+// Compares the Myers diff engine with the old positional line walker
+// on large synthetic files (100k+ lines).
+
+#include "../src/core/diff.h"
+#include "../src/core/patch.h"
+#include "../src/core/utils.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+// The walker Diff::generate used before the Myers engine: line i vs line i only
+static std::vector<std::string> positionalDiff(const std::string& oldText, const std::string& newText) {
+    std::vector<std::string> oldLines = Utils::splitLines(oldText);
+    std::vector<std::string> newLines = Utils::splitLines(newText);
+    std::vector<std::string> diff;
+    size_t i = 0, j = 0;
+    while (i < oldLines.size() || j < newLines.size()) {
+        if (i < oldLines.size() && j < newLines.size()) {
+            if (oldLines[i] != newLines[j]) {
+                diff.push_back("- " + oldLines[i]);
+                diff.push_back("+ " + newLines[j]);
+            }
+            ++i; ++j;
+        } else if (i < oldLines.size()) {
+            diff.push_back("- " + oldLines[i++]);
+        } else {
+            diff.push_back("+ " + newLines[j++]);
+        }
+    }
+    return diff;
+}
+
+static double millisSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void runCase(const std::string& name, const std::string& oldText, const std::string& newText) {
+    auto t0 = std::chrono::steady_clock::now();
+    std::string legacy = Utils::joinLines(positionalDiff(oldText, newText));
+    double legacyMs = millisSince(t0);
+
+    t0 = std::chrono::steady_clock::now();
+    std::string myers = Utils::joinLines(Diff::generate(oldText, newText));
+    double myersMs = millisSince(t0);
+
+    t0 = std::chrono::steady_clock::now();
+    bool ok = Patch::applyDiff(oldText, myers) == newText;
+    double applyMs = millisSince(t0);
+
+    std::cout << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(12) << legacyMs << std::setw(14) << legacy.size()
+              << std::setw(12) << myersMs << std::setw(14) << myers.size()
+              << std::setw(12) << applyMs << (ok ? "  ok" : "  MISMATCH") << "\n";
+}
+
+int main() {
+    const int lineCount = 120000;
+    std::vector<std::string> lines;
+    for (int i = 0; i < lineCount; ++i) {
+        lines.push_back("line " + std::to_string(i) + ": the quick brown fox jumps over the lazy dog");
+    }
+    std::string base = Utils::joinLines(lines);
+
+    std::cout << "Diff benchmark, " << lineCount << " lines (" << base.size() << " bytes)\n";
+    std::cout << std::left << std::setw(22) << "case" << std::right
+              << std::setw(12) << "walker ms" << std::setw(14) << "walker bytes"
+              << std::setw(12) << "myers ms" << std::setw(14) << "myers bytes"
+              << std::setw(12) << "apply ms" << "\n";
+
+    {
+        std::vector<std::string> edited = lines;
+        edited.insert(edited.begin() + 10, "an inserted line near the top");
+        runCase("insert near top", base, Utils::joinLines(edited));
+    }
+    {
+        std::vector<std::string> edited = lines;
+        for (size_t i = 500; i < edited.size(); i += 1000) edited[i] += " (edited)";
+        runCase("scattered edits", base, Utils::joinLines(edited));
+    }
+    {
+        std::vector<std::string> edited = lines;
+        for (int i = 0; i < 100; ++i) edited.push_back("appended line " + std::to_string(i));
+        runCase("append", base, Utils::joinLines(edited));
+    }
+    {
+        std::vector<std::string> edited = lines;
+        for (size_t i = 0; i < edited.size(); i += 97) edited.erase(edited.begin() + i);
+        runCase("scattered deletes", base, Utils::joinLines(edited));
+    }
+    {
+        std::vector<std::string> edited(lines.begin() + lineCount / 2, lines.end());
+        edited.insert(edited.end(), lines.begin(), lines.begin() + lineCount / 2);
+        runCase("swap halves", base, Utils::joinLines(edited));
+    }
+
+    return 0;
+}
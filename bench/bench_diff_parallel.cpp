@@ -0,0 +1,74 @@
+// Measures the anchor-partitioned parallel diff against the sequential
+// engine on a large log-like file, at 1/2/4/8/16 threads. Every parallel
+// result is checked to apply cleanly and to match the 1-thread output.
+
+#include "../src/core/diff.h"
+#include "../src/core/patch.h"
+#include "../src/core/thread_pool.h"
+#include "../src/core/utils.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <vector>
+
+static double millisSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// A log dump: mostly unique numbered records with recurring separator and
+// status lines, edited at scattered places (deletions, insertions, rewrites)
+static void makeTexts(size_t lines, std::string& oldText, std::string& newText) {
+    unsigned seed = 2024;
+    auto next = [&]() { seed = seed * 1103515245 + 12345; return (seed >> 16) & 0x7fff; };
+    for (size_t i = 0; i < lines; ++i) {
+        std::string line;
+        if (i % 50 == 0) line = "----------------------------------------\n";
+        else if (i % 7 == 0) line = "status: ok\n";
+        else line = "2024-05-01T12:00:00 worker-" + std::to_string(i % 64) + " request " + std::to_string(i) +
+                    " took " + std::to_string(next() % 1000) + "ms\n";
+        oldText += line;
+
+        unsigned roll = next() % 1000;
+        if (roll < 2) continue;                                     // deleted
+        if (roll < 4) newText += "inserted note " + std::to_string(i) + "\n";
+        newText += roll < 6 ? "rewritten record " + std::to_string(i) + "\n" : line;
+    }
+}
+
+int main() {
+    const size_t lineCount = 1000000;
+    std::string oldText, newText;
+    makeTexts(lineCount, oldText, newText);
+    std::cout << "Parallel diff benchmark: " << lineCount << " lines, "
+              << std::fixed << std::setprecision(1) << oldText.size() / (1024.0 * 1024.0) << " MB, "
+              << std::thread::hardware_concurrency() << " hardware threads\n";
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::string sequential = Diff::generateText(oldText, newText);
+    double sequentialMs = millisSince(t0);
+    bool ok = Patch::applyDiff(oldText, sequential) == newText;
+    std::cout << std::left << std::setw(14) << "sequential" << std::right << std::setw(12)
+              << sequentialMs << " ms   diff " << sequential.size() << " bytes"
+              << (ok ? "" : "   MISMATCH") << "\n";
+
+    std::string reference;
+    double oneThreadMs = 0;
+    for (size_t threads : {1, 2, 4, 8, 16}) {
+        ThreadPool pool(threads);
+        t0 = std::chrono::steady_clock::now();
+        std::string parallel = Diff::generateTextParallel(oldText, newText, pool);
+        double ms = millisSince(t0);
+        if (threads == 1) {
+            reference = parallel;
+            oneThreadMs = ms;
+        }
+        bool same = parallel == reference && Patch::applyDiff(oldText, parallel) == newText;
+        std::cout << std::left << std::setw(14) << (std::to_string(threads) + " threads") << std::right
+                  << std::setw(12) << ms << " ms   speedup " << std::setprecision(2) << oneThreadMs / ms
+                  << "x vs 1 thread, " << sequentialMs / ms << "x vs sequential"
+                  << (same ? "" : "   MISMATCH") << std::setprecision(1) << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+// Commits per second at each durability level: one writer committing in
+// process, then several clients committing to one repository through a
+// server, where batch durability lets commits that queue up together share
+// one journal flush (group commit).
+
+#include "../src/api/server.h"
+#include "../src/core/utils.h"
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static const char* levelName(Durability level) {
+    return level == Durability::None ? "none" : level == Durability::Batch ? "batch" : "strict";
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// A few hundred lines of notes with one line changed per revision
+static std::string revision(int writer, int index) {
+    std::string text;
+    for (int i = 0; i < 300; ++i) text += "line " + std::to_string(i) + " of the shared notes\n";
+    text += "writer " + std::to_string(writer) + " revision " + std::to_string(index) + "\n";
+    return text;
+}
+
+int main() {
+    const std::string repoPath = "./bench_repo_durability";
+    const std::string socketPath = "./bench_durability.sock";
+    const int singleCommits = 300;
+    const int clients = 8;
+    const int clientCommits = 40;
+    const Durability levels[] = {Durability::None, Durability::Batch, Durability::Strict};
+
+    std::cout << "Single writer, " << singleCommits << " commits\n";
+    std::cout << std::left << std::setw(10) << "level" << std::right << std::setw(14) << "commits/s"
+              << std::setw(16) << "journal syncs" << "\n";
+    for (Durability level : levels) {
+        if (fs::exists(repoPath)) fs::remove_all(repoPath);
+        std::ostringstream sink;
+        std::streambuf* saved = std::cout.rdbuf(sink.rdbuf());
+        Repo repo(repoPath);
+        repo.setDurability(level);
+        repo.init();
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < singleCommits; ++i) repo.commit(revision(0, i));
+        double seconds = secondsSince(t0);
+        std::cout.rdbuf(saved);
+        std::cout << std::left << std::setw(10) << levelName(level) << std::right << std::fixed
+                  << std::setprecision(0) << std::setw(14) << singleCommits / seconds
+                  << std::setw(16) << repo.getJournal().syncCount() << "\n";
+    }
+
+    // Each client commits its own files; the server runs the commits on
+    // the repository one at a time
+    fs::create_directories("./bench_durability_inputs");
+    const std::string workDir = fs::current_path().string();
+    for (int c = 0; c < clients; ++c) {
+        for (int i = 0; i < clientCommits; ++i) {
+            std::string path = "./bench_durability_inputs/" + std::to_string(c) + "_" + std::to_string(i) + ".txt";
+            Utils::writeFile(path, revision(c + 1, i));
+        }
+    }
+
+    std::cout << "\n" << clients << " clients through a server, " << clientCommits << " commits each\n";
+    std::cout << std::left << std::setw(10) << "level" << std::right << std::setw(14) << "commits/s" << "\n";
+    for (Durability level : levels) {
+        if (fs::exists(repoPath)) fs::remove_all(repoPath);
+        std::ostringstream sink;
+        std::streambuf* saved = std::cout.rdbuf(sink.rdbuf());
+        Repo(repoPath).init();
+        std::cout.rdbuf(saved);
+
+        RepoOptions options;
+        options.durability = level;
+        Server server(socketPath, options, clients);
+        if (!server.start()) return 1;
+        std::thread loop([&server] { server.run(); });
+
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<std::thread> writers;
+        for (int c = 0; c < clients; ++c) {
+            writers.emplace_back([&, c] {
+                Server::Client client(socketPath);
+                std::string out, err;
+                for (int i = 0; i < clientCommits; ++i) {
+                    Command cmd;
+                    cmd.workDir = workDir;
+                    cmd.name = "commit";
+                    cmd.args = {"./bench_durability_inputs/" + std::to_string(c) + "_" + std::to_string(i) + ".txt"};
+                    client.request(repoPath, cmd, out, err);
+                }
+            });
+        }
+        for (auto& writer : writers) writer.join();
+        double seconds = secondsSince(t0);
+        std::cout << std::left << std::setw(10) << levelName(level) << std::right << std::fixed
+                  << std::setprecision(0) << std::setw(14) << clients * clientCommits / seconds << "\n";
+
+        server.stop();
+        loop.join();
+    }
+
+    fs::remove_all("./bench_durability_inputs");
+    fs::remove_all(repoPath);
+    return 0;
+}
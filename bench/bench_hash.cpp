@@ -0,0 +1,60 @@
+// Hashing throughput in GB/s: the old polynomial Utils::hashString versus
+// SHA-256 on the portable and the SHA-extension code paths.
+
+#include "../src/core/sha256.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+// The placeholder hash Utils::hashString used before the object store
+static std::string polynomialHash(const std::string& input) {
+    unsigned long long hash = 0;
+    for (char c : input) {
+        hash = (hash * 31 + static_cast<unsigned long long>(c)) % 1000000000;
+    }
+    return std::to_string(hash);
+}
+
+template <typename Fn>
+static double gigabytesPerSecond(const std::string& data, Fn hashFn) {
+    // repeat until at least ~256 MB or 0.2 s have been hashed
+    size_t rounds = std::max<size_t>(1, (256u << 20) / std::max<size_t>(data.size(), 1));
+    size_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    size_t done = 0;
+    double seconds = 0;
+    do {
+        for (size_t i = 0; i < rounds; ++i) sink += hashFn(data).size();
+        done += rounds;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (seconds < 0.2);
+    if (sink == 0) std::cout << "";
+    return (double)data.size() * done / seconds / 1e9;
+}
+
+int main() {
+    const std::vector<size_t> sizes = {64, 4096, 1u << 20, 16u << 20};
+    bool hasShaNi = Sha256::accelerated();
+
+    std::cout << "Hash throughput (GB/s), SHA extensions " << (hasShaNi ? "available" : "not available") << "\n";
+    std::cout << std::left << std::setw(12) << "size" << std::right
+              << std::setw(14) << "polynomial" << std::setw(16) << "sha256 portable"
+              << std::setw(16) << "sha256 sha-ni" << "\n";
+
+    for (size_t size : sizes) {
+        std::string data(size, '\0');
+        for (size_t i = 0; i < size; ++i) data[i] = static_cast<char>('a' + (i * 7) % 26);
+
+        double poly = gigabytesPerSecond(data, polynomialHash);
+        Sha256::useAcceleration(false);
+        double portable = gigabytesPerSecond(data, Sha256::hex);
+        Sha256::useAcceleration(true);
+        double fast = hasShaNi ? gigabytesPerSecond(data, Sha256::hex) : 0.0;
+
+        std::cout << std::left << std::setw(12) << size << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(14) << poly << std::setw(16) << portable << std::setw(16) << fast << "\n";
+    }
+    return 0;
+}
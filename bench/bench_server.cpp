@@ -0,0 +1,94 @@
+// Request latency through a resident server against a fresh Repo per
+// command (what every CLI run pays before process start-up is even counted).
+// The server keeps the parsed version log, HEAD and reconstruction cache
+// between requests.
+
+#include "../src/api/server.h"
+#include "../src/cli/commands.h"
+#include "../src/core/utils.h"
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static double microsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+    const std::string repoPath = "./bench_repo_server";
+    const std::string socketPath = "./bench_server.sock";
+    const int versionCount = 1000;
+    const int rounds = 200;
+
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+    std::ostringstream sink;
+    std::streambuf* saved = std::cout.rdbuf(sink.rdbuf());
+    {
+        Repo repo(repoPath);
+        repo.init();
+        std::vector<std::string> lines;
+        for (int i = 0; i < 2000; ++i) lines.push_back("line " + std::to_string(i) + " of the shared notes");
+        size_t next = 0;
+        unsigned seed = 7;
+        repo.commitBatch([&](std::string& text) {
+            if (next++ == versionCount) return false;
+            seed = seed * 1103515245 + 12345;
+            lines[(seed >> 16) % lines.size()] += " edited";
+            text = Utils::joinLines(lines);
+            return true;
+        });
+    }
+    std::cout.rdbuf(saved);
+
+    Server server(socketPath, RepoOptions(), 4);
+    if (!server.start()) return 1;
+    std::thread loop([&server] { server.run(); });
+    Server::Client client(socketPath);
+
+    std::vector<Command> commands(3);
+    commands[0].name = "diff";
+    commands[0].args = {"998", "999"};
+    commands[1].name = "checkout";
+    commands[1].args = {std::to_string(versionCount - 1)};
+    commands[2].name = "checkout";
+    commands[2].args = {std::to_string(versionCount / 2 + 5)};
+
+    std::cout << "Request latency, " << versionCount << " versions, " << rounds << " rounds (microseconds)\n";
+    std::cout << std::left << std::setw(18) << "command" << std::right << std::setw(16) << "fresh Repo"
+              << std::setw(16) << "server" << "\n";
+    for (const auto& cmd : commands) {
+        std::string label = cmd.name + " " + cmd.args[0];
+
+        saved = std::cout.rdbuf(sink.rdbuf());
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds; ++i) {
+            Repo repo(repoPath);
+            CLI::executeCommand(repo, cmd);
+            sink.str("");
+        }
+        double freshUs = microsSince(t0) / rounds;
+        std::cout.rdbuf(saved);
+
+        std::string out, err;
+        client.request(repoPath, cmd, out, err);   // first request opens the repository
+        t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds; ++i) client.request(repoPath, cmd, out, err);
+        double serverUs = microsSince(t0) / rounds;
+
+        std::cout << std::left << std::setw(18) << label << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(16) << freshUs << std::setw(16) << serverUs << "\n";
+    }
+
+    client.close();
+    server.stop();
+    loop.join();
+    fs::remove_all(repoPath);
+    return 0;
+}
@@ -0,0 +1,63 @@
+// Compares line splitting strategies: the old getline-into-strings split
+// against the zero-copy splitLineViews with each newline scanner.
+
+#include "../src/core/utils.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// The splitLines implementation used before splitLineViews
+static std::vector<std::string> getlineSplit(const std::string& text) {
+    std::vector<std::string> lines;
+    std::stringstream ss(text);
+    std::string line;
+    while (std::getline(ss, line)) lines.push_back(line);
+    return lines;
+}
+
+static double millisSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void report(const std::string& name, double ms, size_t bytes, size_t lines) {
+    double mbPerSec = (bytes / (1024.0 * 1024.0)) / (ms / 1000.0);
+    std::cout << std::left << std::setw(18) << name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(12) << ms << std::setw(12) << mbPerSec << std::setw(12) << lines << "\n";
+}
+
+static void runText(const std::string& label, const std::string& text) {
+    const int rounds = 10;
+    std::cout << label << " (" << text.size() << " bytes)\n";
+    std::cout << std::left << std::setw(18) << "splitter" << std::right
+              << std::setw(12) << "ms" << std::setw(12) << "MB/s" << std::setw(12) << "lines" << "\n";
+
+    size_t count = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) count = getlineSplit(text).size();
+    report("getline", millisSince(t0) / rounds, text.size(), count);
+
+    for (const char* scanner : {"memchr", "sse2", "avx2"}) {
+        if (!Utils::useLineScanner(scanner)) continue;
+        t0 = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; ++r) count = Utils::splitLineViews(text).size();
+        report(std::string("views/") + scanner, millisSince(t0) / rounds, text.size(), count);
+    }
+    std::cout << "\n";
+}
+
+int main() {
+    std::string shortLines, longLines;
+    for (int i = 0; i < 400000; ++i) {
+        shortLines += "line " + std::to_string(i) + ": the quick brown fox\n";
+    }
+    for (int i = 0; i < 20000; ++i) {
+        longLines += std::string(400 + i % 200, 'a' + i % 26) + "\n";
+    }
+
+    runText("Short lines", shortLines);
+    runText("Long lines", longLines);
+    return 0;
+}
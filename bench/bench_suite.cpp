@@ -0,0 +1,393 @@
+// The benchmark suite behind `make bench`. It times the core operations,
+// at fixed input sizes, and commit/rollback/metadata loading on synthetic
+// repositories of 10, 1k and 100k versions built by HistoryGenerator.
+// Results are printed as a table and written as JSON; given a saved
+// baseline, every benchmark is compared against it and the run fails if
+// any got slower by more than the threshold.
+//
+// Usage: bench_suite.exe [--sizes 10,1000,100000] [--out results.json]
+//                        [--baseline baseline.json] [--threshold 25]
+//                        [--min-time 200] [--filter substring]
+
+#include "history_generator.h"
+#include "../src/core/diff.h"
+#include "../src/core/patch.h"
+#include "../src/core/repo.h"
+#include "../src/core/utils.h"
+#include "../src/storage/metadata.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct Result {
+    std::string name;
+    size_t iterations = 0;
+    double nsPerOp = 0;
+    size_t bytesPerOp = 0;   // input bytes per operation (0: not a throughput benchmark)
+};
+
+struct Options {
+    std::vector<size_t> sizes = {10, 1000, 100000};
+    std::string out;
+    std::string baseline;
+    double threshold = 25.0;     // percent slower that counts as a regression
+    double minTimeMs = 200.0;    // time spent measuring each benchmark
+    std::string filter;
+};
+
+static Options options;
+static std::vector<Result> results;
+
+static double nanosSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Commands print progress; benchmarks run with std::cout silenced
+class Quiet {
+public:
+    Quiet() : saved(std::cout.rdbuf(sink.rdbuf())) {}
+    ~Quiet() { std::cout.rdbuf(saved); }
+private:
+    std::ostringstream sink;
+    std::streambuf* saved;
+};
+
+static void record(const Result& result) {
+    results.push_back(result);
+    std::cout << std::left << std::setw(40) << result.name << std::right << std::fixed
+              << std::setw(10) << result.iterations << std::setprecision(0) << std::setw(16) << result.nsPerOp;
+    if (result.bytesPerOp) {
+        double mbPerSec = (result.bytesPerOp / (1024.0 * 1024.0)) / (result.nsPerOp / 1e9);
+        std::cout << std::setprecision(1) << std::setw(12) << mbPerSec;
+    }
+    std::cout << "\n";
+}
+
+static bool selected(const std::string& name) {
+    return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+// Time `op` in 5 samples of a calibrated iteration count and record the
+// fastest: noise (other processes, page faults, frequency changes) only
+// ever adds time, so the minimum is the most repeatable figure
+static void measure(const std::string& name, size_t bytesPerOp, const std::function<void()>& op) {
+    if (!selected(name)) return;
+    const int samples = 5;
+    double sampleNs = options.minTimeMs * 1e6 / samples;
+    std::vector<double> perOp;
+    size_t perSample = 1;
+    {
+        Quiet quiet;
+        auto t0 = std::chrono::steady_clock::now();
+        op(); // warm-up, and a first estimate
+        double estimate = std::max(nanosSince(t0), 1.0);
+        perSample = std::max<size_t>(1, static_cast<size_t>(sampleNs / estimate));
+
+        for (int s = 0; s < samples; ++s) {
+            t0 = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < perSample; ++i) op();
+            perOp.push_back(nanosSince(t0) / perSample);
+        }
+    }
+    record({name, perSample * samples, *std::min_element(perOp.begin(), perOp.end()), bytesPerOp});
+}
+
+// Operations on one text, independent of any repository
+static void benchOperations() {
+    for (size_t lineCount : {1000, 100000}) {
+        std::string oldText = HistoryGenerator::makeText(lineCount);
+        std::string newText = HistoryGenerator::editText(oldText);
+        std::string diffText = Diff::generateText(oldText, newText);
+        std::string label = "/" + std::to_string(lineCount) + "_lines";
+
+        measure("split_lines" + label, oldText.size(), [&] { Utils::splitLines(oldText); });
+        measure("hash_string" + label, oldText.size(), [&] { Utils::hashString(oldText); });
+        measure("diff_generate" + label, oldText.size(), [&] { Diff::generate(oldText, newText); });
+        measure("patch_apply" + label, oldText.size(), [&] {
+            if (Patch::applyDiff(oldText, diffText).size() != newText.size()) std::cerr << "Error: patch mismatch\n";
+        });
+    }
+}
+
+// Net diff between two versions 50 commits apart of a 100k-line file:
+// composing the stored diffs against rebuilding both texts and diffing them
+static void benchVersionDiff() {
+    if (!selected("diff_versions")) return;
+    const std::string path = "./bench_repo_compose";
+    fs::remove_all(path);
+    HistoryGenerator history(5, 100000, SIZE_MAX);
+    {
+        Quiet quiet;
+        Repo repo(path);
+        repo.init();
+        repo.commit(history.text());
+        for (int v = 1; v < 60; ++v) repo.commit(history.next());
+    }
+
+    Repo repo(path);
+    std::string hunks;
+    bool composed = false;
+    repo.diffVersions(5, 55, hunks, composed);
+    if (!composed) std::cerr << "Error: the version diff was not composed\n";
+    size_t textBytes = repo.getLatestText().size();
+    measure("diff_versions_composed/100000_lines", textBytes, [&] { repo.diffVersions(5, 55, hunks, composed); });
+    measure("diff_versions_rebuilt/100000_lines", textBytes, [&] {
+        repo.getCache().clear();
+        Diff::generateText(Patch::reconstructVersion(repo, repo.getVersions()[5]),
+                           Patch::reconstructVersion(repo, repo.getVersions()[55]));
+    });
+    fs::remove_all(path);
+}
+
+// Blame of the newest of 100 versions of a 100k-line file: one pass
+// composing every stored diff, and the same continued from a cached blame
+// five versions back
+static void benchBlame() {
+    if (!selected("blame")) return;
+    const std::string path = "./bench_repo_blame";
+    fs::remove_all(path);
+    HistoryGenerator history(7, 100000, SIZE_MAX);
+    {
+        Quiet quiet;
+        Repo repo(path);
+        repo.init();
+        repo.commit(history.text());
+        for (int v = 1; v < 100; ++v) repo.commit(history.next());
+    }
+
+    Repo repo(path);
+    std::vector<int> origins;
+    std::vector<std::string> lines;
+    size_t textBytes = repo.getLatestText().size();
+    measure("blame_full_history/100000_lines", textBytes, [&] {
+        fs::remove_all(path + "/blame");
+        repo.annotate(99, origins, lines);
+    });
+    fs::remove_all(path + "/blame");
+    repo.annotate(94, origins, lines);
+    measure("blame_from_cache/100000_lines", textBytes, [&] {
+        fs::remove(path + "/blame/99");
+        repo.getCache().clear();
+        repo.annotate(99, origins, lines);
+    });
+    fs::remove_all(path);
+}
+
+// Repack of 200 versions of a 10k-line file in which every other commit
+// reverts to an earlier revision: keeping each delta against the previous
+// version, and choosing bases from a window of 10
+static void benchRepackBases() {
+    if (!selected("repack")) return;
+    const std::string path = "./bench_repo_bases";
+    fs::remove_all(path);
+    HistoryGenerator history(11, 10000, SIZE_MAX);
+    {
+        Quiet quiet;
+        Repo repo(path);
+        repo.init();
+        std::vector<std::string> revisions{history.text()};
+        repo.commit(revisions.back());
+        for (int v = 1; v < 200; ++v) {
+            if (v % 2 == 0) {
+                repo.commit(revisions[revisions.size() - 1 - (v / 2) % std::min<size_t>(revisions.size(), 4)]);
+            } else {
+                revisions.push_back(history.next());
+                repo.commit(revisions.back());
+            }
+        }
+    }
+
+    Repo repo(path);
+    measure("repack_keep_bases/200_versions", 0, [&] { repo.repack(RepackOptions{0, 50}); });
+    measure("repack_delta_bases/200_versions", 0, [&] { repo.repack(RepackOptions{10, 50}); });
+    fs::remove_all(path);
+}
+
+// Build a repository of `count` versions from `history` in one commitBatch;
+// returns the nanoseconds it took
+static double buildRepo(const std::string& path, size_t count, HistoryGenerator& history) {
+    fs::remove_all(path);
+    Quiet quiet;
+    Repo(path).init();
+    size_t produced = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    Repo(path).commitBatch([&](std::string& text) {
+        if (produced == count) return false;
+        text = produced == 0 ? history.text() : history.next();
+        ++produced;
+        return true;
+    });
+    return nanosSince(t0);
+}
+
+// Commit, rollback, log queries and metadata loading on a repository of `count` versions
+static void benchRepo(size_t count) {
+    const std::string path = "./bench_repo_suite";
+    const std::string label = "/" + std::to_string(count) + "_versions";
+    HistoryGenerator history(count);
+
+    double buildNs = buildRepo(path, count, history);
+    if (selected("repo_build" + label)) record({"repo_build" + label, count, buildNs / count, 0});
+
+    // What every command pays before it starts: the version log and HEAD
+    measure("repo_open" + label, 0, [&] { Repo(path).getLatestText(); });
+
+    // Paginated log: reads 20 records whatever the history length
+    LogQuery newest;
+    newest.limit = 20;
+    measure("log_latest_20" + label, 0, [&] { Repo(path).log(newest); });
+
+    // The legacy text metadata, written once from the version log
+    // (commitBatch skips a revision identical to its predecessor, so the
+    // repository can hold slightly fewer versions than were generated)
+    const std::string metadataPath = path + "/versions_bench.txt";
+    size_t versionCount = 0;
+    {
+        Repo repo(path);
+        repo.getLatestText();
+        versionCount = repo.getVersions().size();
+        Metadata::saveMetadata(metadataPath, repo.getVersions());
+    }
+    measure("metadata_load" + label, Utils::readFile(metadataPath).size(), [&] {
+        if (Metadata::loadMetadata(metadataPath).size() != versionCount) std::cerr << "Error: metadata mismatch\n";
+    });
+
+    // Search through the index commitBatch kept: a rare line and a common phrase
+    const std::string rare = "#" + std::to_string(count * 3);
+    measure("search_rare" + label, 0, [&] { Repo(path).search(rare); });
+    measure("search_common" + label, 0, [&] { Repo(path).search("config update"); });
+
+    measure("commit" + label, 0, [&] { Repo(path).commit(history.next()); });
+
+    // Rollback reconstructs from the nearest keyframe, then commits the result
+    const std::string outPath = path + "/rollback.txt";
+    int latest = static_cast<int>(versionCount) - 1;
+    measure("rollback_latest" + label, 0, [&] { Repo(path).rollback(latest, outPath); });
+    measure("rollback_middle" + label, 0, [&] { Repo(path).rollback(latest / 2, outPath); });
+
+    fs::remove_all(path);
+}
+
+static void writeJson(const std::string& path) {
+    std::ostringstream json;
+    json << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        json << "    {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations << ", \"ns_per_op\": "
+             << std::fixed << std::setprecision(1) << r.nsPerOp << ", \"bytes_per_op\": " << r.bytesPerOp << "}"
+             << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    json << "  ]\n}\n";
+    if (!Utils::writeFile(path, json.str())) {
+        std::cerr << "Error: cannot write " << path << "\n";
+        return;
+    }
+    std::cout << "Results written to " << path << "\n";
+}
+
+// Name -> ns_per_op from a file written by writeJson (one benchmark per line)
+static std::map<std::string, double> readBaseline(const std::string& path) {
+    std::map<std::string, double> baseline;
+    std::istringstream in(Utils::readFile(path));
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t name = line.find("\"name\": \"");
+        size_t ns = line.find("\"ns_per_op\": ");
+        if (name == std::string::npos || ns == std::string::npos) continue;
+        name += 9;
+        size_t nameEnd = line.find('"', name);
+        if (nameEnd == std::string::npos) continue;
+        baseline[line.substr(name, nameEnd - name)] = std::atof(line.c_str() + ns + 13);
+    }
+    return baseline;
+}
+
+// Print each benchmark against the baseline; returns the number of regressions
+static int compareBaseline(const std::string& path) {
+    std::map<std::string, double> baseline = readBaseline(path);
+    if (baseline.empty()) {
+        std::cerr << "Error: no benchmarks found in baseline " << path << "\n";
+        return 1;
+    }
+
+    std::cout << "\nAgainst baseline " << path << " (regression: more than " << std::setprecision(0)
+              << options.threshold << "% slower)\n";
+    std::cout << std::left << std::setw(40) << "benchmark" << std::right << std::setw(16) << "baseline ns"
+              << std::setw(16) << "now ns" << std::setw(10) << "change" << "\n";
+    int regressions = 0;
+    for (const Result& r : results) {
+        auto it = baseline.find(r.name);
+        std::cout << std::left << std::setw(40) << r.name << std::right;
+        if (it == baseline.end() || it->second <= 0) {
+            std::cout << std::setw(16) << "-" << std::setw(16) << r.nsPerOp << std::setw(10) << "new" << "\n";
+            continue;
+        }
+        double change = (r.nsPerOp / it->second - 1.0) * 100.0;
+        bool regressed = change > options.threshold;
+        regressions += regressed;
+        std::cout << std::setw(16) << it->second << std::setw(16) << r.nsPerOp << std::showpos
+                  << std::setw(9) << change << "%" << std::noshowpos << (regressed ? "  REGRESSION" : "") << "\n";
+    }
+    if (regressions) std::cout << regressions << " benchmark(s) regressed\n";
+    else std::cout << "No regressions\n";
+    return regressions;
+}
+
+static bool parseArgs(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Error: " << arg << " expects a value\n";
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--sizes") {
+            options.sizes.clear();
+            std::istringstream list(value);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                if (!item.empty()) options.sizes.push_back(std::stoul(item));
+            }
+        } else if (arg == "--out") {
+            options.out = value;
+        } else if (arg == "--baseline") {
+            options.baseline = value;
+        } else if (arg == "--threshold") {
+            options.threshold = std::atof(value.c_str());
+        } else if (arg == "--min-time") {
+            options.minTimeMs = std::atof(value.c_str());
+        } else if (arg == "--filter") {
+            options.filter = value;
+        } else {
+            std::cerr << "Error: unknown option " << arg << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (!parseArgs(argc, argv)) return 2;
+
+    std::cout << std::left << std::setw(40) << "benchmark" << std::right << std::setw(10) << "iters"
+              << std::setw(16) << "ns/op" << std::setw(12) << "MB/s" << "\n";
+    benchOperations();
+    benchVersionDiff();
+    benchBlame();
+    benchRepackBases();
+    for (size_t count : options.sizes) benchRepo(count);
+
+    if (!options.out.empty()) writeJson(options.out);
+    if (!options.baseline.empty() && compareBaseline(options.baseline) > 0) return 1;
+    return 0;
+}
@@ -0,0 +1,144 @@
+#pragma once
+// Deterministic synthetic histories for the benchmarks. The same seed
+// always yields the same sequence of revisions, so numbers from different
+// builds (and the saved baseline) measure the same work.
+//
+// Each revision applies one edit pattern seen in real files:
+//   - scattered edits: a few lines rewritten at random places
+//   - appends: lines added at the end (logs, changelogs)
+//   - reorders: a block of lines moved elsewhere
+//   - block churn: a block deleted and new lines inserted elsewhere
+// Appends are balanced by trimming the front once the file reaches
+// maxLines, the way a rotated log behaves, so long histories stay a
+// realistic size instead of growing without bound.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class HistoryGenerator {
+public:
+    explicit HistoryGenerator(uint64_t seed = 42, size_t startLines = 400, size_t maxLines = 800)
+        : state(seed ? seed : 1), maxLines(maxLines) {
+        for (size_t i = 0; i < startLines; ++i) lines.push_back(makeLine());
+    }
+
+    // Text of the current revision
+    std::string text() const {
+        std::string out;
+        size_t total = 0;
+        for (const auto& line : lines) total += line.size() + 1;
+        out.reserve(total);
+        for (const auto& line : lines) {
+            out += line;
+            out += '\n';
+        }
+        return out;
+    }
+
+    // Advance to the next revision and return its text
+    std::string next() {
+        unsigned roll = random() % 100;
+        if (roll < 50) scatteredEdits();
+        else if (roll < 80) append();
+        else if (roll < 90) reorder();
+        else churn();
+        if (lines.size() > maxLines) lines.erase(lines.begin(), lines.begin() + (lines.size() - maxLines));
+        return text();
+    }
+
+    // A text of about `lineCount` lines, for the single-operation benchmarks
+    static std::string makeText(size_t lineCount, uint64_t seed = 7) {
+        HistoryGenerator gen(seed, lineCount, lineCount);
+        return gen.text();
+    }
+
+    // `text` after one revision's worth of edits of every kind
+    static std::string editText(const std::string& text, uint64_t seed = 11) {
+        HistoryGenerator gen(seed, 0, SIZE_MAX);
+        size_t start = 0;
+        while (start < text.size()) {
+            size_t end = text.find('\n', start);
+            if (end == std::string::npos) end = text.size();
+            gen.lines.push_back(text.substr(start, end - start));
+            start = end + 1;
+        }
+        for (int i = 0; i < 8; ++i) gen.scatteredEdits();
+        gen.append();
+        gen.reorder();
+        gen.churn();
+        return gen.text();
+    }
+
+private:
+    std::vector<std::string> lines;
+    uint64_t state;
+    size_t maxLines;
+    size_t serial = 0;
+
+    uint64_t random() {
+        // xorshift64*: fast, and identical on every platform
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return (state * 2685821657736338717ULL) >> 32;
+    }
+
+    std::string makeLine() {
+        static const char* const words[] = {
+            "request", "handler", "config", "update", "value", "return", "buffer", "index",
+            "worker", "status", "result", "offset", "commit", "record", "stream", "cache"
+        };
+        std::string line;
+        switch (random() % 4) {
+        case 0: line = "    "; break;
+        case 1: line = "        "; break;
+        default: break;
+        }
+        size_t count = 3 + random() % 8;
+        for (size_t i = 0; i < count; ++i) {
+            if (i) line += ' ';
+            line += words[random() % 16];
+        }
+        line += " #" + std::to_string(serial++);
+        return line;
+    }
+
+    size_t randomIndex() {
+        return lines.empty() ? 0 : random() % lines.size();
+    }
+
+    void scatteredEdits() {
+        if (lines.empty()) return append();
+        size_t count = 1 + random() % 3;
+        for (size_t i = 0; i < count; ++i) lines[randomIndex()] = makeLine();
+    }
+
+    void append() {
+        size_t count = 1 + random() % 5;
+        for (size_t i = 0; i < count; ++i) lines.push_back(makeLine());
+    }
+
+    void reorder() {
+        if (lines.size() < 20) return scatteredEdits();
+        size_t length = 2 + random() % 9;
+        size_t from = random() % (lines.size() - length);
+        std::vector<std::string> block(lines.begin() + from, lines.begin() + from + length);
+        lines.erase(lines.begin() + from, lines.begin() + from + length);
+        size_t to = random() % (lines.size() + 1);
+        lines.insert(lines.begin() + to, block.begin(), block.end());
+    }
+
+    void churn() {
+        if (lines.size() < 20) return append();
+        size_t length = 1 + random() % 8;
+        size_t from = random() % (lines.size() - length);
+        lines.erase(lines.begin() + from, lines.begin() + from + length);
+        size_t at = random() % (lines.size() + 1);
+        size_t count = 1 + random() % 8;
+        std::vector<std::string> added;
+        for (size_t i = 0; i < count; ++i) added.push_back(makeLine());
+        lines.insert(lines.begin() + at, added.begin(), added.end());
+    }
+};
@@ -0,0 +1,413 @@
+#include "server.h"
+#include "../cli/commands.h"
+#include "../cli/output_capture.h"
+#include "../storage/binary_io.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char REQUEST_MAGIC[4] = {'D', 'S', 'A', 'Q'};
+const char RESPONSE_MAGIC[4] = {'D', 'S', 'A', 'R'};
+const size_t MAX_REQUEST = 1 << 20;         // requests carry paths, not file contents
+const size_t MAX_RESPONSE = size_t(1) << 31;   // a checkout prints the whole text
+const int ACCEPT_POLL_MS = 200;              // how often run() checks for stop()
+
+std::vector<std::string> splitFields(const std::string& payload) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (start <= payload.size()) {
+        size_t end = payload.find('\0', start);
+        if (end == std::string::npos) end = payload.size();
+        fields.push_back(payload.substr(start, end - start));
+        start = end + 1;
+    }
+    return fields;
+}
+
+#ifndef _WIN32
+
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL;   // a vanished client must not raise SIGPIPE
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+bool readAll(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::recv(fd, data, size, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::send(fd, data, size, SEND_FLAGS);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool socketAddress(const std::string& path, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Error: socket path must be 1 to " << sizeof(address.sun_path) - 1
+                  << " characters: " << path << "\n";
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+#endif
+
+} // namespace
+
+Server::Server(const std::string& socketPath, const RepoOptions& options, size_t threads)
+    : socketPath(socketPath), options(options), threadCount(threads == 0 ? 1 : threads) {
+}
+
+Server::~Server() {
+    stop();
+    shutdownWorkers();
+}
+
+#ifndef _WIN32
+
+bool Server::start() {
+    sockaddr_un address;
+    if (!socketAddress(socketPath, address)) return false;
+
+    listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        std::cerr << "Error: cannot create socket: " << std::strerror(errno) << "\n";
+        return false;
+    }
+
+    // A socket file left by a server that is no longer running is replaced;
+    // one that still answers belongs to a live server
+    if (fs::exists(socketPath)) {
+        int probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        bool live = probe >= 0 && ::connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        if (probe >= 0) ::close(probe);
+        if (live) {
+            std::cerr << "Error: a server is already listening on " << socketPath << "\n";
+            ::close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+        ::unlink(socketPath.c_str());
+    }
+
+    if (::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listenFd, 64) != 0) {
+        std::cerr << "Error: cannot listen on " << socketPath << ": " << std::strerror(errno) << "\n";
+        ::close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+
+    stopping = false;
+    OutputCapture::install();
+    for (size_t i = 0; i < threadCount; ++i) {
+        workers.emplace_back(&Server::workerLoop, this);
+    }
+    return true;
+}
+
+void Server::run() {
+    while (!stopping) {
+        pollfd listening = {listenFd, POLLIN, 0};
+        int ready = ::poll(&listening, 1, ACCEPT_POLL_MS);
+        if (ready <= 0) continue;   // timeout, or a signal (stop() may have been called)
+
+        int fd = ::accept(listenFd, nullptr, nullptr);
+        if (fd < 0) continue;
+        {
+            std::lock_guard<std::mutex> guard(queueLock);
+            pending.push_back(fd);
+        }
+        queueReady.notify_one();
+    }
+    shutdownWorkers();
+}
+
+void Server::stop() {
+    stopping = true;
+}
+
+void Server::shutdownWorkers() {
+    {
+        std::lock_guard<std::mutex> guard(queueLock);
+        for (int fd : pending) ::close(fd);
+        pending.clear();
+        // Wake workers blocked reading from an idle client
+        for (int fd : active) ::shutdown(fd, SHUT_RDWR);
+    }
+    queueReady.notify_all();
+    for (auto& worker : workers) worker.join();
+    workers.clear();
+
+    // Only a server that started owns the socket file and an output route
+    if (listenFd >= 0) {
+        ::close(listenFd);
+        listenFd = -1;
+        ::unlink(socketPath.c_str());
+        OutputCapture::release();
+    }
+}
+
+void Server::workerLoop() {
+    while (true) {
+        int fd;
+        {
+            std::unique_lock<std::mutex> guard(queueLock);
+            queueReady.wait(guard, [this] { return stopping || !pending.empty(); });
+            if (stopping) return;
+            fd = pending.front();
+            pending.pop_front();
+            active.push_back(fd);
+        }
+
+        serveConnection(fd);
+
+        {
+            std::lock_guard<std::mutex> guard(queueLock);
+            active.erase(std::find(active.begin(), active.end(), fd));
+        }
+        ::close(fd);
+    }
+}
+
+void Server::serveConnection(int fd) {
+    while (!stopping) {
+        unsigned char header[8];
+        if (!readAll(fd, reinterpret_cast<char*>(header), sizeof(header))) return;
+        uint32_t length = BinaryIO::get32(header + 4);
+        if (std::memcmp(header, REQUEST_MAGIC, 4) != 0 || length > MAX_REQUEST) return;
+
+        std::string payload(length, '\0');
+        if (!readAll(fd, &payload[0], length)) return;
+
+        std::string out, err;
+        uint32_t status;
+        {
+            OutputCapture::Scope capture(out, err);
+            status = handle(payload);
+        }
+
+        unsigned char head[12];
+        unsigned char errLength[4];
+        std::memcpy(head, RESPONSE_MAGIC, 4);
+        BinaryIO::put32(head + 4, status);
+        BinaryIO::put32(head + 8, static_cast<uint32_t>(out.size()));
+        BinaryIO::put32(errLength, static_cast<uint32_t>(err.size()));
+
+        std::string response;
+        response.reserve(sizeof(head) + out.size() + sizeof(errLength) + err.size());
+        response.append(reinterpret_cast<const char*>(head), sizeof(head));
+        response += out;
+        response.append(reinterpret_cast<const char*>(errLength), sizeof(errLength));
+        response += err;
+
+        ++served;
+        if (!writeAll(fd, response.data(), response.size())) return;
+    }
+}
+
+#else
+
+bool Server::start() {
+    std::cerr << "Error: serve needs Unix-domain sockets, which this build does not support.\n";
+    return false;
+}
+
+void Server::run() {
+}
+
+void Server::stop() {
+    stopping = true;
+}
+
+void Server::shutdownWorkers() {
+}
+
+void Server::workerLoop() {
+}
+
+void Server::serveConnection(int) {
+}
+
+#endif
+
+uint32_t Server::handle(const std::string& payload) {
+    std::vector<std::string> fields = splitFields(payload);
+    if (fields.size() < 3 || fields[1].empty() || fields[2].empty()) {
+        std::cerr << "Error: malformed request.\n";
+        return STATUS_BAD_REQUEST;
+    }
+
+    Command cmd;
+    cmd.workDir = fields[0];
+    cmd.name = fields[2];
+    cmd.args.assign(fields.begin() + 3, fields.end());
+
+    // The server's own stdin belongs to no client
+    if (cmd.name == "serve" || (cmd.name == "commit-batch" && !cmd.args.empty() && cmd.args[0] == "-")) {
+        std::cerr << "Error: " << cmd.name << (cmd.name == "serve" ? "" : " -")
+                  << " cannot run through a server; run it directly.\n";
+        return STATUS_BAD_REQUEST;
+    }
+
+    fs::path repoPath(fields[1]);
+    if (repoPath.is_relative() && !cmd.workDir.empty()) repoPath = fs::path(cmd.workDir) / repoPath;
+    OpenRepo& open = openRepo(repoPath.lexically_normal().string());
+
+    uint64_t ticket = 0;
+    {
+        std::lock_guard<std::mutex> guard(open.lock);
+        uint64_t before = open.repo->commitTicket();
+        CLI::executeCommand(*open.repo, cmd);
+        if (open.repo->commitTicket() != before) ticket = open.repo->commitTicket();
+    }
+
+    // Flushed with the repository free, so commits that arrive meanwhile
+    // join the next flush instead of each waiting for its own
+    if (ticket != 0 && !open.repo->waitDurable(ticket)) {
+        std::cerr << "Error: the commit could not be flushed to disk.\n";
+    }
+    return STATUS_OK;
+}
+
+Server::OpenRepo& Server::openRepo(const std::string& path) {
+    std::lock_guard<std::mutex> guard(reposLock);
+    std::unique_ptr<OpenRepo>& slot = repos[path];
+    if (!slot) {
+        slot.reset(new OpenRepo());
+        slot->repo.reset(new Repo(path));
+        slot->repo->configure(options);
+        slot->repo->setGroupCommit(true);
+    }
+    return *slot;
+}
+
+size_t Server::requestsServed() const {
+    return served;
+}
+
+Server::Client::Client(const std::string& socketPath) : socketPath(socketPath) {
+}
+
+Server::Client::~Client() {
+    close();
+}
+
+#ifndef _WIN32
+
+bool Server::Client::connect() {
+    close();
+    sockaddr_un address;
+    if (!socketAddress(socketPath, address)) return false;
+    fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void Server::Client::close() {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+}
+
+bool Server::Client::request(const std::string& repoPath, const Command& cmd, std::string& out, std::string& err) {
+    if (fd < 0 && !connect()) return false;
+
+    std::error_code ec;
+    std::string payload = fs::current_path(ec).string();
+    payload += '\0';
+    payload += fs::absolute(repoPath, ec).lexically_normal().string();
+    payload += '\0';
+    payload += cmd.name;
+    for (const auto& arg : cmd.args) {
+        payload += '\0';
+        payload += arg;
+    }
+    if (payload.size() > MAX_REQUEST) return false;
+
+    unsigned char header[8];
+    std::memcpy(header, REQUEST_MAGIC, 4);
+    BinaryIO::put32(header + 4, static_cast<uint32_t>(payload.size()));
+    if (!writeAll(fd, reinterpret_cast<const char*>(header), sizeof(header)) ||
+        !writeAll(fd, payload.data(), payload.size())) {
+        close();
+        return false;
+    }
+
+    unsigned char reply[12];
+    unsigned char errLength[4];
+    if (!readAll(fd, reinterpret_cast<char*>(reply), sizeof(reply)) ||
+        std::memcmp(reply, RESPONSE_MAGIC, 4) != 0) {
+        close();
+        return false;
+    }
+    size_t outSize = BinaryIO::get32(reply + 8);
+    if (outSize > MAX_RESPONSE) {
+        close();
+        return false;
+    }
+    out.assign(outSize, '\0');
+    if (!readAll(fd, &out[0], outSize) ||
+        !readAll(fd, reinterpret_cast<char*>(errLength), sizeof(errLength))) {
+        close();
+        return false;
+    }
+    size_t errSize = BinaryIO::get32(errLength);
+    if (errSize > MAX_RESPONSE) {
+        close();
+        return false;
+    }
+    err.assign(errSize, '\0');
+    if (!readAll(fd, &err[0], errSize)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+#else
+
+bool Server::Client::connect() {
+    return false;
+}
+
+void Server::Client::close() {
+}
+
+bool Server::Client::request(const std::string&, const Command&, std::string&, std::string&) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,103 @@
+#pragma once
+#include "../cli/parser.h"
+#include "../core/repo.h"
+#include "../core/version.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Long-running repository server (`main.exe serve <socket>`). Repositories
+// are opened with the options the server was started with.
+//
+// Repositories stay open between requests, so their parsed version log, HEAD
+// text and reconstruction cache are reused instead of rebuilt by every CLI
+// run. Clients connect to a Unix-domain socket and send framed requests:
+//
+//   request:  "DSAQ" | length (4) | fields separated by '\0':
+//             working directory, repository path, command, arguments...
+//   response: "DSAR" | status (4) | stdout length (4) | stdout | stderr length (4) | stderr
+//
+// A connection may carry any number of requests. An accept thread hands
+// connections to a small pool of workers; commands on the same repository
+// run one at a time, different repositories in parallel. Whatever a command
+// prints is captured per worker thread and returned in the response.
+//
+// Commits use group commit (Repo::setGroupCommit): a worker flushes the
+// journal only after releasing the repository, and answers once its commit
+// is on disk, so commits that queued up meanwhile share one flush.
+//
+// Not available on Windows (start() reports it and returns false).
+class Server {
+public:
+    // Status codes in a response
+    static const uint32_t STATUS_OK = 0;
+    static const uint32_t STATUS_BAD_REQUEST = 1;
+
+    Server(const std::string& socketPath, const RepoOptions& options, size_t threads = 4);
+    ~Server();
+
+    // Bind the socket and start the workers; false if that fails
+    bool start();
+    // Accept connections until stop() (or SIGINT/SIGTERM when run from main)
+    void run();
+    // Ask run() to return; safe to call from any thread or a signal handler
+    void stop();
+
+    // Number of requests answered so far
+    size_t requestsServed() const;
+
+    // Client side of the protocol: `main.exe --server <socket> <command>`
+    class Client {
+    public:
+        explicit Client(const std::string& socketPath);
+        ~Client();
+
+        bool connect();
+        void close();
+
+        // Run cmd on the repository at repoPath; out and err receive what
+        // it printed. Relative paths in cmd resolve against this process's
+        // working directory. False if the server could not be reached.
+        bool request(const std::string& repoPath, const Command& cmd, std::string& out, std::string& err);
+
+    private:
+        std::string socketPath;
+        int fd = -1;
+    };
+
+private:
+    struct OpenRepo {
+        std::mutex lock;          // one command at a time per repository
+        std::unique_ptr<Repo> repo;
+    };
+
+    std::string socketPath;
+    RepoOptions options;
+    size_t threadCount;
+    int listenFd = -1;
+    std::atomic<bool> stopping{false};
+    std::atomic<size_t> served{0};
+
+    std::vector<std::thread> workers;
+    std::mutex queueLock;
+    std::condition_variable queueReady;
+    std::deque<int> pending;          // accepted connections waiting for a worker
+    std::vector<int> active;          // connections being served (shut down on stop)
+
+    std::mutex reposLock;
+    std::map<std::string, std::unique_ptr<OpenRepo>> repos;
+
+    void workerLoop();
+    void serveConnection(int fd);
+    uint32_t handle(const std::string& payload);   // run one request; returns its status
+    OpenRepo& openRepo(const std::string& path);
+    void shutdownWorkers();
+};
@@ -1,33 +1,178 @@
 #include "commands.h"
-#include <iostream>
+#include "output_capture.h"
+#include "../core/thread_pool.h"
+#include "../core/utils.h"
+#include "../storage/mapped_file.h"
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
 #include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
 
 namespace CLI {
 
+// File arguments are relative to the caller's directory, which for a
+// command forwarded to a server is not the server's
+static std::string resolvePath(const Command& cmd, const std::string& path) {
+    std::filesystem::path p(path);
+    if (cmd.workDir.empty() || p.is_absolute()) return path;
+    return (std::filesystem::path(cmd.workDir) / p).string();
+}
+
+// A decimal count or id: digits only, few enough to fit an int
+static bool isNumber(const std::string& text) {
+    return !text.empty() && text.size() < 10 && text.find_first_not_of("0123456789") == std::string::npos;
+}
+
+// log's filters. A date alone as --until means the end of that day.
+static bool parseLogQuery(const std::vector<std::string>& args, LogQuery& query) {
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string& flag = args[i];
+        if (i + 1 >= args.size()) return false;
+        const std::string& value = args[++i];
+        if (flag == "-n") {
+            if (!isNumber(value)) return false;
+            query.limit = std::stoul(value);
+        } else if (flag == "--since") {
+            if (!Utils::parseTimestamp(value, query.since)) return false;
+        } else if (flag == "--until") {
+            if (!Utils::parseTimestamp(value, query.until)) return false;
+            if (value.size() == 10 && value[4] == '-') query.until += 24 * 60 * 60 - 1;
+        } else if (flag == "--range") {
+            size_t dots = value.find("..");
+            if (dots == std::string::npos) return false;
+            std::string a = value.substr(0, dots), b = value.substr(dots + 2);
+            if ((!a.empty() && !isNumber(a)) || (!b.empty() && !isNumber(b))) return false;
+            query.first = a.empty() ? 0 : std::stoi(a);
+            query.last = b.empty() ? -1 : std::stoi(b);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// blame's arguments: <version> [-L <first>,<last>], lines 1-based and
+// inclusive; either end of the range may be left out
+static bool parseBlameArgs(const std::vector<std::string>& args, int& versionID,
+                           size_t& firstLine, size_t& lastLine) {
+    if (args.empty() || !isNumber(args[0])) return false;
+    versionID = std::stoi(args[0]);
+    if (args.size() == 1) return true;
+    if (args.size() != 3 || args[1] != "-L") return false;
+
+    const std::string& range = args[2];
+    size_t comma = range.find(',');
+    std::string a = range.substr(0, comma);
+    std::string b = comma == std::string::npos ? a : range.substr(comma + 1);
+    if ((!a.empty() && !isNumber(a)) || (!b.empty() && !isNumber(b))) return false;
+    firstLine = a.empty() ? 1 : std::stoul(a);
+    lastLine = b.empty() ? 0 : std::stoul(b);
+    return firstLine > 0 && (lastLine == 0 || lastLine >= firstLine);
+}
+
+// repack's arguments: [--window <versions>] [--depth <diffs>]; a window of
+// 0 keeps every delta's base
+static bool parseRepackArgs(const std::vector<std::string>& args, RepackOptions& options) {
+    for (size_t i = 0; i < args.size(); i += 2) {
+        if (i + 1 >= args.size() || !isNumber(args[i + 1])) return false;
+        if (args[i] == "--window") options.window = std::stoul(args[i + 1]);
+        else if (args[i] == "--depth") options.maxDepth = std::stoi(args[i + 1]);
+        else return false;
+    }
+    return options.maxDepth > 0;
+}
+
 void executeCommand(Repo& repo, const Command& cmd) {
     if (cmd.name == "init") {
         repo.init();
+        bool encrypt = false;
+        for (const auto& arg : cmd.args) encrypt = encrypt || arg == "--encrypt";
+        if (encrypt && !repo.isEncrypted()) repo.enableEncryption();
     } 
     else if (cmd.name == "commit") {
         if (cmd.args.empty()) {
             std::cerr << "Usage: commit <file_path>\n";
             return;
         }
-        // Read text from file
-        std::string fileContent = "";
-        std::ifstream ifs(cmd.args[0]);
-        if (!ifs.is_open()) {
-            std::cerr << "Failed to open file: " << cmd.args[0] << "\n";
-            return;
+        std::string inputPath = resolvePath(cmd, cmd.args[0]);
+        if (repo.exceedsMemoryBudget(Utils::fileSize(inputPath))) {
+            // Too large to diff in memory within the budget
+            repo.commitStreaming(inputPath);
+        } else {
+            // Map the input (pipes such as /dev/stdin are read into a buffer)
+            MappedFile input;
+            if (!input.open(inputPath)) {
+                std::cerr << "Failed to open file: " << cmd.args[0] << "\n";
+                return;
+            }
+            repo.commit(input.view());
         }
-        fileContent.assign((std::istreambuf_iterator<char>(ifs)),
-                           (std::istreambuf_iterator<char>()));
-        ifs.close();
 
-        repo.commit(fileContent);
+        if (repo.getMemoryBudget() > 0) {
+            const size_t MB = 1024 * 1024;
+            size_t peak = Utils::peakMemoryBytes();
+            std::cout << "Peak memory: " << (peak + MB - 1) / MB << " MB (budget " << repo.getMemoryBudget() / MB << " MB)\n";
+            if (peak > repo.getMemoryBudget()) std::cerr << "Warning: peak memory exceeded the budget.\n";
+        }
     } 
+    else if (cmd.name == "commit-batch") {
+        if (cmd.args.empty()) {
+            std::cerr << "Usage: commit-batch <manifest>   (one file path per line)\n"
+                      << "       commit-batch -            (revisions on stdin, separated by NUL bytes)\n";
+            return;
+        }
+
+        if (cmd.args[0] == "-") {
+            std::istream& in = std::cin;
+            repo.commitBatch([&in](std::string& text) {
+                return static_cast<bool>(std::getline(in, text, '\0'));
+            });
+            return;
+        }
+
+        std::ifstream manifest(resolvePath(cmd, cmd.args[0]));
+        if (!manifest.is_open()) {
+            std::cerr << "Failed to open manifest: " << cmd.args[0] << "\n";
+            return;
+        }
+        std::vector<std::string> paths;
+        std::string line;
+        while (std::getline(manifest, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty()) continue;
+            line = resolvePath(cmd, line);
+            if (!Utils::fileExists(line)) {
+                std::cerr << "Failed to open file: " << line << " (nothing committed)\n";
+                return;
+            }
+            paths.push_back(line);
+        }
+
+        // A file that disappears mid-batch ends it; the revisions before it are kept
+        size_t next = 0;
+        repo.commitBatch([&](std::string& text) {
+            if (next == paths.size()) return false;
+            MappedFile input;
+            if (!input.open(paths[next])) {
+                std::cerr << "Failed to open file: " << paths[next] << "\n";
+                return false;
+            }
+            text.assign(input.data(), input.size());
+            ++next;
+            return true;
+        });
+    }
     else if (cmd.name == "log") {
-        repo.log();
+        LogQuery query;
+        if (!parseLogQuery(cmd.args, query)) {
+            std::cerr << "Usage: log [-n <count>] [--since <time>] [--until <time>] [--range <a>..<b>]\n"
+                      << "       <time>: \"YYYY-MM-DD HH:MM:SS\", YYYY-MM-DD or seconds since the epoch\n";
+            return;
+        }
+        repo.log(query);
     } 
     else if (cmd.name == "diff") {
         if (cmd.args.size() < 2) {
@@ -38,6 +183,25 @@ void executeCommand(Repo& repo, const Command& cmd) {
         int b = std::stoi(cmd.args[1]);
         repo.diff(a, b);
     } 
+    else if (cmd.name == "blame") {
+        int versionID = 0;
+        size_t firstLine = 1, lastLine = 0;
+        if (!parseBlameArgs(cmd.args, versionID, firstLine, lastLine)) {
+            std::cerr << "Usage: blame <versionID> [-L <first>,<last>]\n";
+            return;
+        }
+        repo.blame(versionID, firstLine, lastLine);
+    }
+    else if (cmd.name == "search") {
+        if (cmd.args.empty()) {
+            std::cerr << "Usage: search <pattern>\n";
+            return;
+        }
+        // Unquoted words are searched for as one phrase
+        std::string pattern = cmd.args[0];
+        for (size_t i = 1; i < cmd.args.size(); ++i) pattern += " " + cmd.args[i];
+        repo.search(pattern);
+    }
     else if (cmd.name == "checkout") {
         if (cmd.args.empty()) {
             std::cerr << "Usage: checkout <versionID>\n";
@@ -52,12 +216,112 @@ void executeCommand(Repo& repo, const Command& cmd) {
             return;
         }
         int versionID = std::stoi(cmd.args[0]);
-        std::string outputFilePath = cmd.args[1];
+        std::string outputFilePath = resolvePath(cmd, cmd.args[1]);
         repo.rollback(versionID, outputFilePath);
     }
+    else if (cmd.name == "repack") {
+        RepackOptions options;
+        if (!parseRepackArgs(cmd.args, options)) {
+            std::cerr << "Usage: repack [--window <versions>] [--depth <diffs>]\n";
+            return;
+        }
+        repo.repack(options);
+    }
+    else if (cmd.name == "verify") {
+        repo.verify();
+    }
+    else if (cmd.name == "stats") {
+        repo.stats();
+    }
     else {
         std::cerr << "Unknown command: " << cmd.name << "\n";
     }
 }
 
+std::vector<std::string> expandRepoList(const std::string& list) {
+    std::vector<std::string> paths;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) end = list.size();
+        std::string item = list.substr(start, end - start);
+        start = end + 1;
+        if (item.empty()) continue;
+
+        std::vector<std::string> matches = item.find_first_of("*?") == std::string::npos
+            ? std::vector<std::string>{item} : Utils::expandGlob(item);
+        for (const auto& path : matches) {
+            if (Utils::directoryExists(path)) paths.push_back(path);
+        }
+    }
+    return paths;
+}
+
+bool executeAcrossRepos(const std::vector<std::string>& repoPaths, const Command& cmd,
+                        const RepoOptions& options, size_t threads) {
+    if (cmd.name != "log" && cmd.name != "verify" && cmd.name != "stats" && cmd.name != "repack") {
+        std::cerr << "Error: --repos runs log, verify, stats or repack (not " << cmd.name << ").\n";
+        return false;
+    }
+
+    struct Result {
+        std::string out;
+        std::string err;
+        bool ok = true;
+        bool done = false;
+    };
+    std::vector<Result> results(repoPaths.size());
+    std::mutex resultLock;
+    std::condition_variable resultReady;
+
+    auto start = std::chrono::steady_clock::now();
+    OutputCapture::install();
+    {
+        ThreadPool pool(threads);
+        for (size_t i = 0; i < repoPaths.size(); ++i) {
+            pool.submit([&, i] {
+                Result& result = results[i];
+                {
+                    OutputCapture::Scope capture(result.out, result.err);
+                    Repo repo(repoPaths[i]);
+                    repo.configure(options);
+                    if (cmd.name == "verify") {
+                        result.ok = repo.verify();
+                    } else {
+                        executeCommand(repo, cmd);
+                        result.ok = result.err.empty();
+                    }
+                }
+                std::lock_guard<std::mutex> guard(resultLock);
+                result.done = true;
+                resultReady.notify_all();
+            });
+        }
+
+        // Print each repository as soon as it and everything before it is done
+        for (size_t i = 0; i < results.size(); ++i) {
+            std::unique_lock<std::mutex> guard(resultLock);
+            resultReady.wait(guard, [&] { return results[i].done; });
+            guard.unlock();
+            std::cout << "==> " << repoPaths[i] << " <==\n" << results[i].out;
+            std::cerr << results[i].err;
+            std::cout.flush();
+        }
+        threads = pool.size();
+    }
+    OutputCapture::release();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t failed = 0;
+    for (const auto& result : results) {
+        if (!result.ok) ++failed;
+    }
+    std::cout << "\n" << cmd.name << ": " << repoPaths.size() << " repositories in " << std::fixed
+              << std::setprecision(3) << seconds << " s (" << std::setprecision(1)
+              << (seconds > 0 ? repoPaths.size() / seconds : 0.0) << " repos/s, " << threads << " threads)";
+    if (failed > 0) std::cout << ", " << failed << " with errors";
+    std::cout << "\n";
+    return failed == 0;
+}
+
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <vector>
 #include "core/repo.h"
 #include "parser.h"
 
@@ -8,4 +9,16 @@ namespace CLI {
     // Execute a Command on the given Repo
     void executeCommand(Repo& repo, const Command& cmd);
 
+    // Expand "--repos" arguments: comma-separated paths, each of which may be
+    // a glob ("users/*"). Directories only, in the order given, globs sorted.
+    std::vector<std::string> expandRepoList(const std::string& list);
+
+    // Run a read or maintenance command (log, verify, stats, repack) on every
+    // repository using a work-stealing pool of `threads` workers (0 = one per
+    // core). Each repository's output is printed as one block, in list order,
+    // followed by a throughput line. Every repository is opened with
+    // `options`. Returns false if any repository failed.
+    bool executeAcrossRepos(const std::vector<std::string>& repoPaths, const Command& cmd,
+                            const RepoOptions& options, size_t threads);
+
 }
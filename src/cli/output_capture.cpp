@@ -0,0 +1,83 @@
+#include "output_capture.h"
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+
+namespace OutputCapture {
+
+namespace {
+
+// Where this thread's std::cout [0] and std::cerr [1] output goes (null: the real stream)
+thread_local std::string* captured[2] = {nullptr, nullptr};
+
+class RoutedBuffer : public std::streambuf {
+public:
+    RoutedBuffer(std::streambuf* fallback, int stream) : fallback(fallback), stream(stream) {}
+
+    std::streambuf* getFallback() const { return fallback; }
+
+protected:
+    int overflow(int c) override {
+        if (c == traits_type::eof()) return traits_type::not_eof(c);
+        if (std::string* target = captured[stream]) {
+            target->push_back(static_cast<char>(c));
+            return c;
+        }
+        return fallback->sputc(static_cast<char>(c));
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        if (std::string* target = captured[stream]) {
+            target->append(s, static_cast<size_t>(n));
+            return n;
+        }
+        return fallback->sputn(s, n);
+    }
+
+    int sync() override {
+        return captured[stream] ? 0 : fallback->pubsync();
+    }
+
+private:
+    std::streambuf* fallback;
+    int stream;
+};
+
+std::mutex routingLock;
+size_t routingUsers = 0;
+std::unique_ptr<RoutedBuffer> coutRouter;
+std::unique_ptr<RoutedBuffer> cerrRouter;
+
+} // namespace
+
+void install() {
+    std::lock_guard<std::mutex> guard(routingLock);
+    if (routingUsers++ > 0) return;
+    coutRouter.reset(new RoutedBuffer(std::cout.rdbuf(), 0));
+    cerrRouter.reset(new RoutedBuffer(std::cerr.rdbuf(), 1));
+    std::cout.rdbuf(coutRouter.get());
+    std::cerr.rdbuf(cerrRouter.get());
+}
+
+void release() {
+    std::lock_guard<std::mutex> guard(routingLock);
+    if (routingUsers == 0 || --routingUsers > 0) return;
+    std::cout.rdbuf(coutRouter->getFallback());
+    std::cerr.rdbuf(cerrRouter->getFallback());
+    coutRouter.reset();
+    cerrRouter.reset();
+}
+
+Scope::Scope(std::string& out, std::string& err)
+    : previousOut(captured[0]), previousErr(captured[1]) {
+    captured[0] = &out;
+    captured[1] = &err;
+}
+
+Scope::~Scope() {
+    captured[0] = previousOut;
+    captured[1] = previousErr;
+}
+
+}
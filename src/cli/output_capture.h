@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+
+// Commands report through std::cout and std::cerr. To run several of them at
+// once (the server's workers, --repos), both streams can be routed through
+// per-thread buffers: while a Scope is alive on a thread, what that thread
+// prints lands in the Scope's strings, and every other thread still reaches
+// the terminal. Only the buffers are per thread: the stream objects and
+// their format state (width, alignment, precision) are shared, so commands
+// format padded output in a local std::ostringstream first.
+namespace OutputCapture {
+
+    // Route std::cout and std::cerr (reference counted; pair every install
+    // with a release). Scopes only capture while routing is installed.
+    void install();
+    void release();
+
+    class Scope {
+    public:
+        Scope(std::string& out, std::string& err);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        std::string* previousOut;
+        std::string* previousErr;
+    };
+
+}
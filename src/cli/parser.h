@@ -5,6 +5,7 @@
 struct Command {
     std::string name;             // e.g., "init", "commit", "diff"
     std::vector<std::string> args; // command arguments
+    std::string workDir;          // relative file arguments resolve against this ("" = current directory)
 };
 
 // Parse argc/argv into a Command struct
@@ -0,0 +1,69 @@
+#include "arena.h"
+#include <new>
+#include <cstdint>
+
+Arena::Arena(size_t firstBlock) : nextSize(firstBlock == 0 ? 1024 : firstBlock) {
+}
+
+Arena::~Arena() {
+    for (const Block& block : blocks) ::operator delete(block.data);
+}
+
+void Arena::reset() {
+    if (blocks.size() > 1) {
+        // One block as large as the whole round, so the next round fits in it
+        size_t total = 0;
+        for (const Block& block : blocks) {
+            total += block.size;
+            ::operator delete(block.data);
+        }
+        blocks.clear();
+        blocks.push_back({static_cast<char*>(::operator new(total)), total});
+        ++allocations;
+        nextSize = total;
+    }
+    current = 0;
+    used = 0;
+}
+
+size_t Arena::capacity() const {
+    size_t total = 0;
+    for (const Block& block : blocks) total += block.size;
+    return total;
+}
+
+size_t Arena::blocksAllocated() const {
+    return allocations;
+}
+
+void* Arena::do_allocate(size_t bytes, size_t alignment) {
+    for (;;) {
+        if (current < blocks.size()) {
+            const Block& block = blocks[current];
+            uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+            size_t start = static_cast<size_t>(((base + used + alignment - 1) & ~uintptr_t(alignment - 1)) - base);
+            if (start + bytes <= block.size) {
+                used = start + bytes;
+                return block.data + start;
+            }
+            if (current + 1 < blocks.size()) {
+                ++current;
+                used = 0;
+                continue;
+            }
+        }
+
+        // A new block, large enough for the request at any alignment
+        size_t size = nextSize;
+        while (size < bytes + alignment) size *= 2;
+        blocks.push_back({static_cast<char*>(::operator new(size)), size});
+        ++allocations;
+        nextSize = size * 2;
+        current = blocks.size() - 1;
+        used = 0;
+    }
+}
+
+bool Arena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <memory_resource>
+#include <vector>
+#include <cstddef>
+
+// Bump allocator for the temporaries of one operation (line indexes, diff
+// tables, patch scratch). Allocation moves a pointer; deallocation does
+// nothing; reset() forgets everything at once.
+//
+// Unlike std::pmr::monotonic_buffer_resource, reset() keeps the memory:
+// the blocks of a round are merged into one block of their total size, so
+// a loop that resets once per step (one version replayed, one revision
+// committed) stops allocating after its first steps.
+class Arena : public std::pmr::memory_resource {
+public:
+    explicit Arena(size_t firstBlock = 64 * 1024);
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Release everything allocated so far; the memory is kept for reuse
+    void reset();
+
+    // Bytes held in blocks, and blocks obtained from the heap so far
+    size_t capacity() const;
+    size_t blocksAllocated() const;
+
+private:
+    struct Block {
+        char* data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t current = 0;     // block being filled
+    size_t used = 0;        // bytes used in it
+    size_t nextSize;        // size of the next block to allocate
+    size_t allocations = 0;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
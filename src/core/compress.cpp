@@ -0,0 +1,236 @@
+#include "compress.h"
+#include "utils.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace Compress {
+
+namespace {
+
+const size_t MIN_MATCH = 4;
+const size_t MAX_OFFSET = 65535;
+const int MAX_HASH_BITS = 14;
+const size_t WILD_COPY = 16;   // short copies are done as one fixed-size block
+
+inline uint32_t read32(const char* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t hash4(uint32_t v, int bits) {
+    return (v * 2654435761u) >> (32 - bits);
+}
+
+// Lengths past the 4-bit token field continue in 255-valued bytes
+void writeLength(std::string& out, size_t length) {
+    while (length >= 255) {
+        out.push_back(static_cast<char>(255));
+        length -= 255;
+    }
+    out.push_back(static_cast<char>(length));
+}
+
+void emitSequence(std::string& out, const char* literals, size_t literalLength,
+                  size_t offset, size_t matchLength) {
+    size_t matchCode = matchLength - MIN_MATCH;
+    unsigned char token = static_cast<unsigned char>((std::min<size_t>(literalLength, 15) << 4) |
+                                                     std::min<size_t>(matchCode, 15));
+    out.push_back(static_cast<char>(token));
+    if (literalLength >= 15) writeLength(out, literalLength - 15);
+    out.append(literals, literalLength);
+    out.push_back(static_cast<char>(offset & 0xFF));
+    out.push_back(static_cast<char>(offset >> 8));
+    if (matchCode >= 15) writeLength(out, matchCode - 15);
+}
+
+void emitLastLiterals(std::string& out, const char* literals, size_t literalLength) {
+    out.push_back(static_cast<char>(std::min<size_t>(literalLength, 15) << 4));
+    if (literalLength >= 15) writeLength(out, literalLength - 15);
+    out.append(literals, literalLength);
+}
+
+// Compress base[start, end); base[0, start) is the dictionary
+std::string compressRange(const char* base, size_t start, size_t end) {
+    std::string out;
+    out.reserve((end - start) / 2 + 16);
+
+    // Small inputs (most deltas) get a table sized to them
+    int bits = 8;
+    while (bits < MAX_HASH_BITS && (size_t(1) << bits) < end) ++bits;
+    std::vector<int32_t> table(size_t(1) << bits, -1);
+    for (size_t pos = 0; pos + MIN_MATCH <= start; ++pos) {
+        table[hash4(read32(base + pos), bits)] = static_cast<int32_t>(pos);
+    }
+
+    size_t anchor = start;   // first byte not yet emitted
+    size_t pos = start;
+    size_t misses = 0;
+    while (pos + MIN_MATCH <= end) {
+        uint32_t sequence = read32(base + pos);
+        uint32_t h = hash4(sequence, bits);
+        int32_t candidate = table[h];
+        table[h] = static_cast<int32_t>(pos);
+
+        if (candidate < 0 || pos - candidate > MAX_OFFSET || read32(base + candidate) != sequence) {
+            // Incompressible stretches are skipped faster the longer they run
+            pos += 1 + (misses++ >> 6);
+            continue;
+        }
+        misses = 0;
+
+        size_t matchStart = pos;
+        size_t ref = static_cast<size_t>(candidate);
+        // Grow the match backwards over pending literals, then forwards
+        while (matchStart > anchor && ref > 0 && base[matchStart - 1] == base[ref - 1]) {
+            --matchStart;
+            --ref;
+        }
+        size_t matchEnd = pos + MIN_MATCH;
+        size_t refEnd = static_cast<size_t>(candidate) + MIN_MATCH;
+        while (matchEnd < end && base[matchEnd] == base[refEnd]) {
+            ++matchEnd;
+            ++refEnd;
+        }
+
+        emitSequence(out, base + anchor, matchStart - anchor, matchStart - ref, matchEnd - matchStart);
+        anchor = pos = matchEnd;
+
+        // Index a position inside the match so nearby repeats are found
+        if (pos >= 2 && pos + 2 <= end) {
+            table[hash4(read32(base + pos - 2), bits)] = static_cast<int32_t>(pos - 2);
+        }
+    }
+
+    emitLastLiterals(out, base + anchor, end - anchor);
+    return out;
+}
+
+bool readLength(const unsigned char*& p, const unsigned char* end, size_t& length) {
+    unsigned char b;
+    do {
+        if (p >= end) return false;
+        b = *p++;
+        length += b;
+    } while (b == 255);
+    return true;
+}
+
+} // namespace
+
+std::string compress(std::string_view input, std::string_view dictionary) {
+    if (dictionary.empty()) {
+        return compressRange(input.data(), 0, input.size());
+    }
+    // Only the last window of the dictionary is reachable
+    if (dictionary.size() > MAX_OFFSET) dictionary = dictionary.substr(dictionary.size() - MAX_OFFSET);
+    std::string joined;
+    joined.reserve(dictionary.size() + input.size());
+    joined.append(dictionary.data(), dictionary.size());
+    joined.append(input.data(), input.size());
+    return compressRange(joined.data(), dictionary.size(), joined.size());
+}
+
+bool decompress(std::string_view block, size_t rawSize, std::string& out, std::string_view dictionary) {
+    if (dictionary.size() > MAX_OFFSET) dictionary = dictionary.substr(dictionary.size() - MAX_OFFSET);
+
+    out.resize(rawSize);
+    char* const begin = &out[0];
+    char* op = begin;
+    char* const oend = begin + rawSize;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(block.data());
+    const unsigned char* const end = p + block.size();
+
+    while (p < end) {
+        unsigned char token = *p++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(p, end, literalLength)) return false;
+        if (literalLength > size_t(end - p) || literalLength > size_t(oend - op)) return false;
+        if (literalLength <= WILD_COPY && size_t(end - p) >= WILD_COPY && size_t(oend - op) >= WILD_COPY) {
+            std::memcpy(op, p, WILD_COPY);   // may run past the literals; later writes fix that up
+        } else {
+            std::memcpy(op, p, literalLength);
+        }
+        op += literalLength;
+        p += literalLength;
+
+        if (p == end) break;   // the last sequence carries literals only
+
+        if (end - p < 2) return false;
+        size_t offset = p[0] | (size_t(p[1]) << 8);
+        p += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(p, end, matchLength)) return false;
+        matchLength += MIN_MATCH;
+
+        size_t produced = op - begin;
+        if (offset == 0 || offset > produced + dictionary.size()) return false;
+        if (matchLength > size_t(oend - op)) return false;
+
+        // Part of the match may lie in the dictionary
+        if (offset > produced) {
+            size_t fromDict = std::min(offset - produced, matchLength);
+            std::memcpy(op, dictionary.data() + dictionary.size() - (offset - produced), fromDict);
+            op += fromDict;
+            matchLength -= fromDict;
+            if (matchLength == 0) continue;
+        }
+        const char* ref = op - offset;
+        if (offset >= WILD_COPY && matchLength <= WILD_COPY && size_t(oend - op) >= WILD_COPY) {
+            std::memcpy(op, ref, WILD_COPY);
+            op += matchLength;
+        } else if (offset >= matchLength) {
+            std::memcpy(op, ref, matchLength);
+            op += matchLength;
+        } else {
+            // Overlapping copy repeats the last `offset` bytes
+            for (size_t i = 0; i < matchLength; ++i) *op++ = ref[i];
+        }
+    }
+    return op == oend;
+}
+
+std::string trainDictionary(const std::vector<std::string>& samples, size_t maxBytes) {
+    // Count each distinct line once per sample it appears in
+    std::unordered_map<std::string_view, size_t> seenIn;
+    std::unordered_map<std::string_view, size_t> lastSample;
+    for (size_t s = 0; s < samples.size(); ++s) {
+        for (std::string_view line : Utils::splitLineViews(samples[s])) {
+            if (line.size() < MIN_MATCH) continue;
+            auto last = lastSample.find(line);
+            if (last != lastSample.end() && last->second == s + 1) continue;
+            lastSample[line] = s + 1;
+            ++seenIn[line];
+        }
+    }
+
+    std::vector<std::pair<size_t, std::string_view>> ranked;
+    for (const auto& entry : seenIn) {
+        if (entry.second >= 2) ranked.emplace_back(entry.second * (entry.first.size() + 1), entry.first);
+    }
+    std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+
+    std::vector<std::string_view> chosen;
+    size_t total = 0;
+    for (const auto& entry : ranked) {
+        if (total + entry.second.size() + 1 > maxBytes) continue;
+        chosen.push_back(entry.second);
+        total += entry.second.size() + 1;
+    }
+
+    // Most valuable lines last, nearest to the data being compressed
+    std::string dictionary;
+    dictionary.reserve(total);
+    for (auto it = chosen.rbegin(); it != chosen.rend(); ++it) {
+        dictionary.append(it->data(), it->size());
+        dictionary.push_back('\n');
+    }
+    return dictionary;
+}
+
+}
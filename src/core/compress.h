@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+namespace Compress {
+
+    // LZ77 block compressor in the style of LZ4: a token byte holding the
+    // literal and match lengths, the literals, then a 2-byte back-reference
+    // offset (64 KB window). Fast to decode and dependency-free.
+    //
+    // With a dictionary, matches may also point into `dictionary` as if it
+    // preceded the input. Decompression must be given the same dictionary.
+    std::string compress(std::string_view input, std::string_view dictionary = std::string_view());
+
+    // Expand a block produced by compress into exactly rawSize bytes.
+    // Returns false on a malformed block (never reads or writes out of bounds).
+    bool decompress(std::string_view block, size_t rawSize, std::string& out,
+                    std::string_view dictionary = std::string_view());
+
+    // Build a dictionary of at most maxBytes from sample payloads: the lines
+    // that recur most across samples, weighted by the bytes they would save.
+    std::string trainDictionary(const std::vector<std::string>& samples, size_t maxBytes = 16 * 1024);
+
+}
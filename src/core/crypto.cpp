@@ -1,16 +1,649 @@
+#ifdef _WIN32
+#define _CRT_RAND_S            // rand_s, the CRT's wrapper of the system RNG
+#endif
+
 #include "crypto.h"
-#include <string>
+#include "sha256.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CRYPTO_X86 1
+#include <immintrin.h>
+#endif
+
+#ifdef _WIN32
+#include <stdlib.h>
+#endif
 
 namespace Crypto {
 
-std::string encrypt(const std::string& plaintext, const std::string& key) {
-    // Phase 1: no encryption, just return the text
-    return plaintext;
+namespace {
+
+const char MAGIC[4] = {'\0', 'D', 'S', 'E'};
+const unsigned char FORMAT = 1;
+
+inline uint32_t load32(const unsigned char* p) {
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+inline void store32(unsigned char* p, uint32_t v) {
+    p[0] = static_cast<unsigned char>(v);
+    p[1] = static_cast<unsigned char>(v >> 8);
+    p[2] = static_cast<unsigned char>(v >> 16);
+    p[3] = static_cast<unsigned char>(v >> 24);
+}
+
+inline uint32_t rotl(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+#define QUARTER(a, b, c, d)                     \
+    a += b; d ^= a; d = rotl(d, 16);            \
+    c += d; b ^= c; b = rotl(b, 12);            \
+    a += b; d ^= a; d = rotl(d, 8);             \
+    c += d; b ^= c; b = rotl(b, 7);
+
+// Initial state: constants, key, block counter, nonce
+void initState(uint32_t state[16], const Key& key, const unsigned char nonce[NONCE_BYTES], uint32_t counter) {
+    state[0] = 0x61707865;
+    state[1] = 0x3320646e;
+    state[2] = 0x79622d32;
+    state[3] = 0x6b206574;
+    for (int i = 0; i < 8; ++i) state[4 + i] = load32(key.data() + 4 * i);
+    state[12] = counter;
+    for (int i = 0; i < 3; ++i) state[13 + i] = load32(nonce + 4 * i);
+}
+
+void block(const uint32_t state[16], unsigned char out[64]) {
+    uint32_t x[16];
+    std::memcpy(x, state, sizeof(x));
+    for (int round = 0; round < 10; ++round) {
+        QUARTER(x[0], x[4], x[8], x[12]);
+        QUARTER(x[1], x[5], x[9], x[13]);
+        QUARTER(x[2], x[6], x[10], x[14]);
+        QUARTER(x[3], x[7], x[11], x[15]);
+        QUARTER(x[0], x[5], x[10], x[15]);
+        QUARTER(x[1], x[6], x[11], x[12]);
+        QUARTER(x[2], x[7], x[8], x[13]);
+        QUARTER(x[3], x[4], x[9], x[14]);
+    }
+    for (int i = 0; i < 16; ++i) store32(out + 4 * i, x[i] + state[i]);
+}
+
+// Whole blocks: XOR `blocks` * 64 bytes, advancing state[12]
+void xorPortable(uint32_t state[16], const unsigned char* in, unsigned char* out, size_t blocks) {
+    unsigned char stream[64];
+    for (; blocks > 0; --blocks, in += 64, out += 64) {
+        block(state, stream);
+        for (int i = 0; i < 64; ++i) out[i] = in[i] ^ stream[i];
+        ++state[12];
+    }
+}
+
+#ifdef CRYPTO_X86
+
+#define ROTL128(v, n) _mm_or_si128(_mm_slli_epi32(v, n), _mm_srli_epi32(v, 32 - (n)))
+#define QUARTER128(a, b, c, d)                                          \
+    a = _mm_add_epi32(a, b); d = _mm_xor_si128(d, a); d = ROTL128(d, 16); \
+    c = _mm_add_epi32(c, d); b = _mm_xor_si128(b, c); b = ROTL128(b, 12); \
+    a = _mm_add_epi32(a, b); d = _mm_xor_si128(d, a); d = ROTL128(d, 8);  \
+    c = _mm_add_epi32(c, d); b = _mm_xor_si128(b, c); b = ROTL128(b, 7);
+
+// Four blocks at once: lane j of x[i] is word i of block j. The words are
+// transposed back into block order four at a time before the XOR.
+__attribute__((target("sse2")))
+void xorSse2(uint32_t state[16], const unsigned char* in, unsigned char* out, size_t blocks) {
+    for (; blocks >= 4; blocks -= 4, in += 256, out += 256) {
+        __m128i x[16], initial[16];
+        for (int i = 0; i < 16; ++i) initial[i] = _mm_set1_epi32(static_cast<int>(state[i]));
+        initial[12] = _mm_add_epi32(initial[12], _mm_setr_epi32(0, 1, 2, 3));
+        for (int i = 0; i < 16; ++i) x[i] = initial[i];
+
+        for (int round = 0; round < 10; ++round) {
+            QUARTER128(x[0], x[4], x[8], x[12]);
+            QUARTER128(x[1], x[5], x[9], x[13]);
+            QUARTER128(x[2], x[6], x[10], x[14]);
+            QUARTER128(x[3], x[7], x[11], x[15]);
+            QUARTER128(x[0], x[5], x[10], x[15]);
+            QUARTER128(x[1], x[6], x[11], x[12]);
+            QUARTER128(x[2], x[7], x[8], x[13]);
+            QUARTER128(x[3], x[4], x[9], x[14]);
+        }
+        for (int i = 0; i < 16; ++i) x[i] = _mm_add_epi32(x[i], initial[i]);
+
+        for (int g = 0; g < 4; ++g) {
+            __m128i a = x[4 * g], b = x[4 * g + 1], c = x[4 * g + 2], d = x[4 * g + 3];
+            __m128i ab0 = _mm_unpacklo_epi32(a, b), ab1 = _mm_unpackhi_epi32(a, b);
+            __m128i cd0 = _mm_unpacklo_epi32(c, d), cd1 = _mm_unpackhi_epi32(c, d);
+            __m128i rows[4] = {
+                _mm_unpacklo_epi64(ab0, cd0), _mm_unpackhi_epi64(ab0, cd0),
+                _mm_unpacklo_epi64(ab1, cd1), _mm_unpackhi_epi64(ab1, cd1)
+            };
+            for (int j = 0; j < 4; ++j) {
+                size_t offset = 64 * j + 16 * g;
+                __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + offset));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + offset), _mm_xor_si128(data, rows[j]));
+            }
+        }
+        state[12] += 4;
+    }
+    xorPortable(state, in, out, blocks);
 }
 
-std::string decrypt(const std::string& ciphertext, const std::string& key) {
-    // Phase 1: no decryption, just return the text
-    return ciphertext;
+#define ROTL256(v, n) _mm256_or_si256(_mm256_slli_epi32(v, n), _mm256_srli_epi32(v, 32 - (n)))
+#define QUARTER256(a, b, c, d)                                                  \
+    a = _mm256_add_epi32(a, b); d = _mm256_xor_si256(d, a); d = ROTL256(d, 16); \
+    c = _mm256_add_epi32(c, d); b = _mm256_xor_si256(b, c); b = ROTL256(b, 12); \
+    a = _mm256_add_epi32(a, b); d = _mm256_xor_si256(d, a); d = ROTL256(d, 8);  \
+    c = _mm256_add_epi32(c, d); b = _mm256_xor_si256(b, c); b = ROTL256(b, 7);
+
+// Eight blocks at once. After the 4x4 transpose inside each 128-bit half,
+// rows[g][j] holds words 4g..4g+3 of block j (low half) and of block j + 4
+// (high half); pairs of groups are then joined into 32-byte stores.
+__attribute__((target("avx2")))
+void xorAvx2(uint32_t state[16], const unsigned char* in, unsigned char* out, size_t blocks) {
+    for (; blocks >= 8; blocks -= 8, in += 512, out += 512) {
+        __m256i x[16], initial[16];
+        for (int i = 0; i < 16; ++i) initial[i] = _mm256_set1_epi32(static_cast<int>(state[i]));
+        initial[12] = _mm256_add_epi32(initial[12], _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        for (int i = 0; i < 16; ++i) x[i] = initial[i];
+
+        for (int round = 0; round < 10; ++round) {
+            QUARTER256(x[0], x[4], x[8], x[12]);
+            QUARTER256(x[1], x[5], x[9], x[13]);
+            QUARTER256(x[2], x[6], x[10], x[14]);
+            QUARTER256(x[3], x[7], x[11], x[15]);
+            QUARTER256(x[0], x[5], x[10], x[15]);
+            QUARTER256(x[1], x[6], x[11], x[12]);
+            QUARTER256(x[2], x[7], x[8], x[13]);
+            QUARTER256(x[3], x[4], x[9], x[14]);
+        }
+        for (int i = 0; i < 16; ++i) x[i] = _mm256_add_epi32(x[i], initial[i]);
+
+        __m256i rows[4][4];
+        for (int g = 0; g < 4; ++g) {
+            __m256i a = x[4 * g], b = x[4 * g + 1], c = x[4 * g + 2], d = x[4 * g + 3];
+            __m256i ab0 = _mm256_unpacklo_epi32(a, b), ab1 = _mm256_unpackhi_epi32(a, b);
+            __m256i cd0 = _mm256_unpacklo_epi32(c, d), cd1 = _mm256_unpackhi_epi32(c, d);
+            rows[g][0] = _mm256_unpacklo_epi64(ab0, cd0);
+            rows[g][1] = _mm256_unpackhi_epi64(ab0, cd0);
+            rows[g][2] = _mm256_unpacklo_epi64(ab1, cd1);
+            rows[g][3] = _mm256_unpackhi_epi64(ab1, cd1);
+        }
+        for (int j = 0; j < 4; ++j) {
+            for (int half = 0; half < 2; ++half) {
+                // Words 0..7 and 8..15 of block j (selector 0x20) or block j + 4 (0x31)
+                __m256i lo = half ? _mm256_permute2x128_si256(rows[0][j], rows[1][j], 0x31)
+                                  : _mm256_permute2x128_si256(rows[0][j], rows[1][j], 0x20);
+                __m256i hi = half ? _mm256_permute2x128_si256(rows[2][j], rows[3][j], 0x31)
+                                  : _mm256_permute2x128_si256(rows[2][j], rows[3][j], 0x20);
+                size_t offset = 64 * (j + 4 * half);
+                const __m256i* src = reinterpret_cast<const __m256i*>(in + offset);
+                __m256i* dst = reinterpret_cast<__m256i*>(out + offset);
+                _mm256_storeu_si256(dst, _mm256_xor_si256(_mm256_loadu_si256(src), lo));
+                _mm256_storeu_si256(dst + 1, _mm256_xor_si256(_mm256_loadu_si256(src + 1), hi));
+            }
+        }
+        state[12] += 8;
+    }
+    xorSse2(state, in, out, blocks);
 }
 
-}
\ No newline at end of file
+#endif
+
+using XorFn = void (*)(uint32_t*, const unsigned char*, unsigned char*, size_t);
+
+struct Implementation {
+    const char* name;
+    XorFn fn;
+};
+
+bool supported(const std::string& name) {
+    if (name == "portable") return true;
+#ifdef CRYPTO_X86
+    __builtin_cpu_init();
+    if (name == "sse2") return __builtin_cpu_supports("sse2");
+    if (name == "avx2") return __builtin_cpu_supports("avx2");
+#endif
+    return false;
+}
+
+Implementation makeImplementation(const std::string& name) {
+#ifdef CRYPTO_X86
+    if (name == "avx2") return {"avx2", xorAvx2};
+    if (name == "sse2") return {"sse2", xorSse2};
+#endif
+    (void)name;
+    return {"portable", xorPortable};
+}
+
+Implementation pickImplementation() {
+    for (const char* name : {"avx2", "sse2"}) {
+        if (supported(name)) return makeImplementation(name);
+    }
+    return makeImplementation("portable");
+}
+
+Implementation active = pickImplementation();
+
+void chunkNonce(unsigned char nonce[NONCE_BYTES], uint32_t index, bool last) {
+    std::memset(nonce, 0, NONCE_BYTES);
+    nonce[7] = static_cast<unsigned char>(index >> 24);
+    nonce[8] = static_cast<unsigned char>(index >> 16);
+    nonce[9] = static_cast<unsigned char>(index >> 8);
+    nonce[10] = static_cast<unsigned char>(index);
+    nonce[11] = last ? 1 : 0;
+}
+
+Key chunkKeyFor(const Key& key, const unsigned char salt[SALT_BYTES]) {
+    return hmacSha256(std::string_view(reinterpret_cast<const char*>(key.data()), key.size()),
+                      std::string_view(reinterpret_cast<const char*>(salt), SALT_BYTES));
+}
+
+// Poly1305 over aad | pad | ciphertext | pad | lengths, keyed by block 0
+void computeTag(const Key& key, const unsigned char nonce[NONCE_BYTES], std::string_view aad,
+                const unsigned char* ciphertext, size_t length, unsigned char tag[TAG_BYTES]) {
+    uint32_t state[16];
+    unsigned char oneTimeKey[64];
+    initState(state, key, nonce, 0);
+    block(state, oneTimeKey);
+
+    static const unsigned char zeros[16] = {0};
+    Poly1305 mac(oneTimeKey);
+    mac.update(reinterpret_cast<const unsigned char*>(aad.data()), aad.size());
+    mac.update(zeros, (16 - aad.size() % 16) % 16);
+    mac.update(ciphertext, length);
+    mac.update(zeros, (16 - length % 16) % 16);
+    unsigned char lengths[16];
+    uint64_t aadBytes = aad.size(), textBytes = length;
+    for (int i = 0; i < 8; ++i) {
+        lengths[i] = static_cast<unsigned char>(aadBytes >> (8 * i));
+        lengths[8 + i] = static_cast<unsigned char>(textBytes >> (8 * i));
+    }
+    mac.update(lengths, sizeof(lengths));
+    mac.finish(tag);
+}
+
+bool tagsEqual(const unsigned char* a, const unsigned char* b) {
+    unsigned char diff = 0;
+    for (size_t i = 0; i < TAG_BYTES; ++i) diff |= a[i] ^ b[i];
+    return diff == 0;
+}
+
+} // namespace
+
+void chacha20(const Key& key, const unsigned char nonce[NONCE_BYTES], uint32_t counter,
+              const unsigned char* in, unsigned char* out, size_t length) {
+    uint32_t state[16];
+    initState(state, key, nonce, counter);
+    size_t whole = length / 64;
+    active.fn(state, in, out, whole);
+    size_t done = whole * 64;
+    if (done < length) {
+        unsigned char stream[64];
+        block(state, stream);
+        for (size_t i = done; i < length; ++i) out[i] = in[i] ^ stream[i - done];
+    }
+}
+
+const char* implementation() {
+    return active.name;
+}
+
+bool useImplementation(const std::string& name) {
+    if (!supported(name)) return false;
+    active = makeImplementation(name);
+    return true;
+}
+
+// Poly1305 with 26-bit limbs, so every product fits in 64 bits
+Poly1305::Poly1305(const unsigned char key[32]) {
+    r[0] = load32(key) & 0x3ffffff;
+    r[1] = (load32(key + 3) >> 2) & 0x3ffff03;
+    r[2] = (load32(key + 6) >> 4) & 0x3ffc0ff;
+    r[3] = (load32(key + 9) >> 6) & 0x3f03fff;
+    r[4] = (load32(key + 12) >> 8) & 0x00fffff;
+    for (int i = 0; i < 5; ++i) h[i] = 0;
+    for (int i = 0; i < 4; ++i) pad[i] = load32(key + 16 + 4 * i);
+}
+
+void Poly1305::blocks(const unsigned char* data, size_t length, uint32_t hibit) {
+    const uint32_t r0 = r[0], r1 = r[1], r2 = r[2], r3 = r[3], r4 = r[4];
+    const uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+    uint32_t h0 = h[0], h1 = h[1], h2 = h[2], h3 = h[3], h4 = h[4];
+
+    for (; length >= 16; length -= 16, data += 16) {
+        h0 += load32(data) & 0x3ffffff;
+        h1 += (load32(data + 3) >> 2) & 0x3ffffff;
+        h2 += (load32(data + 6) >> 4) & 0x3ffffff;
+        h3 += (load32(data + 9) >> 6) & 0x3ffffff;
+        h4 += (load32(data + 12) >> 8) | hibit;
+
+        uint64_t d0 = uint64_t(h0) * r0 + uint64_t(h1) * s4 + uint64_t(h2) * s3 + uint64_t(h3) * s2 + uint64_t(h4) * s1;
+        uint64_t d1 = uint64_t(h0) * r1 + uint64_t(h1) * r0 + uint64_t(h2) * s4 + uint64_t(h3) * s3 + uint64_t(h4) * s2;
+        uint64_t d2 = uint64_t(h0) * r2 + uint64_t(h1) * r1 + uint64_t(h2) * r0 + uint64_t(h3) * s4 + uint64_t(h4) * s3;
+        uint64_t d3 = uint64_t(h0) * r3 + uint64_t(h1) * r2 + uint64_t(h2) * r1 + uint64_t(h3) * r0 + uint64_t(h4) * s4;
+        uint64_t d4 = uint64_t(h0) * r4 + uint64_t(h1) * r3 + uint64_t(h2) * r2 + uint64_t(h3) * r1 + uint64_t(h4) * r0;
+
+        uint32_t c = static_cast<uint32_t>(d0 >> 26); h0 = static_cast<uint32_t>(d0) & 0x3ffffff;
+        d1 += c; c = static_cast<uint32_t>(d1 >> 26); h1 = static_cast<uint32_t>(d1) & 0x3ffffff;
+        d2 += c; c = static_cast<uint32_t>(d2 >> 26); h2 = static_cast<uint32_t>(d2) & 0x3ffffff;
+        d3 += c; c = static_cast<uint32_t>(d3 >> 26); h3 = static_cast<uint32_t>(d3) & 0x3ffffff;
+        d4 += c; c = static_cast<uint32_t>(d4 >> 26); h4 = static_cast<uint32_t>(d4) & 0x3ffffff;
+        h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+        h1 += c;
+    }
+    h[0] = h0; h[1] = h1; h[2] = h2; h[3] = h3; h[4] = h4;
+}
+
+void Poly1305::update(const unsigned char* data, size_t length) {
+    if (buffered) {
+        size_t take = std::min(length, 16 - buffered);
+        std::memcpy(buffer + buffered, data, take);
+        buffered += take;
+        data += take;
+        length -= take;
+        if (buffered < 16) return;
+        blocks(buffer, 16, 1u << 24);
+        buffered = 0;
+    }
+    size_t whole = length & ~size_t(15);
+    blocks(data, whole, 1u << 24);
+    std::memcpy(buffer, data + whole, length - whole);
+    buffered = length - whole;
+}
+
+void Poly1305::finish(unsigned char tag[TAG_BYTES]) {
+    if (buffered) {
+        // The last partial block gets its 1 bit in the data, not in hibit
+        buffer[buffered] = 1;
+        std::memset(buffer + buffered + 1, 0, 16 - buffered - 1);
+        blocks(buffer, 16, 0);
+    }
+
+    uint32_t h0 = h[0], h1 = h[1], h2 = h[2], h3 = h[3], h4 = h[4];
+    uint32_t c = h1 >> 26; h1 &= 0x3ffffff;
+    h2 += c; c = h2 >> 26; h2 &= 0x3ffffff;
+    h3 += c; c = h3 >> 26; h3 &= 0x3ffffff;
+    h4 += c; c = h4 >> 26; h4 &= 0x3ffffff;
+    h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+    h1 += c;
+
+    // h - p, selected in constant time if h >= p
+    uint32_t g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+    uint32_t g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+    uint32_t g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+    uint32_t g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+    uint32_t g4 = h4 + c - (1u << 26);
+    uint32_t mask = (g4 >> 31) - 1;
+    g0 &= mask; g1 &= mask; g2 &= mask; g3 &= mask; g4 &= mask;
+    mask = ~mask;
+    h0 = (h0 & mask) | g0;
+    h1 = (h1 & mask) | g1;
+    h2 = (h2 & mask) | g2;
+    h3 = (h3 & mask) | g3;
+    h4 = (h4 & mask) | g4;
+
+    // Back to 4 x 32 bits, plus the pad, mod 2^128
+    h0 = h0 | (h1 << 26);
+    h1 = (h1 >> 6) | (h2 << 20);
+    h2 = (h2 >> 12) | (h3 << 14);
+    h3 = (h3 >> 18) | (h4 << 8);
+    uint64_t f = uint64_t(h0) + pad[0];             store32(tag, static_cast<uint32_t>(f));
+    f = uint64_t(h1) + pad[1] + (f >> 32);          store32(tag + 4, static_cast<uint32_t>(f));
+    f = uint64_t(h2) + pad[2] + (f >> 32);          store32(tag + 8, static_cast<uint32_t>(f));
+    f = uint64_t(h3) + pad[3] + (f >> 32);          store32(tag + 12, static_cast<uint32_t>(f));
+}
+
+void seal(const Key& key, const unsigned char nonce[NONCE_BYTES], std::string_view aad,
+          const unsigned char* in, unsigned char* out, size_t length, unsigned char tag[TAG_BYTES]) {
+    chacha20(key, nonce, 1, in, out, length);
+    computeTag(key, nonce, aad, out, length, tag);
+}
+
+bool open(const Key& key, const unsigned char nonce[NONCE_BYTES], std::string_view aad,
+          const unsigned char* in, unsigned char* out, size_t length, const unsigned char tag[TAG_BYTES]) {
+    unsigned char expected[TAG_BYTES];
+    computeTag(key, nonce, aad, in, length, expected);
+    if (!tagsEqual(expected, tag)) return false;
+    chacha20(key, nonce, 1, in, out, length);
+    return true;
+}
+
+std::array<unsigned char, 32> hmacSha256(std::string_view key, std::string_view data) {
+    unsigned char block[64] = {0};
+    if (key.size() > sizeof(block)) {
+        Sha256::Digest hashed = Sha256::digest(key.data(), key.size());
+        std::memcpy(block, hashed.data(), hashed.size());
+    } else {
+        std::memcpy(block, key.data(), key.size());
+    }
+
+    unsigned char pad[64];
+    for (int i = 0; i < 64; ++i) pad[i] = block[i] ^ 0x36;
+    Sha256::Hasher inner;
+    inner.update(pad, sizeof(pad));
+    inner.update(data.data(), data.size());
+    Sha256::Digest innerDigest = inner.finish();
+
+    for (int i = 0; i < 64; ++i) pad[i] = block[i] ^ 0x5c;
+    Sha256::Hasher outer;
+    outer.update(pad, sizeof(pad));
+    outer.update(innerDigest.data(), innerDigest.size());
+    return outer.finish();
+}
+
+void pbkdf2Sha256(std::string_view password, std::string_view salt, uint32_t iterations,
+                  unsigned char* out, size_t length) {
+    // The keyed inner and outer states are the same for every iteration;
+    // hash the padded key once and copy the hasher instead of redoing it
+    unsigned char block[64] = {0};
+    if (password.size() > sizeof(block)) {
+        Sha256::Digest hashed = Sha256::digest(password.data(), password.size());
+        std::memcpy(block, hashed.data(), hashed.size());
+    } else {
+        std::memcpy(block, password.data(), password.size());
+    }
+    unsigned char pad[64];
+    Sha256::Hasher innerKeyed, outerKeyed;
+    for (int i = 0; i < 64; ++i) pad[i] = block[i] ^ 0x36;
+    innerKeyed.update(pad, sizeof(pad));
+    for (int i = 0; i < 64; ++i) pad[i] = block[i] ^ 0x5c;
+    outerKeyed.update(pad, sizeof(pad));
+
+    auto hmac = [&](const unsigned char* data, size_t size) {
+        Sha256::Hasher inner = innerKeyed;
+        inner.update(data, size);
+        Sha256::Digest innerDigest = inner.finish();
+        Sha256::Hasher outer = outerKeyed;
+        outer.update(innerDigest.data(), innerDigest.size());
+        return outer.finish();
+    };
+
+    std::string first(salt);
+    first.append(4, '\0');
+    for (uint32_t blockIndex = 1; length > 0; ++blockIndex) {
+        first[salt.size()] = static_cast<char>(blockIndex >> 24);
+        first[salt.size() + 1] = static_cast<char>(blockIndex >> 16);
+        first[salt.size() + 2] = static_cast<char>(blockIndex >> 8);
+        first[salt.size() + 3] = static_cast<char>(blockIndex);
+
+        Sha256::Digest u = hmac(reinterpret_cast<const unsigned char*>(first.data()), first.size());
+        Sha256::Digest t = u;
+        for (uint32_t i = 1; i < iterations; ++i) {
+            u = hmac(u.data(), u.size());
+            for (size_t j = 0; j < t.size(); ++j) t[j] ^= u[j];
+        }
+        size_t take = std::min(length, t.size());
+        std::memcpy(out, t.data(), take);
+        out += take;
+        length -= take;
+    }
+}
+
+Key deriveKey(std::string_view passphrase, std::string_view salt, uint32_t iterations) {
+    Key key;
+    pbkdf2Sha256(passphrase, salt, iterations, key.data(), key.size());
+    return key;
+}
+
+bool randomBytes(unsigned char* out, size_t length) {
+#ifdef _WIN32
+    for (size_t i = 0; i < length; i += 4) {
+        unsigned int value;
+        if (rand_s(&value) != 0) return false;
+        for (size_t j = 0; j < 4 && i + j < length; ++j) out[i + j] = static_cast<unsigned char>(value >> (8 * j));
+    }
+    return true;
+#else
+    std::ifstream source("/dev/urandom", std::ios::binary);
+    return source.read(reinterpret_cast<char*>(out), static_cast<std::streamsize>(length)) &&
+           static_cast<size_t>(source.gcount()) == length;
+#endif
+}
+
+Encryptor::Encryptor(const Key& key) {
+    if (!randomBytes(salt, SALT_BYTES)) {
+        // Never reuse a key stream: without a random source, fall back to a
+        // salt that is at least unique to this moment and this object
+        Sha256::Hasher hasher;
+        const void* self = this;
+        auto now = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+        hasher.update(&self, sizeof(self));
+        hasher.update(&now, sizeof(now));
+        Sha256::Digest digest = hasher.finish();
+        std::memcpy(salt, digest.data(), SALT_BYTES);
+    }
+    chunkKey = chunkKeyFor(key, salt);
+}
+
+Encryptor::Encryptor(const Key& key, const unsigned char salt[SALT_BYTES]) {
+    std::memcpy(this->salt, salt, SALT_BYTES);
+    chunkKey = chunkKeyFor(key, salt);
+}
+
+std::string Encryptor::header() const {
+    std::string out(MAGIC, sizeof(MAGIC));
+    out += static_cast<char>(FORMAT);
+    out.append(reinterpret_cast<const char*>(salt), SALT_BYTES);
+    return out;
+}
+
+void Encryptor::update(std::string_view piece, std::string& out) {
+    // A full chunk is held until more text arrives: only then is it known
+    // not to be the last
+    while (!piece.empty()) {
+        if (pending.size() == CHUNK_BYTES) {
+            unsigned char nonce[NONCE_BYTES];
+            chunkNonce(nonce, index++, false);
+            size_t at = out.size();
+            out.resize(at + CHUNK_BYTES + TAG_BYTES);
+            unsigned char* dst = reinterpret_cast<unsigned char*>(&out[at]);
+            seal(chunkKey, nonce, std::string_view(), reinterpret_cast<const unsigned char*>(pending.data()),
+                 dst, CHUNK_BYTES, dst + CHUNK_BYTES);
+            pending.clear();
+        }
+        size_t take = std::min(CHUNK_BYTES - pending.size(), piece.size());
+        pending.append(piece.data(), take);
+        piece.remove_prefix(take);
+    }
+}
+
+void Encryptor::finish(std::string& out) {
+    unsigned char nonce[NONCE_BYTES];
+    chunkNonce(nonce, index++, true);
+    size_t at = out.size();
+    out.resize(at + pending.size() + TAG_BYTES);
+    unsigned char* dst = reinterpret_cast<unsigned char*>(&out[at]);
+    seal(chunkKey, nonce, std::string_view(), reinterpret_cast<const unsigned char*>(pending.data()),
+         dst, pending.size(), dst + pending.size());
+    pending.clear();
+}
+
+Decryptor::Decryptor(const Key& key) : key(key) {
+}
+
+bool Decryptor::openChunk(const char* data, size_t length, bool last, std::string& out) {
+    if (length < TAG_BYTES) return false;
+    size_t textBytes = length - TAG_BYTES;
+    unsigned char nonce[NONCE_BYTES];
+    chunkNonce(nonce, index++, last);
+    size_t at = out.size();
+    out.resize(at + textBytes);
+    const unsigned char* src = reinterpret_cast<const unsigned char*>(data);
+    if (!open(chunkKey, nonce, std::string_view(), src, reinterpret_cast<unsigned char*>(&out[at]),
+              textBytes, src + textBytes)) {
+        out.resize(at);
+        return false;
+    }
+    return true;
+}
+
+bool Decryptor::update(std::string_view stored, std::string& out) {
+    if (failed) return false;
+    if (header.size() < HEADER_BYTES) {
+        size_t take = std::min(HEADER_BYTES - header.size(), stored.size());
+        header.append(stored.data(), take);
+        stored.remove_prefix(take);
+        if (header.size() < HEADER_BYTES) return true;
+        if (!isEncrypted(header) || static_cast<unsigned char>(header[4]) != FORMAT) {
+            failed = true;
+            return false;
+        }
+        chunkKey = chunkKeyFor(key, reinterpret_cast<const unsigned char*>(header.data()) + 5);
+    }
+
+    const size_t sealedChunk = CHUNK_BYTES + TAG_BYTES;
+    while (!stored.empty()) {
+        if (pending.size() == sealedChunk) {
+            if (!openChunk(pending.data(), sealedChunk, false, out)) {
+                failed = true;
+                return false;
+            }
+            pending.clear();
+        }
+        size_t take = std::min(sealedChunk - pending.size(), stored.size());
+        pending.append(stored.data(), take);
+        stored.remove_prefix(take);
+    }
+    return true;
+}
+
+bool Decryptor::finish(std::string& out) {
+    if (failed || header.size() < HEADER_BYTES) return false;
+    bool ok = openChunk(pending.data(), pending.size(), true, out);
+    pending.clear();
+    failed = !ok;
+    return ok;
+}
+
+std::string encrypt(std::string_view plaintext, const Key& key) {
+    Encryptor encryptor(key);
+    std::string out = encryptor.header();
+    size_t chunks = plaintext.size() / CHUNK_BYTES + 1;
+    out.reserve(out.size() + plaintext.size() + chunks * TAG_BYTES);
+    encryptor.update(plaintext, out);
+    encryptor.finish(out);
+    return out;
+}
+
+bool decrypt(std::string_view stored, const Key& key, std::string& plaintext) {
+    plaintext.clear();
+    plaintext.reserve(plaintextSize(stored.size()));
+    Decryptor decryptor(key);
+    return decryptor.update(stored, plaintext) && decryptor.finish(plaintext);
+}
+
+bool isEncrypted(std::string_view stored) {
+    return stored.size() >= HEADER_BYTES && stored.compare(0, sizeof(MAGIC), std::string_view(MAGIC, sizeof(MAGIC))) == 0;
+}
+
+size_t plaintextSize(size_t storedSize) {
+    if (storedSize < HEADER_BYTES + TAG_BYTES) return 0;
+    size_t body = storedSize - HEADER_BYTES;
+    size_t chunks = (body + CHUNK_BYTES + TAG_BYTES - 1) / (CHUNK_BYTES + TAG_BYTES);
+    return body - chunks * TAG_BYTES;
+}
+
+}
@@ -1,12 +1,124 @@
 #pragma once
+#include <array>
 #include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
 
+// Encryption at rest: ChaCha20-Poly1305 (RFC 8439) with a key derived from
+// a passphrase by PBKDF2-HMAC-SHA256 (RFC 8018).
+//
+// Stored format of an encrypted file or pack entry:
+//   "\0DSE" | format (1) | salt (16) | chunks
+// Each chunk is up to CHUNK_BYTES of text sealed separately, followed by
+// its 16-byte tag; every chunk but the last is full. The salt is random per
+// object, and the chunk's key is HMAC-SHA256(key, salt), so no two objects
+// share a key stream. A chunk's nonce is its index and a last-chunk flag,
+// so chunks cannot be reordered, dropped or cut off at the end unnoticed.
 namespace Crypto {
 
-    // Encrypt text with a key (stub)
-    std::string encrypt(const std::string& plaintext, const std::string& key);
+    using Key = std::array<unsigned char, 32>;
 
-    // Decrypt text with a key (stub)
-    std::string decrypt(const std::string& ciphertext, const std::string& key);
+    const size_t KEY_BYTES = 32;
+    const size_t NONCE_BYTES = 12;
+    const size_t TAG_BYTES = 16;
+    const size_t SALT_BYTES = 16;
+    const size_t HEADER_BYTES = 5 + SALT_BYTES;
+    const size_t CHUNK_BYTES = 64 * 1024;
+    const uint32_t DEFAULT_ITERATIONS = 100000;
 
-}
\ No newline at end of file
+    // XOR `length` bytes with the ChaCha20 key stream that starts at block `counter`
+    void chacha20(const Key& key, const unsigned char nonce[NONCE_BYTES], uint32_t counter,
+                  const unsigned char* in, unsigned char* out, size_t length);
+
+    // Which ChaCha20 code path is in use ("portable", "sse2" or "avx2"), and
+    // a way to force one (false if this CPU or build lacks it)
+    const char* implementation();
+    bool useImplementation(const std::string& name);
+
+    // Incremental Poly1305 one-time authenticator
+    class Poly1305 {
+    public:
+        explicit Poly1305(const unsigned char key[32]);
+        void update(const unsigned char* data, size_t length);
+        void finish(unsigned char tag[TAG_BYTES]);
+
+    private:
+        uint32_t r[5], h[5], pad[4];
+        unsigned char buffer[16];
+        size_t buffered = 0;
+
+        void blocks(const unsigned char* data, size_t length, uint32_t hibit);
+    };
+
+    // AEAD_CHACHA20_POLY1305: encrypt `length` bytes from `in` to `out` and
+    // produce the tag; open() checks the tag (in constant time) before decrypting
+    void seal(const Key& key, const unsigned char nonce[NONCE_BYTES], std::string_view aad,
+              const unsigned char* in, unsigned char* out, size_t length, unsigned char tag[TAG_BYTES]);
+    bool open(const Key& key, const unsigned char nonce[NONCE_BYTES], std::string_view aad,
+              const unsigned char* in, unsigned char* out, size_t length, const unsigned char tag[TAG_BYTES]);
+
+    // HMAC-SHA256 (RFC 2104) and PBKDF2-HMAC-SHA256 (RFC 8018)
+    std::array<unsigned char, 32> hmacSha256(std::string_view key, std::string_view data);
+    void pbkdf2Sha256(std::string_view password, std::string_view salt, uint32_t iterations,
+                      unsigned char* out, size_t length);
+
+    // The key for a passphrase and a repository's salt
+    Key deriveKey(std::string_view passphrase, std::string_view salt, uint32_t iterations = DEFAULT_ITERATIONS);
+
+    // Bytes from the operating system's random source; false if unavailable
+    bool randomBytes(unsigned char* out, size_t length);
+
+    // Encrypts text piece by piece into the stored format
+    class Encryptor {
+    public:
+        explicit Encryptor(const Key& key);                               // random salt
+        Encryptor(const Key& key, const unsigned char salt[SALT_BYTES]);
+
+        // The header, to be written before anything update() produces
+        std::string header() const;
+        // Append the chunks completed by `piece` to `out`
+        void update(std::string_view piece, std::string& out);
+        // Append the last chunk to `out`
+        void finish(std::string& out);
+
+    private:
+        unsigned char salt[SALT_BYTES];
+        Key chunkKey;
+        std::string pending;
+        uint32_t index = 0;
+    };
+
+    // Decrypts the stored format piece by piece
+    class Decryptor {
+    public:
+        explicit Decryptor(const Key& key);
+
+        // Feed stored bytes (header first). The text of every chunk known not
+        // to be the last is appended to `out`. False if the header or a tag is wrong.
+        bool update(std::string_view stored, std::string& out);
+        // The last chunk; false if it is missing or not authentic
+        bool finish(std::string& out);
+
+    private:
+        Key key;
+        Key chunkKey;
+        std::string header;
+        std::string pending;
+        uint32_t index = 0;
+        bool failed = false;
+
+        bool openChunk(const char* data, size_t length, bool last, std::string& out);
+    };
+
+    // One-shot forms of Encryptor and Decryptor
+    std::string encrypt(std::string_view plaintext, const Key& key);
+    bool decrypt(std::string_view stored, const Key& key, std::string& plaintext);
+
+    // True if `stored` starts with the encrypted format's header
+    bool isEncrypted(std::string_view stored);
+
+    // Text size of an encrypted file of storedSize bytes
+    size_t plaintextSize(size_t storedSize);
+
+}
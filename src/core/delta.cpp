@@ -0,0 +1,217 @@
+#include "delta.h"
+#include "trace.h"
+#include "utils.h"
+#include <algorithm>
+
+namespace Delta {
+
+namespace {
+
+// Copies pieces from one description to the next, a line position at a time
+class Cursor {
+public:
+    Cursor(const std::vector<Piece>& from, std::vector<Piece>& to) : from(from), to(to) {}
+
+    // Copy lines up to position `end` (or as many as remain)
+    void copyTo(size_t end) {
+        while (position < end && index < from.size()) {
+            const Piece& piece = from[index];
+            size_t take = std::min(piece.length - offset, end - position);
+            push(Piece{piece.source, piece.start + offset, take});
+            advance(take);
+        }
+    }
+
+    // Drop the next line
+    void skip() {
+        if (index < from.size()) advance(1);
+    }
+
+    void push(const Piece& piece) {
+        // Keep consecutive lines of the same source as one piece
+        if (!to.empty() && to.back().source == piece.source &&
+            to.back().start + to.back().length == piece.start) {
+            to.back().length += piece.length;
+        } else {
+            to.push_back(piece);
+        }
+    }
+
+    size_t at() const { return position; }
+
+private:
+    const std::vector<Piece>& from;
+    std::vector<Piece>& to;
+    size_t index = 0;      // piece holding the line at `position`
+    size_t offset = 0;     // line within that piece
+    size_t position = 0;
+
+    void advance(size_t lines) {
+        position += lines;
+        offset += lines;
+        if (offset == from[index].length) {
+            ++index;
+            offset = 0;
+        }
+    }
+};
+
+// Old-side start and count of "@@ -a,b +c,d @@"
+bool parseHunkHeader(std::string_view header, size_t& oldStart, size_t& oldCount) {
+    size_t pos = 4;
+    auto number = [&](size_t& value) {
+        size_t begin = pos;
+        value = 0;
+        while (pos < header.size() && header[pos] >= '0' && header[pos] <= '9') {
+            value = value * 10 + (header[pos++] - '0');
+        }
+        return pos > begin;
+    };
+    if (header.compare(0, 4, "@@ -") != 0 || !number(oldStart)) return false;
+    if (pos >= header.size() || header[pos++] != ',') return false;
+    return number(oldCount);
+}
+
+void pushEdit(std::vector<Diff::Edit>& edits, Diff::Op op, size_t oldStart, size_t newStart, size_t length) {
+    if (length == 0) return;
+    if (!edits.empty() && edits.back().op == op) {
+        edits.back().length += length;
+    } else {
+        edits.push_back({op, oldStart, newStart, length});
+    }
+}
+
+} // namespace
+
+Composition::Composition(size_t baseLines) : count(baseLines) {
+    if (baseLines > 0) current.push_back({-1, 0, baseLines});
+}
+
+bool Composition::apply(std::string_view diffText) {
+    TRACE_SCOPE("Delta::apply");
+    std::vector<std::string_view> diffLines = Utils::splitLineViews(diffText);
+    bool hunks = false;
+    for (const auto& dline : diffLines) {
+        if (dline.empty()) continue;
+        hunks = dline.compare(0, 2, "@@") == 0;
+        break;
+    }
+    if (!hunks) {
+        // An empty diff changes nothing but still counts as a step
+        bool empty = std::all_of(diffLines.begin(), diffLines.end(), [](std::string_view l) { return l.empty(); });
+        if (empty) added.emplace_back();
+        return empty;
+    }
+
+    // The same walk as Patch's applyHunks, over pieces instead of lines
+    next.clear();
+    Cursor cursor(current, next);
+    const int source = static_cast<int>(added.size());
+    std::vector<std::string_view> lines;
+    size_t removed = 0;
+    for (const auto& dline : diffLines) {
+        if (dline.empty()) continue;
+        if (dline[0] == '@') {
+            size_t oldStart = 0, oldCount = 0;
+            if (!parseHunkHeader(dline, oldStart, oldCount)) continue;
+            cursor.copyTo(oldCount == 0 ? oldStart : oldStart - 1);
+        } else if (dline[0] == ' ') {
+            cursor.copyTo(cursor.at() + 1);
+        } else if (dline[0] == '-') {
+            if (cursor.at() < count) ++removed;
+            cursor.skip();
+        } else if (dline[0] == '+') {
+            cursor.push({source, lines.size(), 1});
+            lines.push_back(dline.size() > 2 ? dline.substr(2) : std::string_view());
+        }
+    }
+    cursor.copyTo(count);
+    current.swap(next);
+    count = count - removed + lines.size();
+    added.push_back(std::move(lines));
+    return true;
+}
+
+int Composition::steps() const {
+    return static_cast<int>(added.size());
+}
+
+const std::vector<std::string_view>& Composition::addedLines(int step) const {
+    return added[step];
+}
+
+const std::vector<Piece>& Composition::pieces() const {
+    return current;
+}
+
+size_t Composition::lineCount() const {
+    return count;
+}
+
+std::vector<std::string_view> Composition::lines(const std::vector<std::string_view>& baseLines) const {
+    std::vector<std::string_view> out;
+    out.reserve(count);
+    for (const Piece& piece : current) {
+        const std::vector<std::string_view>& from = piece.source < 0 ? baseLines : added[piece.source];
+        out.insert(out.end(), from.begin() + piece.start, from.begin() + piece.start + piece.length);
+    }
+    return out;
+}
+
+std::vector<Diff::Edit> netEdits(const Composition& composition,
+                                 const std::vector<std::string_view>& baseLines,
+                                 const std::vector<std::string_view>& composedLines) {
+    TRACE_SCOPE("Delta::netEdits");
+    std::vector<Diff::Edit> edits;
+    size_t oldPos = 0, newPos = 0;
+    size_t addedFrom = 0, addedCount = 0;   // added lines waiting for the next base run
+
+    // Base lines [oldPos, oldEnd) were removed and the waiting added lines
+    // took their place; diff the two so what survived unchanged shows as such
+    auto changed = [&](size_t oldEnd) {
+        size_t removedCount = oldEnd - oldPos;
+        if (removedCount > 0 && addedCount > 0) {
+            std::vector<std::string_view> before(baseLines.begin() + oldPos, baseLines.begin() + oldEnd);
+            std::vector<std::string_view> after(composedLines.begin() + addedFrom,
+                                                composedLines.begin() + addedFrom + addedCount);
+            for (const Diff::Edit& e : Diff::computeEdits(before, after)) {
+                pushEdit(edits, e.op, oldPos + e.oldStart, addedFrom + e.newStart, e.length);
+            }
+        } else {
+            pushEdit(edits, Diff::Op::Delete, oldPos, addedFrom, removedCount);
+            pushEdit(edits, Diff::Op::Insert, oldEnd, addedFrom, addedCount);
+        }
+        oldPos = oldEnd;
+        addedCount = 0;
+    };
+
+    for (const Piece& piece : composition.pieces()) {
+        if (piece.source >= 0) {
+            if (addedCount == 0) addedFrom = newPos;
+            addedCount += piece.length;
+            newPos += piece.length;
+            continue;
+        }
+        if (addedCount == 0) addedFrom = newPos;
+        changed(piece.start);
+        pushEdit(edits, Diff::Op::Equal, piece.start, newPos, piece.length);
+        oldPos = piece.start + piece.length;
+        newPos += piece.length;
+    }
+    if (addedCount == 0) addedFrom = newPos;
+    changed(baseLines.size());
+    return edits;
+}
+
+std::vector<Diff::Edit> invert(const std::vector<Diff::Edit>& edits) {
+    std::vector<Diff::Edit> inverted;
+    inverted.reserve(edits.size());
+    for (const Diff::Edit& e : edits) {
+        Diff::Op op = e.op == Diff::Op::Insert ? Diff::Op::Delete
+                    : e.op == Diff::Op::Delete ? Diff::Op::Insert : Diff::Op::Equal;
+        inverted.push_back({op, e.newStart, e.oldStart, e.length});
+    }
+    return inverted;
+}
+
+} // namespace Delta
@@ -0,0 +1,61 @@
+#pragma once
+#include "diff.h"
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+// Delta composition: the net change across a chain of stored diffs,
+// without rebuilding the texts in between.
+//
+// A Composition describes a text by where its lines come from: runs of
+// lines of a base text, and runs of lines added by diffs (views into the
+// diff texts). Applying a diff edits this description instead of a text, so
+// a step costs one pass over the pieces plus the diff's own lines, however
+// long the text is; pieces only multiply where the diffs changed something.
+namespace Delta {
+
+    struct Piece {
+        int source;             // apply() step whose diff added these lines (-1: base lines)
+        size_t start;           // the run: lines [start, start + length) of the base,
+        size_t length;          // or of what that step added, in order
+    };
+
+    class Composition {
+    public:
+        // The base text itself, `baseLines` lines long
+        explicit Composition(size_t baseLines);
+
+        // Apply one stored diff in hunk form (Diff::appendHunks), as
+        // Patch::applyDiff would, as step steps() - 1. Added lines are views
+        // into diffText, which must outlive the composition. Returns false,
+        // changing nothing, for the older headerless format, which carries
+        // no line positions.
+        bool apply(std::string_view diffText);
+        int steps() const;
+
+        // The lines step `step` added, in the order its diff lists them
+        const std::vector<std::string_view>& addedLines(int step) const;
+
+        const std::vector<Piece>& pieces() const;
+        size_t lineCount() const;
+
+        // The described text's lines, given the base's
+        std::vector<std::string_view> lines(const std::vector<std::string_view>& baseLines) const;
+
+    private:
+        std::vector<Piece> current;
+        std::vector<Piece> next;     // built by apply, then swapped in
+        std::vector<std::vector<std::string_view>> added;   // lines added by each step
+        size_t count;
+    };
+
+    // Net edit script from the base to the composed text (in Diff's form).
+    // Each changed region is diffed again, so a line deleted by one diff and
+    // added back by a later one cancels out.
+    std::vector<Diff::Edit> netEdits(const Composition& composition,
+                                     const std::vector<std::string_view>& baseLines,
+                                     const std::vector<std::string_view>& composedLines);
+
+    // The same script seen from the other side (new to old)
+    std::vector<Diff::Edit> invert(const std::vector<Diff::Edit>& edits);
+}
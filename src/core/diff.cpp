@@ -1,44 +1,808 @@
 #include "diff.h"
+#include "thread_pool.h"
+#include "trace.h"
 #include "utils.h"
 
 #include <vector>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <algorithm>
+#include <charconv>
+#include <deque>
+#include <cstdint>
+#include <functional>
 
 namespace Diff {
 
-std::vector<std::string> generate(const std::string& oldText, const std::string& newText) {
-    std::vector<std::string> oldLines = Utils::splitLines(oldText);
-    std::vector<std::string> newLines = Utils::splitLines(newText);
-    std::vector<std::string> diff;
+namespace {
 
-    size_t oldSize = oldLines.size();
-    size_t newSize = newLines.size();
-    size_t i = 0, j = 0;
+// Past this many edit steps in one sub-problem the search stops looking for
+// the exact middle snake and splits at the furthest forward point instead
+// (the same trade-off GNU diff makes), keeping worst-case cost bounded.
+const int COST_LIMIT = 1024;
 
-    while (i < oldSize || j < newSize) {
-        if (i < oldSize && j < newSize) {
-            if (oldLines[i] == newLines[j]) {
-                // same line, skip
-                ++i; ++j;
-            } else {
-                // line changed: mark deletion and addition
-                diff.push_back("- " + oldLines[i]);
-                diff.push_back("+ " + newLines[j]);
-                ++i; ++j;
-            }
-        } else if (i < oldSize) {
-            // leftover deletions
-            diff.push_back("- " + oldLines[i]);
+// Linear-space Myers diff over interned line ids.
+// Marks removed old lines and added new lines; everything else is common.
+struct Myers {
+    const int* a;
+    const int* b;
+    std::pmr::vector<char>& removed;
+    std::pmr::vector<char>& added;
+    std::pmr::vector<int> v1, v2;   // furthest-reaching paths, reused across calls
+
+    Myers(const int* a_, const int* b_, std::pmr::vector<char>& removed_, std::pmr::vector<char>& added_,
+          std::pmr::memory_resource* scratch)
+        : a(a_), b(b_), removed(removed_), added(added_), v1(scratch), v2(scratch) {}
+
+    void diff(int aLo, int aHi, int bLo, int bHi) {
+        // trim common prefix/suffix of this sub-problem
+        while (aLo < aHi && bLo < bHi && a[aLo] == b[bLo]) { ++aLo; ++bLo; }
+        while (aLo < aHi && bLo < bHi && a[aHi - 1] == b[bHi - 1]) { --aHi; --bHi; }
+
+        if (aLo == aHi) {
+            std::fill(added.begin() + bLo, added.begin() + bHi, 1);
+            return;
+        }
+        if (bLo == bHi) {
+            std::fill(removed.begin() + aLo, removed.begin() + aHi, 1);
+            return;
+        }
+
+        int x, y;
+        if (!bisect(aLo, aHi, bLo, bHi, x, y)) {
+            // no common line at all
+            std::fill(removed.begin() + aLo, removed.begin() + aHi, 1);
+            std::fill(added.begin() + bLo, added.begin() + bHi, 1);
+            return;
+        }
+        diff(aLo, x, bLo, y);
+        diff(x, aHi, y, bHi);
+    }
+
+    // Find the middle snake of the shortest edit path; (xs, ys) is the split point
+    bool bisect(int aLo, int aHi, int bLo, int bHi, int& xs, int& ys) {
+        const int n = aHi - aLo;
+        const int m = bHi - bLo;
+        const int maxD = (n + m + 1) / 2;
+        const int vOffset = maxD;
+        const int vLength = 2 * maxD + 2;   // room for k = maxD + 1, which d = 0 seeds
+        v1.assign(vLength, -1);
+        v2.assign(vLength, -1);
+        v1[vOffset + 1] = 0;
+        v2[vOffset + 1] = 0;
+
+        const int delta = n - m;
+        const bool front = (delta % 2 != 0);   // forward path detects the overlap
+        int k1start = 0, k1end = 0, k2start = 0, k2end = 0;
+
+        for (int d = 0; d < maxD; ++d) {
+            // forward path
+            for (int k1 = -d + k1start; k1 <= d - k1end; k1 += 2) {
+                const int k1Offset = vOffset + k1;
+                int x1;
+                if (k1 == -d || (k1 != d && v1[k1Offset - 1] < v1[k1Offset + 1])) {
+                    x1 = v1[k1Offset + 1];
+                } else {
+                    x1 = v1[k1Offset - 1] + 1;
+                }
+                int y1 = x1 - k1;
+                while (x1 < n && y1 < m && a[aLo + x1] == b[bLo + y1]) { ++x1; ++y1; }
+                v1[k1Offset] = x1;
+
+                if (x1 > n) {
+                    k1end += 2;      // ran off the right of the grid
+                } else if (y1 > m) {
+                    k1start += 2;    // ran off the bottom of the grid
+                } else if (front) {
+                    const int k2Offset = vOffset + delta - k1;
+                    if (k2Offset >= 0 && k2Offset < vLength && v2[k2Offset] != -1) {
+                        if (x1 >= n - v2[k2Offset]) {
+                            xs = aLo + x1;
+                            ys = bLo + y1;
+                            return true;
+                        }
+                    }
+                }
+            }
+
+            if (d >= COST_LIMIT) {
+                // too expensive: split where the forward search got furthest
+                int best = -1;
+                for (int k1 = -d + k1start; k1 <= d - k1end; k1 += 2) {
+                    const int x1 = v1[vOffset + k1];
+                    const int y1 = x1 - k1;
+                    if (x1 <= n && y1 <= m && x1 + y1 > best) {
+                        best = x1 + y1;
+                        xs = aLo + x1;
+                        ys = bLo + y1;
+                    }
+                }
+                if (best > 0) return true;
+            }
+
+            // reverse path
+            for (int k2 = -d + k2start; k2 <= d - k2end; k2 += 2) {
+                const int k2Offset = vOffset + k2;
+                int x2;
+                if (k2 == -d || (k2 != d && v2[k2Offset - 1] < v2[k2Offset + 1])) {
+                    x2 = v2[k2Offset + 1];
+                } else {
+                    x2 = v2[k2Offset - 1] + 1;
+                }
+                int y2 = x2 - k2;
+                while (x2 < n && y2 < m && a[aHi - 1 - x2] == b[bHi - 1 - y2]) { ++x2; ++y2; }
+                v2[k2Offset] = x2;
+
+                if (x2 > n) {
+                    k2end += 2;
+                } else if (y2 > m) {
+                    k2start += 2;
+                } else if (!front) {
+                    const int k1Offset = vOffset + delta - k2;
+                    if (k1Offset >= 0 && k1Offset < vLength && v1[k1Offset] != -1) {
+                        const int x1 = v1[k1Offset];
+                        const int y1 = vOffset + x1 - k1Offset;
+                        if (x1 >= n - x2) {
+                            xs = aLo + x1;
+                            ys = bLo + y1;
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+        return false;
+    }
+};
+
+// Append one line run to the edit script, merging with the previous run when possible
+void pushEdit(std::vector<Edit>& edits, Op op, size_t oldPos, size_t newPos) {
+    if (!edits.empty()) {
+        Edit& last = edits.back();
+        if (last.op == op) {
+            ++last.length;
+            return;
+        }
+    }
+    edits.push_back({op, oldPos, newPos, 1});
+}
+
+std::string hunkRange(size_t start, size_t count) {
+    // unified convention: an empty range names the line before it
+    return std::to_string(count == 0 ? start : start + 1) + "," + std::to_string(count);
+}
+
+} // namespace
+
+namespace {
+
+// computeEdits over plain arrays of lines, with its tables in `scratch`
+std::vector<Edit> editsBetween(const std::string_view* oldLines, size_t oldSize,
+                               const std::string_view* newLines, size_t newSize,
+                               std::pmr::memory_resource* scratch) {
+    TRACE_SCOPE("Diff::computeEdits");
+    // Cheap prefix/suffix trim before any hashing
+    size_t prefix = 0;
+    while (prefix < oldSize && prefix < newSize && oldLines[prefix] == newLines[prefix]) ++prefix;
+    size_t suffix = 0;
+    while (suffix < oldSize - prefix && suffix < newSize - prefix &&
+           oldLines[oldSize - 1 - suffix] == newLines[newSize - 1 - suffix]) ++suffix;
+
+    const size_t n = oldSize - prefix - suffix;
+    const size_t m = newSize - prefix - suffix;
+
+    // Intern the middle section so the O(ND) loop compares ints, not strings
+    std::pmr::unordered_map<std::string_view, int> ids(scratch);
+    ids.reserve(n + m);
+    std::pmr::vector<int> a(n, scratch), b(m, scratch);
+    for (size_t i = 0; i < n; ++i) {
+        a[i] = ids.emplace(oldLines[prefix + i], (int)ids.size()).first->second;
+    }
+    for (size_t j = 0; j < m; ++j) {
+        b[j] = ids.emplace(newLines[prefix + j], (int)ids.size()).first->second;
+    }
+
+    std::pmr::vector<char> removed(n, 0, scratch), added(m, 0, scratch);
+    if (n > 0 || m > 0) {
+        Myers myers(a.data(), b.data(), removed, added, scratch);
+        myers.diff(0, (int)n, 0, (int)m);
+    }
+
+    std::vector<Edit> edits;
+    if (prefix > 0) edits.push_back({Op::Equal, 0, 0, prefix});
+
+    size_t i = 0, j = 0;
+    while (i < n || j < m) {
+        if (i < n && (removed[i] || j == m)) {
+            pushEdit(edits, Op::Delete, prefix + i, prefix + j);
             ++i;
-        } else if (j < newSize) {
-            // leftover additions
-            diff.push_back("+ " + newLines[j]);
+        } else if (j < m && (added[j] || i == n)) {
+            pushEdit(edits, Op::Insert, prefix + i, prefix + j);
             ++j;
+        } else {
+            pushEdit(edits, Op::Equal, prefix + i, prefix + j);
+            ++i; ++j;
+        }
+    }
+
+    if (suffix > 0) {
+        if (!edits.empty() && edits.back().op == Op::Equal) {
+            edits.back().length += suffix;
+        } else {
+            edits.push_back({Op::Equal, prefix + n, prefix + m, suffix});
+        }
+    }
+    return edits;
+}
+
+} // namespace
+
+std::vector<Edit> computeEdits(const std::vector<std::string_view>& oldLines,
+                               const std::vector<std::string_view>& newLines) {
+    return editsBetween(oldLines.data(), oldLines.size(), newLines.data(), newLines.size(),
+                        std::pmr::get_default_resource());
+}
+
+std::vector<Edit> computeEdits(const std::pmr::vector<std::string_view>& oldLines,
+                               const std::pmr::vector<std::string_view>& newLines,
+                               std::pmr::memory_resource* scratch) {
+    return editsBetween(oldLines.data(), oldLines.size(), newLines.data(), newLines.size(), scratch);
+}
+
+namespace {
+
+// Parallel diff regions hold at least this many lines (old + new), and there
+// are never more than MAX_REGIONS of them, whatever the thread count
+const size_t MIN_REGION_LINES = 8 * 1024;
+const size_t MAX_REGIONS = 256;
+const size_t HASH_CHUNK = 64 * 1024;   // lines hashed per task
+// Only lines whose hash falls in 1 of ANCHOR_SAMPLE buckets are considered
+// as anchors: regions need one cut every few thousand lines, not a match
+// for every line, and counting fewer lines keeps the setup cheap
+const size_t ANCHOR_SAMPLE = 16;
+
+struct LineKey {
+    std::string_view text;
+    size_t hash;
+    bool operator==(const LineKey& other) const { return hash == other.hash && text == other.text; }
+};
+
+struct LineKeyHash {
+    size_t operator()(const LineKey& key) const { return key.hash; }
+};
+
+// A pair of equal lines matched before the regions are diffed
+struct Anchor {
+    size_t oldPos;
+    size_t newPos;
+};
+
+struct LineCount {
+    size_t oldCount = 0;
+    size_t newCount = 0;
+    size_t oldPos = 0;
+    size_t newPos = 0;
+};
+
+// A sampled line: its index and hash
+struct HashedLine {
+    size_t index;
+    size_t hash;
+};
+
+// Hash lines [lo, hi) in chunks, keep the sample, and sort it into shards
+// by hash so each shard can be counted by one task without locking
+void sampleIntoShards(const std::vector<std::string_view>& lines, size_t lo, size_t hi, size_t shards,
+                      ThreadPool& pool, std::vector<std::vector<std::vector<HashedLine>>>& byChunk) {
+    size_t chunks = (hi - lo + HASH_CHUNK - 1) / HASH_CHUNK;
+    byChunk.assign(chunks, std::vector<std::vector<HashedLine>>(shards));
+    for (size_t c = 0; c < chunks; ++c) {
+        pool.submit([&lines, &byChunk, lo, hi, shards, c] {
+            std::hash<std::string_view> hasher;
+            size_t begin = lo + c * HASH_CHUNK;
+            size_t end = std::min(hi, begin + HASH_CHUNK);
+            for (size_t i = begin; i < end; ++i) {
+                size_t h = hasher(lines[i]);
+                if ((h >> 32) % ANCHOR_SAMPLE != 0) continue;
+                byChunk[c][h % shards].push_back({i, h});
+            }
+        });
+    }
+}
+
+// Sampled lines that occur exactly once in old[oldLo, oldHi) and once in
+// new[newLo, newHi), as (old, new) position pairs ordered by new position
+std::vector<Anchor> uniqueMatches(const std::vector<std::string_view>& oldLines, size_t oldLo, size_t oldHi,
+                                  const std::vector<std::string_view>& newLines, size_t newLo, size_t newHi,
+                                  ThreadPool& pool) {
+    // Which lines are sampled and unique depends only on their content, so
+    // the result does not depend on the shard count
+    const size_t shards = std::max<size_t>(1, pool.size());
+    std::vector<std::vector<std::vector<HashedLine>>> oldByChunk, newByChunk;
+    sampleIntoShards(oldLines, oldLo, oldHi, shards, pool, oldByChunk);
+    sampleIntoShards(newLines, newLo, newHi, shards, pool, newByChunk);
+    pool.wait();
+
+    std::vector<std::vector<Anchor>> found(shards);
+    for (size_t s = 0; s < shards; ++s) {
+        pool.submit([&, s] {
+            std::unordered_map<LineKey, LineCount, LineKeyHash> counts;
+            for (const auto& chunk : oldByChunk) {
+                for (const HashedLine& line : chunk[s]) {
+                    LineCount& count = counts[LineKey{oldLines[line.index], line.hash}];
+                    if (count.oldCount++ == 0) count.oldPos = line.index;
+                }
+            }
+            for (const auto& chunk : newByChunk) {
+                for (const HashedLine& line : chunk[s]) {
+                    auto it = counts.find(LineKey{newLines[line.index], line.hash});
+                    if (it == counts.end() || it->second.oldCount != 1) continue;
+                    if (it->second.newCount++ == 0) it->second.newPos = line.index;
+                }
+            }
+            for (const auto& entry : counts) {
+                if (entry.second.oldCount == 1 && entry.second.newCount == 1) {
+                    found[s].push_back({entry.second.oldPos, entry.second.newPos});
+                }
+            }
+        });
+    }
+    pool.wait();
+
+    std::vector<Anchor> matches;
+    for (const auto& shard : found) matches.insert(matches.end(), shard.begin(), shard.end());
+    std::sort(matches.begin(), matches.end(), [](const Anchor& x, const Anchor& y) {
+        return x.newPos < y.newPos;
+    });
+    return matches;
+}
+
+// Longest subsequence of matches (ordered by new position) whose old
+// positions also increase: the anchors patience diff keeps
+std::vector<Anchor> longestIncreasing(const std::vector<Anchor>& matches) {
+    std::vector<size_t> tails;                         // index of the smallest tail per length
+    std::vector<size_t> previous(matches.size(), SIZE_MAX);
+    for (size_t i = 0; i < matches.size(); ++i) {
+        auto pos = std::lower_bound(tails.begin(), tails.end(), matches[i].oldPos,
+                                    [&](size_t t, size_t oldPos) { return matches[t].oldPos < oldPos; });
+        if (pos != tails.begin()) previous[i] = *(pos - 1);
+        if (pos == tails.end()) tails.push_back(i); else *pos = i;
+    }
+    std::vector<Anchor> chain(tails.size());
+    size_t at = tails.empty() ? SIZE_MAX : tails.back();
+    for (size_t k = chain.size(); k-- > 0; at = previous[at]) chain[k] = matches[at];
+    return chain;
+}
+
+// Append a run, merging it into the previous run of the same operation
+void appendRun(std::vector<Edit>& edits, const Edit& run) {
+    if (run.length == 0) return;
+    if (!edits.empty() && edits.back().op == run.op) {
+        edits.back().length += run.length;
+    } else {
+        edits.push_back(run);
+    }
+}
+
+} // namespace
+
+std::vector<Edit> computeEditsParallel(const std::vector<std::string_view>& oldLines,
+                                       const std::vector<std::string_view>& newLines,
+                                       ThreadPool& pool) {
+    TRACE_SCOPE("Diff::computeEditsParallel");
+    const size_t oldSize = oldLines.size();
+    const size_t newSize = newLines.size();
+
+    size_t prefix = 0;
+    while (prefix < oldSize && prefix < newSize && oldLines[prefix] == newLines[prefix]) ++prefix;
+    size_t suffix = 0;
+    while (suffix < oldSize - prefix && suffix < newSize - prefix &&
+           oldLines[oldSize - 1 - suffix] == newLines[newSize - 1 - suffix]) ++suffix;
+
+    const size_t oldHi = oldSize - suffix;
+    const size_t newHi = newSize - suffix;
+    const size_t total = (oldHi - prefix) + (newHi - prefix);
+    if (total < PARALLEL_MIN_LINES) return computeEdits(oldLines, newLines);
+
+    // Cut at anchors once a region has reached its target size
+    std::vector<Anchor> anchors = longestIncreasing(
+        uniqueMatches(oldLines, prefix, oldHi, newLines, prefix, newHi, pool));
+    const size_t target = std::max(MIN_REGION_LINES, total / MAX_REGIONS);
+
+    struct Region {
+        size_t oldLo, oldHi, newLo, newHi;
+        std::vector<Edit> edits;
+    };
+    std::vector<Region> regions;
+    std::vector<Anchor> cuts;
+    size_t oldLo = prefix, newLo = prefix;
+    for (const Anchor& anchor : anchors) {
+        if ((anchor.oldPos - oldLo) + (anchor.newPos - newLo) < target) continue;
+        regions.push_back({oldLo, anchor.oldPos, newLo, anchor.newPos, {}});
+        cuts.push_back(anchor);
+        oldLo = anchor.oldPos + 1;
+        newLo = anchor.newPos + 1;
+    }
+    regions.push_back({oldLo, oldHi, newLo, newHi, {}});
+
+    for (Region& region : regions) {
+        pool.submit([&oldLines, &newLines, &region] {
+            std::vector<std::string_view> a(oldLines.begin() + region.oldLo, oldLines.begin() + region.oldHi);
+            std::vector<std::string_view> b(newLines.begin() + region.newLo, newLines.begin() + region.newHi);
+            region.edits = computeEdits(a, b);
+            for (Edit& edit : region.edits) {
+                edit.oldStart += region.oldLo;
+                edit.newStart += region.newLo;
+            }
+        });
+    }
+    pool.wait();
+
+    // Regions in order, each followed by the anchor that ends it
+    std::vector<Edit> edits;
+    appendRun(edits, {Op::Equal, 0, 0, prefix});
+    for (size_t r = 0; r < regions.size(); ++r) {
+        for (const Edit& edit : regions[r].edits) appendRun(edits, edit);
+        if (r < cuts.size()) appendRun(edits, {Op::Equal, cuts[r].oldPos, cuts[r].newPos, 1});
+    }
+    appendRun(edits, {Op::Equal, oldHi, newHi, suffix});
+    return edits;
+}
+
+namespace {
+
+// Walk the hunks of an edit script, handing each header and each prefixed
+// line to `sink` (shared by the vector and the flat-text renderers)
+template <typename Lines, typename Sink>
+void emitHunks(const std::vector<Edit>& edits, const Lines& oldLines, const Lines& newLines,
+               size_t context, Sink& sink) {
+    size_t e = 0;
+
+    while (e < edits.size()) {
+        while (e < edits.size() && edits[e].op == Op::Equal) ++e;
+        if (e == edits.size()) break;
+
+        // Extend the hunk over short equal runs that separate two changes
+        size_t first = e, last = e;
+        size_t k = e + 1;
+        while (k < edits.size()) {
+            if (edits[k].op != Op::Equal) {
+                last = k++;
+            } else if (k + 1 < edits.size() && edits[k].length <= 2 * context) {
+                ++k;
+            } else {
+                break;
+            }
+        }
+
+        size_t lead = 0;
+        if (first > 0 && edits[first - 1].op == Op::Equal) {
+            lead = std::min(context, edits[first - 1].length);
+        }
+        size_t trail = 0;
+        if (last + 1 < edits.size() && edits[last + 1].op == Op::Equal) {
+            trail = std::min(context, edits[last + 1].length);
+        }
+
+        const Edit& lastEdit = edits[last];
+        size_t oldBegin = edits[first].oldStart - lead;
+        size_t newBegin = edits[first].newStart - lead;
+        size_t oldEnd = lastEdit.oldStart + (lastEdit.op == Op::Insert ? 0 : lastEdit.length) + trail;
+        size_t newEnd = lastEdit.newStart + (lastEdit.op == Op::Delete ? 0 : lastEdit.length) + trail;
+
+        sink.header(oldBegin, oldEnd - oldBegin, newBegin, newEnd - newBegin);
+
+        for (size_t i = oldBegin; i < edits[first].oldStart; ++i) {
+            sink.line("  ", oldLines[i]);
+        }
+        for (size_t h = first; h <= last; ++h) {
+            const Edit& ed = edits[h];
+            for (size_t t = 0; t < ed.length; ++t) {
+                if (ed.op == Op::Equal) sink.line("  ", oldLines[ed.oldStart + t]);
+                else if (ed.op == Op::Delete) sink.line("- ", oldLines[ed.oldStart + t]);
+                else sink.line("+ ", newLines[ed.newStart + t]);
+            }
+        }
+        for (size_t i = oldEnd - trail; i < oldEnd; ++i) {
+            sink.line("  ", oldLines[i]);
+        }
+
+        e = last + 1;
+    }
+}
+
+struct VectorSink {
+    std::vector<std::string>& out;
+    void header(size_t oldStart, size_t oldCount, size_t newStart, size_t newCount) {
+        out.push_back("@@ -" + hunkRange(oldStart, oldCount) + " +" + hunkRange(newStart, newCount) + " @@");
+    }
+    void line(const char* prefix, std::string_view text) {
+        std::string l;
+        l.reserve(2 + text.size());
+        l.append(prefix, 2).append(text);
+        out.push_back(std::move(l));
+    }
+};
+
+struct TextSink {
+    std::string& out;
+    // Digits go straight into `out`: no string per hunk
+    void header(size_t oldStart, size_t oldCount, size_t newStart, size_t newCount) {
+        out.append("@@ -");
+        range(oldStart, oldCount);
+        out.append(" +");
+        range(newStart, newCount);
+        out.append(" @@\n");
+    }
+    void range(size_t start, size_t count) {
+        char digits[48];
+        char* end = std::to_chars(digits, digits + 24, count == 0 ? start : start + 1).ptr;
+        *end++ = ',';
+        end = std::to_chars(end, digits + sizeof(digits), count).ptr;
+        out.append(digits, end - digits);
+    }
+    void line(const char* prefix, std::string_view text) {
+        out.append(prefix, 2).append(text).push_back('\n');
+    }
+};
+
+std::vector<std::string_view> asViews(const std::vector<std::string>& lines) {
+    return std::vector<std::string_view>(lines.begin(), lines.end());
+}
+
+} // namespace
+
+std::vector<Edit> computeEdits(const std::vector<std::string>& oldLines,
+                               const std::vector<std::string>& newLines) {
+    return computeEdits(asViews(oldLines), asViews(newLines));
+}
+
+std::vector<std::string> formatHunks(const std::vector<Edit>& edits,
+                                     const std::vector<std::string_view>& oldLines,
+                                     const std::vector<std::string_view>& newLines,
+                                     size_t context) {
+    std::vector<std::string> out;
+    VectorSink sink{out};
+    emitHunks(edits, oldLines, newLines, context, sink);
+    return out;
+}
+
+void appendHunks(std::string& out, const std::vector<Edit>& edits,
+                 const std::vector<std::string_view>& oldLines,
+                 const std::vector<std::string_view>& newLines,
+                 size_t context) {
+    TextSink sink{out};
+    emitHunks(edits, oldLines, newLines, context, sink);
+}
+
+std::vector<std::string> generate(const std::string& oldText, const std::string& newText,
+                                  size_t context) {
+    TRACE_SCOPE("Diff::generate");
+    std::vector<std::string_view> oldLines = Utils::splitLineViews(oldText);
+    std::vector<std::string_view> newLines = Utils::splitLineViews(newText);
+    return formatHunks(computeEdits(oldLines, newLines), oldLines, newLines, context);
+}
+
+void generateText(std::string_view oldText, std::string_view newText, std::string& out,
+                  std::pmr::memory_resource* scratch, size_t context) {
+    TRACE_SCOPE("Diff::generate");
+    std::pmr::vector<std::string_view> oldLines(scratch), newLines(scratch);
+    Utils::splitLineViews(oldText, oldLines);
+    Utils::splitLineViews(newText, newLines);
+    TextSink sink{out};
+    emitHunks(computeEdits(oldLines, newLines, scratch), oldLines, newLines, context, sink);
+}
+
+std::string generateText(std::string_view oldText, std::string_view newText, size_t context) {
+    TRACE_SCOPE("Diff::generate");
+    std::vector<std::string_view> oldLines = Utils::splitLineViews(oldText);
+    std::vector<std::string_view> newLines = Utils::splitLineViews(newText);
+    std::string out;
+    appendHunks(out, computeEdits(oldLines, newLines), oldLines, newLines, context);
+    return out;
+}
+
+std::string generateTextParallel(std::string_view oldText, std::string_view newText,
+                                 ThreadPool& pool, size_t context) {
+    TRACE_SCOPE("Diff::generate");
+    std::vector<std::string_view> oldLines = Utils::splitLineViews(oldText);
+    std::vector<std::string_view> newLines = Utils::splitLineViews(newText);
+    std::string out;
+    appendHunks(out, computeEditsParallel(oldLines, newLines, pool), oldLines, newLines, context);
+    return out;
+}
+
+namespace {
+
+// One side of a streamed diff: lines read from the input but not yet consumed
+class LineWindow {
+public:
+    LineWindow(const ReadFn& read, size_t capacity) : read(read), capacity(capacity) {
+        text.reserve(capacity);
+    }
+
+    // Read until the window holds `capacity` bytes or the input ends, then
+    // index the complete lines (a line longer than the window grows it)
+    void fill() {
+        size_t limit = std::max(capacity, text.size());
+        for (;;) {
+            while (!ended && text.size() < limit) {
+                size_t have = text.size();
+                text.resize(limit);
+                size_t got = read(&text[have], limit - have);
+                text.resize(have + got);
+                if (got == 0) ended = true;
+            }
+            if (ended || text.find('\n') != std::string::npos) break;
+            limit += capacity;
+        }
+        complete = ended ? text.size() : text.rfind('\n') + 1;
+        lines = Utils::splitLineViews(std::string_view(text).substr(0, complete));
+    }
+
+    // Drop the first `count` lines
+    void consume(size_t count) {
+        size_t bytes = count < lines.size() ? static_cast<size_t>(lines[count].data() - text.data()) : complete;
+        text.erase(0, bytes);
+        consumed += bytes;
+        lines.clear();
+        complete = 0;
+    }
+
+    // Everything left of the input is in the window
+    bool exhausted() const { return ended && complete == text.size(); }
+
+    std::vector<std::string_view> lines;
+    size_t consumed = 0;   // bytes consumed so far
+
+private:
+    const ReadFn& read;
+    size_t capacity;
+    std::string text;
+    size_t complete = 0;   // bytes of text that form complete lines
+    bool ended = false;
+};
+
+// Writes hunks as edit lines arrive in order, with the same layout as
+// emitHunks; only the hunk being built is kept in memory
+class HunkWriter {
+public:
+    HunkWriter(std::ostream& out, size_t context, size_t maxHunkBytes)
+        : out(out), context(context), maxHunkBytes(maxHunkBytes) {}
+
+    void equal(std::string_view line) {
+        if (open) {
+            gap.emplace_back(line);
+            if (gap.size() > 2 * context) close(context);
         }
+        recent.emplace_back(line);
+        if (recent.size() > context) recent.pop_front();
+        ++oldPos;
+        ++newPos;
     }
 
-    return diff;
+    void change(Op op, std::string_view line) {
+        if (!open) {
+            // Lead context: the equal lines just before this change
+            open = true;
+            oldBegin = oldPos - recent.size();
+            newBegin = newPos - recent.size();
+            for (const auto& r : recent) addLine("  ", r, 1, 1);
+        } else {
+            for (const auto& g : gap) addLine("  ", g, 1, 1);
+        }
+        gap.clear();
+        recent.clear();
+
+        if (op == Op::Delete) {
+            addLine("- ", line, 1, 0);
+            ++oldPos;
+        } else {
+            addLine("+ ", line, 0, 1);
+            ++newPos;
+        }
+
+        // A huge hunk is cut here; the next change starts a new one
+        if (body.size() >= maxHunkBytes) close(0);
+    }
+
+    void finish() {
+        if (open) close(context);
+    }
+
+private:
+    std::ostream& out;
+    size_t context;
+    size_t maxHunkBytes;
+    size_t oldPos = 0, newPos = 0;           // next line on each side
+    bool open = false;
+    size_t oldBegin = 0, newBegin = 0;
+    size_t oldCount = 0, newCount = 0;
+    std::string body;
+    std::vector<std::string> gap;            // equal lines since the hunk's last change
+    std::deque<std::string> recent;          // last `context` equal lines
+
+    void addLine(const char* prefix, std::string_view line, size_t oldLines, size_t newLines) {
+        body.append(prefix, 2).append(line).push_back('\n');
+        oldCount += oldLines;
+        newCount += newLines;
+    }
+
+    void close(size_t trail) {
+        trail = std::min(trail, gap.size());
+        for (size_t i = 0; i < trail; ++i) addLine("  ", gap[i], 1, 1);
+        out << "@@ -" << hunkRange(oldBegin, oldCount) << " +" << hunkRange(newBegin, newCount) << " @@\n";
+        out.write(body.data(), body.size());
+        body.clear();
+        gap.clear();
+        oldCount = newCount = 0;
+        open = false;
+    }
+};
+
+} // namespace
+
+bool generateStream(const ReadFn& oldText, size_t oldBytes,
+                    const ReadFn& newText, size_t newBytes,
+                    std::ostream& out, size_t windowBytes, StreamStats& stats,
+                    size_t context) {
+    TRACE_SCOPE("Diff::generateStream");
+    stats = StreamStats();
+    const size_t half = std::max<size_t>(windowBytes / 2, 1);
+    LineWindow oldWindow(oldText, half), newWindow(newText, half);
+    HunkWriter writer(out, context, half);
+
+    for (;;) {
+        oldWindow.fill();
+        newWindow.fill();
+        ++stats.windows;
+        const std::vector<std::string_view>& a = oldWindow.lines;
+        const std::vector<std::string_view>& b = newWindow.lines;
+        const bool last = oldWindow.exhausted() && newWindow.exhausted();
+
+        std::vector<Edit> edits = computeEdits(a, b);
+        size_t cut = edits.size();
+        size_t takeOld = a.size(), takeNew = b.size();
+        if (!last) {
+            // Changes after the last match may pair with lines not read yet
+            while (cut > 0 && edits[cut - 1].op != Op::Equal) --cut;
+            if (cut > 0) {
+                takeOld = edits[cut - 1].oldStart + edits[cut - 1].length;
+                takeNew = edits[cut - 1].newStart + edits[cut - 1].length;
+            } else {
+                // Nothing in the windows matches: the side with more input
+                // left is taken to hold an inserted (or deleted) block
+                ++stats.unmatched;
+                size_t oldLeft = oldBytes > oldWindow.consumed ? oldBytes - oldWindow.consumed : 0;
+                size_t newLeft = newBytes > newWindow.consumed ? newBytes - newWindow.consumed : 0;
+                bool takeNewSide = !b.empty() && (a.empty() || newLeft >= oldLeft);
+                takeOld = takeNewSide ? 0 : a.size();
+                takeNew = takeNewSide ? b.size() : 0;
+            }
+        }
+
+        for (size_t e = 0; e < cut; ++e) {
+            const Edit& edit = edits[e];
+            for (size_t t = 0; t < edit.length; ++t) {
+                if (edit.op == Op::Equal) writer.equal(a[edit.oldStart + t]);
+                else if (edit.op == Op::Delete) writer.change(Op::Delete, a[edit.oldStart + t]);
+                else writer.change(Op::Insert, b[edit.newStart + t]);
+            }
+        }
+        if (cut == 0) {
+            for (size_t i = 0; i < takeOld; ++i) writer.change(Op::Delete, a[i]);
+            for (size_t j = 0; j < takeNew; ++j) writer.change(Op::Insert, b[j]);
+        }
+
+        stats.oldLines += takeOld;
+        stats.newLines += takeNew;
+        oldWindow.consume(takeOld);
+        newWindow.consume(takeNew);
+        if (last) break;
+    }
+    writer.finish();
+    return static_cast<bool>(out);
 }
 
-} // namespace Diff
\ No newline at end of file
+} // namespace Diff
@@ -1,11 +1,121 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
+#include <cstddef>
+#include <functional>
+#include <memory_resource>
+#include <ostream>
+
+class ThreadPool;
 
 namespace Diff {
 
-    // Generate a diff between oldText and newText
-    // Returns lines prefixed with "+" (addition) or "-" (deletion)
-    std::vector<std::string> generate(const std::string& oldText, const std::string& newText);
+    // Unchanged lines kept around each change when building hunks
+    const size_t DEFAULT_CONTEXT = 3;
+
+    enum class Op { Equal, Delete, Insert };
+
+    // A run of `length` lines sharing the same operation.
+    // oldStart/newStart are 0-based line indexes into the old and new sequences
+    // (for an Insert, oldStart is the insertion point in the old sequence; for a
+    // Delete, newStart is the matching position in the new sequence).
+    struct Edit {
+        Op op;
+        size_t oldStart;
+        size_t newStart;
+        size_t length;
+    };
+
+    // Compute a minimal edit script between two line sequences.
+    // Common prefix/suffix are trimmed first, then Myers' O(ND) algorithm with
+    // the linear-space (middle snake) refinement handles the remainder.
+    // Regions with a very large edit distance fall back to a heuristic split,
+    // so the script stays correct but may not be minimal there.
+    std::vector<Edit> computeEdits(const std::vector<std::string_view>& oldLines,
+                                   const std::vector<std::string_view>& newLines);
+    std::vector<Edit> computeEdits(const std::vector<std::string>& oldLines,
+                                   const std::vector<std::string>& newLines);
+    // Same, with the engine's tables (line ids, marks, search paths)
+    // allocated from `scratch`, typically an Arena reset by the caller
+    std::vector<Edit> computeEdits(const std::pmr::vector<std::string_view>& oldLines,
+                                   const std::pmr::vector<std::string_view>& newLines,
+                                   std::pmr::memory_resource* scratch);
+
+    // Inputs smaller than this (lines left after trimming the common prefix
+    // and suffix) are not worth splitting; computeEditsParallel hands them
+    // to computeEdits unchanged.
+    const size_t PARALLEL_MIN_LINES = 16 * 1024;
+
+    // computeEdits for very large inputs, using every worker of `pool`.
+    // Lines that occur exactly once on each side (patience diff's anchors)
+    // and keep their relative order are matched first; they cut the input
+    // into independent regions, which are diffed concurrently with the
+    // sequential engine and stitched back in order. Where the regions are
+    // cut depends only on the input, so the result is the same for any
+    // number of threads. It is a valid script in the same form as
+    // computeEdits', though around an anchor it may align lines differently.
+    std::vector<Edit> computeEditsParallel(const std::vector<std::string_view>& oldLines,
+                                           const std::vector<std::string_view>& newLines,
+                                           ThreadPool& pool);
+
+    // Render an edit script as hunks:
+    //   "@@ -oldStart,oldCount +newStart,newCount @@"
+    // followed by "  " (context), "- " (deletion) and "+ " (addition) lines.
+    std::vector<std::string> formatHunks(const std::vector<Edit>& edits,
+                                         const std::vector<std::string_view>& oldLines,
+                                         const std::vector<std::string_view>& newLines,
+                                         size_t context = DEFAULT_CONTEXT);
+
+    // Same hunks appended to `out` as newline-terminated text, without
+    // allocating a string per diff line
+    void appendHunks(std::string& out, const std::vector<Edit>& edits,
+                     const std::vector<std::string_view>& oldLines,
+                     const std::vector<std::string_view>& newLines,
+                     size_t context = DEFAULT_CONTEXT);
+
+    // Generate a diff between oldText and newText as hunks (see formatHunks)
+    std::vector<std::string> generate(const std::string& oldText, const std::string& newText,
+                                      size_t context = DEFAULT_CONTEXT);
+
+    // Generate the same diff as one string (what commit stores)
+    std::string generateText(std::string_view oldText, std::string_view newText,
+                             size_t context = DEFAULT_CONTEXT);
+    // Same, appended to `out`; line indexes and engine tables come from `scratch`
+    void generateText(std::string_view oldText, std::string_view newText, std::string& out,
+                      std::pmr::memory_resource* scratch, size_t context = DEFAULT_CONTEXT);
+
+    // generateText with the edit script from computeEditsParallel
+    std::string generateTextParallel(std::string_view oldText, std::string_view newText,
+                                     ThreadPool& pool, size_t context = DEFAULT_CONTEXT);
+
+
+    // Input for generateStream: fills up to `capacity` bytes of `buffer` and
+    // returns how many it wrote, 0 once the input is exhausted
+    using ReadFn = std::function<size_t(char* buffer, size_t capacity)>;
+
+    struct StreamStats {
+        size_t oldLines = 0;
+        size_t newLines = 0;
+        size_t windows = 0;      // rounds of windowed matching
+        size_t unmatched = 0;    // rounds where the windows shared no line
+    };
+
+    // generateText for inputs too large to hold in memory. Old and new text
+    // are read through windows of about windowBytes / 2 each; each round
+    // diffs the two windows, writes the hunks up to the last matching line
+    // and keeps the rest for the next round, so memory stays near
+    // windowBytes however large the inputs are. oldBytes and newBytes are
+    // the input sizes, used to guess which side a block with no match in
+    // the other window belongs to.
+    //
+    // When both inputs fit in one window the result equals generateText,
+    // except that a hunk longer than half a window is split in two.
+    // Matching cannot see past a window, so a change larger than one may
+    // come out as a longer (still correct) diff.
+    bool generateStream(const ReadFn& oldText, size_t oldBytes,
+                        const ReadFn& newText, size_t newBytes,
+                        std::ostream& out, size_t windowBytes, StreamStats& stats,
+                        size_t context = DEFAULT_CONTEXT);
 
-}
\ No newline at end of file
+}
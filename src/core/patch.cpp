@@ -1,35 +1,57 @@
 #include "patch.h"
+#include "arena.h"
+#include "trace.h"
 #include "utils.h"
 #include "diff.h"
 
+#include <algorithm>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <fstream>
 #include <iostream>
 
 namespace Patch {
 
-// Helper to apply a single diff file to text
-static std::string applyDiffFile(const std::string& baseText, const std::string& diffPath) {
-    std::vector<std::string> lines = Utils::splitLines(baseText);
-    std::vector<std::string> diffLines = Utils::splitLines(Utils::readFile(diffPath));
-    std::vector<std::string> result;
+// Text of a diff line without its two-character prefix
+static std::string_view payload(std::string_view dline) {
+    return dline.size() > 2 ? dline.substr(2) : std::string_view();
+}
+
+static void appendLine(std::string& out, std::string_view line) {
+    out.append(line.data(), line.size());
+    out.push_back('\n');
+}
+
+// Parse the old-side range of "@@ -a,b +c,d @@"
+static bool parseHunkHeader(std::string_view header, size_t& oldStart, size_t& oldCount) {
+    size_t pos = 4;   // past "@@ -"
+    auto number = [&](size_t& value) {
+        size_t begin = pos;
+        value = 0;
+        while (pos < header.size() && header[pos] >= '0' && header[pos] <= '9') {
+            value = value * 10 + (header[pos++] - '0');
+        }
+        return pos > begin;
+    };
+    if (header.compare(0, 4, "@@ -") != 0 || !number(oldStart)) return false;
+    if (pos >= header.size() || header[pos++] != ',') return false;
+    return number(oldCount);
+}
 
+// Older diffs carry no positions: deletions consume base lines in order,
+// additions are emitted in order, and the rest of the base is appended.
+template <typename Lines>
+static void applyLegacyDiff(const Lines& lines, const Lines& diffLines, std::string& result) {
     size_t i = 0; // index in original lines
     for (const auto& dline : diffLines) {
         if (dline.empty()) continue;
 
         if (dline[0] == '-') {
-            std::string lineToRemove = dline.substr(2);
-            // skip lines in original that match lineToRemove
-            if (i < lines.size() && lines[i] == lineToRemove) {
-                ++i; // remove this line
-            } else {
-                // mismatch: skip
-                ++i;
-            }
+            // remove (or skip on mismatch) the next original line
+            ++i;
         } else if (dline[0] == '+') {
-            result.push_back(dline.substr(2)); // add line
+            appendLine(result, payload(dline)); // add line
         } else {
             // unknown format, ignore
         }
@@ -37,21 +59,125 @@ static std::string applyDiffFile(const std::string& baseText, const std::string&
 
     // Append remaining original lines not removed
     while (i < lines.size()) {
-        result.push_back(lines[i]);
+        appendLine(result, lines[i]);
         ++i;
     }
+}
+
+// Apply "@@ -a,b +c,d @@" hunks produced by Diff::formatHunks
+template <typename Lines>
+static void applyHunks(const Lines& lines, const Lines& diffLines, std::string& result) {
+    size_t i = 0; // index in original lines
+    for (const auto& dline : diffLines) {
+        if (dline.empty()) continue;
+
+        if (dline[0] == '@') {
+            size_t oldStart = 0, oldCount = 0;
+            if (!parseHunkHeader(dline, oldStart, oldCount)) continue;
+
+            // copy the untouched lines that precede this hunk
+            size_t hunkBegin = (oldCount == 0) ? oldStart : oldStart - 1;
+            while (i < hunkBegin && i < lines.size()) {
+                appendLine(result, lines[i]);
+                ++i;
+            }
+        } else if (dline[0] == ' ') {
+            if (i < lines.size()) {
+                appendLine(result, lines[i]);
+                ++i;
+            }
+        } else if (dline[0] == '-') {
+            if (i < lines.size()) ++i;
+        } else if (dline[0] == '+') {
+            appendLine(result, payload(dline));
+        }
+    }
 
-    return Utils::joinLines(result);
+    while (i < lines.size()) {
+        appendLine(result, lines[i]);
+        ++i;
+    }
+}
+
+std::string applyDiff(const std::string& baseText, const std::string& diffText) {
+    std::string result;
+    applyDiff(baseText, diffText, result, std::pmr::get_default_resource());
+    return result;
+}
+
+void applyDiff(std::string_view baseText, std::string_view diffText, std::string& out,
+               std::pmr::memory_resource* scratch) {
+    TRACE_SCOPE("Patch::applyDiff");
+    std::pmr::vector<std::string_view> lines(scratch), diffLines(scratch);
+    Utils::splitLineViews(baseText, lines);
+    Utils::splitLineViews(diffText, diffLines);
+    out.clear();
+    out.reserve(baseText.size() + diffText.size());
+
+    for (const auto& dline : diffLines) {
+        if (dline.compare(0, 2, "@@") == 0) {
+            applyHunks(lines, diffLines, out);
+            return;
+        }
+    }
+    applyLegacyDiff(lines, diffLines, out);
 }
 
-// Reconstruct a version by applying diffs from base
+// Reconstruct a version from the closest starting point: the nearest cached
+// ancestor or the version's keyframe snapshot, whichever is later. Diffs are
+// against the previous version except where repack chose another base;
+// the walk back follows those bases.
 std::string reconstructVersion(const Repo& repo, const Version& version) {
-    // Simplified implementation - read the diff file directly
-    // In a full implementation, this would apply all diffs sequentially
-    if (!version.diffPath.empty() && Utils::fileExists(version.diffPath)) {
-        return Utils::readFile(version.diffPath);
+    TRACE_SCOPE("Patch::reconstructVersion");
+    const std::vector<Version>& versions = repo.getVersions();
+    VersionCache& cache = repo.getCache();
+
+    std::string text;
+    if (cache.get(version.id, text)) return text;
+
+    // Versions whose diffs are applied, newest first, down to a known text
+    std::vector<int> chain;
+    int at = version.id;
+    for (;;) {
+        // Versions written before keyframes existed replay from version 0
+        const int keyframe = std::max(versions[at].keyframe, 0);
+        int low = at;   // low + 1 .. at each apply to the previous version
+        while (low > keyframe && versions[low].base < 0) --low;
+
+        int cached = cache.nearestBelow(at + 1, low, text);
+        if (cached >= 0) {
+            for (int i = at; i > cached; --i) chain.push_back(i);
+            break;
+        }
+        for (int i = at; i > low; --i) chain.push_back(i);
+        if (low > 0 && low == keyframe && repo.hasSnapshot(versions[low])) {
+            text = repo.readSnapshot(versions[low]);
+            cache.put(low, text);
+            break;
+        }
+        chain.push_back(low);
+        if (versions[low].base >= 0) {
+            at = versions[low].base;
+        } else if (low > 0) {
+            at = low - 1;
+        } else {
+            text.clear();
+            break;
+        }
     }
-    return "";
+
+    // The replay's line indexes share one arena, reset per step, and the
+    // text alternates between two buffers that keep their capacity
+    Arena scratch;
+    std::string next;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        scratch.reset();
+        applyDiff(text, repo.readDiff(versions[*it]), next, &scratch);
+        text.swap(next);
+    }
+
+    cache.put(version.id, text);
+    return text;
 }
 
-} // namespace Patch
\ No newline at end of file
+} // namespace Patch
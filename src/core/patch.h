@@ -1,11 +1,22 @@
 #pragma once
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "repo.h"
 
 namespace Patch {
 
+    // Apply one stored diff to baseText and return the resulting text.
+    // Understands hunk diffs from Diff::generate as well as the older
+    // headerless "+ "/"- " line format.
+    std::string applyDiff(const std::string& baseText, const std::string& diffText);
+    // Same, written to `out` (which must not hold baseText); the line
+    // indexes come from `scratch`, and out's capacity is reused
+    void applyDiff(std::string_view baseText, std::string_view diffText, std::string& out,
+                   std::pmr::memory_resource* scratch);
+
     // Reconstruct the full text of a given version
     std::string reconstructVersion(const Repo& repo, const Version& version);
 
-}
\ No newline at end of file
+}
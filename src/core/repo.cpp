@@ -1,15 +1,258 @@
 #include "repo.h"
+#include "delta.h"
 #include "diff.h"
+#include "patch.h"
+#include "arena.h"
+#include "crypto.h"
 #include "utils.h"
+#include "sha256.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "../storage/file_manager.h"
 #include "../storage/metadata.h"
+#include <algorithm>
 #include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
 #include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unordered_set>
+#include <unordered_map>
+
+// Matching lines `search` lists (every version range is always printed)
+static const size_t SEARCH_LINES_SHOWN = 20;
+
+// Diffs used to train the compression dictionary at repack time
+static const size_t DICTIONARY_SAMPLES = 1024;
+static const size_t DICTIONARY_SAMPLE_BYTES = 8 * 1024;
+
+// An in-memory commit holds the old and new text, their line indexes and
+// the diff: about this many times the larger text
+static const size_t IN_MEMORY_FACTOR = 6;
+// Share of the memory budget given to the streaming diff's two windows;
+// the rest covers their line indexes and the edit script
+static const size_t STREAM_WINDOW_SHARE = 4;
+static const size_t COPY_BLOCK = 1 << 20;
+
+// The journal is checkpointed once it grows past this, which bounds what
+// recovery (and every load, which reads it) has to go through
+static const size_t JOURNAL_CHECKPOINT_BYTES = 256 * 1024;
+
+// Encrypted repositories: the passphrase's environment variable, and the
+// message whose HMAC in the key file tells a wrong passphrase from a right one
+static const char* const PASSPHRASE_VARIABLE = "DSA_PASSPHRASE";
+static const char KEY_CHECK[] = "dsa key check";
+
+static std::string_view bytesOf(const std::array<unsigned char, 32>& bytes) {
+    return std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+// Diffs applied to rebuild each version: from its keyframe's snapshot, or
+// from empty, following the delta bases
+static std::vector<int> chainDepths(const std::vector<Version>& versions) {
+    std::vector<int> depths(versions.size());
+    for (size_t i = 0; i < versions.size(); ++i) {
+        const Version& v = versions[i];
+        bool snapshot = !v.snapshotObject.empty() || !v.snapshotPath.empty();
+        if (i > 0 && snapshot) depths[i] = 0;
+        else depths[i] = 1 + (v.base >= 0 ? depths[v.base] : i > 0 ? depths[i - 1] : 0);
+    }
+    return depths;
+}
+
+// Diffs hold lines, each ending in '\n', so a version's text is what was
+// committed with a final newline added where it lacked one, and its hash
+// is of that text
+static bool unterminated(std::string_view text) {
+    return !text.empty() && text.back() != '\n';
+}
+
+// First line of HEAD: "DSAHEAD1 <version id> <sha-256>\n", then the text
+static std::string headHeader(const Version& head) {
+    return "DSAHEAD1 " + std::to_string(head.id) + " " + head.hash + "\n";
+}
 
 Repo::Repo(const std::string& path)
-    : repoPath(path), versionsFilePath(path + "/versions.txt"), currentText("") {
+    : repoPath(path), versionsFilePath(path + "/versions.txt"), currentText(""),
+      headFilePath(path + "/HEAD"), keyFilePath(path + "/keyfile"), blameDir(path + "/blame"), store(path),
+      versionLog(path + "/versions.log"), journal(path + "/journal"), searchIndex(path + "/search"),
+      writerLockPath(path + "/lock") {
+}
+
+Repo::WriterScope::WriterScope(Repo& repo) : repo(repo) {
+    if (repo.writerDepth++ > 0) return;
+    repo.writerLock = Utils::lockFile(repo.writerLockPath);
+    if (repo.writerLock < 0) std::cerr << "Error: cannot lock " << repo.writerLockPath << "\n";
+}
+
+Repo::WriterScope::~WriterScope() {
+    if (--repo.writerDepth > 0) return;
+    Utils::unlockFile(repo.writerLock);
+    repo.writerLock = -1;
+}
+
+bool Repo::WriterScope::held() const {
+    return repo.writerLock >= 0;
+}
+
+void Repo::setDurability(Durability level) {
+    durability = level;
+    store.setSyncWrites(level == Durability::Strict);
+}
+
+Durability Repo::getDurability() const {
+    return durability;
+}
+
+void Repo::setGroupCommit(bool enabled) {
+    groupCommit = enabled;
+}
+
+uint64_t Repo::commitTicket() const {
+    return lastTicket;
+}
+
+bool Repo::waitDurable(uint64_t ticket) {
+    return journal.sync(ticket);
+}
+
+void Repo::configure(const RepoOptions& options) {
+    setKeyframePolicy(options.policy);
+    setDiffThreads(options.diffThreads);
+    setMemoryBudget(options.memoryBudget);
+    setPassphrase(options.passphrase);
+    setDurability(options.durability);
+}
+
+void Repo::setKeyframePolicy(const KeyframePolicy& policy) {
+    keyframePolicy = policy;
+}
+
+void Repo::setCompression(bool enabled) {
+    store.setCompression(enabled);
+}
+
+void Repo::setDiffThreads(size_t threads) {
+    diffPool.reset();
+    if (threads > 1) diffPool = std::make_shared<ThreadPool>(threads);
+}
+
+void Repo::setPassphrase(const std::string& text) {
+    passphrase = text;
+}
+
+std::string Repo::secretPassphrase() const {
+    if (!passphrase.empty()) return passphrase;
+    const char* fromEnvironment = std::getenv(PASSPHRASE_VARIABLE);
+    return fromEnvironment ? fromEnvironment : "";
+}
+
+bool Repo::isEncrypted() const {
+    return Utils::fileExists(keyFilePath);
+}
+
+bool Repo::enableEncryption(uint32_t iterations) {
+    TRACE_SCOPE("Repo::enableEncryption");
+    if (!Utils::directoryExists(repoPath)) {
+        std::cerr << "Error: Repository not initialized. Run 'init' first.\n";
+        return false;
+    }
+    if (isEncrypted()) {
+        std::cerr << "Error: " << repoPath << " is already encrypted.\n";
+        return false;
+    }
+    std::string secret = secretPassphrase();
+    if (secret.empty()) {
+        std::cerr << "Error: encryption needs a passphrase (--passphrase-file, or " << PASSPHRASE_VARIABLE << ").\n";
+        return false;
+    }
+    if (!loadVersions()) return false;
+
+    Sha256::Digest salt;
+    if (!Crypto::randomBytes(salt.data(), salt.size())) {
+        std::cerr << "Error: no random source for the key salt.\n";
+        return false;
+    }
+    Crypto::Key derived = Crypto::deriveKey(secret, bytesOf(salt), iterations);
+    Sha256::Digest check = Crypto::hmacSha256(bytesOf(derived), KEY_CHECK);
+    std::string keyLine = "DSAKEY1 pbkdf2-sha256 " + std::to_string(iterations) + " " +
+                          Sha256::toHex(salt) + " " + Sha256::toHex(check) + "\n";
+    // Losing the key file loses everything encrypted with it, so it is on
+    // disk before anything is
+    std::string tmpPath = keyFilePath + ".tmp";
+    if (!Utils::writeFile(tmpPath, keyLine) || !Utils::syncFile(tmpPath) ||
+        std::rename(tmpPath.c_str(), keyFilePath.c_str()) != 0 || !Utils::syncDirectory(repoPath)) {
+        std::remove(tmpPath.c_str());
+        std::cerr << "Error: failed to write " << keyFilePath << "\n";
+        return false;
+    }
+    key = std::make_shared<const Crypto::Key>(derived);
+    store.setKey(key);
+
+    // The search index holds every line in the clear
+    searchIndex.remove();
+
+    // HEAD holds the newest text in full, so it is rewritten encrypted now;
+    // objects already stored stay readable and are encrypted by the next repack
+    if (!versions.empty()) {
+        latestText();
+        saveHead();
+    }
+    std::cout << "Encryption enabled for " << repoPath << " (ChaCha20-Poly1305, PBKDF2 with "
+              << iterations << " iterations).\n";
+    return true;
+}
+
+bool Repo::unlock() {
+    if (key || !isEncrypted()) return true;
+    TRACE_SCOPE("Repo::unlock");
+
+    std::istringstream keyLine(Utils::readFile(keyFilePath));
+    std::string magic, kdf, saltHex, checkHex;
+    uint32_t iterations = 0;
+    Sha256::Digest salt, check;
+    if (!(keyLine >> magic >> kdf >> iterations >> saltHex >> checkHex) || magic != "DSAKEY1" ||
+        kdf != "pbkdf2-sha256" || iterations == 0 || !Sha256::fromHex(saltHex, salt) ||
+        !Sha256::fromHex(checkHex, check)) {
+        std::cerr << "Error: " << keyFilePath << " is not a readable key file.\n";
+        return false;
+    }
+
+    std::string secret = secretPassphrase();
+    if (secret.empty()) {
+        std::cerr << "Error: " << repoPath << " is encrypted; give --passphrase-file or set "
+                  << PASSPHRASE_VARIABLE << ".\n";
+        return false;
+    }
+    Crypto::Key derived = Crypto::deriveKey(secret, bytesOf(salt), iterations);
+    if (Crypto::hmacSha256(bytesOf(derived), KEY_CHECK) != check) {
+        std::cerr << "Error: wrong passphrase for " << repoPath << "\n";
+        return false;
+    }
+    key = std::make_shared<const Crypto::Key>(derived);
+    store.setKey(key);
+    return true;
+}
+
+void Repo::setMemoryBudget(size_t bytes) {
+    memoryBudget = bytes;
+}
+
+size_t Repo::getMemoryBudget() const {
+    return memoryBudget;
+}
+
+bool Repo::exceedsMemoryBudget(size_t textBytes) const {
+    if (memoryBudget == 0) return false;
+    size_t largest = std::max(textBytes, Utils::fileSize(headFilePath));
+    return largest > memoryBudget / IN_MEMORY_FACTOR;
 }
 
 void Repo::init() {
+    TRACE_SCOPE("Repo::init");
     // Create repository directory if it doesn't exist
     if (!Utils::directoryExists(repoPath)) {
         Utils::createDirectory(repoPath);
@@ -18,146 +261,658 @@ void Repo::init() {
         std::cout << "Repository already exists at: " << repoPath << "\n";
     }
 
-    // Create versions.txt if it doesn't exist
-    if (!Utils::fileExists(versionsFilePath)) {
-        std::ofstream ofs(versionsFilePath);
-        ofs.close();
-        std::cout << "Created versions metadata file.\n";
+    // Load existing versions (migrating an old versions.txt if there is one)
+    if (!loadVersions()) return;
+
+    // Create the version log if it doesn't exist
+    if (!versionLog.exists()) {
+        if (versionLog.create()) {
+            std::cout << "Created versions metadata file.\n";
+        } else {
+            std::cerr << "Error: Failed to create " << versionLog.getPath() << "\n";
+        }
     }
 
-    // Load existing versions
-    loadVersions();
+    // New repositories keep a search index from their first commit; older
+    // ones get one the first time they are searched
+    if (versions.empty() && !isEncrypted() && !searchIndex.exists()) searchIndex.create();
 }
 
-void Repo::commit(const std::string& text) {
+bool Repo::commit(std::string_view text) {
+    TRACE_SCOPE("Repo::commit");
     // Check if repo is initialized
     if (!Utils::directoryExists(repoPath)) {
         std::cerr << "Error: Repository not initialized. Run 'init' first.\n";
-        return;
+        return false;
     }
 
+    WriterScope writer(*this);
+    if (!writer.held()) return false;
+
     // Load existing versions
-    loadVersions();
+    if (!loadVersions()) return false;
+
+    std::string terminated;
+    if (unterminated(text)) {
+        terminated.reserve(text.size() + 1);
+        terminated.append(text.data(), text.size()).push_back('\n');
+        text = terminated;
+    }
 
-    // Create new version
+    // Identical content to the latest version: nothing to store
+    std::string hash = Utils::hashString(text);
+    if (!versions.empty() && versions.back().hash == hash) {
+        std::cout << "No changes since version " << versions.back().id << "; nothing committed.\n";
+        return false;
+    }
+
+    Journal::Entry entry;
+    bool journaled = durability == Durability::Batch && versionLog.exists();
+    Version newVersion = stageVersion(text, hash, journaled ? &entry : nullptr);
+    uint64_t ticket = 0;
+    if (journaled) {
+        entry.version = newVersion;
+        if (!journalVersion(entry, ticket)) return false;
+    }
+
+    // Append one record to the version log
+    if (!versionLog.append(newVersion)) {
+        std::cerr << "Error: Failed to record version " << newVersion.id << "\n";
+        // Recovery must not bring back a commit that failed
+        if (journaled) checkpointJournal();
+        return false;
+    }
+    versions.push_back(newVersion);
+    if (durability == Durability::Strict && !Utils::syncFile(versionLog.getPath())) {
+        std::cerr << "Error: failed to flush " << versionLog.getPath() << "\n";
+        return false;
+    }
+
+    // The new text becomes HEAD, so the next commit (in this process or
+    // another) diffs against it without replaying history
+    currentText.assign(text.data(), text.size());
+    currentTextId = newVersion.id;
+    saveHead();
+    cache.put(newVersion.id, currentText);
+    updateSearchIndex();
+
+    // Under group commit the caller flushes, after letting others append
+    if (journaled) {
+        lastTicket = ticket;
+        if (!groupCommit && !journal.sync(ticket)) return false;
+    }
+
+    std::cout << "Committed version " << newVersion.id
+              << " (hash: " << newVersion.hash.substr(0, 8) << "...)\n";
+    return true;
+}
+
+Version Repo::stageVersion(std::string_view text, const std::string& hash, Journal::Entry* journaled) {
+    TRACE_SCOPE("Repo::stageVersion");
     Version newVersion;
     newVersion.id = versions.size();
     newVersion.timestamp = Utils::currentTimestamp();
-    newVersion.hash = Utils::hashString(text);
+    newVersion.hash = hash;
 
-    // Generate diff against previous version
+    // Generate diff against previous version (the first commit diffs against
+    // an empty text, so it becomes a single all-additions hunk)
     std::string diffText;
+    if (diffPool) {
+        diffText = Diff::generateTextParallel(latestText(), text, *diffPool);
+    } else {
+        scratch.reset();
+        Diff::generateText(latestText(), text, diffText, &scratch);
+    }
+    newVersion.diffObject = store.put(diffText);
+    if (journaled) journaled->objects.push_back(FileManager::encodeText(diffText, key.get()));
+
+    // Store a full snapshot when the policy asks for one, so reconstruction
+    // of this and later versions starts here instead of at version 0.
+    // Content seen before (e.g. a rollback) already has its snapshot object.
     if (versions.empty()) {
-        // First commit: entire text is a diff
-        auto lines = Utils::splitLines(text);
-        for (const auto& line : lines) {
-            diffText += "+ " + line + "\n";
-        }
+        newVersion.keyframe = 0;    // diff 0 applies to an empty text
+    } else if (store.has(hash) || needsKeyframe(store.size(newVersion.diffObject))) {
+        newVersion.keyframe = newVersion.id;
+        newVersion.snapshotObject = store.put(text);
+        if (journaled) journaled->objects.push_back(FileManager::encodeText(text, key.get()));
     } else {
-        // Generate diff from previous version
-        auto diffLines = Diff::generate(currentText, text);
-        diffText = Utils::joinLines(diffLines);
+        newVersion.keyframe = versions.back().keyframe;
+    }
+    return newVersion;
+}
+
+void Repo::commitStreaming(const std::string& path) {
+    TRACE_SCOPE("Repo::commitStreaming");
+    if (!Utils::directoryExists(repoPath)) {
+        std::cerr << "Error: Repository not initialized. Run 'init' first.\n";
+        return;
+    }
+
+    WriterScope writer(*this);
+    if (!writer.held() || !loadVersions()) return;
+
+    // A file without a final newline is committed from a copy that has one
+    // (see unterminated)
+    {
+        std::ifstream input(path, std::ios::binary | std::ios::ate);
+        char last = '\n';
+        if (input.is_open() && input.tellg() > 0) input.seekg(-1, std::ios::end).get(last);
+        if (last != '\n') {
+            std::string copyPath = repoPath + "/commit.input.tmp";
+            std::error_code ec;
+            std::filesystem::copy_file(path, copyPath, std::filesystem::copy_options::overwrite_existing, ec);
+            if (ec || !(std::ofstream(copyPath, std::ios::binary | std::ios::app) << '\n')) {
+                std::cerr << "Error: cannot copy " << path << " into " << repoPath << "\n";
+            } else {
+                commitStreaming(copyPath);
+            }
+            std::filesystem::remove(copyPath, ec);
+            return;
+        }
+    }
+
+    std::string hash = Utils::hashFile(path);
+    if (hash.empty()) {
+        std::cerr << "Error: cannot read " << path << "\n";
+        return;
     }
+    if (!versions.empty() && versions.back().hash == hash) {
+        std::cout << "No changes since version " << versions.back().id << "; nothing committed.\n";
+        return;
+    }
+
+    // The previous text is read from HEAD. A missing or stale HEAD is
+    // rebuilt first, which is the one step that holds a text in memory.
+    FileManager::Reader head;
+    if (!versions.empty() && !openHead(head)) {
+        latestText();
+        std::string().swap(currentText);
+        currentTextId = -1;
+        if (!openHead(head)) {
+            std::cerr << "Error: cannot read " << headFilePath << "\n";
+            return;
+        }
+    }
+    size_t oldBytes = versions.empty() ? 0 : head.size() - headHeader(versions.back()).size();
+    std::ifstream input(path, std::ios::binary);
+    Diff::ReadFn readOld = [&](char* buffer, size_t capacity) {
+        return versions.empty() ? size_t(0) : head.read(buffer, capacity);
+    };
+    Diff::ReadFn readNew = [&](char* buffer, size_t capacity) {
+        input.read(buffer, capacity);
+        TRACE_COUNT(BytesRead, static_cast<uint64_t>(input.gcount()));
+        return static_cast<size_t>(input.gcount());
+    };
+
+    // The diff goes to a spool file first: its id is the hash of all of it
+    std::string spoolPath = repoPath + "/commit.diff.tmp";
+    std::ofstream spool(spoolPath, std::ios::binary | std::ios::trunc);
+    Diff::StreamStats stats;
+    size_t windowBytes = std::max<size_t>(memoryBudget / STREAM_WINDOW_SHARE, COPY_BLOCK);
+    bool diffed = spool.is_open() &&
+                  Diff::generateStream(readOld, oldBytes, readNew, Utils::fileSize(path),
+                                       spool, windowBytes, stats);
+    spool.close();
+    head = FileManager::Reader();
+    input.close();
 
-    // Save diff to file
-    std::string diffFilename = "diff_" + std::to_string(newVersion.id) + ".txt";
-    newVersion.diffPath = repoPath + "/" + diffFilename;
-    Utils::writeFile(newVersion.diffPath, diffText);
+    Version newVersion;
+    newVersion.id = versions.size();
+    newVersion.timestamp = Utils::currentTimestamp();
+    newVersion.hash = hash;
+    size_t diffBytes = Utils::fileSize(spoolPath);
+    TRACE_COUNT(FilesOpened, 2);
+    TRACE_COUNT(BytesWritten, diffBytes);
+    if (diffed && !spool.fail()) newVersion.diffObject = store.putFile(spoolPath);
+    std::remove(spoolPath.c_str());
+    if (newVersion.diffObject.empty()) {
+        std::cerr << "Error: failed to store the diff for " << path << "\n";
+        return;
+    }
 
-    // Update current text
-    currentText = text;
+    // Keyframes follow the same policy as commit()
+    if (versions.empty()) {
+        newVersion.keyframe = 0;
+    } else if (store.has(hash) || needsKeyframe(store.size(newVersion.diffObject))) {
+        newVersion.keyframe = newVersion.id;
+        newVersion.snapshotObject = store.putFile(path);
+        if (newVersion.snapshotObject.empty()) {
+            std::cerr << "Error: failed to store a snapshot of " << path << "\n";
+            return;
+        }
+    } else {
+        newVersion.keyframe = versions.back().keyframe;
+    }
 
-    // Add version to list and save
+    if (!versionLog.append(newVersion)) {
+        std::cerr << "Error: Failed to record version " << newVersion.id << "\n";
+        return;
+    }
     versions.push_back(newVersion);
-    saveVersions();
+    if (!flushAppended()) return;
+    if (!saveHeadFrom(path)) std::cerr << "Warning: could not update " << headFilePath << "\n";
+    updateSearchIndex();
 
     std::cout << "Committed version " << newVersion.id
               << " (hash: " << newVersion.hash.substr(0, 8) << "...)\n";
+    std::cout << "Streamed " << stats.oldLines << " old and " << stats.newLines << " new lines in "
+              << stats.windows << " windows of " << windowBytes / (1024 * 1024) << " MB\n";
+}
+
+size_t Repo::commitBatch(const RevisionSource& next) {
+    TRACE_SCOPE("Repo::commitBatch");
+    if (!Utils::directoryExists(repoPath)) {
+        std::cerr << "Error: Repository not initialized. Run 'init' first.\n";
+        return 0;
+    }
+
+    WriterScope writer(*this);
+    if (!writer.held() || !loadVersions()) return 0;
+    latestText();
+    size_t first = versions.size();
+    size_t unchanged = 0;
+
+    // Objects are written as each revision is staged; until the version log
+    // names them they are unreferenced, so an interrupted batch leaves no
+    // partial history behind
+    std::string text;
+    while (next(text)) {
+        if (unterminated(text)) text.push_back('\n');
+        std::string hash = Utils::hashString(text);
+        if (!versions.empty() && versions.back().hash == hash) {
+            ++unchanged;
+            continue;
+        }
+        versions.push_back(stageVersion(text, hash));
+        currentText.swap(text);
+        currentTextId = versions.back().id;
+    }
+
+    size_t committed = versions.size() - first;
+    if (committed == 0) {
+        std::cout << "No changes in " << unchanged << " revisions; nothing committed.\n";
+        return 0;
+    }
+
+    std::vector<Version> batch(versions.begin() + first, versions.end());
+    if (!versionLog.append(batch)) {
+        std::cerr << "Error: Failed to record versions " << first << " to " << versions.back().id << "\n";
+        versions.resize(first);
+        currentTextId = -1;
+        return 0;
+    }
+    if (!flushAppended()) return 0;
+    saveHead();
+    cache.put(currentTextId, currentText);
+    updateSearchIndex();
+
+    std::cout << "Committed " << committed << " versions (" << first << " to " << versions.back().id << ")";
+    if (unchanged > 0) std::cout << ", skipped " << unchanged << " unchanged";
+    std::cout << ".\n";
+    return committed;
 }
 
-void Repo::log() {
+void Repo::log(const LogQuery& query) {
+    TRACE_SCOPE("Repo::log");
     if (!Utils::directoryExists(repoPath)) {
         std::cerr << "Error: Repository not initialized.\n";
         return;
     }
 
-    loadVersions();
+    // The whole history is loaded as before; a query reads only the
+    // matching records from the version log (an old versions.txt is
+    // migrated into one first)
+    bool everything = query.first <= 0 && query.last < 0 && query.limit == 0 &&
+                      query.since == LogQuery().since && query.until == LogQuery().until;
+    std::vector<Version> matches;
+    size_t total = 0;
+    if (everything || !versionLog.exists()) {
+        if (!loadVersions()) return;
+        total = versions.size();
+    }
+    if (!everything && versionLog.exists()) {
+        if (!unlock()) return;
+        if (!versionLog.query(query, matches, total)) {
+            std::cerr << "Error: " << versionLog.getPath() << " is not a readable version log.\n";
+            return;
+        }
+    }
+    const std::vector<Version>& shown = everything ? versions : matches;
 
-    if (versions.empty()) {
+    if (total == 0) {
         std::cout << "No commits yet.\n";
         return;
     }
+    if (shown.empty()) {
+        std::cout << "No versions match (" << total << " in total).\n";
+        return;
+    }
 
     std::cout << "Commit History:\n";
     std::cout << "----------------------------------------\n";
-    for (const auto& v : versions) {
+    for (const auto& v : shown) {
         std::cout << "Version " << v.id << "\n";
         std::cout << "  Timestamp: " << v.timestamp << "\n";
         std::cout << "  Hash: " << v.hash.substr(0, 16) << "...\n";
-        std::cout << "  Diff: " << v.diffPath << "\n";
+        if (!v.diffObject.empty()) {
+            std::cout << "  Diff: object " << v.diffObject.substr(0, 16) << "...\n";
+        } else {
+            std::cout << "  Diff: " << v.diffPath << "\n";
+        }
+        if (!v.snapshotObject.empty()) {
+            std::cout << "  Snapshot: object " << v.snapshotObject.substr(0, 16) << "...\n";
+        } else if (!v.snapshotPath.empty()) {
+            std::cout << "  Snapshot: " << v.snapshotPath << "\n";
+        }
         std::cout << "----------------------------------------\n";
     }
+    if (shown.size() < total) {
+        std::cout << "Showing " << shown.size() << " of " << total << " versions.\n";
+    }
 }
 
 void Repo::diff(int versionA, int versionB) {
+    TRACE_SCOPE("Repo::diff");
+    std::string hunks;
+    bool composed = false;
+    if (!diffVersions(versionA, versionB, hunks, composed)) return;
+
+    size_t added = 0, removed = 0;
+    for (std::string_view line : Utils::splitLineViews(hunks)) {
+        if (line.compare(0, 2, "+ ") == 0) ++added;
+        else if (line.compare(0, 2, "- ") == 0) ++removed;
+    }
+
+    std::cout << "Diff between version " << versionA << " and version " << versionB << ":\n";
+    std::cout << "========================================\n";
+    if (hunks.empty()) std::cout << "(no changes)\n";
+    else std::cout << hunks;
+    std::cout << "========================================\n";
+    std::cout << added << " lines added, " << removed << " removed ("
+              << (composed ? "composed from " + std::to_string(std::abs(versionB - versionA)) + " stored diffs"
+                           : std::string("both versions rebuilt"))
+              << ")\n";
+}
+
+bool Repo::diffVersions(int versionA, int versionB, std::string& hunks, bool& composed) {
+    TRACE_SCOPE("Repo::diffVersions");
+    hunks.clear();
+    composed = false;
     if (!Utils::directoryExists(repoPath)) {
         std::cerr << "Error: Repository not initialized.\n";
-        return;
+        return false;
     }
 
-    loadVersions();
+    if (!loadVersions()) return false;
 
     if (versionA < 0 || versionA >= (int)versions.size() ||
         versionB < 0 || versionB >= (int)versions.size()) {
         std::cerr << "Error: Invalid version numbers.\n";
-        return;
+        return false;
     }
+    if (versionA == versionB) return true;
 
-    // Read diff files for both versions
-    std::string diffA = Utils::readFile(versions[versionA].diffPath);
-    std::string diffB = Utils::readFile(versions[versionB].diffPath);
+    // The older version is composed from its keyframe (composeLines), then
+    // the diffs on to the newer one are composed onto it: the keyframe's
+    // text is the only one read in full. When the chain is larger than that
+    // text, rebuilding both and diffing them is cheaper.
+    const int older = std::min(versionA, versionB), newer = std::max(versionA, versionB);
+    const int keyframe = std::max(versions[older].keyframe, 0);
+    const Version& origin = versions[keyframe];
+    bool fromSnapshot = !origin.snapshotObject.empty() && keyframe > 0;
+    bool composable = fromSnapshot || keyframe == 0;
+    size_t textBytes = fromSnapshot ? store.size(origin.snapshotObject) : store.size(versions[0].diffObject);
+    size_t chainBytes = 0;
+    for (int id = keyframe + 1; id <= newer && composable; ++id) {
+        composable = !versions[id].diffObject.empty() && versions[id].base < 0;
+        chainBytes += store.size(versions[id].diffObject);
+    }
+    composable = composable && !versions[0].diffObject.empty() && chainBytes <= textBytes;
 
-    std::cout << "Diff between version " << versionA << " and version " << versionB << ":\n";
+    std::deque<std::string> texts;   // texts and diffs the compositions' lines point into
+    std::vector<std::string_view> olderLines;
+    if (composable && composeLines(older, texts, olderLines)) {
+        // The older version to the newer
+        Delta::Composition toNewer(olderLines.size());
+        for (int id = older + 1; id <= newer && composable; ++id) {
+            texts.push_back(readDiff(versions[id]));
+            composable = toNewer.apply(texts.back());
+        }
+
+        if (composable) {
+            std::vector<std::string_view> newerLines = toNewer.lines(olderLines);
+            std::vector<Diff::Edit> edits = Delta::netEdits(toNewer, olderLines, newerLines);
+            if (versionA < versionB) {
+                Diff::appendHunks(hunks, edits, olderLines, newerLines);
+            } else {
+                Diff::appendHunks(hunks, Delta::invert(edits), newerLines, olderLines);
+            }
+            composed = true;
+            return true;
+        }
+    }
+
+    // Older diff formats, or a chain longer than the text
+    std::string textA = Patch::reconstructVersion(*this, versions[versionA]);
+    std::string textB = Patch::reconstructVersion(*this, versions[versionB]);
+    hunks = Diff::generateText(textA, textB);
+    return true;
+}
+
+bool Repo::composeLines(int versionID, std::deque<std::string>& texts, std::vector<std::string_view>& lines) {
+    TRACE_SCOPE("Repo::composeLines");
+    const int keyframe = std::max(versions[versionID].keyframe, 0);
+    const Version& origin = versions[keyframe];
+    if (keyframe > 0 && !hasSnapshot(origin)) return false;
+
+    texts.push_back(keyframe > 0 ? readSnapshot(origin) : Patch::applyDiff("", readDiff(versions[0])));
+    std::vector<std::string_view> originLines = Utils::splitLineViews(texts.back());
+    Delta::Composition composition(originLines.size());
+    for (int id = keyframe + 1; id <= versionID; ++id) {
+        texts.push_back(previousDiff(id));
+        if (!composition.apply(texts.back())) return false;
+    }
+    lines = composition.lines(originLines);
+    return true;
+}
+
+bool Repo::annotate(int versionID, std::vector<int>& lineOrigins, std::vector<std::string>& lines) {
+    TRACE_SCOPE("Repo::annotate");
+    lineOrigins.clear();
+    lines.clear();
+    if (!Utils::directoryExists(repoPath)) {
+        std::cerr << "Error: Repository not initialized.\n";
+        return false;
+    }
+
+    if (!loadVersions()) return false;
+
+    if (versionID < 0 || versionID >= (int)versions.size()) {
+        std::cerr << "Error: Invalid version ID.\n";
+        return false;
+    }
+
+    // Start from the newest version blamed before, or from an empty text
+    std::deque<std::string> texts;   // texts and diffs the compositions' lines point into
+    std::vector<int> baseOrigins;
+    std::vector<std::string_view> baseLines;
+    int start = loadBlame(versionID, baseOrigins);
+    if (start >= 0 && !composeLines(start, texts, baseLines)) {
+        texts.push_back(Patch::reconstructVersion(*this, versions[start]));
+        baseLines = Utils::splitLineViews(texts.back());
+    }
+    if (baseLines.size() != baseOrigins.size()) {
+        start = -1;
+        baseOrigins.clear();
+        baseLines.clear();
+    }
+
+    // Step i of the composition is version start + 1 + i, so each piece's
+    // source names the version that added its lines
+    Delta::Composition composition(baseLines.size());
+    for (int id = start + 1; id <= versionID; ++id) {
+        texts.push_back(previousDiff(id));
+        if (composition.apply(texts.back())) continue;
+
+        // Older headerless diffs carry no line positions
+        texts.back() = previousDiff(id, true);
+        composition.apply(texts.back());
+    }
+
+    lineOrigins.reserve(composition.lineCount());
+    for (const Delta::Piece& piece : composition.pieces()) {
+        for (size_t i = 0; i < piece.length; ++i) {
+            lineOrigins.push_back(piece.source < 0 ? baseOrigins[piece.start + i] : start + 1 + piece.source);
+        }
+    }
+    for (std::string_view line : composition.lines(baseLines)) lines.emplace_back(line);
+
+    if (start != versionID) saveBlame(versionID, lineOrigins);
+    return true;
+}
+
+void Repo::blame(int versionID, size_t firstLine, size_t lastLine) {
+    TRACE_SCOPE("Repo::blame");
+    std::vector<int> origins;
+    std::vector<std::string> lines;
+    if (!annotate(versionID, origins, lines)) return;
+
+    if (lines.empty()) {
+        std::cout << "Version " << versionID << " is empty.\n";
+        return;
+    }
+    if (firstLine < 1) firstLine = 1;
+    if (lastLine == 0 || lastLine > lines.size()) lastLine = lines.size();
+    if (firstLine > lastLine) {
+        std::cerr << "Error: Version " << versionID << " has only " << lines.size() << " lines.\n";
+        return;
+    }
+
+    const int versionWidth = (int)std::to_string(versions.size() - 1).size();
+    const int lineWidth = (int)std::to_string(lastLine).size();
+    std::cout << "Blame of version " << versionID << ", lines " << firstLine << "-" << lastLine
+              << " of " << lines.size() << " (version, line, text):\n";
     std::cout << "========================================\n";
-    std::cout << "Version " << versionA << " diff:\n";
-    std::cout << diffA << "\n";
+    // Padded in a stream of its own: std::cout's format state is shared by
+    // every thread printing through it (OutputCapture)
+    std::ostringstream listing;
+    for (size_t i = firstLine - 1; i < lastLine; ++i) {
+        listing << std::setw(versionWidth) << origins[i] << " "
+                << std::setw(lineWidth) << i + 1 << "  " << lines[i] << "\n";
+    }
+    std::cout << listing.str();
     std::cout << "========================================\n";
-    std::cout << "Version " << versionB << " diff:\n";
-    std::cout << diffB << "\n";
+}
+
+void Repo::search(const std::string& pattern) {
+    TRACE_SCOPE("Repo::search");
+    if (!Utils::directoryExists(repoPath)) {
+        std::cerr << "Error: Repository not initialized.\n";
+        return;
+    }
+
+    if (isEncrypted()) {
+        std::cerr << "Error: search is not available in encrypted repositories "
+                  << "(its index would hold their text unencrypted).\n";
+        return;
+    }
+
+    // An index that is up to date answers on its own: only the newest
+    // record of the version log is read, to check that it is
+    size_t count = versionLog.count();
+    Version newest;
+    bool current = count > 0 && searchIndex.open() && searchIndex.version() == (int)count - 1 &&
+                   versionLog.read(count - 1, newest) && newest.hash == searchIndex.versionHash();
+    if (!current) {
+        if (!loadVersions()) return;
+        if (versions.empty()) {
+            std::cout << "No versions found.\n";
+            return;
+        }
+        count = versions.size();
+    }
+
+    std::vector<SearchIndex::Match> matches;
+    if ((!current && !indexHistory()) || !searchIndex.find(pattern, matches)) {
+        std::cerr << "Error: Could not read the search index in " << repoPath << "/search\n";
+        return;
+    }
+    if (matches.empty()) {
+        std::cout << "No version contains \"" << pattern << "\".\n";
+        return;
+    }
+
+    // The versions holding any matching line: the union of the lines' lifetimes
+    auto lastOf = [&](const SearchIndex::Match& m) {
+        return m.last == SearchIndex::OPEN ? (int)count - 1 : (int)m.last;
+    };
+    std::vector<std::pair<int, int>> spans;
+    for (const auto& m : matches) spans.emplace_back((int)m.first, lastOf(m));
+    std::sort(spans.begin(), spans.end());
+    std::vector<std::pair<int, int>> merged;
+    for (const auto& span : spans) {
+        if (!merged.empty() && span.first <= merged.back().second + 1) {
+            merged.back().second = std::max(merged.back().second, span.second);
+        } else {
+            merged.push_back(span);
+        }
+    }
+    auto range = [](int first, int last) {
+        return first == last ? std::to_string(first) : std::to_string(first) + "-" + std::to_string(last);
+    };
+
+    std::cout << "\"" << pattern << "\" found in " << matches.size() << " line"
+              << (matches.size() == 1 ? "" : "s") << ", in versions ";
+    for (size_t i = 0; i < merged.size(); ++i) {
+        std::cout << (i ? ", " : "") << range(merged[i].first, merged[i].second);
+    }
+    std::cout << "\n========================================\n";
+    const size_t shown = std::min(matches.size(), SEARCH_LINES_SHOWN);
+    std::ostringstream listing;     // padded apart from std::cout, as in blame
+    for (size_t i = 0; i < shown; ++i) {
+        listing << std::left << std::setw(12) << range((int)matches[i].first, lastOf(matches[i]))
+                << std::right << matches[i].text << "\n";
+    }
+    std::cout << listing.str();
+    if (matches.size() > shown) std::cout << "... and " << matches.size() - shown << " more lines\n";
     std::cout << "========================================\n";
 }
 
 void Repo::checkout(int versionID) {
+    TRACE_SCOPE("Repo::checkout");
     if (!Utils::directoryExists(repoPath)) {
         std::cerr << "Error: Repository not initialized.\n";
         return;
     }
 
-    loadVersions();
+    if (!loadVersions()) return;
 
     if (versionID < 0 || versionID >= (int)versions.size()) {
         std::cerr << "Error: Invalid version ID.\n";
         return;
     }
 
-    // Read the diff file
-    std::string diffContent = Utils::readFile(versions[versionID].diffPath);
+    // Rebuild the full text and materialize it next to the metadata
+    std::string text = Patch::reconstructVersion(*this, versions[versionID]);
+    std::string outputPath = repoPath + "/current_version.txt";
+    Utils::writeFile(outputPath, text);
 
-    std::cout << "Checked out version " << versionID << ":\n";
+    std::cout << "Checked out version " << versionID << " to " << outputPath << ":\n";
     std::cout << "========================================\n";
-    std::cout << diffContent << "\n";
+    std::cout << text;
     std::cout << "========================================\n";
     std::cout << "Hash: " << versions[versionID].hash << "\n";
     std::cout << "Timestamp: " << versions[versionID].timestamp << "\n";
 }
 
 void Repo::rollback(int versionID, const std::string& outputFilePath) {
+    TRACE_SCOPE("Repo::rollback");
     if (!Utils::directoryExists(repoPath)) {
         std::cerr << "Error: Repository not initialized.\n";
         return;
     }
 
-    loadVersions();
+    if (!loadVersions()) return;
 
     if (versionID < 0 || versionID >= (int)versions.size()) {
         std::cerr << "Error: Invalid version ID.\n";
@@ -165,75 +920,719 @@ void Repo::rollback(int versionID, const std::string& outputFilePath) {
     }
 
     // Reconstruct the full text by applying diffs sequentially
-    std::string reconstructedText = "";
+    std::string reconstructedText = Patch::reconstructVersion(*this, versions[versionID]);
+
+    // Save reconstructed text to output file
+    if (Utils::writeFile(outputFilePath, reconstructedText)) {
+        std::cout << "Successfully rolled back to version " << versionID << "\n";
+        std::cout << "File saved to: " << outputFilePath << "\n";
+        std::cout << "Original version hash: " << versions[versionID].hash << "\n";
+        std::cout << "Original version timestamp: " << versions[versionID].timestamp << "\n";
 
-    for (int i = 0; i <= versionID; ++i) {
-        std::string diffContent = Utils::readFile(versions[i].diffPath);
-        auto diffLines = Utils::splitLines(diffContent);
+        // Commit the rolled back content as a new version
+        std::cout << "\nCommitting rolled back content as new version...\n";
+        if (commit(reconstructedText)) {
+            std::cout << "Rollback committed successfully! This is now the current version.\n";
+        }
+    } else {
+        std::cerr << "Error: Failed to write file to " << outputFilePath << "\n";
+    }
+}
 
-        if (i == 0) {
-            // First version: extract all added lines
-            for (const auto& line : diffLines) {
-                if (!line.empty() && line[0] == '+') {
-                    reconstructedText += line.substr(2) + "\n";
-                }
-            }
+void Repo::repack(const RepackOptions& options) {
+    TRACE_SCOPE("Repo::repack");
+    if (!Utils::directoryExists(repoPath)) {
+        std::cerr << "Error: Repository not initialized.\n";
+        return;
+    }
+
+    WriterScope writer(*this);
+    if (!writer.held() || !loadVersions()) return;
+    // The journal's entries name records the delta bases may rewrite
+    if (journal.exists() && !checkpointJournal()) return;
+    ObjectStore::DiskStats before = store.diskStats();
+
+    // New delta bases are named by the rewritten version log before the
+    // pack is written; the deltas they replace are then left out of it
+    std::unordered_set<std::string> replaced;
+    if (options.window > 0 && !chooseDeltaBases(options, replaced)) return;
+
+    std::vector<std::pair<std::string, std::string>> versionObjects;
+    versionObjects.reserve(versions.size());
+    for (const auto& v : versions) {
+        versionObjects.emplace_back(v.diffObject, v.snapshotObject);
+    }
+
+    // Small deltas compress poorly on their own; a dictionary of the lines
+    // that recur across recent diffs gives them something to refer back to
+    std::vector<std::string> samples;
+    size_t first = versions.size() > DICTIONARY_SAMPLES ? versions.size() - DICTIONARY_SAMPLES : 0;
+    for (size_t i = first; i < versions.size(); ++i) {
+        std::string diffText = readDiff(versions[i]);
+        if (diffText.size() <= DICTIONARY_SAMPLE_BYTES) samples.push_back(std::move(diffText));
+    }
+    if (samples.size() >= 8 && store.trainDictionary(samples)) {
+        std::cout << "Trained a compression dictionary from " << samples.size() << " diffs.\n";
+    }
+
+    ObjectStore::RepackStats stats;
+    if (!store.repack(versionObjects, stats, replaced)) return;
+
+    std::cout << "Packed " << stats.objects << " objects (" << stats.rawBytes << " bytes of content, "
+              << stats.packBytes << " bytes packed) into " << repoPath << "/objects/pack; removed "
+              << stats.looseRemoved << " loose files (" << stats.looseBytes << " bytes).\n";
+    long long saved = (long long)(before.looseBytes + before.packBytes) - (long long)stats.packBytes;
+    std::cout << "Objects on disk: " << before.looseBytes + before.packBytes << " bytes before, "
+              << stats.packBytes << " after (" << saved << " saved).\n";
+}
+
+bool Repo::chooseDeltaBases(const RepackOptions& options, std::unordered_set<std::string>& replaced) {
+    TRACE_SCOPE("Repo::chooseDeltaBases");
+    const int maxDepth = std::max(options.maxDepth, 1);
+    std::vector<Version> updated = versions;
+    std::vector<int> depths(versions.size());                   // of the new layout
+    // The last window + 1 texts, each with a bitmap of its line hashes:
+    // a clear bit means no line of the text has that hash
+    const size_t LINE_BITS = 1 << 16;
+    struct Candidate {
+        int id;
+        std::string text;
+        std::vector<uint64_t> lineBits;
+    };
+    std::deque<Candidate> recent;
+    std::unordered_map<std::string, int> byHash;                // newest version with each text
+    size_t bytesBefore = 0, bytesAfter = 0, rebased = 0, snapshots = 0;
+
+    for (size_t i = 0; i < versions.size(); ++i) {
+        const Version& v = versions[i];
+        Version& out = updated[i];
+        std::string stored = readDiff(v);
+        bytesBefore += stored.size();
+        bool snapshot = !v.snapshotObject.empty() || !v.snapshotPath.empty();
+        // Rebuilt from the window where its base is still in it
+        int from = snapshot ? -1 : v.base >= 0 ? v.base : (int)i - 1;
+        std::string text = !recent.empty() && from >= recent.front().id
+                               ? Patch::applyDiff(recent[from - recent.front().id].text, stored)
+                               : Patch::reconstructVersion(*this, v);
+        std::vector<std::pair<size_t, size_t>> lines;           // hash and length of each line
+        for (std::string_view line : Utils::splitLineViews(text)) {
+            lines.emplace_back(std::hash<std::string_view>()(line), line.size());
+        }
+
+        if (i == 0 || snapshot || v.diffObject.empty()) {
+            // Version 0, keyframes (rebuilt from their snapshot) and diffs from
+            // before the object store keep their delta
+            depths[i] = i > 0 && snapshot ? 0 : 1 + (i > 0 ? depths[i - 1] : 0);
+            bytesAfter += stored.size();
         } else {
-            // Apply diff to current text
-            auto currentLines = Utils::splitLines(reconstructedText);
-            std::vector<std::string> newLines;
-            size_t currentIdx = 0;
-
-            for (const auto& diffLine : diffLines) {
-                if (diffLine.empty()) continue;
-
-                if (diffLine[0] == '-') {
-                    // Line removed - skip the corresponding line in current text
-                    if (currentIdx < currentLines.size()) {
-                        ++currentIdx;
+            // The diff against the previous version is the one to beat, by an
+            // eighth at least: other commands read a rebased delta more
+            // slowly (they rebuild both texts to compose it)
+            const std::string& previousText = recent.back().text;
+            std::string fromPrevious = v.base < 0 ? std::move(stored) : Diff::generateText(previousText, text);
+            const bool previousFits = depths[i - 1] + 1 <= maxDepth;
+            size_t limit = previousFits ? fromPrevious.size() - fromPrevious.size() / 8 : SIZE_MAX;
+            int best = -1;
+            std::string bestDiff;
+            const std::string* bestText = nullptr;
+
+            // An earlier version with the same text (a revert): the empty diff
+            auto same = byHash.find(v.hash);
+            if (same != byHash.end() && same->second != (int)i - 1 && depths[same->second] + 1 <= maxDepth &&
+                (int)i - same->second <= VersionLog::MAX_BASE_DISTANCE) {
+                best = same->second;
+                bestText = &text;
+                limit = 0;
+            }
+            // Then the window, nearest first. A diff holds at least the
+            // change in size and every line the base lacks, so a base that
+            // far off is passed over without diffing it.
+            for (auto it = recent.rbegin() + 1; it != recent.rend() && limit > 0; ++it) {
+                if (depths[it->id] + 1 > maxDepth) continue;
+                size_t gap = it->text.size() > text.size() ? it->text.size() - text.size()
+                                                           : text.size() - it->text.size();
+                if (gap >= limit) continue;
+                size_t added = 0;
+                for (size_t k = 0; k < lines.size() && added < limit; ++k) {
+                    size_t bit = lines[k].first % LINE_BITS;
+                    if (!(it->lineBits[bit / 64] >> (bit % 64) & 1)) {
+                        added += lines[k].second + 3;    // "+ " and the newline
                     }
-                } else if (diffLine[0] == '+') {
-                    // Line added
-                    newLines.push_back(diffLine.substr(2));
                 }
+                if (added >= limit) continue;
+                std::string candidate;
+                scratch.reset();
+                Diff::generateText(it->text, text, candidate, &scratch);
+                if (candidate.size() >= limit) continue;
+                best = it->id;
+                bestText = &it->text;
+                bestDiff = std::move(candidate);
+                limit = bestDiff.size();
             }
+            if (best >= 0 && Utils::hashString(Patch::applyDiff(*bestText, bestDiff)) != v.hash) best = -1;
 
-            // Add remaining lines from current text
-            while (currentIdx < currentLines.size()) {
-                newLines.push_back(currentLines[currentIdx]);
-                ++currentIdx;
+            if (best >= 0) {
+                out.base = best;
+                out.diffObject = store.put(bestDiff);
+                depths[i] = depths[best] + 1;
+                bytesAfter += bestDiff.size();
+                ++rebased;
+            } else {
+                out.base = -1;
+                if (v.base >= 0) out.diffObject = store.put(fromPrevious);
+                depths[i] = depths[i - 1] + 1;
+                bytesAfter += fromPrevious.size();
+                if (!previousFits) {
+                    // Every base is too deep: store the text itself
+                    out.snapshotObject = store.put(text);
+                    bytesAfter += text.size();
+                    depths[i] = 0;
+                    ++snapshots;
+                }
+            }
+            if (out.diffObject.empty()) {
+                std::cerr << "Error: failed to store the new delta of version " << i << "; repack aborted.\n";
+                return false;
             }
+            if (out.diffObject != v.diffObject) replaced.insert(v.diffObject);
+        }
+
+        byHash[v.hash] = (int)i;
+        std::vector<uint64_t> lineBits(LINE_BITS / 64);
+        for (const auto& line : lines) lineBits[line.first % LINE_BITS / 64] |= uint64_t(1) << (line.first % 64);
+        recent.push_back(Candidate{(int)i, std::move(text), std::move(lineBits)});
+        if (recent.size() > options.window + 1) recent.pop_front();
+    }
 
-            reconstructedText = Utils::joinLines(newLines);
+    if (snapshots > 0) {
+        for (size_t i = 1; i < updated.size(); ++i) {
+            updated[i].keyframe = updated[i].snapshotObject.empty() && updated[i].snapshotPath.empty()
+                                      ? updated[i - 1].keyframe : (int)i;
         }
     }
 
-    // Save reconstructed text to output file
-    if (Utils::writeFile(outputFilePath, reconstructedText)) {
-        std::cout << "Successfully rolled back to version " << versionID << "\n";
-        std::cout << "File saved to: " << outputFilePath << "\n";
-        std::cout << "Original version hash: " << versions[versionID].hash << "\n";
-        std::cout << "Original version timestamp: " << versions[versionID].timestamp << "\n";
+    // Deltas still named by some version stay
+    for (const auto& v : updated) {
+        replaced.erase(v.diffObject);
+        replaced.erase(v.snapshotObject);
+    }
 
-        // Commit the rolled back content as a new version
-        std::cout << "\nCommitting rolled back content as new version...\n";
-        commit(reconstructedText);
-        std::cout << "Rollback committed successfully! This is now the current version.\n";
-    } else {
-        std::cerr << "Error: Failed to write file to " << outputFilePath << "\n";
+    std::vector<int> oldDepths = chainDepths(versions);
+    int deepestBefore = oldDepths.empty() ? 0 : *std::max_element(oldDepths.begin(), oldDepths.end());
+    int deepestAfter = depths.empty() ? 0 : *std::max_element(depths.begin(), depths.end());
+    bool changed = snapshots > 0;
+    for (size_t i = 0; i < versions.size() && !changed; ++i) {
+        changed = updated[i].base != versions[i].base || updated[i].diffObject != versions[i].diffObject;
+    }
+    if (changed) {
+        if (!versionLog.rewrite(updated)) {
+            std::cerr << "Error: failed to rewrite " << versionLog.getPath() << "; repack aborted.\n";
+            return false;
+        }
+        versions = std::move(updated);
+        cache.clear();
+    }
+
+    long long saved = (long long)bytesBefore - (long long)bytesAfter;
+    std::cout << "Delta bases: " << rebased << " of " << versions.size() << " versions based on an earlier version"
+              << " than the previous";
+    if (snapshots > 0) std::cout << ", " << snapshots << " new snapshots";
+    std::cout << "; deltas " << bytesBefore << " bytes before, " << bytesAfter
+              << (snapshots > 0 ? " after with the snapshots (" : " after (") << saved
+              << " saved); longest delta chain " << deepestBefore << " before, " << deepestAfter
+              << " after (limit " << maxDepth << ").\n";
+    return true;
+}
+
+bool Repo::verify() {
+    TRACE_SCOPE("Repo::verify");
+    if (!Utils::directoryExists(repoPath)) {
+        std::cerr << "Error: Repository not initialized.\n";
+        return false;
+    }
+
+    if (!loadVersions()) return false;
+
+    const size_t MAX_REPORTED = 10;
+    size_t problems = 0;
+    auto report = [&](int id, const std::string& what) {
+        if (problems++ < MAX_REPORTED) std::cout << "  version " << id << ": " << what << "\n";
+    };
+
+    // One forward pass: each version is the previous text plus its diff, and
+    // a keyframe's snapshot must agree with that replay. A diff repack based
+    // on an earlier version applies to that version's text instead.
+    std::string text, next;
+    for (const auto& v : versions) {
+        std::string diffText = readDiff(v);
+        if (!v.diffObject.empty() && (!store.has(v.diffObject) || Utils::hashString(diffText) != v.diffObject)) {
+            report(v.id, "diff object " + v.diffObject.substr(0, 16) + "... is missing or damaged");
+        }
+        scratch.reset();
+        if (v.base >= 0) {
+            Patch::applyDiff(Patch::reconstructVersion(*this, versions[v.base]), diffText, next, &scratch);
+        } else {
+            Patch::applyDiff(text, diffText, next, &scratch);
+        }
+        text.swap(next);
+
+        bool textOk = Utils::hashString(text) == v.hash;
+        if (!v.snapshotObject.empty() || !v.snapshotPath.empty()) {
+            std::string snapshot = readSnapshot(v);
+            bool snapshotOk = Utils::hashString(snapshot) == v.hash;
+            if (!snapshotOk) report(v.id, "snapshot does not match the version hash");
+            // Carry on from a good snapshot so one bad diff is reported once
+            if (snapshotOk && !textOk) {
+                report(v.id, "replaying the diffs does not give the snapshot");
+                text = std::move(snapshot);
+                continue;
+            }
+        }
+        if (!textOk) report(v.id, "reconstructed text does not match the version hash");
+    }
+
+    if (problems > MAX_REPORTED) std::cout << "  ... and " << problems - MAX_REPORTED << " more\n";
+    if (problems > 0) {
+        std::cout << "Verify failed: " << problems << " problems in " << versions.size() << " versions.\n";
+        return false;
+    }
+    std::cout << "Verified " << versions.size() << " versions: OK\n";
+    return true;
+}
+
+void Repo::stats() {
+    TRACE_SCOPE("Repo::stats");
+    if (!Utils::directoryExists(repoPath)) {
+        std::cerr << "Error: Repository not initialized.\n";
+        return;
+    }
+
+    if (!loadVersions()) return;
+
+    size_t keyframes = 0, rebased = 0;
+    for (const auto& v : versions) {
+        if (!v.snapshotObject.empty() || !v.snapshotPath.empty()) ++keyframes;
+        if (v.base >= 0) ++rebased;
     }
+    std::vector<int> depths = chainDepths(versions);
+    int longestChain = depths.empty() ? 0 : *std::max_element(depths.begin(), depths.end());
+    const std::string& latest = latestText();
+    ObjectStore::DiskStats disk = store.diskStats();
+
+    std::cout << "Versions: " << versions.size() << " (" << keyframes << " snapshots, longest delta chain "
+              << longestChain << ")\n";
+    if (rebased > 0) std::cout << "Deltas based on an earlier version than the previous: " << rebased << "\n";
+    std::cout << "Latest text: " << latest.size() << " bytes\n";
+    std::cout << "Objects: " << disk.looseObjects << " loose (" << disk.looseBytes << " bytes), "
+              << disk.packObjects << " packed (" << disk.packBytes << " bytes)\n";
+}
+
+std::string Repo::getLatestText() {
+    if (!loadVersions()) return "";
+    return latestText();
+}
+
+const std::string& Repo::latestText() {
+    TRACE_SCOPE("Repo::latestText");
+    if (versions.empty()) {
+        currentText.clear();
+        currentTextId = -1;
+        return currentText;
+    }
+    const Version& head = versions.back();
+    if (currentTextId == head.id) return currentText;
+
+    if (!loadHead()) {
+        // HEAD is missing or stale (repository from an older build, or a
+        // crash between the version log and HEAD): rebuild it once
+        currentText = Patch::reconstructVersion(*this, head);
+        currentTextId = head.id;
+        saveHead();
+    }
+    return currentText;
+}
+
+bool Repo::loadHead() {
+    TRACE_SCOPE("Repo::loadHead");
+    std::string content = FileManager::loadText(headFilePath, key.get());
+    size_t newline = content.find('\n');
+    if (newline == std::string::npos) return false;
+
+    const Version& head = versions.back();
+    if (content.compare(0, newline + 1, headHeader(head)) != 0) return false;
+
+    std::string_view text(content.data() + newline + 1, content.size() - newline - 1);
+    if (Utils::hashString(text) != head.hash) return false;
+
+    content.erase(0, newline + 1);
+    currentText = std::move(content);
+    currentTextId = head.id;
+    return true;
+}
+
+void Repo::saveHead() {
+    TRACE_SCOPE("Repo::saveHead");
+    std::string content = headHeader(versions.back());
+    content += currentText;
+
+    // Replace atomically: readers see the old HEAD or the new one, never half
+    std::string tmpPath = headFilePath + ".tmp";
+    std::error_code ec;
+    bool saved = FileManager::saveText(tmpPath, content, key.get());
+    if (saved) std::filesystem::rename(tmpPath, headFilePath, ec);
+    if (!saved || ec) {
+        std::filesystem::remove(tmpPath, ec);
+        std::cerr << "Warning: could not update " << headFilePath << "\n";
+    }
+}
+
+bool Repo::openHead(FileManager::Reader& head) {
+    TRACE_SCOPE("Repo::openHead");
+    // Check the header and the text's hash, then reopen at the text
+    const Version& newest = versions.back();
+    std::string header = headHeader(newest);
+    std::string buffer(COPY_BLOCK, '\0');
+    auto readHeader = [&]() {
+        size_t got = 0, n;
+        while (got < header.size() && (n = head.read(&buffer[got], header.size() - got)) > 0) got += n;
+        return got == header.size() && buffer.compare(0, header.size(), header) == 0;
+    };
+
+    if (!head.open(headFilePath, key.get()) || !readHeader()) return false;
+    Sha256::Hasher hasher;
+    size_t n;
+    while ((n = head.read(&buffer[0], buffer.size())) > 0) hasher.update(buffer.data(), n);
+    if (Sha256::toHex(hasher.finish()) != newest.hash) return false;
+
+    head = FileManager::Reader();
+    return head.open(headFilePath, key.get()) && readHeader();
+}
+
+bool Repo::saveHeadFrom(const std::string& path) {
+    TRACE_SCOPE("Repo::saveHeadFrom");
+    std::ifstream input(path, std::ios::binary);
+    if (input.is_open()) TRACE_COUNT(FilesOpened, 1);
+    std::string tmpPath = headFilePath + ".tmp";
+    FileManager::Writer writer;
+    bool ok = input.is_open() && writer.open(tmpPath, key.get()) &&
+              writer.write(headHeader(versions.back()));
+    std::string buffer(COPY_BLOCK, '\0');
+    while (ok && input) {
+        input.read(&buffer[0], buffer.size());
+        TRACE_COUNT(BytesRead, static_cast<uint64_t>(input.gcount()));
+        ok = writer.write(std::string_view(buffer.data(), static_cast<size_t>(input.gcount())));
+    }
+    ok = writer.close() && ok && !input.bad();
+
+    std::error_code ec;
+    if (ok) std::filesystem::rename(tmpPath, headFilePath, ec);
+    if (!ok || ec) {
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
+
+const std::vector<Version>& Repo::getVersions() const {
+    return versions;
+}
+
+VersionCache& Repo::getCache() const {
+    return cache;
+}
+
+void Repo::updateSearchIndex() {
+    // Kept up only where one exists (new repositories, or searched before)
+    if (!isEncrypted() && searchIndex.exists()) indexHistory();
+}
+
+bool Repo::indexHistory() {
+    TRACE_SCOPE("Repo::indexHistory");
+    // An index of another history (the log was rewritten) or with damaged
+    // files is built again from the start
+    bool usable = searchIndex.open();
+    int indexed = searchIndex.version();
+    if (!usable || indexed >= (int)versions.size() ||
+        (indexed >= 0 && versions[indexed].hash != searchIndex.versionHash())) {
+        if (!searchIndex.create()) return false;
+    }
+    if (searchIndex.version() == (int)versions.size() - 1) return true;
+
+    for (int id = searchIndex.version() + 1; id < (int)versions.size(); ++id) {
+        if (searchIndex.add(id, versions[id].hash, previousDiff(id))) continue;
+
+        // Older headerless diffs carry no line positions
+        if (!searchIndex.add(id, versions[id].hash, previousDiff(id, true))) return false;
+    }
+    return searchIndex.flush();
+}
+
+// A blame file: "DSABLAME1 <version> <hash>", then one "<origin> <count>"
+// line per run of consecutive lines added by the same version
+static std::string blameHeader(const Version& v) {
+    return "DSABLAME1 " + std::to_string(v.id) + " " + v.hash + "\n";
+}
+
+int Repo::loadBlame(int versionID, std::vector<int>& lineOrigins) {
+    TRACE_SCOPE("Repo::loadBlame");
+    std::vector<int> cached;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(blameDir, ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name.empty() || name.find_first_not_of("0123456789") != std::string::npos || name.size() > 9) continue;
+        int id = std::stoi(name);
+        if (id <= versionID) cached.push_back(id);
+    }
+    std::sort(cached.rbegin(), cached.rend());
+
+    for (int id : cached) {
+        std::string content = FileManager::loadText(blameDir + "/" + std::to_string(id), key.get());
+        std::vector<std::string_view> records = Utils::splitLineViews(content);
+        if (records.empty() || std::string(records[0]) + "\n" != blameHeader(versions[id])) continue;
+
+        lineOrigins.clear();
+        bool valid = true;
+        for (size_t r = 1; r < records.size() && valid; ++r) {
+            std::istringstream run{std::string(records[r])};
+            int origin = -1;
+            size_t count = 0;
+            valid = (run >> origin >> count) && origin >= 0 && origin <= id;
+            if (valid) lineOrigins.insert(lineOrigins.end(), count, origin);
+        }
+        if (valid) return id;
+    }
+    lineOrigins.clear();
+    return -1;
+}
+
+void Repo::saveBlame(int versionID, const std::vector<int>& lineOrigins) {
+    TRACE_SCOPE("Repo::saveBlame");
+    std::string content = blameHeader(versions[versionID]);
+    for (size_t i = 0; i < lineOrigins.size();) {
+        size_t end = i;
+        while (end < lineOrigins.size() && lineOrigins[end] == lineOrigins[i]) ++end;
+        content += std::to_string(lineOrigins[i]) + " " + std::to_string(end - i) + "\n";
+        i = end;
+    }
+
+    // Only a cache: a failure to write it is not worth reporting
+    Utils::createDirectory(blameDir);
+    std::string path = blameDir + "/" + std::to_string(versionID);
+    std::string tmpPath = path + ".tmp";
+    std::error_code ec;
+    if (FileManager::saveText(tmpPath, content, key.get())) std::filesystem::rename(tmpPath, path, ec);
+    std::filesystem::remove(tmpPath, ec);
+}
+
+std::string Repo::previousDiff(int id, bool rebuild) {
+    if (versions[id].base < 0 && !rebuild) return readDiff(versions[id]);
+    std::string before = id > 0 ? Patch::reconstructVersion(*this, versions[id - 1]) : "";
+    return Diff::generateText(before, Patch::reconstructVersion(*this, versions[id]));
+}
+
+std::string Repo::readDiff(const Version& v) const {
+    if (!v.diffObject.empty()) return store.get(v.diffObject, v.id);
+    return Utils::readFile(v.diffPath);
+}
+
+bool Repo::hasSnapshot(const Version& v) const {
+    if (!v.snapshotObject.empty()) return store.has(v.snapshotObject);
+    return !v.snapshotPath.empty() && Utils::fileExists(v.snapshotPath);
+}
+
+std::string Repo::readSnapshot(const Version& v) const {
+    if (!v.snapshotObject.empty()) return store.get(v.snapshotObject, v.id);
+    return Utils::readFile(v.snapshotPath);
+}
+
+const ObjectStore& Repo::getStore() const {
+    return store;
+}
+
+const Journal& Repo::getJournal() const {
+    return journal;
 }
 
 std::string Repo::getRepoPath() const {
     return repoPath;
 }
 
-void Repo::loadVersions() {
-    if (Utils::fileExists(versionsFilePath)) {
-        versions = Metadata::loadMetadata(versionsFilePath);
+bool Repo::loadVersions() {
+    TRACE_SCOPE("Repo::loadVersions");
+    if (!unlock()) return false;
+    if (!versionLog.exists() && Utils::fileExists(versionsFilePath) && !migrateVersionsFile()) {
+        return false;
+    }
+    if (versionLog.exists() && !versionLog.load(versions)) {
+        std::cerr << "Error: " << versionLog.getPath() << " is not a readable version log.\n";
+        return false;
+    }
+    if (!journalChecked && versionLog.exists()) {
+        journalChecked = true;
+        recoverJournal();
+    }
+    return true;
+}
+
+bool Repo::recoverJournal() {
+    if (!journal.exists()) return true;
+    TRACE_SCOPE("Repo::recoverJournal");
+    std::vector<Journal::Entry> entries;
+    size_t checkpoint = 0;
+    bool sameBoot = false;
+    bool readable = journal.read(entries, checkpoint, sameBoot);
+    if (!readable) {
+        std::cerr << "Warning: " << journal.getPath() << " is not a readable journal; starting a new one.\n";
+        checkpoint = versions.size();
+    }
+
+    // After a crash (the machine went down, not just the process) records
+    // past the last journaled commit may name objects that never reached
+    // the disk. None of them was reported committed, so they go.
+    size_t dropped = 0;
+    size_t keep = entries.empty() ? checkpoint : std::max(checkpoint, (size_t)entries.back().version.id + 1);
+    if (!sameBoot && versions.size() > keep) {
+        dropped = versions.size() - keep;
+        std::vector<Version> kept(versions.begin(), versions.begin() + keep);
+        if (!versionLog.rewrite(kept)) {
+            std::cerr << "Error: failed to drop unfinished versions from " << versionLog.getPath() << "\n";
+            return false;
+        }
+        versions.swap(kept);
+        currentTextId = -1;
+    }
+
+    // Objects the page cache lost are written again from the entries, and
+    // records the log lost are appended. Within one boot nothing written
+    // was lost, so only records missing from the log need looking at.
+    size_t restoredObjects = 0, restoredVersions = 0;
+    for (const auto& entry : entries) {
+        const Version& v = entry.version;
+        if (v.id < 0 || (size_t)v.id > versions.size()) break;
+        bool missing = (size_t)v.id == versions.size();
+        if (!missing && (sameBoot || versions[v.id].hash != v.hash)) continue;
+
+        bool intact = true;
+        for (const auto& stored : entry.objects) {
+            std::string content = FileManager::decodeText(stored, key.get());
+            std::string id = Utils::hashString(content);
+            if (id != v.diffObject && id != v.snapshotObject) {
+                intact = false;
+                break;
+            }
+            if (store.has(id) && Utils::hashString(store.get(id)) == id) continue;
+            if (!store.restore(content)) {
+                std::cerr << "Error: failed to restore object " << id.substr(0, 16) << "...\n";
+                return false;
+            }
+            ++restoredObjects;
+        }
+        if (!intact) break;
+        if (missing) {
+            if (!versionLog.append(v)) return false;
+            versions.push_back(v);
+            currentTextId = -1;
+            ++restoredVersions;
+        }
+    }
+
+    bool changed = dropped > 0 || restoredObjects > 0 || restoredVersions > 0;
+    if (changed) {
+        std::cerr << "Recovered " << repoPath << " from its journal: " << restoredVersions << " versions and "
+                  << restoredObjects << " objects restored, " << dropped << " unfinished versions dropped.\n";
+        // The search index was not flushed either; it is built again on the next search
+        if (!sameBoot) searchIndex.remove();
+    }
+    if ((changed || !readable || durability != Durability::Batch) && !checkpointJournal()) return false;
+    if (durability != Durability::Batch) journal.remove();
+    return true;
+}
+
+bool Repo::checkpointJournal() {
+    TRACE_SCOPE("Repo::checkpointJournal");
+    std::vector<Journal::Entry> entries;
+    size_t first = 0;
+    bool sameBoot = false;
+    if (!journal.read(entries, first, sameBoot)) first = 0;   // no journal yet: all of it
+
+    std::vector<std::string> ids;
+    for (size_t i = std::min(first, versions.size()); i < versions.size(); ++i) {
+        if (!versions[i].diffObject.empty()) ids.push_back(versions[i].diffObject);
+        if (!versions[i].snapshotObject.empty()) ids.push_back(versions[i].snapshotObject);
+    }
+    if (!store.sync(ids) || (versionLog.exists() && !Utils::syncFile(versionLog.getPath()))) {
+        std::cerr << "Error: failed to flush " << repoPath << " for a checkpoint.\n";
+        return false;
+    }
+    return journal.reset(versions.size());
+}
+
+bool Repo::journalVersion(const Journal::Entry& entry, uint64_t& ticket) {
+    if ((!journal.exists() || journal.size() >= JOURNAL_CHECKPOINT_BYTES) && !checkpointJournal()) return false;
+    return journal.append(entry, ticket);
+}
+
+bool Repo::flushAppended() {
+    bool ok = true;
+    if (durability == Durability::Strict) ok = Utils::syncFile(versionLog.getPath());
+    else if (durability == Durability::Batch) ok = checkpointJournal();
+    if (!ok) std::cerr << "Error: failed to flush the new versions of " << repoPath << "\n";
+    return ok;
+}
+
+bool Repo::migrateVersionsFile() {
+    TRACE_SCOPE("Repo::migrateVersionsFile");
+    std::vector<Version> legacy = Metadata::loadMetadata(versionsFilePath);
+
+    // The log stores object ids only, so loose diff and snapshot files move
+    // into the object store. Hashes from before SHA-256 are recomputed by
+    // replaying the history once.
+    std::string text;
+    for (auto& v : legacy) {
+        std::string diffText = readDiff(v);
+        bool keyframe = hasSnapshot(v);
+        text = keyframe ? readSnapshot(v) : Patch::applyDiff(text, diffText);
+
+        if (v.diffObject.empty()) {
+            v.diffObject = store.put(diffText);
+            v.diffPath.clear();
+        }
+        if (v.snapshotObject.empty() && keyframe) {
+            v.snapshotObject = store.put(text);
+            v.snapshotPath.clear();
+        }
+        Sha256::Digest digest;
+        if (!Sha256::fromHex(v.hash, digest)) {
+            v.hash = Utils::hashString(text);
+        }
     }
+
+    if (!versionLog.rewrite(legacy)) {
+        std::cerr << "Error: Failed to migrate " << versionsFilePath << "\n";
+        return false;
+    }
+    // Keep the old file around, but out of the way of the next load
+    std::rename(versionsFilePath.c_str(), (versionsFilePath + ".migrated").c_str());
+    std::cout << "Migrated " << legacy.size() << " versions from versions.txt to versions.log.\n";
+    return true;
 }
 
-void Repo::saveVersions() {
-    Metadata::saveMetadata(versionsFilePath, versions);
+bool Repo::needsKeyframe(size_t newDiffBytes) const {
+    // Versions written before keyframes existed chain back to version 0
+    int lastKeyframe = versions.back().keyframe < 0 ? 0 : versions.back().keyframe;
+    int nextID = (int)versions.size();
+
+    if (keyframePolicy.interval > 0 && nextID - lastKeyframe >= keyframePolicy.interval) {
+        return true;
+    }
+    // Diffs are counted as stored (compressed, encrypted), the new one too
+    if (keyframePolicy.maxChainBytes > 0) {
+        size_t chainBytes = newDiffBytes;
+        for (int i = lastKeyframe + 1; i < nextID; ++i) {
+            const Version& v = versions[i];
+            chainBytes += v.diffObject.empty() ? Utils::fileSize(v.diffPath) : store.size(v.diffObject);
+        }
+        if (chainBytes > keyframePolicy.maxChainBytes) return true;
+    }
+    return false;
 }
@@ -1,40 +1,250 @@
 #pragma once
+#include <deque>
+#include <functional>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_set>
 #include <vector>
+#include "arena.h"
+#include "crypto.h"
 #include "version.h"
+#include "version_cache.h"
+#include "../storage/file_manager.h"
+#include "../storage/journal.h"
+#include "../storage/object_store.h"
+#include "../storage/search_index.h"
+#include "../storage/version_log.h"
+
+class ThreadPool;
 
 class Repo {
 private:
     std::string repoPath;                 // Path to repository directory
     std::vector<Version> versions;        // All committed versions
-    std::string versionsFilePath;         // Path to versions.txt metadata file
-    std::string currentText;              // Current working text
+    std::string versionsFilePath;         // Path to the old versions.txt (read once, for migration)
+    std::string currentText;              // Text of version currentTextId
+    int currentTextId = -1;               // Version currentText holds (-1: none yet)
+    std::string headFilePath;             // Latest version's text, materialized on disk
+    std::string keyFilePath;              // Present in encrypted repositories: KDF salt and key check
+    std::string blameDir;                 // Line origins of versions blamed before, one file each
+    KeyframePolicy keyframePolicy;        // When commit stores a full snapshot
+    mutable VersionCache cache;           // Recently reconstructed version texts
+    ObjectStore store;                    // Content-addressed diffs and snapshots
+    VersionLog versionLog;                // Append-only binary version metadata
+    Journal journal;                      // Commits since the last checkpoint (Durability::Batch)
+    Durability durability = Durability::Batch;
+    bool groupCommit = false;             // commit() leaves flushing the journal to waitDurable
+    bool journalChecked = false;          // recoverJournal has run for this instance
+    uint64_t lastTicket = 0;              // journal position of the newest commit
+    SearchIndex searchIndex;              // Lines of every version, by trigram (not in encrypted repositories)
+    std::shared_ptr<ThreadPool> diffPool; // Workers for diffing large commits (none: sequential)
+    size_t memoryBudget = 0;              // Bytes a commit may use (0: no limit)
+    Arena scratch;                        // Per-step temporaries of diff and replay, reset per step
+    std::string passphrase;               // Given with setPassphrase ("": use DSA_PASSPHRASE)
+    std::shared_ptr<const Crypto::Key> key; // Set once unlocked (null: not encrypted)
+    std::string writerLockPath;           // <repo>/lock, held while a commit or repack writes
+    intptr_t writerLock = -1;             // Utils::lockFile handle while held
+    int writerDepth = 0;                  // WriterScopes open on this instance
+
+    // Commit and repack hold the writer lock, so writers in other processes
+    // take turns instead of filling the same version log slot. It is taken
+    // before the version log is (re)loaded. Nested scopes share it.
+    class WriterScope {
+    public:
+        explicit WriterScope(Repo& repo);
+        ~WriterScope();
+        WriterScope(const WriterScope&) = delete;
+        WriterScope& operator=(const WriterScope&) = delete;
+        bool held() const;
 
-    void loadVersions();                  // Load versions from metadata file
-    void saveVersions();                  // Save versions to metadata file
+    private:
+        Repo& repo;
+    };
+
+    bool loadVersions();                  // Unlock, then load new versions from the version log (false: locked or unreadable)
+    bool unlock();                        // Derive the key if the repository is encrypted
+    std::string secretPassphrase() const; // The passphrase given, else DSA_PASSPHRASE
+    bool migrateVersionsFile();           // Convert versions.txt into the version log
+    const std::string& latestText();      // Text of the newest version (HEAD file, else rebuilt)
+    bool loadHead();                      // Read HEAD if it matches the newest version
+    void saveHead();                      // Write currentText as HEAD
+    bool needsKeyframe(size_t newDiffBytes) const; // Apply keyframePolicy to the next commit (stored diff bytes)
+    // Store objects for the next version (and, if given, add them to its journal entry)
+    Version stageVersion(std::string_view text, const std::string& hash, Journal::Entry* journaled = nullptr);
+    // Once per instance: put back from the journal what a crash lost of
+    // the version log and objects, then checkpoint
+    bool recoverJournal();
+    // Flush the objects of versions since the last checkpoint and the
+    // version log, then start an empty journal
+    bool checkpointJournal();
+    // Append a commit's entry, checkpointing first once the journal is large
+    bool journalVersion(const Journal::Entry& entry, uint64_t& ticket);
+    // Make versions appended without a journal entry (commitBatch,
+    // commitStreaming) as durable as the level asks
+    bool flushAppended();
+    bool openHead(FileManager::Reader& head); // HEAD positioned at the text, if it matches the newest version
+    bool saveHeadFrom(const std::string& path); // Write a file's content as HEAD, a block at a time
+    // A version's lines composed (Delta) from its keyframe, without applying
+    // each diff to the text; `texts` keeps what they point into. False for
+    // the older headerless diff format.
+    bool composeLines(int versionID, std::deque<std::string>& texts, std::vector<std::string_view>& lines);
+    // Hunks from version id - 1 to id: the stored diff, or with `rebuild`
+    // (or where repack based the diff on another version) diffed from both texts
+    std::string previousDiff(int id, bool rebuild = false);
+    // For each version, the smallest delta among the previous version, an
+    // earlier one with the same text and the `window` before it, with no
+    // version more than maxDepth diffs from a snapshot (a version that would
+    // be gets one). The version log is rewritten atomically to name the new
+    // deltas; those they replace are added to `replaced`.
+    bool chooseDeltaBases(const RepackOptions& options, std::unordered_set<std::string>& replaced);
+    void updateSearchIndex();             // After a commit: index the new versions, if there is an index
+    bool indexHistory();                  // Bring the search index up to the newest version (building it if need be)
+    int loadBlame(int versionID, std::vector<int>& lineOrigins); // Newest cached version <= versionID (-1: none)
+    void saveBlame(int versionID, const std::vector<int>& lineOrigins);
 
 public:
     // Constructor: takes the repository path (e.g., "./repo")
     Repo(const std::string& path);
 
+    // Apply every setting below from one RepoOptions
+    void configure(const RepoOptions& options);
+
+    // Configure when commits store full snapshots
+    void setKeyframePolicy(const KeyframePolicy& policy);
+
+    // Compress newly stored objects (default on)
+    void setCompression(bool enabled);
+
+    // Diff large commits on `threads` workers (Diff::computeEditsParallel);
+    // 0 or 1 keeps the sequential engine
+    void setDiffThreads(size_t threads);
+
+    // Memory a commit may use, in bytes (0, the default: no limit). A text
+    // too large to diff in memory within it is committed with commitStreaming.
+    void setMemoryBudget(size_t bytes);
+    size_t getMemoryBudget() const;
+    // True if committing a text of textBytes (against the current HEAD) would
+    // not fit the budget in memory
+    bool exceedsMemoryBudget(size_t textBytes) const;
+
+    // What a commit has flushed to disk when it returns (default Batch).
+    // Strict flushes each object and the version log record; Batch flushes
+    // one journal entry (see Journal), so commits close together share a
+    // flush; None leaves it all to the OS.
+    void setDurability(Durability level);
+    Durability getDurability() const;
+
+    // Group commit for a server: commit() at Batch writes its journal entry
+    // but returns before flushing it. Call waitDurable(commitTicket()) once
+    // the repository is free for other commits, whose entries then go out
+    // in the same flush. Thread-safe against commands running meanwhile.
+    void setGroupCommit(bool enabled);
+    uint64_t commitTicket() const;          // journal position of the newest commit (0: none)
+    bool waitDurable(uint64_t ticket);
+
+    // Passphrase of an encrypted repository; without one, DSA_PASSPHRASE
+    // from the environment is used
+    void setPassphrase(const std::string& text);
+
+    // Encrypt everything written from now on with a key derived from the
+    // passphrase (PBKDF2, `iterations` rounds). HEAD is rewritten encrypted
+    // at once; objects stored before stay plain until the next repack.
+    bool enableEncryption(uint32_t iterations = Crypto::DEFAULT_ITERATIONS);
+    bool isEncrypted() const;
+
     // Initialize a new repository
     void init();
 
-    // Commit the given text as a new version
-    void commit(const std::string& text);
+    // Commit the given text as a new version. Diffs store whole lines, so
+    // a text without a final newline is committed with one (as are files
+    // and batch revisions), and the version hash covers that text. False
+    // if no version was committed (an error, or nothing changed).
+    bool commit(std::string_view text);
+
+    // Commit the content of a file without holding it, or the previous
+    // version, in memory: both are diffed through windows (Diff::generateStream)
+    // sized to the memory budget, and objects and HEAD are written a block
+    // at a time. The stored diff may be longer than commit() would make
+    // when a change spans more than a window.
+    void commitStreaming(const std::string& path);
+
+    // Yields the next revision of a batch into `text`; false when there are no more
+    using RevisionSource = std::function<bool(std::string& text)>;
 
-    // Display commit log (history)
-    void log();
+    // Commit every revision from `next`, in order, as consecutive versions.
+    // Metadata is loaded once, each revision is diffed against the previous
+    // one in memory, and the version log and HEAD are written once at the end.
+    // Revisions identical to their predecessor are skipped. Returns the
+    // number of versions committed.
+    size_t commitBatch(const RevisionSource& next);
 
-    // Show diff between two versions
+    // Display commit log (history), or the part of it `query` selects.
+    // Only the selected records are read, so a query for the newest few
+    // versions or a time window costs the same on any length of history.
+    void log(const LogQuery& query = LogQuery());
+
+    // Show what changed from one version to another (either may be the older)
     void diff(int versionA, int versionB);
 
+    // The net diff from version a to b as hunks (Diff::appendHunks form).
+    // The stored diffs between them are composed (Delta) without rebuilding
+    // either text; only when that chain is larger than the text are both
+    // versions rebuilt and diffed instead. `composed` tells which was done.
+    bool diffVersions(int versionA, int versionB, std::string& hunks, bool& composed);
+
+    // The version that last added each line of a version's text. One pass
+    // over the history composes the stored diffs (Delta) while tracking the
+    // diff every run of lines came from, so the cost follows the size of the
+    // diffs, not versions times text. Results are cached per version, and a
+    // later blame starts from the newest cached version at or below it.
+    bool annotate(int versionID, std::vector<int>& lineOrigins, std::vector<std::string>& lines);
+
+    // Print the annotated text, or lines firstLine..lastLine of it
+    // (1-based, inclusive; 0 as lastLine: to the end)
+    void blame(int versionID, size_t firstLine = 1, size_t lastLine = 0);
+
+    // Every version that held a line containing `pattern` (plain bytes,
+    // case-sensitive), and those lines. Answered from the search index,
+    // which commits keep current; a repository without one is indexed
+    // first, once.
+    void search(const std::string& pattern);
+
     // Restore (checkout) a specific version
     void checkout(int versionID);
 
     // Rollback to a specific version (reconstruct and save file)
     void rollback(int versionID, const std::string& outputFilePath);
 
+    // Fold loose objects into the packfile, indexed by version id. First
+    // each version's delta base is chosen again (chooseDeltaBases) unless
+    // options.window is 0.
+    void repack(const RepackOptions& options = RepackOptions());
+
+    // Replay the whole history once, checking every object and version hash.
+    // Prints what is wrong; returns true if nothing is.
+    bool verify();
+
+    // Print version, keyframe and storage figures
+    void stats();
+
+    // Full text of the most recent version ("" if nothing is committed)
+    std::string getLatestText();
+
+    // Versions loaded by the last command
+    const std::vector<Version>& getVersions() const;
+
+    // Reconstruction cache shared by checkout, rollback and Patch::reconstructVersion
+    VersionCache& getCache() const;
+
+    // Stored payloads of a version (object store, or loose files for older versions)
+    std::string readDiff(const Version& v) const;
+    bool hasSnapshot(const Version& v) const;
+    std::string readSnapshot(const Version& v) const;
+
+    const ObjectStore& getStore() const;
+    const Journal& getJournal() const;
+
     // Get current repository path
     std::string getRepoPath() const;
 };
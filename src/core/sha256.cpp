@@ -0,0 +1,243 @@
+#include "sha256.h"
+#include <algorithm>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SHA256_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace Sha256 {
+
+namespace {
+
+const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+inline uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+inline uint32_t loadBE32(const unsigned char* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+void compressPortable(uint32_t* state, const unsigned char* data, size_t blocks) {
+    uint32_t w[64];
+    for (; blocks > 0; --blocks, data += 64) {
+        for (int t = 0; t < 16; ++t) w[t] = loadBE32(data + 4 * t);
+        for (int t = 16; t < 64; ++t) {
+            uint32_t s0 = rotr(w[t - 15], 7) ^ rotr(w[t - 15], 18) ^ (w[t - 15] >> 3);
+            uint32_t s1 = rotr(w[t - 2], 17) ^ rotr(w[t - 2], 19) ^ (w[t - 2] >> 10);
+            w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int t = 0; t < 64; ++t) {
+            uint32_t S1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+            uint32_t ch = (e & f) ^ (~e & g);
+            uint32_t t1 = h + S1 + ch + K[t] + w[t];
+            uint32_t S0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+            uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t t2 = S0 + maj;
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+}
+
+#ifdef SHA256_X86
+
+// Four rounds per step with the SHA-NI instructions; the message schedule
+// rotates through four registers (W[g % 4] holds words 4g..4g+3).
+__attribute__((target("sha,sse4.1,ssse3")))
+void compressShaNi(uint32_t* state, const unsigned char* data, size_t blocks) {
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i tmp = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0]));
+    __m128i state1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4]));
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);                 // CDAB
+    state1 = _mm_shuffle_epi32(state1, 0x1B);           // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);   // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);        // CDGH
+
+    for (; blocks > 0; --blocks, data += 64) {
+        const __m128i abefSave = state0;
+        const __m128i cdghSave = state1;
+        __m128i w[4];
+
+        for (int g = 0; g < 16; ++g) {
+            if (g < 4) {
+                w[g] = _mm_shuffle_epi8(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * g)), byteSwap);
+            }
+            __m128i msg = _mm_add_epi32(w[g & 3],
+                                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(&K[4 * g])));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            if (g >= 3 && g <= 14) {
+                // finish the schedule words for step g + 1
+                __m128i next = _mm_add_epi32(w[(g + 1) & 3], _mm_alignr_epi8(w[g & 3], w[(g - 1) & 3], 4));
+                w[(g + 1) & 3] = _mm_sha256msg2_epu32(next, w[g & 3]);
+            }
+            msg = _mm_shuffle_epi32(msg, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+            if (g >= 1 && g <= 12) {
+                w[(g - 1) & 3] = _mm_sha256msg1_epu32(w[(g - 1) & 3], w[g & 3]);
+            }
+        }
+
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);              // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);           // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);        // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);           // HGFE
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), state1);
+}
+
+bool cpuHasShaNi() {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+    const bool sse41 = (ecx & (1u << 19)) != 0;
+    const bool ssse3 = (ecx & (1u << 9)) != 0;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+    const bool sha = (ebx & (1u << 29)) != 0;
+    return sse41 && ssse3 && sha;
+}
+
+#else
+
+bool cpuHasShaNi() { return false; }
+
+#endif
+
+using CompressFn = void (*)(uint32_t*, const unsigned char*, size_t);
+
+CompressFn selectCompress(bool allowAccelerated) {
+#ifdef SHA256_X86
+    if (allowAccelerated && cpuHasShaNi()) return compressShaNi;
+#endif
+    (void)allowAccelerated;
+    return compressPortable;
+}
+
+CompressFn compressBlocks = selectCompress(true);
+
+} // namespace
+
+Hasher::Hasher() : buffered(0), totalBytes(0) {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    std::memcpy(state, initial, sizeof(state));
+}
+
+void Hasher::update(const void* data, size_t length) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    totalBytes += length;
+
+    if (buffered > 0) {
+        size_t take = std::min(length, sizeof(buffer) - buffered);
+        std::memcpy(buffer + buffered, p, take);
+        buffered += take;
+        p += take;
+        length -= take;
+        if (buffered < sizeof(buffer)) return;
+        compressBlocks(state, buffer, 1);
+        buffered = 0;
+    }
+
+    size_t blocks = length / 64;
+    if (blocks > 0) {
+        compressBlocks(state, p, blocks);
+        p += blocks * 64;
+        length -= blocks * 64;
+    }
+
+    std::memcpy(buffer, p, length);
+    buffered = length;
+}
+
+Digest Hasher::finish() {
+    const uint64_t bitLength = totalBytes * 8;
+
+    unsigned char pad[72] = {0x80};
+    size_t padLength = (buffered < 56) ? 56 - buffered : 120 - buffered;
+    for (int i = 0; i < 8; ++i) {
+        pad[padLength + i] = static_cast<unsigned char>(bitLength >> (56 - 8 * i));
+    }
+    update(pad, padLength + 8);
+
+    Digest out;
+    for (int i = 0; i < 8; ++i) {
+        out[4 * i] = static_cast<unsigned char>(state[i] >> 24);
+        out[4 * i + 1] = static_cast<unsigned char>(state[i] >> 16);
+        out[4 * i + 2] = static_cast<unsigned char>(state[i] >> 8);
+        out[4 * i + 3] = static_cast<unsigned char>(state[i]);
+    }
+    return out;
+}
+
+Digest digest(const void* data, size_t length) {
+    Hasher hasher;
+    hasher.update(data, length);
+    return hasher.finish();
+}
+
+Digest digest(const std::string& data) {
+    return digest(data.data(), data.size());
+}
+
+std::string toHex(const Digest& digest) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out(64, '0');
+    for (size_t i = 0; i < digest.size(); ++i) {
+        out[2 * i] = digits[digest[i] >> 4];
+        out[2 * i + 1] = digits[digest[i] & 0x0f];
+    }
+    return out;
+}
+
+std::string hex(const std::string& data) {
+    return toHex(digest(data));
+}
+
+bool fromHex(const std::string& hexText, Digest& digest) {
+    if (hexText.size() != 64) return false;
+    auto nibble = [](char c) -> int {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+    for (size_t i = 0; i < digest.size(); ++i) {
+        int hi = nibble(hexText[2 * i]);
+        int lo = nibble(hexText[2 * i + 1]);
+        if (hi < 0 || lo < 0) return false;
+        digest[i] = static_cast<unsigned char>((hi << 4) | lo);
+    }
+    return true;
+}
+
+bool accelerated() {
+    return compressBlocks != compressPortable;
+}
+
+void useAcceleration(bool enable) {
+    compressBlocks = selectCompress(enable);
+}
+
+} // namespace Sha256
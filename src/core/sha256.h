@@ -0,0 +1,42 @@
+#pragma once
+#include <array>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace Sha256 {
+
+    using Digest = std::array<unsigned char, 32>;
+
+    // Incremental SHA-256 (FIPS 180-4)
+    class Hasher {
+    public:
+        Hasher();
+        void update(const void* data, size_t length);
+        Digest finish();
+
+    private:
+        uint32_t state[8];
+        unsigned char buffer[64];
+        size_t buffered;
+        uint64_t totalBytes;
+    };
+
+    // One-shot digests
+    Digest digest(const void* data, size_t length);
+    Digest digest(const std::string& data);
+
+    // Lowercase hex of a digest, and hex digest of a string
+    std::string toHex(const Digest& digest);
+    std::string hex(const std::string& data);
+
+    // Parse 64 hex characters back into a digest; false on malformed input
+    bool fromHex(const std::string& hexText, Digest& digest);
+
+    // True when blocks go through the x86 SHA extensions instead of the portable code
+    bool accelerated();
+
+    // Force the portable path (false) or re-enable the accelerated one if the CPU has it
+    void useAcceleration(bool enable);
+
+}
@@ -0,0 +1,127 @@
+#include "thread_pool.h"
+
+namespace {
+
+// Which pool and worker the current thread belongs to (none for outside threads)
+thread_local const ThreadPool* currentPool = nullptr;
+thread_local size_t currentIndex = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    for (size_t i = 0; i < threads; ++i) queues.emplace_back(new Queue());
+    for (size_t i = 0; i < threads; ++i) workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> guard(idleLock);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+void ThreadPool::submit(Task task) {
+    int self = currentWorker();
+    size_t index = self >= 0 ? static_cast<size_t>(self) : nextQueue++ % queues.size();
+    ++unfinished;
+    {
+        // Counted before it becomes visible, so `queued` never runs behind the deques
+        std::lock_guard<std::mutex> idle(idleLock);
+        ++queued;
+        std::lock_guard<std::mutex> guard(queues[index]->lock);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    workAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+    int self = currentWorker();
+    if (self >= 0) {
+        // Help instead of blocking a worker the remaining tasks may need. The
+        // tasks sitting in wait() (this one included) are not waited for.
+        ++waitingTasks;
+        Task task;
+        while (unfinished > waitingTasks) {
+            if (takeTask(static_cast<size_t>(self), task)) {
+                runTask(task);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        --waitingTasks;
+        return;
+    }
+    std::unique_lock<std::mutex> guard(idleLock);
+    allDone.wait(guard, [this] { return unfinished == 0; });
+}
+
+size_t ThreadPool::size() const {
+    return workers.size();
+}
+
+size_t ThreadPool::steals() const {
+    return stolen;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    currentPool = this;
+    currentIndex = index;
+    Task task;
+    while (true) {
+        if (takeTask(index, task)) {
+            runTask(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(idleLock);
+        workAvailable.wait(guard, [this] { return stopping || queued > 0; });
+        if (stopping && queued == 0) return;
+    }
+}
+
+bool ThreadPool::takeTask(size_t index, Task& task) {
+    bool found = false;
+    // Own deque first, newest task
+    {
+        Queue& own = *queues[index];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            found = true;
+        }
+    }
+    // Then steal the oldest task of the next busy worker
+    for (size_t offset = 1; !found && offset < queues.size(); ++offset) {
+        Queue& victim = *queues[(index + offset) % queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            ++stolen;
+            found = true;
+        }
+    }
+    if (found) {
+        std::lock_guard<std::mutex> idle(idleLock);
+        --queued;
+    }
+    return found;
+}
+
+void ThreadPool::runTask(Task& task) {
+    task();
+    task = nullptr;
+    if (--unfinished == 0) {
+        std::lock_guard<std::mutex> guard(idleLock);
+        allDone.notify_all();
+    }
+}
+
+int ThreadPool::currentWorker() const {
+    return currentPool == this ? static_cast<int>(currentIndex) : -1;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstddef>
+
+// Fixed-size work-stealing thread pool.
+//
+// Every worker owns a deque of tasks. It takes work from the back of its own
+// deque (newest first, so a task's subtasks run while their data is still
+// in cache) and, when that is empty, steals from the front of another
+// worker's deque (oldest first, which tends to be the biggest piece of work
+// left). A worker stuck on one long task therefore never holds back the
+// tasks queued behind it. Tasks submitted from a worker go to that worker's
+// deque; tasks from other threads are spread round-robin.
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    // threads == 0 picks std::thread::hardware_concurrency()
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(Task task);
+
+    // Block until every submitted task has finished. Called from a task, it
+    // runs queued tasks while it waits, and returns once only tasks that are
+    // themselves waiting remain.
+    void wait();
+
+    size_t size() const;
+
+    // Tasks taken from another worker's deque so far
+    size_t steals() const;
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> nextQueue{0};
+    std::atomic<size_t> unfinished{0};   // submitted but not yet completed
+    std::atomic<size_t> stolen{0};
+    std::atomic<size_t> waitingTasks{0};   // tasks blocked in wait()
+    std::atomic<bool> stopping{false};
+
+    // Sleeping workers and waiters; `queued` counts tasks sitting in deques
+    std::mutex idleLock;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+    size_t queued = 0;
+
+    void workerLoop(size_t index);
+    bool takeTask(size_t index, Task& task);
+    void runTask(Task& task);
+    int currentWorker() const;
+};
@@ -0,0 +1,150 @@
+#include "trace.h"
+#include "utils.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace Trace {
+
+std::atomic<bool> active{false};
+
+namespace {
+
+struct Event {
+    const char* name;
+    uint64_t start;    // ns since enable()
+    uint64_t duration; // ns
+    uint32_t thread;
+};
+
+struct Phase {
+    uint64_t calls = 0;
+    uint64_t totalNs = 0;
+};
+
+// A long replay records one event per applied diff; past this many the
+// remaining scopes still count towards the totals but are not kept
+const size_t MAX_EVENTS = 1 << 20;
+
+std::mutex lock;
+std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+bool keepingEvents = false;
+std::vector<Event> events;
+size_t droppedEvents = 0;
+std::map<std::string, Phase> phases;
+std::atomic<uint64_t> counters[CounterCount];
+std::atomic<uint32_t> nextThread{1};
+
+const char* const counterNames[CounterCount] = {
+    "bytes read", "bytes written", "files opened", "lines processed", "allocations"
+};
+
+uint32_t threadNumber() {
+    thread_local uint32_t number = nextThread.fetch_add(1);
+    return number;
+}
+
+} // namespace
+
+void enable(bool keepEvents) {
+    std::lock_guard<std::mutex> guard(lock);
+    origin = std::chrono::steady_clock::now();
+    keepingEvents = keepEvents;
+    active.store(true, std::memory_order_relaxed);
+}
+
+void disable() {
+    active.store(false, std::memory_order_relaxed);
+}
+
+void reset() {
+    std::lock_guard<std::mutex> guard(lock);
+    events.clear();
+    droppedEvents = 0;
+    phases.clear();
+    for (auto& value : counters) value.store(0, std::memory_order_relaxed);
+}
+
+void addCounter(Counter counter, uint64_t amount) {
+    counters[counter].fetch_add(amount, std::memory_order_relaxed);
+}
+
+uint64_t counter(Counter counter) {
+    return counters[counter].load(std::memory_order_relaxed);
+}
+
+uint64_t Scope::now() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - origin).count());
+}
+
+void Scope::finish() {
+    uint64_t end = now();
+    uint32_t thread = threadNumber();
+    std::lock_guard<std::mutex> guard(lock);
+    Phase& phase = phases[name];
+    ++phase.calls;
+    phase.totalNs += end - start;
+    if (!keepingEvents) return;
+    if (events.size() < MAX_EVENTS) events.push_back({name, start, end - start, thread});
+    else ++droppedEvents;
+}
+
+void printSummary(std::ostream& out) {
+    std::vector<std::pair<std::string, Phase>> sorted;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        sorted.assign(phases.begin(), phases.end());
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+        return a.second.totalNs > b.second.totalNs;
+    });
+
+    std::ostringstream text;
+    text << "\n" << std::left << std::setw(34) << "Phase" << std::right << std::setw(10) << "calls"
+         << std::setw(14) << "total ms" << std::setw(14) << "avg us" << "\n";
+    text << std::fixed;
+    for (const auto& [name, phase] : sorted) {
+        text << std::left << std::setw(34) << name << std::right << std::setw(10) << phase.calls
+             << std::setprecision(3) << std::setw(14) << phase.totalNs / 1e6
+             << std::setprecision(1) << std::setw(14) << phase.totalNs / 1e3 / phase.calls << "\n";
+    }
+    text << "\n";
+    for (int c = 0; c < CounterCount; ++c) {
+        text << std::left << std::setw(34) << counterNames[c] << std::right << std::setw(10)
+             << counter(static_cast<Counter>(c)) << "\n";
+    }
+    out << text.str();
+}
+
+bool writeChromeTrace(const std::string& path) {
+    std::ostringstream json;
+    json << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    uint64_t last = 0;
+    size_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        json << std::fixed << std::setprecision(3);
+        for (const Event& e : events) {
+            // Chrome trace timestamps are microseconds
+            json << "{\"name\":\"" << e.name << "\",\"cat\":\"dsa\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+                 << ",\"ts\":" << e.start / 1e3 << ",\"dur\":" << e.duration / 1e3 << "},\n";
+            last = std::max(last, e.start + e.duration);
+        }
+        dropped = droppedEvents;
+    }
+
+    // Final counter values, as one counter event at the end of the trace
+    json << "{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":" << last / 1e3 << ",\"args\":{";
+    for (int c = 0; c < CounterCount; ++c) {
+        json << (c ? "," : "") << "\"" << counterNames[c] << "\":" << counter(static_cast<Counter>(c));
+    }
+    json << "}}\n],\"otherData\":{\"droppedEvents\":" << dropped << "}}\n";
+    return Utils::writeFile(path, json.str());
+}
+
+} // namespace Trace
@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Scoped timers and counters for the hot paths (--stats, --trace).
+//
+// Everything is off until Trace::enable(). While off, a probe costs one
+// relaxed load of a global flag and a branch that is never taken: a scope
+// takes no timestamp and a counter is not touched. Building with
+// -DDSA_NO_TRACE removes the probes altogether.
+//
+// Probes are placed with the macros at the bottom:
+//   TRACE_SCOPE("Repo::checkout");                    // timed until the end of the block
+//   TRACE_COUNT(BytesRead, content.size());           // added to a counter
+namespace Trace {
+
+    enum Counter {
+        BytesRead,
+        BytesWritten,
+        FilesOpened,
+        LinesProcessed,
+        Allocations,
+        CounterCount
+    };
+
+    extern std::atomic<bool> active;
+
+    inline bool enabled() {
+        return active.load(std::memory_order_relaxed);
+    }
+
+    // Start collecting. With keepEvents every scope is also kept as an event
+    // for writeChromeTrace; without it only per-phase totals are kept.
+    void enable(bool keepEvents);
+    void disable();
+
+    // Forget all totals, counters and events
+    void reset();
+
+    void addCounter(Counter counter, uint64_t amount);
+    inline void add(Counter counter, uint64_t amount = 1) {
+        if (enabled()) addCounter(counter, amount);
+    }
+    uint64_t counter(Counter counter);
+
+    // Times the enclosing block under `name` (a string literal)
+    class Scope {
+    public:
+        explicit Scope(const char* name) : name(enabled() ? name : nullptr) {
+            if (this->name) start = now();
+        }
+        ~Scope() {
+            if (name) finish();
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* name;
+        uint64_t start = 0;
+
+        static uint64_t now(); // nanoseconds since enable()
+        void finish();
+    };
+
+    // Calls and inclusive time per phase, slowest first, then the counters
+    void printSummary(std::ostream& out);
+
+    // Write the recorded scopes and final counters in Chrome trace format
+    // (chrome://tracing, Perfetto). Returns false if the file cannot be written.
+    bool writeChromeTrace(const std::string& path);
+}
+
+#ifdef DSA_NO_TRACE
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_COUNT(counter, amount) ((void)0)
+#else
+#define TRACE_JOIN2(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN2(a, b)
+#define TRACE_SCOPE(name) Trace::Scope TRACE_JOIN(traceScope, __LINE__)(name)
+#define TRACE_COUNT(counter, amount) Trace::add(Trace::counter, (amount))
+#endif
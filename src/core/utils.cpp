@@ -1,36 +1,189 @@
 #include "utils.h"
+#include "sha256.h"
+#include "trace.h"
 #include <fstream>
 #include <sstream>
 #include <chrono>
 #include <iomanip>
 #include <ctime>
 #include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 #include <sys/stat.h>
 
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define UTILS_X86 1
+#include <immintrin.h>
+#endif
+
 #ifdef _WIN32
 #include <direct.h>
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#define PSAPI_VERSION 2        // GetProcessMemoryInfo from kernel32, no psapi.lib
+#include <windows.h>
+#include <psapi.h>
 #define mkdir(path, mode) _mkdir(path)
 #else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/resource.h>
 #include <sys/types.h>
+#include <unistd.h>
 #endif
 
 namespace Utils {
 
+namespace {
+
+// Scanners fill either kind of line vector
+using LineSink = std::vector<std::string_view>;
+using PmrLineSink = std::pmr::vector<std::string_view>;
+
+// Emit the line ending at every '\n' found in [p, p + n); returns the start of
+// the unterminated remainder
+template <typename Sink>
+const char* scanMemchr(const char* p, size_t n, const char* lineStart, Sink& out) {
+    const char* end = p + n;
+    while (p < end) {
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!nl) break;
+        out.emplace_back(lineStart, nl - lineStart);
+        lineStart = p = nl + 1;
+    }
+    return lineStart;
+}
+
+#ifdef UTILS_X86
+
+// Compare a whole block against '\n' at once and walk the set bits of the mask
+template <typename Sink>
+__attribute__((target("sse2")))
+const char* scanSse2(const char* p, size_t n, const char* lineStart, Sink& out) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    const char* end = p + n;
+    for (; end - p >= 16; p += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+        while (mask) {
+            const char* nl = p + __builtin_ctz(mask);
+            out.emplace_back(lineStart, nl - lineStart);
+            lineStart = nl + 1;
+            mask &= mask - 1;
+        }
+    }
+    return scanMemchr(p, end - p, lineStart, out);
+}
+
+template <typename Sink>
+__attribute__((target("avx2")))
+const char* scanAvx2(const char* p, size_t n, const char* lineStart, Sink& out) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const char* end = p + n;
+    for (; end - p >= 32; p += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline));
+        while (mask) {
+            const char* nl = p + __builtin_ctz(mask);
+            out.emplace_back(lineStart, nl - lineStart);
+            lineStart = nl + 1;
+            mask &= mask - 1;
+        }
+    }
+    return scanMemchr(p, end - p, lineStart, out);
+}
+
+#endif
+
+template <typename Sink>
+using ScanFn = const char* (*)(const char*, size_t, const char*, Sink&);
+
+struct Scanner {
+    const char* name;
+    ScanFn<LineSink> fn;
+    ScanFn<PmrLineSink> pmrFn;
+};
+
+bool scannerSupported(const std::string& name) {
+    if (name == "memchr") return true;
+#ifdef UTILS_X86
+    __builtin_cpu_init();
+    if (name == "sse2") return __builtin_cpu_supports("sse2");
+    if (name == "avx2") return __builtin_cpu_supports("avx2");
+#endif
+    return false;
+}
+
+Scanner makeScanner(const std::string& name) {
+#ifdef UTILS_X86
+    if (name == "avx2") return {"avx2", scanAvx2<LineSink>, scanAvx2<PmrLineSink>};
+    if (name == "sse2") return {"sse2", scanSse2<LineSink>, scanSse2<PmrLineSink>};
+#endif
+    (void)name;
+    return {"memchr", scanMemchr<LineSink>, scanMemchr<PmrLineSink>};
+}
+
+Scanner pickScanner() {
+    for (const char* name : {"avx2", "sse2"}) {
+        if (scannerSupported(name)) return makeScanner(name);
+    }
+    return makeScanner("memchr");
+}
+
+Scanner activeScanner = pickScanner();
+
+} // namespace
+
 bool writeFile(const std::string& path, const std::string& content) {
-    std::ofstream ofs(path, std::ios::out | std::ios::trunc);
-    if (!ofs.is_open()) return false;
-    ofs << content;
-    ofs.close();
+    TRACE_SCOPE("Utils::writeFile");
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream ofs(tmpPath, std::ios::out | std::ios::trunc);
+        if (!ofs.is_open()) return false;
+        TRACE_COUNT(FilesOpened, 1);
+        TRACE_COUNT(BytesWritten, content.size());
+        ofs << content;
+        ofs.close();
+        if (ofs.fail()) {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
     return true;
 }
 
 std::string readFile(const std::string& path) {
+    TRACE_SCOPE("Utils::readFile");
     std::ifstream ifs(path);
     if (!ifs.is_open()) return "";
+    TRACE_COUNT(FilesOpened, 1);
 
-    std::stringstream buffer;
-    buffer << ifs.rdbuf();
-    return buffer.str();
+    // Size the string once and read straight into it; streams without a
+    // size (pipes) fall back to copying through the stream buffer
+    ifs.seekg(0, std::ios::end);
+    std::streamoff size = ifs.tellg();
+    if (size < 0) {
+        ifs.clear();
+        std::stringstream buffer;
+        buffer << ifs.rdbuf();
+        TRACE_COUNT(BytesRead, buffer.str().size());
+        return buffer.str();
+    }
+    std::string content(static_cast<size_t>(size), '\0');
+    ifs.seekg(0, std::ios::beg);
+    ifs.read(&content[0], size);
+    content.resize(static_cast<size_t>(ifs.gcount()));
+    TRACE_COUNT(BytesRead, content.size());
+    return content;
 }
 
 std::string currentTimestamp() {
@@ -42,38 +195,150 @@ std::string currentTimestamp() {
     return ss.str();
 }
 
-std::string hashString(const std::string& input) {
-    // Simple placeholder hash: sum of ASCII modulo 1e9
-    unsigned long long hash = 0;
-    for (char c : input) {
-        hash = (hash * 31 + static_cast<unsigned long long>(c)) % 1000000000;
+bool parseTimestamp(std::string_view text, int64_t& seconds) {
+    if (text.empty()) return false;
+    if (text.find_first_not_of("0123456789") == std::string_view::npos) {
+        if (text.size() > 18) return false;
+        seconds = std::stoll(std::string(text));
+        return true;
+    }
+
+    std::tm tm = {};
+    char tail = 0;
+    std::string copy(text);
+    int fields = std::sscanf(copy.c_str(), "%4d-%2d-%2d %2d:%2d:%2d%c", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                             &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &tail);
+    if (fields != 3 && fields != 6) return false;
+    if (fields == 3 && copy.size() != 10) return false;
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    tm.tm_isdst = -1;
+    std::time_t t = std::mktime(&tm);
+    if (t == static_cast<std::time_t>(-1)) return false;
+    seconds = static_cast<int64_t>(t);
+    return true;
+}
+
+std::string hashString(std::string_view input) {
+    return Sha256::toHex(Sha256::digest(input.data(), input.size()));
+}
+
+std::string hashFile(const std::string& path) {
+    TRACE_SCOPE("Utils::hashFile");
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return "";
+    TRACE_COUNT(FilesOpened, 1);
+    Sha256::Hasher hasher;
+    std::vector<char> buffer(1 << 20);
+    while (in) {
+        in.read(buffer.data(), buffer.size());
+        hasher.update(buffer.data(), static_cast<size_t>(in.gcount()));
+        TRACE_COUNT(BytesRead, static_cast<uint64_t>(in.gcount()));
+    }
+    if (in.bad()) return "";
+    return Sha256::toHex(hasher.finish());
+}
+
+uint32_t crc32(const void* data, size_t length, uint32_t crc) {
+    static const auto table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < length; ++i) {
+        crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
     }
-    return std::to_string(hash);
+    return ~crc;
 }
 
 std::string joinLines(const std::vector<std::string>& lines) {
+    size_t total = 0;
+    for (const auto& line : lines) total += line.size() + 1;
+
+    std::string result;
+    result.reserve(total);
+    for (const auto& line : lines) {
+        result += line;
+        result += '\n';
+    }
+    return result;
+}
+
+std::string joinLines(const std::vector<std::string_view>& lines) {
+    size_t total = 0;
+    for (const auto& line : lines) total += line.size() + 1;
+
     std::string result;
+    result.reserve(total);
     for (const auto& line : lines) {
-        result += line + "\n";
+        result += line;
+        result += '\n';
     }
     return result;
 }
 
 std::vector<std::string> splitLines(const std::string& text) {
-    std::vector<std::string> lines;
-    std::stringstream ss(text);
-    std::string line;
-    while (std::getline(ss, line)) {
-        lines.push_back(line);
+    std::vector<std::string_view> views = splitLineViews(text);
+    return std::vector<std::string>(views.begin(), views.end());
+}
+
+std::vector<std::string_view> splitLineViews(std::string_view text) {
+    TRACE_SCOPE("Utils::splitLines");
+    std::vector<std::string_view> lines;
+    if (text.empty()) return lines;
+
+    const char* begin = text.data();
+    const char* rest = activeScanner.fn(begin, text.size(), begin, lines);
+    const char* end = begin + text.size();
+    if (rest < end) {
+        lines.emplace_back(rest, end - rest);
     }
+    TRACE_COUNT(LinesProcessed, lines.size());
     return lines;
 }
 
+void splitLineViews(std::string_view text, std::pmr::vector<std::string_view>& lines) {
+    TRACE_SCOPE("Utils::splitLines");
+    lines.clear();
+    if (text.empty()) return;
+
+    const char* begin = text.data();
+    const char* rest = activeScanner.pmrFn(begin, text.size(), begin, lines);
+    const char* end = begin + text.size();
+    if (rest < end) {
+        lines.emplace_back(rest, end - rest);
+    }
+    TRACE_COUNT(LinesProcessed, lines.size());
+}
+
+const char* lineScanner() {
+    return activeScanner.name;
+}
+
+bool useLineScanner(const std::string& name) {
+    if (!scannerSupported(name)) return false;
+    activeScanner = makeScanner(name);
+    return true;
+}
+
 bool fileExists(const std::string& path) {
     struct stat buffer;
     return (stat(path.c_str(), &buffer) == 0 && S_ISREG(buffer.st_mode));
 }
 
+size_t fileSize(const std::string& path) {
+    struct stat buffer;
+    if (stat(path.c_str(), &buffer) != 0) return 0;
+    return static_cast<size_t>(buffer.st_size);
+}
+
 bool directoryExists(const std::string& path) {
     struct stat buffer;
     return (stat(path.c_str(), &buffer) == 0 && S_ISDIR(buffer.st_mode));
@@ -83,4 +348,179 @@ bool createDirectory(const std::string& path) {
     return mkdir(path.c_str(), 0755) == 0 || directoryExists(path);
 }
 
+bool syncFile(const std::string& path) {
+    TRACE_SCOPE("Utils::syncFile");
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    bool ok = FlushFileBuffers(file) != 0;
+    CloseHandle(file);
+    return ok;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+#endif
+}
+
+bool syncDirectory(const std::string& path) {
+#ifdef _WIN32
+    return directoryExists(path);
+#else
+    return syncFile(path);
+#endif
+}
+
+bool syncFileSystem(const std::string& path) {
+#ifdef __linux__
+    TRACE_SCOPE("Utils::syncFileSystem");
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool ok = ::syncfs(fd) == 0;
+    ::close(fd);
+    return ok;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+intptr_t lockFile(const std::string& path) {
+    TRACE_SCOPE("Utils::lockFile");
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return -1;
+    OVERLAPPED whole = {};
+    if (!LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &whole)) {
+        CloseHandle(file);
+        return -1;
+    }
+    return reinterpret_cast<intptr_t>(file);
+#else
+    // flock, not fcntl: its locks belong to the open file, so two handles
+    // in one process exclude each other too
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    int result;
+    while ((result = ::flock(fd, LOCK_EX)) != 0 && errno == EINTR) {
+    }
+    if (result != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+#endif
+}
+
+void unlockFile(intptr_t handle) {
+    if (handle < 0) return;
+#ifdef _WIN32
+    HANDLE file = reinterpret_cast<HANDLE>(handle);
+    OVERLAPPED whole = {};
+    UnlockFileEx(file, 0, 1, 0, &whole);
+    CloseHandle(file);
+#else
+    ::flock(static_cast<int>(handle), LOCK_UN);
+    ::close(static_cast<int>(handle));
+#endif
+}
+
+std::string bootId() {
+#ifdef __linux__
+    // A proc file reports no size, so it is read by line, not by readFile
+    std::ifstream in("/proc/sys/kernel/random/boot_id");
+    std::string id;
+    std::getline(in, id);
+    while (!id.empty() && (id.back() == '\r' || id.back() == ' ')) id.pop_back();
+    return id;
+#else
+    return "";
+#endif
+}
+
+bool wildcardMatch(std::string_view pattern, std::string_view name) {
+    // Greedy match with backtracking to the last '*'
+    size_t p = 0, n = 0;
+    size_t starP = std::string_view::npos, starN = 0;
+    while (n < name.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+            ++p;
+            ++n;
+        } else if (p < pattern.size() && pattern[p] == '*') {
+            starP = p++;
+            starN = n;
+        } else if (starP != std::string_view::npos) {
+            p = starP + 1;
+            n = ++starN;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') ++p;
+    return p == pattern.size();
+}
+
+std::vector<std::string> expandGlob(const std::string& pattern) {
+    namespace fs = std::filesystem;
+    std::vector<std::string> components;
+    size_t start = 0;
+    for (size_t i = 0; i <= pattern.size(); ++i) {
+        if (i == pattern.size() || pattern[i] == '/' || pattern[i] == '\\') {
+            components.push_back(pattern.substr(start, i - start));
+            start = i + 1;
+        }
+    }
+
+    // Expand one component at a time; "" as the first component is the root
+    std::vector<std::string> matches = {components[0].empty() ? "/" : ""};
+    size_t first = components[0].empty() ? 1 : 0;
+    for (size_t c = first; c < components.size(); ++c) {
+        const std::string& component = components[c];
+        if (component.empty()) continue;
+        std::vector<std::string> next;
+        for (const auto& base : matches) {
+            std::string prefix = base.empty() || base.back() == '/' ? base : base + "/";
+            if (component.find_first_of("*?") == std::string::npos) {
+                next.push_back(prefix + component);
+                continue;
+            }
+            std::error_code ec;
+            for (const auto& entry : fs::directory_iterator(base.empty() ? "." : base, ec)) {
+                std::string name = entry.path().filename().string();
+                if (name[0] == '.' && component[0] != '.') continue;
+                if (wildcardMatch(component, name)) next.push_back(prefix + name);
+            }
+        }
+        matches.swap(next);
+    }
+
+    std::vector<std::string> existing;
+    for (const auto& path : matches) {
+        std::error_code ec;
+        if (!path.empty() && fs::exists(path, ec)) existing.push_back(path);
+    }
+    std::sort(existing.begin(), existing.end());
+    return existing;
+}
+
+size_t peakMemoryBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);          // bytes
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;   // kilobytes
+#endif
+#endif
+}
+
 } // namespace Utils
\ No newline at end of file
@@ -1,27 +1,91 @@
 #pragma once
 #include <string>
+#include <string_view>
+#include <memory_resource>
 #include <vector>
+#include <cstddef>
+#include <cstdint>
 
 namespace Utils {
 
-    // File I/O
+    // File I/O. writeFile writes a temporary file beside `path` and renames
+    // it over `path`, so readers see the old content or the new, never part
+    // of it. Nothing is flushed: after a crash the file may hold either, or
+    // be empty; callers that need it on disk use syncFile and syncDirectory.
     bool writeFile(const std::string& path, const std::string& content);
     std::string readFile(const std::string& path);
 
     // Timestamp as string
     std::string currentTimestamp();
 
-    // Simple string hash (placeholder for SHA-1 / SHA-256 later)
-    std::string hashString(const std::string& input);
+    // Seconds since the epoch of a timestamp as currentTimestamp writes it
+    // (local time), of a date alone (its midnight), or of a plain number of
+    // seconds. False if the text is none of these.
+    bool parseTimestamp(std::string_view text, int64_t& seconds);
+
+    // SHA-256 of the input as 64 lowercase hex characters
+    std::string hashString(std::string_view input);
+
+    // SHA-256 of a file's content, read in blocks ("" if it cannot be read)
+    std::string hashFile(const std::string& path);
+
+    // CRC-32 (IEEE, as used by zip/png) of a byte range; pass a previous
+    // result as `crc` to continue over several ranges
+    uint32_t crc32(const void* data, size_t length, uint32_t crc = 0);
 
     // Join lines into a single string (with newline)
     std::string joinLines(const std::vector<std::string>& lines);
+    std::string joinLines(const std::vector<std::string_view>& lines);
 
     // Split string into lines
     std::vector<std::string> splitLines(const std::string& text);
 
+    // Split into views of text without copying; the views are valid as long as
+    // text is. Same rules as splitLines: no empty line after a final '\n'.
+    std::vector<std::string_view> splitLineViews(std::string_view text);
+    // Same, into `lines`, whose allocator (typically an Arena) holds the index
+    void splitLineViews(std::string_view text, std::pmr::vector<std::string_view>& lines);
+
+    // Newline scanner behind splitLineViews: "avx2", "sse2" or "memchr",
+    // picked at startup from the CPU. useLineScanner returns false if the
+    // requested one is not available here.
+    const char* lineScanner();
+    bool useLineScanner(const std::string& name);
+
     // File system operations
     bool fileExists(const std::string& path);
+    size_t fileSize(const std::string& path);   // 0 if missing
     bool directoryExists(const std::string& path);
     bool createDirectory(const std::string& path);
+
+    // Flush a file's data, or a directory's entries (after a create or
+    // rename in it), to the device; false if that fails. Directories are
+    // not flushed on Windows, where the file system commits renames itself.
+    bool syncFile(const std::string& path);
+    bool syncDirectory(const std::string& path);
+    // Flush every file written on the file system holding `path`, where the
+    // system can do that in one call (Linux); false elsewhere, and the
+    // caller syncs file by file
+    bool syncFileSystem(const std::string& path);
+
+    // Exclusive lock on a file (created if missing): other callers wait until
+    // it is released by unlockFile, or by the end of the process holding
+    // it. Two handles exclude each other even within one process. -1 if
+    // the file cannot be opened or locked.
+    intptr_t lockFile(const std::string& path);
+    void unlockFile(intptr_t handle);
+
+    // Identifies the current boot of the machine ("" where unknown). Data
+    // written but not flushed survives the writing process, not a reboot.
+    std::string bootId();
+
+    // Paths matching a pattern where '*' and '?' in any component match
+    // within that component (e.g. "users/*/repo"), sorted. A pattern without
+    // wildcards yields itself if it exists. Names starting with '.' only
+    // match a component that starts with '.'.
+    std::vector<std::string> expandGlob(const std::string& pattern);
+    bool wildcardMatch(std::string_view pattern, std::string_view name);
+
+    // Peak resident memory of this process so far, in bytes (0 if unknown)
+    size_t peakMemoryBytes();
 }
\ No newline at end of file
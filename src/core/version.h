@@ -1,9 +1,56 @@
 #pragma once
 #include <string>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 
 struct Version {
     int id;                 // version number
     std::string timestamp;  // commit timestamp
-    std::string diffPath;   // path to diff file
+    std::string diffPath;   // path to diff file (versions written before the object store)
     std::string hash;       // hash of version text
-};
\ No newline at end of file
+    int keyframe = -1;      // nearest version at or before this one holding a full snapshot (-1: none, replay from 0)
+    std::string snapshotPath; // full text of this version, set only on keyframes (before the object store)
+    std::string diffObject;     // object id of the diff against the previous version (or against `base`)
+    std::string snapshotObject; // object id of the full text, set only on keyframes
+    int base = -1;          // version the diff is against, when repack chose another than the previous (-1: the previous)
+};
+
+// When to store a full snapshot so reconstruction never replays a long delta chain
+struct KeyframePolicy {
+    int interval = 64;                  // snapshot every K versions (0 = never by count)
+    size_t maxChainBytes = 1 << 20;     // snapshot once deltas since the last keyframe pass this, as stored (0 = never by size)
+};
+
+// How repack chooses each version's delta base
+struct RepackOptions {
+    size_t window = 10;     // earlier versions tried as bases besides the previous one (0: keep every base)
+    int maxDepth = 64;      // diffs applied, at most, to rebuild any version (as many as
+                            // KeyframePolicy's default interval allows)
+};
+
+// What a commit has flushed to disk by the time it returns
+enum class Durability {
+    None,       // nothing: the OS writes it back when it will
+    Batch,      // its journal entry (Journal); commits close together share one flush
+    Strict,     // its objects and version record themselves
+};
+
+// Settings the command line applies to every repository a run opens
+// (directly, across --repos, or in a server)
+struct RepoOptions {
+    KeyframePolicy policy;
+    size_t diffThreads = 0;             // Repo::setDiffThreads
+    size_t memoryBudget = 0;            // bytes (0: no limit)
+    std::string passphrase;             // "": DSA_PASSPHRASE
+    Durability durability = Durability::Batch;
+};
+
+// Which versions `log` shows. Each filter narrows the one before it.
+struct LogQuery {
+    int first = 0;                                          // --range a..b: versions a to b
+    int last = -1;                                          // (-1: up to the newest)
+    int64_t since = std::numeric_limits<int64_t>::min();    // commit time, seconds since the epoch
+    int64_t until = std::numeric_limits<int64_t>::max();    // (both inclusive)
+    size_t limit = 0;                                       // -n: only the newest N left (0: all)
+};
@@ -0,0 +1,69 @@
+#include "version_cache.h"
+
+VersionCache::VersionCache(size_t capacityBytes) : capacity(capacityBytes) {
+}
+
+bool VersionCache::get(int id, std::string& text) {
+    auto it = index.find(id);
+    if (it == index.end()) {
+        ++counters.misses;
+        return false;
+    }
+    lru.splice(lru.begin(), lru, it->second);
+    text = it->second->text;
+    ++counters.hits;
+    return true;
+}
+
+int VersionCache::nearestBelow(int id, int floor, std::string& text) {
+    auto it = index.lower_bound(id);
+    if (it == index.begin()) return -1;
+    --it;
+    if (it->first < floor) return -1;
+
+    lru.splice(lru.begin(), lru, it->second);
+    text = it->second->text;
+    return it->first;
+}
+
+void VersionCache::put(int id, const std::string& text) {
+    auto it = index.find(id);
+    if (it != index.end()) {
+        counters.bytes -= it->second->text.size();
+        lru.erase(it->second);
+        index.erase(it);
+    }
+    if (text.size() > capacity) return;
+
+    lru.push_front({id, text});
+    index[id] = lru.begin();
+    counters.bytes += text.size();
+    evictToFit();
+}
+
+void VersionCache::setCapacity(size_t capacityBytes) {
+    capacity = capacityBytes;
+    evictToFit();
+}
+
+void VersionCache::clear() {
+    lru.clear();
+    index.clear();
+    counters.bytes = 0;
+}
+
+VersionCache::Stats VersionCache::stats() const {
+    Stats s = counters;
+    s.entries = index.size();
+    return s;
+}
+
+void VersionCache::evictToFit() {
+    while (counters.bytes > capacity && !lru.empty()) {
+        const Entry& victim = lru.back();
+        counters.bytes -= victim.text.size();
+        index.erase(victim.id);
+        lru.pop_back();
+        ++counters.evictions;
+    }
+}
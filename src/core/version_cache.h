@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <list>
+#include <map>
+#include <cstddef>
+
+// Memory-bounded LRU cache of reconstructed version texts, keyed by version id
+class VersionCache {
+public:
+    struct Stats {
+        size_t hits = 0;        // exact version found
+        size_t misses = 0;      // version had to be rebuilt
+        size_t evictions = 0;   // entries dropped to stay under capacity
+        size_t bytes = 0;       // text bytes currently held
+        size_t entries = 0;     // versions currently held
+    };
+
+    static const size_t DEFAULT_CAPACITY = 64u << 20;
+
+    explicit VersionCache(size_t capacityBytes = DEFAULT_CAPACITY);
+
+    // Look up an exact version; counts a hit or a miss
+    bool get(int id, std::string& text);
+
+    // Largest cached id in [floor, id), or -1; copies its text without touching the counters
+    int nearestBelow(int id, int floor, std::string& text);
+
+    // Insert or refresh a version; texts larger than the capacity are not cached
+    void put(int id, const std::string& text);
+
+    void setCapacity(size_t capacityBytes);
+    void clear();
+    Stats stats() const;
+
+private:
+    struct Entry {
+        int id;
+        std::string text;
+    };
+
+    void evictToFit();
+
+    size_t capacity;
+    std::list<Entry> lru;                                   // front = most recently used
+    std::map<int, std::list<Entry>::iterator> index;        // ordered for ancestor lookups
+    Stats counters;
+};
@@ -2,30 +2,186 @@
 //to run the application on command line, paste above line in terminal
 
 #include <iostream>
+#include <csignal>
+#include <cstdlib>
+#include <new>
 #include "core/repo.h"
+#include "core/trace.h"
+#include "core/utils.h"
 #include "cli/parser.h"
 #include "cli/commands.h"
+#include "api/server.h"
 
-int main(int argc, char* argv[]) {
+static Server* runningServer = nullptr;
 
-    // Determine repository path (default to "./repo", or use --repo <path> flag)
-    std::string repoPath = "./repo";
+// Heap allocations are counted for --stats / --trace (one untaken branch
+// while tracing is off)
+void* operator new(std::size_t size) {
+    TRACE_COUNT(Allocations, 1);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    TRACE_COUNT(Allocations, 1);
+    std::size_t align = static_cast<std::size_t>(alignment);
+#ifdef _WIN32
+    if (void* p = _aligned_malloc(size ? size : 1, align)) return p;
+#else
+    if (void* p = std::aligned_alloc(align, (size + align - 1) / align * align + (size ? 0 : align))) return p;
+#endif
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t alignment) noexcept {
+    operator delete(p, alignment);
+}
+
+static void stopServer(int) {
+    if (runningServer) runningServer->stop();
+}
 
-    // Parse --repo flag if present
+// Remove "<flag> <value>" from argv if present and return the value
+static bool takeFlag(int& argc, char* argv[], const std::string& flag, std::string& value) {
     for (int i = 1; i < argc - 1; ++i) {
-        if (std::string(argv[i]) == "--repo") {
-            repoPath = argv[i + 1];
-            // Remove --repo and its value from argv by shifting
+        if (std::string(argv[i]) == flag) {
+            value = argv[i + 1];
+            // Remove the flag and its value from argv by shifting
             for (int j = i; j < argc - 2; ++j) {
                 argv[j] = argv[j + 2];
             }
             argc -= 2;
-            break;
+            return true;
         }
     }
+    return false;
+}
+
+// Remove a "<flag>" switch from argv if present
+static bool takeSwitch(int& argc, char* argv[], const std::string& flag) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == flag) {
+            for (int j = i; j < argc - 1; ++j) {
+                argv[j] = argv[j + 1];
+            }
+            --argc;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Prints the --stats summary and writes the --trace file when main returns
+struct TraceReport {
+    bool stats = false;
+    std::string tracePath;
+
+    ~TraceReport() {
+        if (!Trace::enabled()) return;
+        Trace::disable();
+        if (stats) Trace::printSummary(std::cout);
+        if (!tracePath.empty()) {
+            if (Trace::writeChromeTrace(tracePath)) std::cout << "Trace written to " << tracePath << "\n";
+            else std::cerr << "Error: cannot write trace to " << tracePath << "\n";
+        }
+    }
+};
+
+int main(int argc, char* argv[]) {
+
+    // Time phases and count I/O for this command
+    TraceReport report;
+    report.stats = takeSwitch(argc, argv, "--stats");
+    bool tracing = takeFlag(argc, argv, "--trace", report.tracePath);
+    if (report.stats || tracing) Trace::enable(tracing);
+    TRACE_SCOPE("main");
+
+    // Determine repository path (default to "./repo", or use --repo <path> flag)
+    std::string repoPath = "./repo";
+    takeFlag(argc, argv, "--repo", repoPath);
+
+    // Repository settings; `given` names the flags that set them
+    RepoOptions options;
+    std::vector<std::string> given;
+    std::string value;
+
+    // Keyframe policy overrides
+    if (takeFlag(argc, argv, "--keyframe-interval", value)) {
+        options.policy.interval = std::stoi(value);
+        given.push_back("--keyframe-interval");
+    }
+    if (takeFlag(argc, argv, "--keyframe-bytes", value)) {
+        options.policy.maxChainBytes = std::stoul(value);
+        given.push_back("--keyframe-bytes");
+    }
+
+    // Diff large commits on several threads
+    if (takeFlag(argc, argv, "--diff-threads", value)) {
+        options.diffThreads = std::stoul(value);
+        given.push_back("--diff-threads");
+    }
+
+    // Commit within a memory budget, streaming inputs too large for it
+    if (takeFlag(argc, argv, "--memory-budget", value)) {
+        options.memoryBudget = std::stoul(value) * 1024 * 1024;
+        given.push_back("--memory-budget");
+    }
+
+    // Run the command on many repositories at once
+    std::string repoList;
+    bool multiRepo = takeFlag(argc, argv, "--repos", repoList);
+    size_t jobs = 0;
+    if (takeFlag(argc, argv, "--jobs", value)) {
+        jobs = std::stoul(value);
+    }
+
+    // What a commit flushes to disk before it returns
+    if (takeFlag(argc, argv, "--durability", value)) {
+        if (value == "none") options.durability = Durability::None;
+        else if (value == "batch") options.durability = Durability::Batch;
+        else if (value == "strict") options.durability = Durability::Strict;
+        else {
+            std::cerr << "Error: --durability is none, batch or strict, not " << value << "\n";
+            return 1;
+        }
+        given.push_back("--durability");
+    }
+
+    // Passphrase of an encrypted repository (else DSA_PASSPHRASE is used)
+    if (takeFlag(argc, argv, "--passphrase-file", value)) {
+        options.passphrase = Utils::readFile(value);
+        std::string& passphrase = options.passphrase;
+        while (!passphrase.empty() && (passphrase.back() == '\n' || passphrase.back() == '\r')) passphrase.pop_back();
+        if (passphrase.empty()) {
+            std::cerr << "Error: no passphrase in " << value << "\n";
+            return 1;
+        }
+        given.push_back("--passphrase-file");
+    }
+
+    // Forward the command to a running server instead of executing it here
+    std::string serverSocket;
+    bool forward = takeFlag(argc, argv, "--server", serverSocket);
 
     // Create Repo instance
     Repo repo(repoPath);
+    repo.configure(options);
 
     // Parse command-line arguments
     Command cmd = parseCommandLine(argc, argv);
@@ -33,18 +189,89 @@ int main(int argc, char* argv[]) {
     if (cmd.name.empty()) {
         std::cout << "Usage:\n"
                     << "  --repo <path>         Set repository path (default: ./repo)\n"
+                    << "  --keyframe-interval <K>  Store a full snapshot every K versions (default: 64, 0 = off)\n"
+                    << "  --keyframe-bytes <N>     Store a snapshot once deltas since the last one exceed N bytes on disk\n"
+                    << "  --diff-threads <N>    Diff large files on N threads when committing (default: 1)\n"
+                    << "  --memory-budget <MB>  Keep commit within MB of memory (streams large files) and report peak memory\n"
+                    << "  --server <socket>     Send the command to a server started with 'serve'\n"
+                    << "  --repos <list|glob>   Run log/verify/stats/repack on many repos in parallel (e.g. \"users/*\" or a,b,c)\n"
+                    << "  --jobs <N>            Worker threads for --repos (default: one per core)\n"
+                    << "  --stats               Print time per phase and I/O, line and allocation counts after the command\n"
+                    << "  --trace <file>        Write the command's phases as Chrome trace JSON (chrome://tracing)\n"
+                    << "  --passphrase-file <f> Passphrase of an encrypted repository (default: $DSA_PASSPHRASE)\n"
+                    << "  --durability <level>  What a commit flushes to disk: none, batch (journal, default) or strict\n"
                     << "\nCommands:\n"
                     << "  init                  Initialize repository\n"
+                    << "  init --encrypt        Initialize (or convert) an encrypted repository\n"
                     << "  commit <file>         Commit a text file\n"
+                    << "  commit-batch <manifest>  Commit the files listed in manifest (one per line) as consecutive versions\n"
+                    << "  commit-batch -        Commit revisions read from stdin, separated by NUL bytes\n"
                     << "  log                   Show commit log\n"
+                    << "  log -n <N> | --since <time> | --until <time> | --range <a>..<b>  Show part of the log\n"
                     << "  diff <v1> <v2>        Show diff between versions\n"
+                    << "  blame <versionID> [-L <first>,<last>]  Show the version that added each line\n"
+                    << "  search <pattern>      List the versions that held a line containing pattern\n"
                     << "  checkout <versionID>  Restore a version\n"
                     << "  rollback <versionID> <output_file>  Rollback to version and save to file\n"
+                    << "  repack [--window N] [--depth N]\n"
+                    << "                        Fold loose diffs and snapshots into one indexed pack, first\n"
+                    << "                        rebasing each delta on the best of the N before it (default 10,\n"
+                    << "                        0 to keep bases) with chains of at most --depth diffs (default 64)\n"
+                    << "  verify                Replay the history and check every object and hash\n"
+                    << "  stats                 Show version, snapshot and storage figures\n"
+                    << "  serve <socket> [threads]  Keep repositories open and answer commands on a Unix socket\n"
+                    << "                        (repository options such as --durability are given to serve)\n"
                     << "\nExamples:\n"
                     << "  init                           Initialize default repo (./repo)\n"
                     << "  --repo ./project1 init         Initialize custom repo\n"
                     << "  --repo ./project1 commit file  Commit to custom repo\n"
-                    << "  rollback 2 restored.txt        Rollback to version 2 and save to restored.txt\n";
+                    << "  rollback 2 restored.txt        Rollback to version 2 and save to restored.txt\n"
+                    << "  serve /tmp/dsa.sock            Start a server; then: --server /tmp/dsa.sock log\n";
+        return 0;
+    }
+
+    if (cmd.name == "serve") {
+        if (cmd.args.empty()) {
+            std::cerr << "Usage: serve <socket_path> [threads]\n";
+            return 1;
+        }
+        size_t threads = cmd.args.size() > 1 ? std::stoul(cmd.args[1]) : 4;
+        Server server(cmd.args[0], options, threads);
+        if (!server.start()) return 1;
+        runningServer = &server;
+        std::signal(SIGINT, stopServer);
+        std::signal(SIGTERM, stopServer);
+        std::cout << "Serving on " << cmd.args[0] << " with " << threads << " threads (Ctrl+C to stop)\n";
+        server.run();
+        runningServer = nullptr;
+        std::cout << "Server stopped after " << server.requestsServed() << " requests.\n";
+        return 0;
+    }
+
+    if (multiRepo) {
+        std::vector<std::string> repoPaths = CLI::expandRepoList(repoList);
+        if (repoPaths.empty()) {
+            std::cerr << "Error: no repositories match " << repoList << "\n";
+            return 1;
+        }
+        return CLI::executeAcrossRepos(repoPaths, cmd, options, jobs) ? 0 : 1;
+    }
+
+    if (forward) {
+        // The server opens repositories with the settings it was started
+        // with; a client's own would be silently ignored
+        if (!given.empty()) {
+            std::cerr << "Error: " << given[0] << " cannot be sent to a server; pass it to 'serve' instead.\n";
+            return 1;
+        }
+        Server::Client client(serverSocket);
+        std::string out, err;
+        if (!client.request(repoPath, cmd, out, err)) {
+            std::cerr << "Error: no server answering on " << serverSocket << "\n";
+            return 1;
+        }
+        std::cout << out;
+        std::cerr << err;
         return 0;
     }
 
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+
+// Little-endian integer encoding shared by the binary storage formats
+// (version log, packfile), independent of the host byte order.
+namespace BinaryIO {
+
+    inline void put32(unsigned char* p, uint32_t v) {
+        for (int i = 0; i < 4; ++i) p[i] = static_cast<unsigned char>(v >> (8 * i));
+    }
+
+    inline void put64(unsigned char* p, uint64_t v) {
+        for (int i = 0; i < 8; ++i) p[i] = static_cast<unsigned char>(v >> (8 * i));
+    }
+
+    inline uint32_t get32(const unsigned char* p) {
+        uint32_t v = 0;
+        for (int i = 3; i >= 0; --i) v = (v << 8) | p[i];
+        return v;
+    }
+
+    inline uint64_t get64(const unsigned char* p) {
+        uint64_t v = 0;
+        for (int i = 7; i >= 0; --i) v = (v << 8) | p[i];
+        return v;
+    }
+
+}
@@ -1,29 +1,162 @@
 #include "file_manager.h"
-#include "../core/crypto.h"
+#include "mapped_file.h"
+#include "../core/trace.h"
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <iostream>
 
 namespace FileManager {
 
-bool saveText(const std::string& path, const std::string& content) {
-    // For Phase 1: no encryption
-    std::ofstream ofs(path, std::ios::out | std::ios::trunc);
+bool saveText(const std::string& path, std::string_view content, const Crypto::Key* key) {
+    // Binary mode, since stored objects may be compressed or encrypted
+    std::ofstream ofs(path, std::ios::out | std::ios::trunc | std::ios::binary);
     if (!ofs.is_open()) return false;
+    TRACE_COUNT(FilesOpened, 1);
 
-    std::string data = Crypto::encrypt(content, "phase1key"); // stub
-    ofs << data;
+    if (!key) {
+        ofs.write(content.data(), content.size());
+        TRACE_COUNT(BytesWritten, content.size());
+    } else {
+        std::string data = encodeText(content, key);
+        ofs.write(data.data(), data.size());
+        TRACE_COUNT(BytesWritten, data.size());
+    }
     ofs.close();
+    return !ofs.fail();
+}
+
+std::string loadText(const std::string& path, const Crypto::Key* key) {
+    MappedFile file;
+    if (!file.open(path)) return "";
+
+    return decodeText(file.view(), key);
+}
+
+std::string encodeText(std::string_view content, const Crypto::Key* key) {
+    if (!key) return std::string(content);
+    return Crypto::encrypt(content, *key);
+}
+
+std::string decodeText(std::string_view stored, const Crypto::Key* key) {
+    if (!Crypto::isEncrypted(stored)) return std::string(stored);
+    if (!key) {
+        std::cerr << "Error: the repository is encrypted; a passphrase is needed.\n";
+        return "";
+    }
+    std::string plain;
+    if (!Crypto::decrypt(stored, *key, plain)) {
+        std::cerr << "Error: encrypted data failed authentication (wrong passphrase, or damaged).\n";
+        return "";
+    }
+    return plain;
+}
+
+bool Writer::open(const std::string& path, const Crypto::Key* key) {
+    out.open(path, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!out.is_open()) return false;
+    TRACE_COUNT(FilesOpened, 1);
+    encryptor.reset();
+    if (key) {
+        encryptor = std::make_unique<Crypto::Encryptor>(*key);
+        std::string header = encryptor->header();
+        out.write(header.data(), header.size());
+    }
+    return !out.fail();
+}
+
+bool Writer::write(std::string_view piece) {
+    if (!encryptor) {
+        out.write(piece.data(), piece.size());
+        TRACE_COUNT(BytesWritten, piece.size());
+        return !out.fail();
+    }
+    // Whole chunks are written as they complete; the last waits for close()
+    sealed.clear();
+    encryptor->update(piece, sealed);
+    out.write(sealed.data(), sealed.size());
+    TRACE_COUNT(BytesWritten, sealed.size());
+    return !out.fail();
+}
+
+bool Writer::close() {
+    if (encryptor && out.is_open()) {
+        sealed.clear();
+        encryptor->finish(sealed);
+        out.write(sealed.data(), sealed.size());
+        TRACE_COUNT(BytesWritten, sealed.size());
+        encryptor.reset();
+    }
+    out.close();
+    return !out.fail();
+}
+
+bool Reader::open(const std::string& path, const Crypto::Key* key) {
+    in.open(path, std::ios::in | std::ios::binary);
+    if (!in.is_open()) return false;
+    TRACE_COUNT(FilesOpened, 1);
+    in.seekg(0, std::ios::end);
+    total = static_cast<size_t>(in.tellg());
+    in.seekg(0, std::ios::beg);
+
+    char header[Crypto::HEADER_BYTES];
+    in.read(header, sizeof(header));
+    encrypted = static_cast<size_t>(in.gcount()) == sizeof(header) &&
+                     Crypto::isEncrypted(std::string_view(header, sizeof(header)));
+    in.clear();
+    in.seekg(0, std::ios::beg);
+    if (!encrypted) return true;
+
+    if (!key) {
+        std::cerr << "Error: " << path << " is encrypted; a passphrase is needed.\n";
+        in.close();
+        return false;
+    }
+    decryptor = std::make_unique<Crypto::Decryptor>(*key);
+    total = Crypto::plaintextSize(total);
     return true;
 }
 
-std::string loadText(const std::string& path) {
-    std::ifstream ifs(path);
-    if (!ifs.is_open()) return "";
+size_t Reader::read(char* buffer, size_t capacity) {
+    if (!encrypted) {
+        if (!in.read(buffer, capacity) && in.gcount() == 0) return 0;
+        size_t got = static_cast<size_t>(in.gcount());
+        TRACE_COUNT(BytesRead, got);
+        return got;
+    }
 
-    std::string data((std::istreambuf_iterator<char>(ifs)),
-                      std::istreambuf_iterator<char>());
-    ifs.close();
+    // Refill the decrypted buffer a chunk at a time until there is text to hand out
+    while (plainOffset == plain.size() && !bad && decryptor) {
+        plain.clear();
+        plainOffset = 0;
+        std::string stored(Crypto::CHUNK_BYTES + Crypto::TAG_BYTES, '\0');
+        in.read(&stored[0], stored.size());
+        size_t got = static_cast<size_t>(in.gcount());
+        TRACE_COUNT(BytesRead, got);
+        bool ok = decryptor->update(std::string_view(stored.data(), got), plain);
+        if (ok && got < stored.size()) {
+            ok = decryptor->finish(plain);
+            decryptor.reset();
+        }
+        if (!ok) {
+            std::cerr << "Error: encrypted data failed authentication (wrong passphrase, or damaged).\n";
+            bad = true;
+            plain.clear();
+        }
+    }
 
-    return Crypto::decrypt(data, "phase1key"); // stub
+    size_t n = std::min(capacity, plain.size() - plainOffset);
+    std::memcpy(buffer, plain.data() + plainOffset, n);
+    plainOffset += n;
+    return n;
 }
 
-}
\ No newline at end of file
+size_t Reader::size() const {
+    return total;
+}
+
+bool Reader::failed() const {
+    return bad;
+}
+
+}
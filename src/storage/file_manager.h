@@ -1,12 +1,63 @@
 #pragma once
+#include "../core/crypto.h"
 #include <string>
+#include <string_view>
+#include <fstream>
+#include <memory>
+#include <cstddef>
 
+// Every function takes the repository key, if it has one: with a key, text
+// is written encrypted (Crypto's chunked format); without, as is. Encrypted
+// files are recognised by their header when read back, so a repository can
+// hold both (objects from before encryption was enabled stay readable).
 namespace FileManager {
 
-    // Save text to disk (optionally encrypt)
-    bool saveText(const std::string& path, const std::string& content);
+    // Save text to disk (encrypted if a key is given)
+    bool saveText(const std::string& path, std::string_view content, const Crypto::Key* key = nullptr);
 
-    // Load text from disk (optionally decrypt)
-    std::string loadText(const std::string& path);
+    // Load text from disk (decrypted if it was encrypted); the file is
+    // memory-mapped so the only copy made is the decrypted result.
+    // "" if the file is missing, or encrypted and cannot be decrypted.
+    std::string loadText(const std::string& path, const Crypto::Key* key = nullptr);
 
-}
\ No newline at end of file
+    // The bytes saveText writes for some content, and the reverse
+    std::string encodeText(std::string_view content, const Crypto::Key* key = nullptr);
+    // Turn bytes as saveText stored them (loose file or pack entry) back into text
+    std::string decodeText(std::string_view stored, const Crypto::Key* key = nullptr);
+
+    // saveText for content written piece by piece, so it never has to be
+    // held at once. Pieces are encrypted a chunk at a time as they come;
+    // the file is the same as saveText of all pieces together.
+    class Writer {
+    public:
+        bool open(const std::string& path, const Crypto::Key* key = nullptr);
+        bool write(std::string_view piece);
+        bool close();   // false if any write failed
+
+    private:
+        std::ofstream out;
+        std::unique_ptr<Crypto::Encryptor> encryptor;
+        std::string sealed;
+    };
+
+    // loadText read piece by piece: read() decodes up to `capacity` bytes
+    // into `buffer` and returns how many (0 at the end, or when the rest
+    // of an encrypted file is not authentic)
+    class Reader {
+    public:
+        bool open(const std::string& path, const Crypto::Key* key = nullptr);
+        size_t read(char* buffer, size_t capacity);
+        size_t size() const;   // decoded size of the whole file
+        bool failed() const;   // true once an encrypted chunk failed to decrypt
+
+    private:
+        std::ifstream in;
+        size_t total = 0;
+        bool encrypted = false;
+        std::unique_ptr<Crypto::Decryptor> decryptor;   // reset after the last chunk
+        std::string plain;     // decrypted text not yet returned by read()
+        size_t plainOffset = 0;
+        bool bad = false;
+    };
+
+}
@@ -0,0 +1,234 @@
+#include "journal.h"
+#include "binary_io.h"
+#include "mapped_file.h"
+#include "version_log.h"
+#include "../core/trace.h"
+#include "../core/utils.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+namespace {
+
+const char MAGIC[8] = {'D', 'S', 'A', 'J', 'R', 'N', 'L', '1'};
+const size_t ENTRY_HEADER = 12;
+
+using BinaryIO::put32;
+using BinaryIO::put64;
+using BinaryIO::get32;
+using BinaryIO::get64;
+
+// Identifies the current boot of the machine (0: unknown, never matches)
+uint64_t bootTag() {
+    static const uint64_t tag = [] {
+        std::string id = Utils::bootId();
+        return id.empty() ? uint64_t(0) : std::stoull(Utils::hashString(id).substr(0, 16), nullptr, 16);
+    }();
+    return tag;
+}
+
+std::string parentDirectory(const std::string& path) {
+    std::string parent = std::filesystem::path(path).parent_path().string();
+    return parent.empty() ? "." : parent;
+}
+
+bool parseEntry(const unsigned char* p, size_t length, Journal::Entry& entry) {
+    if (length < VersionLog::RECORD_SIZE + 4) return false;
+    if (!VersionLog::decode(std::string_view(reinterpret_cast<const char*>(p), VersionLog::RECORD_SIZE), entry.version)) {
+        return false;
+    }
+    size_t offset = VersionLog::RECORD_SIZE;
+    uint32_t count = get32(p + offset);
+    offset += 4;
+    entry.objects.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        if (length - offset < 8) return false;
+        uint64_t bytes = get64(p + offset);
+        offset += 8;
+        if (bytes > length - offset) return false;
+        entry.objects.emplace_back(reinterpret_cast<const char*>(p + offset), static_cast<size_t>(bytes));
+        offset += static_cast<size_t>(bytes);
+    }
+    return offset == length;
+}
+
+} // namespace
+
+Journal::Journal(const std::string& path) : path(path) {
+}
+
+bool Journal::exists() const {
+    return Utils::fileExists(path);
+}
+
+bool Journal::reset(size_t checkpointVersions) {
+    TRACE_SCOPE("Journal::reset");
+    std::unique_lock<std::mutex> guard(lock);
+    flushed.wait(guard, [&] { return !syncing; });
+    out.close();
+
+    unsigned char header[HEADER_SIZE] = {};
+    std::memcpy(header, MAGIC, 8);
+    put64(header + 8, bootTag());
+    put64(header + 16, checkpointVersions);
+    put32(header + 28, Utils::crc32(header, 28));
+
+    // The old journal must not come back after a crash: it would undo
+    // commits made after this checkpoint
+    std::string tmpPath = path + ".tmp";
+    std::error_code ec;
+    {
+        std::ofstream tmp(tmpPath, std::ios::binary | std::ios::trunc);
+        tmp.write(reinterpret_cast<const char*>(header), HEADER_SIZE);
+        if (!tmp) {
+            std::filesystem::remove(tmpPath, ec);
+            std::cerr << "Error: failed to write " << tmpPath << "\n";
+            return false;
+        }
+    }
+    if (Utils::syncFile(tmpPath)) std::filesystem::rename(tmpPath, path, ec);
+    else ec = std::make_error_code(std::errc::io_error);
+    if (ec || !Utils::syncDirectory(parentDirectory(path))) {
+        std::filesystem::remove(tmpPath, ec);
+        std::cerr << "Error: failed to start a new journal at " << path << "\n";
+        return false;
+    }
+
+    durable = appended;
+    flushed.notify_all();
+    return true;
+}
+
+void Journal::remove() {
+    std::unique_lock<std::mutex> guard(lock);
+    flushed.wait(guard, [&] { return !syncing; });
+    out.close();
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+    durable = appended;
+    flushed.notify_all();
+}
+
+bool Journal::append(const Entry& entry, uint64_t& ticket) {
+    TRACE_SCOPE("Journal::append");
+    std::string record;
+    if (!VersionLog::encode(entry.version, record)) {
+        std::cerr << "Error: version " << entry.version.id << " has a malformed hash or object id.\n";
+        return false;
+    }
+
+    size_t payloadBytes = record.size() + 4;
+    for (const auto& object : entry.objects) payloadBytes += 8 + object.size();
+    std::string frame(ENTRY_HEADER + record.size() + 4, '\0');
+    frame.reserve(ENTRY_HEADER + payloadBytes);
+    unsigned char* p = reinterpret_cast<unsigned char*>(&frame[0]);
+    put64(p, payloadBytes);
+    std::memcpy(p + ENTRY_HEADER, record.data(), record.size());
+    put32(p + ENTRY_HEADER + record.size(), static_cast<uint32_t>(entry.objects.size()));
+    for (const auto& object : entry.objects) {
+        unsigned char length[8];
+        put64(length, object.size());
+        frame.append(reinterpret_cast<const char*>(length), 8);
+        frame += object;
+    }
+    p = reinterpret_cast<unsigned char*>(&frame[0]);
+    put32(p + 8, Utils::crc32(p + ENTRY_HEADER, payloadBytes));
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (!out.is_open()) {
+        // Entries follow a header reset() wrote
+        if (!exists()) {
+            std::cerr << "Error: " << path << " has not been started.\n";
+            return false;
+        }
+        out.open(path, std::ios::binary | std::ios::app);
+        TRACE_COUNT(FilesOpened, 1);
+    }
+    out.write(frame.data(), frame.size());
+    out.flush();
+    if (!out) {
+        out.close();
+        std::cerr << "Error: failed to write " << path << "\n";
+        return false;
+    }
+    TRACE_COUNT(BytesWritten, frame.size());
+    appended += frame.size();
+    ticket = appended;
+    return true;
+}
+
+bool Journal::sync(uint64_t ticket) {
+    std::unique_lock<std::mutex> guard(lock);
+    while (durable < ticket) {
+        // Someone is flushing already: what they flush may not cover this
+        // ticket, so wait for them and check again
+        if (syncing) {
+            flushed.wait(guard);
+            continue;
+        }
+        TRACE_SCOPE("Journal::sync");
+        syncing = true;
+        uint64_t target = appended;
+        guard.unlock();
+        bool ok = Utils::syncFile(path);
+        guard.lock();
+        syncing = false;
+        ++syncs;
+        if (ok) durable = std::max(durable, target);
+        flushed.notify_all();
+        if (!ok) {
+            std::cerr << "Error: failed to flush " << path << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Journal::read(std::vector<Entry>& entries, size_t& checkpointVersions, bool& sameBoot) const {
+    TRACE_SCOPE("Journal::read");
+    entries.clear();
+    MappedFile file;
+    if (!file.open(path)) return false;
+    const unsigned char* base = reinterpret_cast<const unsigned char*>(file.data());
+    size_t size = file.size();
+    if (size < HEADER_SIZE || std::memcmp(base, MAGIC, 8) != 0 ||
+        get32(base + 28) != Utils::crc32(base, 28)) {
+        return false;
+    }
+    sameBoot = bootTag() != 0 && get64(base + 8) == bootTag();
+    checkpointVersions = static_cast<size_t>(get64(base + 16));
+
+    // Entries are consecutive versions; the first that does not check out
+    // ends the journal
+    size_t offset = HEADER_SIZE;
+    while (size - offset >= ENTRY_HEADER) {
+        const unsigned char* p = base + offset;
+        uint64_t length = get64(p);
+        if (length > size - offset - ENTRY_HEADER ||
+            get32(p + 8) != Utils::crc32(p + ENTRY_HEADER, static_cast<size_t>(length))) {
+            break;
+        }
+        Entry entry;
+        if (!parseEntry(p + ENTRY_HEADER, static_cast<size_t>(length), entry) ||
+            (!entries.empty() && entry.version.id != entries.back().version.id + 1)) {
+            break;
+        }
+        entries.push_back(std::move(entry));
+        offset += ENTRY_HEADER + static_cast<size_t>(length);
+    }
+    return true;
+}
+
+uint64_t Journal::size() const {
+    return Utils::fileSize(path);
+}
+
+uint64_t Journal::syncCount() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return syncs;
+}
+
+const std::string& Journal::getPath() const {
+    return path;
+}
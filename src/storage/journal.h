@@ -0,0 +1,79 @@
+#pragma once
+#include "../core/version.h"
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Write-ahead journal of recent commits (<repo>/journal), behind the
+// `batch` durability level.
+//
+// Each commit appends one entry holding its version record (as the version
+// log stores it) and the stored bytes of the objects it wrote, and only
+// this file is flushed before the commit counts as done. The version log,
+// objects and HEAD are written as usual but not flushed; a checkpoint
+// flushes them and starts a new journal, whose header records how many
+// versions were on disk by then. After a crash, what the log or object
+// store lost is put back from the entries (Repo recovers at load).
+//
+// Layout: a 32-byte header (magic, boot tag, checkpoint version count,
+// reserved, CRC), then entries: length (8) | CRC of the payload (4) |
+// payload. Payload: the version record, the object count (4), and each
+// object as length (8) | bytes. An entry cut short by a crash fails its
+// CRC, and reading stops there.
+//
+// Group commit: append() hands out a ticket (the journal's write position)
+// and sync() returns once the journal is flushed past it. Of the callers
+// waiting at once, one flushes for all of them, so commits that arrive
+// while a flush is under way share the next one.
+class Journal {
+public:
+    static const size_t HEADER_SIZE = 32;
+
+    struct Entry {
+        Version version;
+        std::vector<std::string> objects;   // stored bytes (FileManager::encodeText) of its objects
+    };
+
+    explicit Journal(const std::string& path);
+
+    bool exists() const;
+
+    // Start an empty journal for a checkpoint of `checkpointVersions`
+    // versions, replacing the old one atomically (temporary file, flushed,
+    // + rename). Waits for a sync in flight; every ticket handed out so far
+    // counts as durable afterwards, since the checkpoint flushed all of it.
+    bool reset(size_t checkpointVersions);
+    void remove();
+
+    // Write one entry without flushing it; `ticket` is what to sync() for
+    bool append(const Entry& entry, uint64_t& ticket);
+
+    // Flush the journal through `ticket` (0: nothing to wait for)
+    bool sync(uint64_t ticket);
+
+    // The valid entries, in order, and the header's checkpoint. `sameBoot`
+    // is true if the journal was started since the machine last booted, so
+    // nothing written before a crash can have been lost with the page
+    // cache. False if there is no readable journal.
+    bool read(std::vector<Entry>& entries, size_t& checkpointVersions, bool& sameBoot) const;
+
+    uint64_t size() const;          // bytes in the file
+    uint64_t syncCount() const;     // flushes done by sync() so far
+
+    const std::string& getPath() const;
+
+private:
+    std::string path;
+    std::ofstream out;              // open for appending, reopened by reset()
+
+    mutable std::mutex lock;
+    std::condition_variable flushed;
+    uint64_t appended = 0;          // bytes appended since this object was made
+    uint64_t durable = 0;           // of those, how many are known to be on disk
+    bool syncing = false;           // a sync() is flushing without the lock
+    uint64_t syncs = 0;
+};
@@ -0,0 +1,166 @@
+#include "mapped_file.h"
+#include "../core/trace.h"
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+    open(path);
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : mapping(other.mapping), length(other.length),
+      buffer(std::move(other.buffer)), opened(other.opened) {
+    other.mapping = nullptr;
+    other.length = 0;
+    other.opened = false;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        mapping = other.mapping;
+        length = other.length;
+        buffer = std::move(other.buffer);
+        opened = other.opened;
+        other.mapping = nullptr;
+        other.length = 0;
+        other.opened = false;
+    }
+    return *this;
+}
+
+#ifndef _WIN32
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        length = static_cast<size_t>(info.st_size);
+        TRACE_COUNT(FilesOpened, 1);
+        TRACE_COUNT(BytesRead, length);
+        if (length == 0) {
+            // mmap rejects empty ranges; an empty view is all there is
+            ::close(fd);
+            opened = true;
+            return true;
+        }
+        void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            mapping = static_cast<char*>(p);
+            // Readers go front to back (line splitting, hashing, patching)
+            madvise(p, length, MADV_SEQUENTIAL);
+            ::close(fd);
+            opened = true;
+            return true;
+        }
+        length = 0;
+    }
+
+    // Pipe, FIFO or a file mmap refused: read it in chunks
+    char chunk[64 * 1024];
+    for (;;) {
+        ssize_t n = ::read(fd, chunk, sizeof(chunk));
+        if (n < 0) {
+            ::close(fd);
+            buffer.clear();
+            return false;
+        }
+        if (n == 0) break;
+        buffer.append(chunk, static_cast<size_t>(n));
+        TRACE_COUNT(BytesRead, static_cast<uint64_t>(n));
+    }
+    ::close(fd);
+    opened = true;
+    return true;
+}
+
+void MappedFile::close() {
+    if (mapping) munmap(mapping, length);
+    mapping = nullptr;
+    length = 0;
+    buffer.clear();
+    opened = false;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    if (GetFileType(file) == FILE_TYPE_DISK && GetFileSizeEx(file, &fileSize)) {
+        length = static_cast<size_t>(fileSize.QuadPart);
+        TRACE_COUNT(FilesOpened, 1);
+        TRACE_COUNT(BytesRead, length);
+        if (length == 0) {
+            // CreateFileMapping rejects empty files; an empty view is all there is
+            CloseHandle(file);
+            opened = true;
+            return true;
+        }
+        HANDLE section = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (section != nullptr) {
+            void* p = MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0);
+            // The view keeps the section and file open until it is unmapped
+            CloseHandle(section);
+            if (p != nullptr) {
+                mapping = static_cast<char*>(p);
+                CloseHandle(file);
+                opened = true;
+                return true;
+            }
+        }
+        length = 0;
+    }
+
+    // Pipe, console or a file Windows would not map: read it in chunks
+    char chunk[64 * 1024];
+    for (;;) {
+        DWORD n = 0;
+        if (!ReadFile(file, chunk, sizeof(chunk), &n, nullptr)) {
+            // A pipe reports its end as a broken pipe once the writer closes
+            if (GetLastError() == ERROR_BROKEN_PIPE) break;
+            CloseHandle(file);
+            buffer.clear();
+            return false;
+        }
+        if (n == 0) break;
+        buffer.append(chunk, n);
+        TRACE_COUNT(BytesRead, n);
+    }
+    CloseHandle(file);
+    opened = true;
+    return true;
+}
+
+void MappedFile::close() {
+    if (mapping) UnmapViewOfFile(mapping);
+    mapping = nullptr;
+    length = 0;
+    buffer.clear();
+    opened = false;
+}
+
+#endif
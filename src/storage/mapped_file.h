@@ -0,0 +1,40 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+// Read-only view of a whole file. Regular files are memory-mapped (mmap, or
+// MapViewOfFile on Windows), so the bytes come straight from the page
+// cache; pipes, character devices and anything the system will not map
+// are read into an owned buffer instead. The view stays valid until the
+// object is closed, reopened or destroyed. On Windows a mapped file cannot
+// be replaced by a rename until it is unmapped.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // Map (or read) the file; false if it cannot be opened
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return opened; }
+    // True when the bytes are mapped rather than copied into a buffer
+    bool isMapped() const { return mapping != nullptr; }
+
+    const char* data() const { return mapping ? mapping : buffer.data(); }
+    size_t size() const { return mapping ? length : buffer.size(); }
+    std::string_view view() const { return std::string_view(data(), size()); }
+
+private:
+    char* mapping = nullptr;
+    size_t length = 0;
+    std::string buffer;
+    bool opened = false;
+};
@@ -1,14 +1,20 @@
 #include "metadata.h"
+#include "mapped_file.h"
+#include "../core/trace.h"
 #include "../core/utils.h"
 #include <iostream>
+#include <string_view>
 
 namespace Metadata {
 
 void saveMetadata(const std::string& path, const std::vector<Version>& versions) {
-    // Phase 1: simple plain-text format: id|timestamp|diffPath|hash
+    TRACE_SCOPE("Metadata::saveMetadata");
+    // Plain-text format: id|timestamp|diffPath|hash|keyframe|snapshotPath|diffObject|snapshotObject
     std::string content;
     for (const auto& v : versions) {
-        content += std::to_string(v.id) + "|" + v.timestamp + "|" + v.diffPath + "|" + v.hash + "\n";
+        content += std::to_string(v.id) + "|" + v.timestamp + "|" + v.diffPath + "|" + v.hash +
+                   "|" + std::to_string(v.keyframe) + "|" + v.snapshotPath +
+                   "|" + v.diffObject + "|" + v.snapshotObject + "\n";
     }
     if (!Utils::writeFile(path, content)) {
         std::cerr << "Failed to save metadata to: " << path << "\n";
@@ -16,24 +22,39 @@ void saveMetadata(const std::string& path, const std::vector<Version>& versions)
 }
 
 std::vector<Version> loadMetadata(const std::string& path) {
+    TRACE_SCOPE("Metadata::loadMetadata");
     std::vector<Version> versions;
-    std::string content = Utils::readFile(path);
-    if (content.empty()) return versions;
+    MappedFile file;
+    if (!file.open(path) || file.size() == 0) return versions;
 
-    std::vector<std::string> lines = Utils::splitLines(content);
-    for (const auto& line : lines) {
+    std::vector<std::string_view> fields;
+    for (std::string_view line : Utils::splitLineViews(file.view())) {
         if (line.empty()) continue;
-        size_t pos1 = line.find('|');
-        size_t pos2 = line.find('|', pos1 + 1);
-        size_t pos3 = line.find('|', pos2 + 1);
-        if (pos1 == std::string::npos || pos2 == std::string::npos || pos3 == std::string::npos)
-            continue;
 
+        fields.clear();
+        size_t start = 0;
+        for (size_t pos = line.find('|'); pos != std::string_view::npos; pos = line.find('|', start)) {
+            fields.push_back(line.substr(start, pos - start));
+            start = pos + 1;
+        }
+        fields.push_back(line.substr(start));
+        if (fields.size() < 4) continue;
+
+        // Older files stop after the hash (no keyframes) or after the
+        // snapshot path (no object store)
         Version v;
-        v.id = std::stoi(line.substr(0, pos1));
-        v.timestamp = line.substr(pos1 + 1, pos2 - pos1 - 1);
-        v.diffPath = line.substr(pos2 + 1, pos3 - pos2 - 1);
-        v.hash = line.substr(pos3 + 1);
+        v.id = std::stoi(std::string(fields[0]));
+        v.timestamp = std::string(fields[1]);
+        v.diffPath = std::string(fields[2]);
+        v.hash = std::string(fields[3]);
+        if (fields.size() >= 6) {
+            v.keyframe = std::stoi(std::string(fields[4]));
+            v.snapshotPath = std::string(fields[5]);
+        }
+        if (fields.size() >= 8) {
+            v.diffObject = std::string(fields[6]);
+            v.snapshotObject = std::string(fields[7]);
+        }
         versions.push_back(v);
     }
 
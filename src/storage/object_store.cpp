@@ -0,0 +1,483 @@
+#include "object_store.h"
+#include "file_manager.h"
+#include "binary_io.h"
+#include "mapped_file.h"
+#include "../core/compress.h"
+#include "../core/sha256.h"
+#include "../core/trace.h"
+#include "../core/utils.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Stored object layout (before FileManager's encryption):
+//   "\0DSO" | codec (1) | content size (8) | dictionary id (4) | payload
+const char OBJECT_MAGIC[4] = {'\0', 'D', 'S', 'O'};
+const size_t HEADER_BYTES = 17;
+const size_t MIN_COMPRESS = 32;          // smaller objects are stored raw
+const size_t SMALL_OBJECT = 8 * 1024;    // the dictionary only pays off below this
+const size_t MIN_DICTIONARY = 256;
+// LZBlocks payload: per block, raw size (4) | stored size (4) | bytes,
+// where a stored size equal to the raw size means the block is not compressed
+const size_t FILE_BLOCK = 1 << 20;
+// sync() flushes the whole file system instead, where it can, past this many objects
+const size_t SYNC_FILESYSTEM_OBJECTS = 64;
+
+bool isDictionaryName(const std::string& name) {
+    return name.size() == 8 && name.find_first_not_of("0123456789abcdef") == std::string::npos;
+}
+
+std::string dictionaryName(uint32_t id) {
+    static const char digits[] = "0123456789abcdef";
+    std::string name(8, '0');
+    for (int i = 7; i >= 0; --i, id >>= 4) name[i] = digits[id & 0xF];
+    return name;
+}
+
+} // namespace
+
+ObjectStore::ObjectStore(const std::string& repoPath)
+    : objectsDir(repoPath + "/objects"), pack(repoPath + "/objects/pack") {
+}
+
+std::string ObjectStore::put(std::string_view content) {
+    TRACE_SCOPE("ObjectStore::put");
+    std::string id = Utils::hashString(content);
+    if (has(id)) return id;
+    return writeLoose(id, content) ? id : "";
+}
+
+bool ObjectStore::restore(std::string_view content) {
+    TRACE_SCOPE("ObjectStore::restore");
+    return writeLoose(Utils::hashString(content), content);
+}
+
+bool ObjectStore::writeLoose(const std::string& id, std::string_view content) {
+    bool newDirectory = !Utils::directoryExists(objectsDir + "/" + id.substr(0, 2));
+    Utils::createDirectory(objectsDir);
+    Utils::createDirectory(objectsDir + "/" + id.substr(0, 2));
+
+    // Write under a temporary name first so a partial object is never visible
+    std::string path = pathFor(id);
+    std::string tmpPath = path + ".tmp";
+    if (!FileManager::saveText(tmpPath, encodeObject(content), key.get()) ||
+        (syncWrites && !Utils::syncFile(tmpPath)) || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    if (syncWrites) syncDirectories(id, newDirectory);
+    return true;
+}
+
+void ObjectStore::syncDirectories(const std::string& id, bool newDirectory) const {
+    Utils::syncDirectory(objectsDir + "/" + id.substr(0, 2));
+    if (newDirectory) Utils::syncDirectory(objectsDir);
+}
+
+bool ObjectStore::sync(const std::vector<std::string>& ids) const {
+    TRACE_SCOPE("ObjectStore::sync");
+    if (ids.size() > SYNC_FILESYSTEM_OBJECTS && Utils::syncFileSystem(objectsDir)) return true;
+
+    // Packed objects were flushed with their pack
+    bool ok = true;
+    std::unordered_set<std::string> directories;
+    for (const auto& id : ids) {
+        if (id.size() <= 2 || !Utils::fileExists(pathFor(id))) continue;
+        ok = Utils::syncFile(pathFor(id)) && ok;
+        directories.insert(id.substr(0, 2));
+    }
+    for (const auto& fanout : directories) ok = Utils::syncDirectory(objectsDir + "/" + fanout) && ok;
+    if (!directories.empty()) ok = Utils::syncDirectory(objectsDir) && ok;
+    return ok;
+}
+
+void ObjectStore::setSyncWrites(bool enabled) {
+    syncWrites = enabled;
+}
+
+std::string ObjectStore::putFile(const std::string& path) {
+    TRACE_SCOPE("ObjectStore::putFile");
+    std::string id = Utils::hashFile(path);
+    if (id.empty() || has(id)) return id;
+
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return "";
+    TRACE_COUNT(FilesOpened, 1);
+    const size_t size = Utils::fileSize(path);
+
+    Codec codec = compression ? Codec::LZBlocks : Codec::Raw;
+    unsigned char header[HEADER_BYTES];
+    std::memcpy(header, OBJECT_MAGIC, 4);
+    header[4] = static_cast<unsigned char>(codec);
+    BinaryIO::put64(header + 5, size);
+    BinaryIO::put32(header + 13, 0);
+
+    bool newDirectory = !Utils::directoryExists(objectsDir + "/" + id.substr(0, 2));
+    Utils::createDirectory(objectsDir);
+    Utils::createDirectory(objectsDir + "/" + id.substr(0, 2));
+    std::string objectPath = pathFor(id);
+    std::string tmpPath = objectPath + ".tmp";
+    FileManager::Writer writer;
+    bool ok = writer.open(tmpPath, key.get()) &&
+              writer.write(std::string_view(reinterpret_cast<const char*>(header), HEADER_BYTES));
+
+    std::string block(FILE_BLOCK, '\0');
+    size_t copied = 0;
+    while (ok && in) {
+        in.read(&block[0], FILE_BLOCK);
+        size_t got = static_cast<size_t>(in.gcount());
+        if (got == 0) break;
+        TRACE_COUNT(BytesRead, got);
+        std::string_view raw(block.data(), got);
+        copied += got;
+        if (codec == Codec::Raw) {
+            ok = writer.write(raw);
+            continue;
+        }
+        std::string packed = Compress::compress(raw);
+        bool keepRaw = packed.size() >= got;
+        unsigned char lengths[8];
+        BinaryIO::put32(lengths, static_cast<uint32_t>(got));
+        BinaryIO::put32(lengths + 4, static_cast<uint32_t>(keepRaw ? got : packed.size()));
+        ok = writer.write(std::string_view(reinterpret_cast<const char*>(lengths), sizeof(lengths))) &&
+             writer.write(keepRaw ? raw : std::string_view(packed));
+    }
+    ok = writer.close() && ok && !in.bad();
+
+    // A file that changed while it was read would not match its id
+    if (!ok || copied != size || (syncWrites && !Utils::syncFile(tmpPath)) ||
+        std::rename(tmpPath.c_str(), objectPath.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+        return "";
+    }
+    if (syncWrites) syncDirectories(id, newDirectory);
+    return id;
+}
+
+bool ObjectStore::has(const std::string& id) const {
+    if (id.size() <= 2) return false;
+    return currentPack().has(id) || Utils::fileExists(pathFor(id));
+}
+
+std::string ObjectStore::get(const std::string& id, int version) const {
+    TRACE_SCOPE("ObjectStore::get");
+    if (id.size() <= 2) return "";
+    std::string framed;
+    std::string_view stored;
+    if (currentPack().find(id, stored, version)) {
+        framed = FileManager::decodeText(stored, key.get());
+    } else if (Utils::fileExists(pathFor(id))) {
+        framed = FileManager::loadText(pathFor(id), key.get());
+    } else {
+        return "";
+    }
+
+    std::string content;
+    if (!decodeObject(std::move(framed), content)) {
+        std::cerr << "Error: object " << id.substr(0, 16) << "... is damaged or needs a missing dictionary.\n";
+        return "";
+    }
+    return content;
+}
+
+size_t ObjectStore::size(const std::string& id) const {
+    if (id.size() <= 2) return 0;
+    std::string_view stored;
+    if (currentPack().find(id, stored)) return stored.size();
+    return Utils::fileSize(pathFor(id));
+}
+
+ObjectStore::Codec ObjectStore::codecOf(const std::string& id) const {
+    std::string stored;
+    if (!readStored(id, stored)) return Codec::Raw;
+    std::string framed = FileManager::decodeText(stored, key.get());
+    if (framed.size() < HEADER_BYTES || framed.compare(0, 4, OBJECT_MAGIC, 4) != 0) return Codec::Raw;
+    return static_cast<Codec>(framed[4]);
+}
+
+void ObjectStore::setCompression(bool enabled) {
+    compression = enabled;
+}
+
+void ObjectStore::setKey(std::shared_ptr<const Crypto::Key> repositoryKey) {
+    key = std::move(repositoryKey);
+}
+
+bool ObjectStore::trainDictionary(const std::vector<std::string>& samples) {
+    std::string trained = Compress::trainDictionary(samples);
+    if (trained.size() < MIN_DICTIONARY) return false;   // not enough shared content to help
+
+    Sha256::Digest digest = Sha256::digest(trained);
+    uint32_t id = (uint32_t(digest[0]) << 24) | (uint32_t(digest[1]) << 16) |
+                  (uint32_t(digest[2]) << 8) | digest[3];
+    if (id == 0) id = 1;
+
+    std::string dir = objectsDir + "/dictionaries";
+    Utils::createDirectory(objectsDir);
+    Utils::createDirectory(dir);
+    std::string path = dir + "/" + dictionaryName(id);
+    // On disk before any object is encoded with it
+    if (!FileManager::saveText(path + ".tmp", trained, key.get()) || !Utils::syncFile(path + ".tmp") ||
+        std::rename((path + ".tmp").c_str(), path.c_str()) != 0 || !Utils::syncDirectory(dir) ||
+        !Utils::writeFile(dir + "/current", dictionaryName(id) + "\n")) {
+        std::cerr << "Error: failed to save dictionary " << path << "\n";
+        return false;
+    }
+
+    loadDictionaries();
+    dictionaries[id] = trained;
+    currentDictionary = id;
+    return true;
+}
+
+bool ObjectStore::hasDictionary() const {
+    loadDictionaries();
+    return currentDictionary != 0;
+}
+
+std::string ObjectStore::pathFor(const std::string& id) const {
+    return objectsDir + "/" + id.substr(0, 2) + "/" + id.substr(2);
+}
+
+bool ObjectStore::repack(const std::vector<std::pair<std::string, std::string>>& versionObjects,
+                         RepackStats& stats, const std::unordered_set<std::string>& discard) {
+    stats = RepackStats();
+    const Pack& old = currentPack();
+    std::vector<std::string> loose = looseIds();
+    Pack::Writer writer(pack.getPath());
+
+    // Every object is decoded and encoded again, so a new dictionary or
+    // codec setting reaches the whole history
+    auto addObject = [&](const std::string& id) -> uint32_t {
+        if (id.empty()) return Pack::NO_ENTRY;
+        if (writer.contains(id)) return writer.add(id, std::string_view());   // already written
+        std::string stored, content;
+        if (!readStored(id, stored) || !decodeObject(FileManager::decodeText(stored, key.get()), content)) {
+            return Pack::NO_ENTRY;
+        }
+        stats.rawBytes += content.size();
+        return writer.add(id, FileManager::encodeText(encodeObject(content), key.get()));
+    };
+
+    for (size_t i = 0; i < versionObjects.size(); ++i) {
+        const auto& ids = versionObjects[i];
+        uint32_t diffEntry = addObject(ids.first);
+        uint32_t snapshotEntry = addObject(ids.second);
+        if ((!ids.first.empty() && diffEntry == Pack::NO_ENTRY) ||
+            (!ids.second.empty() && snapshotEntry == Pack::NO_ENTRY)) {
+            std::cerr << "Error: an object of version " << i << " is missing; repack aborted.\n";
+            return false;
+        }
+        writer.setVersion(i, diffEntry, snapshotEntry);
+    }
+
+    // Objects no version refers to are kept as well (a commit in progress
+    // may have stored them), unless the caller replaced them
+    for (const auto& id : loose) {
+        if (!discard.count(id)) addObject(id);
+    }
+    for (size_t row = 0; row < old.objectCount(); ++row) {
+        if (!discard.count(old.idAt(row))) addObject(old.idAt(row));
+    }
+
+    // Unmap the old pack before the new one replaces it
+    pack.close();
+    if (!writer.finish()) {
+        std::cerr << "Error: failed to write " << pack.getPath() << "\n";
+        reloadPack();
+        return false;
+    }
+    reloadPack();
+    stats.objects = pack.objectCount();
+    stats.packBytes = writer.bytesWritten();
+
+    // Everything is in the pack now; drop the loose copies
+    std::error_code ec;
+    for (const auto& id : loose) {
+        std::string path = pathFor(id);
+        stats.looseBytes += Utils::fileSize(path);
+        if (fs::remove(path, ec)) ++stats.looseRemoved;
+        fs::remove(objectsDir + "/" + id.substr(0, 2), ec);   // only succeeds once empty
+    }
+    removeStaleDictionaries();
+    return true;
+}
+
+ObjectStore::DiskStats ObjectStore::diskStats() const {
+    DiskStats stats;
+    for (const auto& id : looseIds()) {
+        ++stats.looseObjects;
+        stats.looseBytes += Utils::fileSize(pathFor(id));
+    }
+    const Pack& packed = currentPack();
+    if (packed.isOpen()) {
+        stats.packObjects = packed.objectCount();
+        stats.packBytes = Utils::fileSize(packed.getPath());
+    }
+    return stats;
+}
+
+void ObjectStore::reloadPack() const {
+    pack.open();
+    packLoaded = true;
+}
+
+const Pack& ObjectStore::currentPack() const {
+    if (!packLoaded) reloadPack();
+    return pack;
+}
+
+std::vector<std::string> ObjectStore::looseIds() const {
+    std::vector<std::string> ids;
+    std::error_code ec;
+    for (const auto& dir : fs::directory_iterator(objectsDir, ec)) {
+        std::string prefix = dir.path().filename().string();
+        if (!dir.is_directory() || prefix.size() != 2) continue;
+        for (const auto& entry : fs::directory_iterator(dir.path(), ec)) {
+            std::string rest = entry.path().filename().string();
+            if (rest.size() == 62 && entry.is_regular_file()) ids.push_back(prefix + rest);
+        }
+    }
+    return ids;
+}
+
+bool ObjectStore::readStored(const std::string& id, std::string& stored, int version) const {
+    std::string_view packed;
+    if (currentPack().find(id, packed, version)) {
+        stored.assign(packed.data(), packed.size());
+        return true;
+    }
+    MappedFile file;
+    if (!Utils::fileExists(pathFor(id)) || !file.open(pathFor(id))) return false;
+    stored.assign(file.data(), file.size());
+    return true;
+}
+
+std::string ObjectStore::encodeObject(std::string_view content) const {
+    Codec codec = Codec::Raw;
+    uint32_t dictionaryId = 0;
+    std::string payload;
+
+    if (compression && content.size() >= MIN_COMPRESS) {
+        payload = Compress::compress(content);
+        codec = Codec::LZ;
+
+        loadDictionaries();
+        const std::string* dict = dictionary(currentDictionary);
+        if (dict && content.size() <= SMALL_OBJECT) {
+            std::string withDictionary = Compress::compress(content, *dict);
+            if (withDictionary.size() < payload.size()) {
+                payload.swap(withDictionary);
+                codec = Codec::LZDictionary;
+                dictionaryId = currentDictionary;
+            }
+        }
+        if (payload.size() >= content.size()) codec = Codec::Raw;
+    }
+
+    unsigned char header[HEADER_BYTES];
+    std::memcpy(header, OBJECT_MAGIC, 4);
+    header[4] = static_cast<unsigned char>(codec);
+    BinaryIO::put64(header + 5, content.size());
+    BinaryIO::put32(header + 13, dictionaryId);
+
+    std::string framed(reinterpret_cast<const char*>(header), HEADER_BYTES);
+    if (codec == Codec::Raw) {
+        framed.append(content.data(), content.size());
+    } else {
+        framed += payload;
+    }
+    return framed;
+}
+
+bool ObjectStore::decodeObject(std::string framed, std::string& content) const {
+    if (framed.size() < HEADER_BYTES || framed.compare(0, 4, OBJECT_MAGIC, 4) != 0) {
+        content = std::move(framed);    // written before objects had a header
+        return true;
+    }
+
+    const unsigned char* header = reinterpret_cast<const unsigned char*>(framed.data());
+    Codec codec = static_cast<Codec>(header[4]);
+    uint64_t size = BinaryIO::get64(header + 5);
+    uint32_t dictionaryId = BinaryIO::get32(header + 13);
+    std::string_view payload(framed.data() + HEADER_BYTES, framed.size() - HEADER_BYTES);
+
+    switch (codec) {
+    case Codec::Raw:
+        if (payload.size() != size) return false;
+        framed.erase(0, HEADER_BYTES);
+        content = std::move(framed);
+        return true;
+    case Codec::LZ:
+        return Compress::decompress(payload, static_cast<size_t>(size), content);
+    case Codec::LZDictionary: {
+        loadDictionaries();
+        const std::string* dict = dictionary(dictionaryId);
+        return dict && Compress::decompress(payload, static_cast<size_t>(size), content, *dict);
+    }
+    case Codec::LZBlocks: {
+        content.clear();
+        content.reserve(static_cast<size_t>(size));
+        std::string block;
+        while (payload.size() >= 8) {
+            const unsigned char* lengths = reinterpret_cast<const unsigned char*>(payload.data());
+            size_t rawSize = BinaryIO::get32(lengths);
+            size_t storedSize = BinaryIO::get32(lengths + 4);
+            payload.remove_prefix(8);
+            if (storedSize > payload.size()) return false;
+            if (storedSize == rawSize) {
+                content.append(payload.data(), rawSize);
+            } else {
+                if (!Compress::decompress(payload.substr(0, storedSize), rawSize, block)) return false;
+                content += block;
+            }
+            payload.remove_prefix(storedSize);
+        }
+        return payload.empty() && content.size() == size;
+    }
+    }
+    return false;
+}
+
+void ObjectStore::loadDictionaries() const {
+    if (dictionariesLoaded) return;
+    dictionariesLoaded = true;
+
+    std::string dir = objectsDir + "/dictionaries";
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        std::string name = entry.path().filename().string();
+        if (!isDictionaryName(name)) continue;
+        dictionaries[static_cast<uint32_t>(std::stoul(name, nullptr, 16))] =
+            FileManager::loadText(entry.path().string(), key.get());
+    }
+    std::string current = Utils::readFile(dir + "/current");
+    current = current.substr(0, current.find('\n'));
+    if (isDictionaryName(current)) currentDictionary = static_cast<uint32_t>(std::stoul(current, nullptr, 16));
+}
+
+const std::string* ObjectStore::dictionary(uint32_t id) const {
+    if (id == 0) return nullptr;
+    auto found = dictionaries.find(id);
+    return found == dictionaries.end() ? nullptr : &found->second;
+}
+
+void ObjectStore::removeStaleDictionaries() {
+    // After a repack every object uses the current dictionary (or none)
+    loadDictionaries();
+    std::error_code ec;
+    for (auto it = dictionaries.begin(); it != dictionaries.end();) {
+        if (it->first == currentDictionary) {
+            ++it;
+            continue;
+        }
+        fs::remove(objectsDir + "/dictionaries/" + dictionaryName(it->first), ec);
+        it = dictionaries.erase(it);
+    }
+}
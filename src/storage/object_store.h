@@ -0,0 +1,132 @@
+#pragma once
+#include "pack.h"
+#include "../core/crypto.h"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+
+// Content-addressed object storage. Each object is keyed by the SHA-256 of its
+// content and lives at <repo>/objects/<first 2 hex>/<remaining 62 hex>, so
+// identical payloads are written once. `repack` folds loose objects into a
+// single packfile (<repo>/objects/pack); reads check the pack first.
+//
+// Objects are compressed on the way in. A small header in front of the
+// payload records the codec, so objects written before compression (plain
+// text, no header) still read back. With a key set, FileManager encrypts
+// every object and dictionary as it is written; unencrypted ones still read.
+class ObjectStore {
+public:
+    enum class Codec : unsigned char {
+        Raw = 0,            // stored as is
+        LZ = 1,             // Compress::compress
+        LZDictionary = 2,   // Compress::compress with the repository dictionary
+        LZBlocks = 3        // Compress::compress per block (objects stored from files)
+    };
+
+    explicit ObjectStore(const std::string& repoPath);
+
+    // Store content and return its id; nothing is written if it already exists
+    std::string put(std::string_view content);
+
+    // put() for the content of a file, read and compressed a block at a time
+    // so it is never held in memory at once ("" if the file cannot be read)
+    std::string putFile(const std::string& path);
+
+    // put() even if the object exists: crash recovery rewrites objects a
+    // lost write may have left empty or damaged
+    bool restore(std::string_view content);
+
+    // Flush new objects to disk as put() and putFile() write them (file, then
+    // its directory), before they are renamed into place. Off by default.
+    void setSyncWrites(bool enabled);
+    // Flush the loose files of these objects and their directories
+    bool sync(const std::vector<std::string>& ids) const;
+
+    // True if an object with this id is stored (packed or loose)
+    bool has(const std::string& id) const;
+
+    // Content of an object ("" if missing). `version` is the version the
+    // object was stored for, if known; packed lookups then use the version index.
+    std::string get(const std::string& id, int version = -1) const;
+
+    // Bytes the object occupies on disk (0 if missing)
+    size_t size(const std::string& id) const;
+
+    // How a stored object is encoded (Raw for objects from before compression)
+    Codec codecOf(const std::string& id) const;
+
+    // Compress new objects (default) or store them raw
+    void setCompression(bool enabled);
+
+    // Encrypt what is written from now on with this key, and decrypt with it
+    // (null: write plain; encrypted objects then cannot be read)
+    void setKey(std::shared_ptr<const Crypto::Key> repositoryKey);
+
+    // Build a dictionary from sample contents (typically recent diffs) and use
+    // it for small objects from now on. Older dictionaries stay readable until
+    // the next repack re-encodes everything with this one.
+    bool trainDictionary(const std::vector<std::string>& samples);
+    bool hasDictionary() const;
+
+    // Location of an object's loose file
+    std::string pathFor(const std::string& id) const;
+
+    struct DiskStats {
+        size_t looseObjects = 0;    // objects stored as loose files
+        size_t looseBytes = 0;
+        size_t packObjects = 0;     // objects in the pack
+        size_t packBytes = 0;       // size of the pack file
+    };
+    DiskStats diskStats() const;
+
+    struct RepackStats {
+        size_t objects = 0;         // objects in the new pack
+        size_t rawBytes = 0;        // their uncompressed size
+        size_t looseRemoved = 0;    // loose files folded in and deleted
+        size_t looseBytes = 0;      // bytes those files held
+        size_t packBytes = 0;       // size of the new pack
+    };
+
+    // Rewrite the pack with every stored object, re-encoded with the current
+    // codec settings. versionObjects[i] is the {diff, snapshot} id pair of
+    // version i ("" for none); those are written first, in version order,
+    // and indexed by version id. Objects in `discard` that no version names
+    // (deltas a repack replaced) are left out; any other object is kept.
+    bool repack(const std::vector<std::pair<std::string, std::string>>& versionObjects,
+                RepackStats& stats, const std::unordered_set<std::string>& discard = {});
+
+    // Pick up a pack written by another process
+    void reloadPack() const;
+
+private:
+    std::string objectsDir;
+    mutable Pack pack;
+    mutable bool packLoaded = false;
+    bool compression = true;
+    bool syncWrites = false;
+    std::shared_ptr<const Crypto::Key> key;
+
+    // Dictionaries by id, loaded on first use; currentDictionary 0 means none
+    mutable std::unordered_map<uint32_t, std::string> dictionaries;
+    mutable uint32_t currentDictionary = 0;
+    mutable bool dictionariesLoaded = false;
+
+    const Pack& currentPack() const;
+    std::vector<std::string> looseIds() const;
+    bool writeLoose(const std::string& id, std::string_view content);
+    void syncDirectories(const std::string& id, bool newDirectory) const;
+
+    // Stored bytes (still encrypted/encoded) of an object, from the pack or a loose file
+    bool readStored(const std::string& id, std::string& stored, int version = -1) const;
+    std::string encodeObject(std::string_view content) const;
+    bool decodeObject(std::string framed, std::string& content) const;
+    void loadDictionaries() const;
+    const std::string* dictionary(uint32_t id) const;
+    void removeStaleDictionaries();
+};
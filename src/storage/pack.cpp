@@ -0,0 +1,242 @@
+#include "pack.h"
+#include "binary_io.h"
+#include "../core/sha256.h"
+#include "../core/utils.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+using BinaryIO::put32;
+using BinaryIO::put64;
+using BinaryIO::get32;
+using BinaryIO::get64;
+
+namespace {
+
+const char PACK_MAGIC[8] = {'D', 'S', 'A', 'P', 'A', 'C', 'K', '1'};
+const char FOOTER_MAGIC[8] = {'D', 'S', 'A', 'P', 'K', 'E', 'N', 'D'};
+
+const size_t DIGEST_BYTES = 32;
+const size_t OBJECT_ROW = DIGEST_BYTES + 16;  // digest | offset | length
+const size_t VERSION_ROW = 8;                 // diff row | snapshot row
+const size_t FOOTER_BYTES = 32;
+
+bool rawDigest(const std::string& id, std::string& digest) {
+    Sha256::Digest d;
+    if (!Sha256::fromHex(id, d)) return false;
+    digest.assign(reinterpret_cast<const char*>(d.data()), d.size());
+    return true;
+}
+
+} // namespace
+
+Pack::Pack(const std::string& path) : path(path) {
+}
+
+bool Pack::open() {
+    close();
+    if (!Utils::fileExists(path) || !file.open(path)) return false;
+
+    const unsigned char* base = reinterpret_cast<const unsigned char*>(file.data());
+    size_t size = file.size();
+    if (size < sizeof(PACK_MAGIC) + FOOTER_BYTES || std::memcmp(base, PACK_MAGIC, 8) != 0) {
+        close();
+        return false;
+    }
+
+    const unsigned char* footer = base + size - FOOTER_BYTES;
+    uint64_t indexOffset = get64(footer + 8);
+    size_t objectRows = get32(footer + 16);
+    size_t versionRows = get32(footer + 20);
+    size_t indexBytes = objectRows * OBJECT_ROW + versionRows * VERSION_ROW;
+    if (std::memcmp(footer, FOOTER_MAGIC, 8) != 0 || get32(footer + 28) != Utils::crc32(footer, 28) ||
+        indexOffset + indexBytes + FOOTER_BYTES != size ||
+        get32(footer + 24) != Utils::crc32(base + indexOffset, indexBytes)) {
+        close();
+        return false;
+    }
+
+    objectIndex = base + indexOffset;
+    versionIndex = objectIndex + objectRows * OBJECT_ROW;
+    objects = objectRows;
+    versions = versionRows;
+    return true;
+}
+
+void Pack::close() {
+    file.close();
+    objectIndex = nullptr;
+    versionIndex = nullptr;
+    objects = 0;
+    versions = 0;
+}
+
+bool Pack::isOpen() const {
+    return objectIndex != nullptr;
+}
+
+bool Pack::findEntry(const std::string& id, int version, size_t& row) const {
+    if (!isOpen()) return false;
+    std::string digest;
+    if (!rawDigest(id, digest)) return false;
+
+    // The version index names the rows directly; confirm the digest matches
+    if (version >= 0 && static_cast<size_t>(version) < versions) {
+        const unsigned char* slot = versionIndex + version * VERSION_ROW;
+        for (uint32_t candidate : {get32(slot), get32(slot + 4)}) {
+            if (candidate < objects &&
+                std::memcmp(objectIndex + candidate * OBJECT_ROW, digest.data(), DIGEST_BYTES) == 0) {
+                row = candidate;
+                return true;
+            }
+        }
+    }
+
+    size_t lo = 0, hi = objects;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = std::memcmp(objectIndex + mid * OBJECT_ROW, digest.data(), DIGEST_BYTES);
+        if (cmp == 0) {
+            row = mid;
+            return true;
+        }
+        if (cmp < 0) lo = mid + 1; else hi = mid;
+    }
+    return false;
+}
+
+bool Pack::find(const std::string& id, std::string_view& stored, int version) const {
+    size_t row;
+    if (!findEntry(id, version, row)) return false;
+    stored = storedAt(row);
+    return true;
+}
+
+bool Pack::has(const std::string& id) const {
+    size_t row;
+    return findEntry(id, -1, row);
+}
+
+size_t Pack::objectCount() const {
+    return objects;
+}
+
+size_t Pack::versionCount() const {
+    return versions;
+}
+
+std::string Pack::idAt(size_t row) const {
+    Sha256::Digest d;
+    std::memcpy(d.data(), objectIndex + row * OBJECT_ROW, DIGEST_BYTES);
+    return Sha256::toHex(d);
+}
+
+std::string_view Pack::storedAt(size_t row) const {
+    const unsigned char* entry = objectIndex + row * OBJECT_ROW;
+    uint64_t offset = get64(entry + DIGEST_BYTES);
+    uint64_t length = get64(entry + DIGEST_BYTES + 8);
+    return std::string_view(file.data() + offset, static_cast<size_t>(length));
+}
+
+const std::string& Pack::getPath() const {
+    return path;
+}
+
+Pack::Writer::Writer(const std::string& path)
+    : path(path), tmpPath(path + ".tmp"),
+      out(tmpPath, std::ios::out | std::ios::trunc | std::ios::binary) {
+    failed = !out.is_open();
+    out.write(PACK_MAGIC, sizeof(PACK_MAGIC));
+    offset = sizeof(PACK_MAGIC);
+}
+
+uint32_t Pack::Writer::add(const std::string& id, std::string_view stored) {
+    auto found = entryById.find(id);
+    if (found != entryById.end()) return found->second;
+
+    Entry entry;
+    if (!rawDigest(id, entry.digest)) {
+        failed = true;
+        return NO_ENTRY;
+    }
+
+    unsigned char length[8];
+    put64(length, stored.size());
+    out.write(entry.digest.data(), DIGEST_BYTES);
+    out.write(reinterpret_cast<const char*>(length), sizeof(length));
+    out.write(stored.data(), stored.size());
+    entry.offset = offset + DIGEST_BYTES + sizeof(length);
+    entry.length = stored.size();
+    offset = entry.offset + entry.length;
+
+    uint32_t index = static_cast<uint32_t>(entries.size());
+    entries.push_back(entry);
+    entryById.emplace(id, index);
+    return index;
+}
+
+void Pack::Writer::setVersion(size_t version, uint32_t diffEntry, uint32_t snapshotEntry) {
+    if (versionSlots.size() <= version) versionSlots.resize(version + 1, {NO_ENTRY, NO_ENTRY});
+    versionSlots[version] = {diffEntry, snapshotEntry};
+}
+
+bool Pack::Writer::contains(const std::string& id) const {
+    return entryById.count(id) > 0;
+}
+
+bool Pack::Writer::finish() {
+    // Object index sorted by digest; the version index refers to its rows
+    std::vector<uint32_t> order(entries.size());
+    for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return entries[a].digest < entries[b].digest;
+    });
+    std::vector<uint32_t> rowOf(entries.size());
+    for (uint32_t row = 0; row < order.size(); ++row) rowOf[order[row]] = row;
+
+    std::string index(entries.size() * OBJECT_ROW + versionSlots.size() * VERSION_ROW, '\0');
+    unsigned char* p = reinterpret_cast<unsigned char*>(&index[0]);
+    for (uint32_t row = 0; row < order.size(); ++row, p += OBJECT_ROW) {
+        const Entry& entry = entries[order[row]];
+        std::memcpy(p, entry.digest.data(), DIGEST_BYTES);
+        put64(p + DIGEST_BYTES, entry.offset);
+        put64(p + DIGEST_BYTES + 8, entry.length);
+    }
+    for (const auto& slot : versionSlots) {
+        put32(p, slot.first == NO_ENTRY ? NO_ENTRY : rowOf[slot.first]);
+        put32(p + 4, slot.second == NO_ENTRY ? NO_ENTRY : rowOf[slot.second]);
+        p += VERSION_ROW;
+    }
+
+    unsigned char footer[FOOTER_BYTES] = {0};
+    std::memcpy(footer, FOOTER_MAGIC, 8);
+    put64(footer + 8, offset);
+    put32(footer + 16, static_cast<uint32_t>(entries.size()));
+    put32(footer + 20, static_cast<uint32_t>(versionSlots.size()));
+    put32(footer + 24, Utils::crc32(index.data(), index.size()));
+    put32(footer + 28, Utils::crc32(footer, 28));
+
+    out.write(index.data(), index.size());
+    out.write(reinterpret_cast<const char*>(footer), sizeof(footer));
+    offset += index.size() + sizeof(footer);
+    out.close();
+
+    // Flushed before it replaces the old pack: repack deletes the loose
+    // files it folded in once this returns
+    std::error_code ec;
+    if (failed || out.fail() || !Utils::syncFile(tmpPath)) {
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    Utils::syncDirectory(std::filesystem::path(path).parent_path().string());
+    return true;
+}
+
+size_t Pack::Writer::bytesWritten() const {
+    return static_cast<size_t>(offset);
+}
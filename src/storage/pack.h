@@ -0,0 +1,90 @@
+#pragma once
+#include "mapped_file.h"
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// A packfile holds many objects back to back in one file (<repo>/objects/pack):
+//
+//   "DSAPACK1"
+//   per object:  digest (32) | payload length (8) | payload (as stored on disk)
+//   object index: digest (32) | payload offset (8) | payload length (8), sorted by digest
+//   version index: diff row (4) | snapshot row (4) per version id, as rows of the object index
+//   footer: "DSAPKEND" | index offset (8) | objects (4) | versions (4) | index CRC | footer CRC
+//
+// Objects are written in version order, so replaying a delta chain walks the
+// file forwards. Lookups by version id go straight through the version index;
+// anything else is a binary search over the object index. Payloads are kept
+// exactly as the loose files store them (FileManager decodes both the same way).
+class Pack {
+public:
+    static constexpr uint32_t NO_ENTRY = 0xFFFFFFFFu;
+
+    explicit Pack(const std::string& path);
+
+    // Map the pack; false if there is none or it fails its checks
+    bool open();
+    void close();
+    bool isOpen() const;
+
+    // Stored bytes of an object. `version` (if >= 0) is the version the
+    // object belongs to, which turns the lookup into an index read.
+    bool find(const std::string& id, std::string_view& stored, int version = -1) const;
+    bool has(const std::string& id) const;
+
+    size_t objectCount() const;
+    size_t versionCount() const;
+    // Id and stored bytes of object index row i
+    std::string idAt(size_t row) const;
+    std::string_view storedAt(size_t row) const;
+
+    const std::string& getPath() const;
+
+    // Streams a new pack to a temporary file; finish() adds the indexes,
+    // flushes it to disk and renames it into place, so readers (and a crash)
+    // see either the old pack or the new one.
+    class Writer {
+    public:
+        explicit Writer(const std::string& path);
+
+        // Append an object unless it is already in this pack; returns its entry
+        uint32_t add(const std::string& id, std::string_view stored);
+        // Record which entries hold a version's diff and snapshot (NO_ENTRY if none)
+        void setVersion(size_t version, uint32_t diffEntry, uint32_t snapshotEntry);
+
+        bool contains(const std::string& id) const;
+        bool finish();
+        size_t bytesWritten() const;
+
+    private:
+        struct Entry {
+            std::string digest;     // 32 raw bytes
+            uint64_t offset;
+            uint64_t length;
+        };
+
+        std::string path;
+        std::string tmpPath;
+        std::ofstream out;
+        uint64_t offset = 0;
+        bool failed = false;
+        std::vector<Entry> entries;
+        std::unordered_map<std::string, uint32_t> entryById;
+        std::vector<std::pair<uint32_t, uint32_t>> versionSlots;
+    };
+
+private:
+    std::string path;
+    MappedFile file;
+    const unsigned char* objectIndex = nullptr;   // sorted by digest
+    const unsigned char* versionIndex = nullptr;  // by version id
+    size_t objects = 0;
+    size_t versions = 0;
+
+    bool findEntry(const std::string& id, int version, size_t& row) const;
+};
@@ -0,0 +1,445 @@
+#include "search_index.h"
+#include "binary_io.h"
+#include "mapped_file.h"
+#include "../core/delta.h"
+#include "../core/trace.h"
+#include "../core/utils.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+const char STATE_MAGIC[] = "DSASEARCH1";
+const char TERMS_MAGIC[8] = {'D', 'S', 'A', 'T', 'R', 'I', '1', '\0'};
+
+const size_t RECORD_SIZE = 20;      // text offset (8), length, first version, last version
+const size_t REC_LAST = 16;
+const size_t POSTING_SIZE = 8;      // trigram, record id
+const size_t TERMS_HEADER = 24;     // magic, term count, table offset
+const size_t TERM_SIZE = 16;        // trigram, posting count, index of its first id
+
+// The tail is merged into terms.dat once it holds this many postings and
+// at least an eighth as many as terms.dat, so each posting is rewritten a
+// bounded number of times however the index grows
+const uint64_t MIN_MERGE = 1 << 18;
+// add() flushes on its own past this many gathered postings
+const size_t FLUSH_POSTINGS = 1 << 21;
+
+using BinaryIO::put32;
+using BinaryIO::put64;
+using BinaryIO::get32;
+using BinaryIO::get64;
+
+// Distinct byte trigrams of a text, ascending
+void trigrams(std::string_view text, std::vector<uint32_t>& grams) {
+    grams.clear();
+    for (size_t i = 0; i + 2 < text.size(); ++i) {
+        grams.push_back(uint32_t(static_cast<unsigned char>(text[i])) << 16 |
+                        uint32_t(static_cast<unsigned char>(text[i + 1])) << 8 |
+                        uint32_t(static_cast<unsigned char>(text[i + 2])));
+    }
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+}
+
+const unsigned char* bytes(const MappedFile& file) {
+    return reinterpret_cast<const unsigned char*>(file.data());
+}
+
+// The term table of a mapped terms.dat (false if it is not one)
+bool termTable(const MappedFile& terms, uint64_t& count, uint64_t& tableOffset) {
+    if (!terms.isOpen() || terms.size() < TERMS_HEADER || std::memcmp(terms.data(), TERMS_MAGIC, 8) != 0) return false;
+    count = get64(bytes(terms) + 8);
+    tableOffset = get64(bytes(terms) + 16);
+    return tableOffset >= TERMS_HEADER && (tableOffset - TERMS_HEADER) % 4 == 0 &&
+           tableOffset + count * TERM_SIZE == terms.size();
+}
+
+// Keep the first `size` bytes of a file (creating it if missing), then append
+bool appendAt(const std::string& path, uint64_t size, const std::string& data) {
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec)) std::ofstream(path, std::ios::binary);
+    if (std::filesystem::file_size(path, ec) != size) std::filesystem::resize_file(path, size, ec);
+    if (ec) return false;
+    if (data.empty()) return true;
+    std::ofstream out(path, std::ios::binary | std::ios::app);
+    out.write(data.data(), data.size());
+    return bool(out.flush());
+}
+
+// Replace a file atomically (temporary file + rename)
+bool replaceFile(const std::string& path, const std::string& content) {
+    std::string tmpPath = path + ".tmp";
+    std::error_code ec;
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        out.write(content.data(), content.size());
+        if (!out.flush()) return false;
+    }
+    std::filesystem::rename(tmpPath, path, ec);
+    return !ec;
+}
+
+} // namespace
+
+SearchIndex::SearchIndex(const std::string& dir) : dir(dir) {
+}
+
+std::string SearchIndex::file(const char* name) const {
+    return dir + "/" + name;
+}
+
+bool SearchIndex::exists() const {
+    return Utils::fileExists(file("state"));
+}
+
+bool SearchIndex::create() {
+    remove();
+    if (!Utils::createDirectory(dir)) return false;
+    indexed = -1;
+    indexedHash = "-";
+    recordCount = textBytes = tailCount = 0;
+    live.clear();
+    newRecords.clear();
+    newText.clear();
+    newPostings.clear();
+    closed.clear();
+    return writeLive() && writeState();
+}
+
+void SearchIndex::remove() {
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+}
+
+bool SearchIndex::open() {
+    TRACE_SCOPE("SearchIndex::open");
+    newRecords.clear();
+    newText.clear();
+    newPostings.clear();
+    closed.clear();
+    live.clear();
+
+    std::istringstream state(Utils::readFile(file("state")));
+    std::string magic;
+    bool valid = (state >> magic >> indexed >> indexedHash >> recordCount >> textBytes >> tailCount) &&
+                 magic == STATE_MAGIC && indexed >= -1 &&
+                 Utils::fileSize(file("lines.dat")) >= recordCount * RECORD_SIZE &&
+                 Utils::fileSize(file("text.dat")) >= textBytes &&
+                 Utils::fileSize(file("tail.dat")) >= tailCount * POSTING_SIZE;
+
+    // The newest version's line ids: its id, their count, then the ids
+    MappedFile liveFile;
+    valid = valid && liveFile.open(file("live.dat")) && liveFile.size() >= 8 &&
+            get32(bytes(liveFile)) == static_cast<uint32_t>(indexed) &&
+            liveFile.size() == 8 + 4 * uint64_t(get32(bytes(liveFile) + 4));
+    if (valid) {
+        live.resize(get32(bytes(liveFile) + 4));
+        for (size_t i = 0; i < live.size() && valid; ++i) {
+            live[i] = get32(bytes(liveFile) + 8 + 4 * i);
+            valid = live[i] < recordCount;
+        }
+    }
+
+    MappedFile terms;
+    uint64_t termCount = 0, tableOffset = 0;
+    if (valid && Utils::fileExists(file("terms.dat"))) {
+        valid = terms.open(file("terms.dat")) && termTable(terms, termCount, tableOffset);
+    }
+    if (!valid) {
+        indexed = -1;
+        live.clear();
+    }
+    return valid;
+}
+
+int SearchIndex::version() const {
+    return indexed;
+}
+
+const std::string& SearchIndex::versionHash() const {
+    return indexedHash;
+}
+
+bool SearchIndex::add(int id, const std::string& hash, std::string_view diffText) {
+    TRACE_SCOPE("SearchIndex::add");
+    Delta::Composition composition(live.size());
+    if (id != indexed + 1 || !composition.apply(diffText)) return false;
+
+    // Kept lines keep their records; added ones get new records. Base lines
+    // stay in order in the composition, so the gaps between base pieces
+    // are the lines the diff removed: they lived until the version before.
+    std::vector<uint32_t> next;
+    next.reserve(composition.lineCount());
+    const std::vector<std::string_view>& added = composition.addedLines(0);
+    std::vector<uint32_t> grams;
+    size_t nextBase = 0;
+    auto close = [&](size_t end) {
+        for (; nextBase < end; ++nextBase) {
+            uint32_t record = live[nextBase];
+            if (record >= recordCount) newRecords[record - recordCount].last = id - 1;
+            else closed.emplace_back(record, id - 1);
+        }
+    };
+    for (const Delta::Piece& piece : composition.pieces()) {
+        if (piece.source < 0) {
+            close(piece.start);
+            next.insert(next.end(), live.begin() + piece.start, live.begin() + piece.start + piece.length);
+            nextBase = piece.start + piece.length;
+            continue;
+        }
+        for (size_t i = piece.start; i < piece.start + piece.length; ++i) {
+            uint32_t record = static_cast<uint32_t>(recordCount + newRecords.size());
+            newRecords.push_back({textBytes + newText.size(), static_cast<uint32_t>(added[i].size()),
+                                  static_cast<uint32_t>(id), OPEN});
+            newText.append(added[i]);
+            trigrams(added[i], grams);
+            for (uint32_t gram : grams) newPostings.push_back(uint64_t(gram) << 32 | record);
+            next.push_back(record);
+        }
+    }
+    close(live.size());
+
+    live.swap(next);
+    indexed = id;
+    indexedHash = hash;
+    return newPostings.size() < FLUSH_POSTINGS || flush();
+}
+
+bool SearchIndex::flush() {
+    TRACE_SCOPE("SearchIndex::flush");
+    std::string records(newRecords.size() * RECORD_SIZE, '\0');
+    unsigned char* p = reinterpret_cast<unsigned char*>(&records[0]);
+    for (const Record& record : newRecords) {
+        put64(p, record.offset);
+        put32(p + 8, record.length);
+        put32(p + 12, record.first);
+        put32(p + REC_LAST, record.last);
+        p += RECORD_SIZE;
+    }
+    std::string postings(newPostings.size() * POSTING_SIZE, '\0');
+    p = reinterpret_cast<unsigned char*>(&postings[0]);
+    for (uint64_t posting : newPostings) {
+        put32(p, static_cast<uint32_t>(posting >> 32));
+        put32(p + 4, static_cast<uint32_t>(posting));
+        p += POSTING_SIZE;
+    }
+
+    Utils::createDirectory(dir);
+    bool written = appendAt(file("lines.dat"), recordCount * RECORD_SIZE, records) &&
+                   appendAt(file("text.dat"), textBytes, newText) &&
+                   appendAt(file("tail.dat"), tailCount * POSTING_SIZE, postings);
+
+    // Records written before: their last version, in place
+    if (written && !closed.empty()) {
+        std::fstream lines(file("lines.dat"), std::ios::in | std::ios::out | std::ios::binary);
+        unsigned char last[4];
+        for (const auto& [record, version] : closed) {
+            put32(last, version);
+            lines.seekp(record * RECORD_SIZE + REC_LAST);
+            lines.write(reinterpret_cast<const char*>(last), 4);
+        }
+        written = bool(lines.flush());
+    }
+    if (!written || !writeLive()) {
+        std::cerr << "Error: Could not update the search index in " << dir << "\n";
+        return false;
+    }
+
+    recordCount += newRecords.size();
+    textBytes += newText.size();
+    tailCount += newPostings.size();
+    newRecords.clear();
+    newText.clear();
+    newPostings.clear();
+    closed.clear();
+
+    uint64_t termPostings = Utils::fileSize(file("terms.dat")) / 4;
+    if (tailCount >= MIN_MERGE && tailCount * 8 >= termPostings) merge();
+    return writeState();
+}
+
+bool SearchIndex::merge() {
+    TRACE_SCOPE("SearchIndex::merge");
+    // The tail, sorted as terms.dat is: by trigram, then record id
+    std::vector<uint64_t> tail(tailCount);
+    {
+        MappedFile tailFile;
+        if (!tailFile.open(file("tail.dat")) || tailFile.size() < tailCount * POSTING_SIZE) return false;
+        for (size_t i = 0; i < tail.size(); ++i) {
+            const unsigned char* p = bytes(tailFile) + i * POSTING_SIZE;
+            tail[i] = uint64_t(get32(p)) << 32 | get32(p + 4);
+        }
+    }
+    std::sort(tail.begin(), tail.end());
+
+    MappedFile terms;
+    uint64_t termCount = 0, tableOffset = 0;
+    if (Utils::fileExists(file("terms.dat")) &&
+        !(terms.open(file("terms.dat")) && termTable(terms, termCount, tableOffset))) return false;
+
+    // Both inputs are sorted, so each term's list is written as it is merged;
+    // the table goes after the ids
+    const std::string tmpPath = file("terms.dat.tmp");
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    std::string buffer(TERMS_HEADER, '\0');
+    std::string table;
+    uint64_t written = 0;
+    std::vector<uint32_t> ids;
+    size_t t = 0;
+    for (uint64_t b = 0; b < termCount || t < tail.size();) {
+        const unsigned char* term = b < termCount ? bytes(terms) + tableOffset + b * TERM_SIZE : nullptr;
+        uint32_t gram = term ? get32(term) : UINT32_MAX;
+        if (t < tail.size()) gram = std::min(gram, static_cast<uint32_t>(tail[t] >> 32));
+
+        ids.clear();
+        if (term && get32(term) == gram) {
+            const unsigned char* first = bytes(terms) + TERMS_HEADER + 4 * get64(term + 8);
+            for (uint32_t i = 0; i < get32(term + 4); ++i) ids.push_back(get32(first + 4 * i));
+            ++b;
+        }
+        size_t fromBase = ids.size();
+        for (; t < tail.size() && static_cast<uint32_t>(tail[t] >> 32) == gram; ++t) {
+            ids.push_back(static_cast<uint32_t>(tail[t]));
+        }
+        // A merge interrupted before its state was saved leaves postings in
+        // both; keep each once
+        std::inplace_merge(ids.begin(), ids.begin() + fromBase, ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+        unsigned char entry[TERM_SIZE];
+        put32(entry, gram);
+        put32(entry + 4, static_cast<uint32_t>(ids.size()));
+        put64(entry + 8, written);
+        table.append(reinterpret_cast<const char*>(entry), TERM_SIZE);
+        for (uint32_t id : ids) {
+            unsigned char v[4];
+            put32(v, id);
+            buffer.append(reinterpret_cast<const char*>(v), 4);
+        }
+        written += ids.size();
+        if (buffer.size() >= (1 << 20)) {
+            out.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    out.write(buffer.data(), buffer.size());
+    out.write(table.data(), table.size());
+
+    unsigned char header[TERMS_HEADER];
+    std::memcpy(header, TERMS_MAGIC, 8);
+    put64(header + 8, table.size() / TERM_SIZE);
+    put64(header + 16, TERMS_HEADER + 4 * written);
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(header), TERMS_HEADER);
+    out.close();
+    terms.close();
+
+    std::error_code ec;
+    if (!out) {
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    std::filesystem::rename(tmpPath, file("terms.dat"), ec);
+    if (ec) return false;
+    std::filesystem::resize_file(file("tail.dat"), 0, ec);
+    tailCount = 0;
+    return true;
+}
+
+bool SearchIndex::writeState() const {
+    std::ostringstream state;
+    state << STATE_MAGIC << " " << indexed << " " << indexedHash << " " << recordCount << " "
+          << textBytes << " " << tailCount << "\n";
+    return replaceFile(file("state"), state.str());
+}
+
+bool SearchIndex::writeLive() const {
+    std::string content(8 + 4 * live.size(), '\0');
+    unsigned char* p = reinterpret_cast<unsigned char*>(&content[0]);
+    put32(p, static_cast<uint32_t>(indexed));
+    put32(p + 4, static_cast<uint32_t>(live.size()));
+    for (size_t i = 0; i < live.size(); ++i) put32(p + 8 + 4 * i, live[i]);
+    return replaceFile(file("live.dat"), content);
+}
+
+bool SearchIndex::find(std::string_view pattern, std::vector<Match>& matches) const {
+    TRACE_SCOPE("SearchIndex::find");
+    matches.clear();
+    if (recordCount == 0) return true;
+    MappedFile lines, text;
+    if (!lines.open(file("lines.dat")) || lines.size() < recordCount * RECORD_SIZE ||
+        !text.open(file("text.dat")) || text.size() < textBytes) return false;
+
+    std::vector<uint32_t> grams;
+    trigrams(pattern, grams);
+    std::vector<uint32_t> candidates;
+    if (grams.empty()) {
+        // Too short to have a trigram: every line is a candidate
+        candidates.resize(recordCount);
+        for (uint32_t i = 0; i < candidates.size(); ++i) candidates[i] = i;
+    } else {
+        std::vector<std::vector<uint32_t>> lists(grams.size());
+
+        MappedFile terms;
+        uint64_t termCount = 0, tableOffset = 0;
+        if (terms.open(file("terms.dat")) && termTable(terms, termCount, tableOffset)) {
+            const unsigned char* table = bytes(terms) + tableOffset;
+            for (size_t g = 0; g < grams.size(); ++g) {
+                uint64_t lo = 0, hi = termCount;
+                while (lo < hi) {
+                    uint64_t mid = (lo + hi) / 2;
+                    if (get32(table + mid * TERM_SIZE) < grams[g]) lo = mid + 1;
+                    else hi = mid;
+                }
+                if (lo == termCount || get32(table + lo * TERM_SIZE) != grams[g]) continue;
+                const unsigned char* term = table + lo * TERM_SIZE;
+                const unsigned char* first = bytes(terms) + TERMS_HEADER + 4 * get64(term + 8);
+                lists[g].resize(get32(term + 4));
+                for (size_t i = 0; i < lists[g].size(); ++i) lists[g][i] = get32(first + 4 * i);
+            }
+        }
+
+        MappedFile tail;
+        if (tailCount > 0 && tail.open(file("tail.dat")) && tail.size() >= tailCount * POSTING_SIZE) {
+            for (uint64_t i = 0; i < tailCount; ++i) {
+                const unsigned char* p = bytes(tail) + i * POSTING_SIZE;
+                auto it = std::lower_bound(grams.begin(), grams.end(), get32(p));
+                if (it != grams.end() && *it == get32(p)) lists[it - grams.begin()].push_back(get32(p + 4));
+            }
+        }
+
+        // Intersect, shortest list first
+        for (auto& list : lists) {
+            if (!std::is_sorted(list.begin(), list.end())) std::sort(list.begin(), list.end());
+            list.erase(std::unique(list.begin(), list.end()), list.end());
+        }
+        std::sort(lists.begin(), lists.end(),
+                  [](const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) { return a.size() < b.size(); });
+        candidates = std::move(lists[0]);
+        std::vector<uint32_t> both;
+        for (size_t g = 1; g < lists.size() && !candidates.empty(); ++g) {
+            both.clear();
+            std::set_intersection(candidates.begin(), candidates.end(), lists[g].begin(), lists[g].end(),
+                                  std::back_inserter(both));
+            candidates.swap(both);
+        }
+    }
+
+    // Verify: the trigrams only say a line may contain the pattern
+    for (uint32_t id : candidates) {
+        if (id >= recordCount) continue;
+        const unsigned char* record = bytes(lines) + uint64_t(id) * RECORD_SIZE;
+        uint64_t offset = get64(record);
+        uint32_t length = get32(record + 8);
+        if (offset + length > textBytes) continue;
+        std::string_view line(text.data() + offset, length);
+        if (line.find(pattern) == std::string_view::npos) continue;
+        matches.push_back({get32(record + 12), get32(record + REC_LAST), std::string(line)});
+    }
+    return true;
+}
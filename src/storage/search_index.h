@@ -0,0 +1,90 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Full-text index over every line any version has held (<repo>/search/),
+// behind `search`.
+//
+// Each line a diff adds becomes a record: its text and the versions it
+// lived in, from the one whose diff added it to the one before the diff
+// that removed it. Records are found through an inverted index from byte
+// trigrams to record ids. A query intersects the posting lists of its
+// pattern's trigrams and then checks each candidate's text, so answers are
+// exact. Indexing reads only the diffs: a version appends records and
+// postings for the lines it added and closes the records of those it
+// removed, however long the text is.
+//
+// Files: lines.dat (fixed-size records), text.dat (their lines), live.dat
+// (record ids of the newest indexed version's lines, in order), terms.dat
+// (postings sorted by trigram, rewritten by merges) and tail.dat (postings
+// appended since the last merge). `state` is replaced last on every flush
+// and says how much of each file is valid, so what an interrupted flush
+// left beyond that is ignored and overwritten.
+class SearchIndex {
+public:
+    static const uint32_t OPEN = UINT32_MAX;   // record of a line still in the newest version
+
+    struct Match {
+        uint32_t first;         // first version holding the line
+        uint32_t last;          // last one (OPEN: the newest indexed)
+        std::string text;
+    };
+
+    explicit SearchIndex(const std::string& dir);
+
+    bool exists() const;
+
+    // Start an empty index, replacing whatever is there
+    bool create();
+    void remove();
+
+    // Load the state and the newest version's line ids; false if the index
+    // is missing or its files disagree
+    bool open();
+
+    int version() const;                  // newest version indexed (-1: none)
+    const std::string& versionHash() const;
+
+    // Index version `id`, which must be version() + 1, from its diff in hunk
+    // form (Diff::appendHunks). False, changing nothing, for the older
+    // headerless format. Gathered in memory until flush (or until enough
+    // has gathered that add flushes on its own).
+    bool add(int id, const std::string& hash, std::string_view diffText);
+
+    // Write what add() gathered; postings are merged into terms.dat once
+    // the tail grows past an eighth of it
+    bool flush();
+
+    // Every line containing `pattern` (bytes, case-sensitive), oldest first
+    bool find(std::string_view pattern, std::vector<Match>& matches) const;
+
+private:
+    struct Record {
+        uint64_t offset;        // of its text in text.dat
+        uint32_t length;
+        uint32_t first;
+        uint32_t last;
+    };
+
+    std::string dir;
+    int indexed = -1;
+    std::string indexedHash;
+    uint64_t recordCount = 0;   // valid in lines.dat
+    uint64_t textBytes = 0;     // valid in text.dat
+    uint64_t tailCount = 0;     // valid postings in tail.dat
+    std::vector<uint32_t> live;
+
+    // Gathered by add() since the last flush
+    std::vector<Record> newRecords;
+    std::string newText;
+    std::vector<uint64_t> newPostings;                      // trigram << 32 | record id
+    std::vector<std::pair<uint32_t, uint32_t>> closed;      // flushed record id, last version
+
+    std::string file(const char* name) const;
+    bool writeState() const;
+    bool writeLive() const;
+    bool merge();
+};
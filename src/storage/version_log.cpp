@@ -0,0 +1,442 @@
+#include "version_log.h"
+#include "binary_io.h"
+#include "mapped_file.h"
+#include "../core/sha256.h"
+#include "../core/trace.h"
+#include "../core/utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+
+namespace {
+
+const char HEADER_MAGIC[8] = {'D', 'S', 'A', 'V', 'L', 'O', 'G', '1'};
+const char FOOTER_MAGIC[8] = {'D', 'S', 'A', 'V', 'E', 'N', 'D', '1'};
+const uint32_t FORMAT_VERSION = 1;
+
+// Record layout (all integers little-endian)
+const size_t REC_ID = 0;
+const size_t REC_KEYFRAME = 4;
+const size_t REC_FLAGS = 8;
+const size_t REC_TIMESTAMP = 12;
+const size_t TIMESTAMP_BYTES = 24;
+const size_t REC_HASH = 36;
+const size_t REC_DIFF = 68;
+const size_t REC_SNAPSHOT = 100;
+const size_t REC_CRC = 132;
+
+// The timestamp text is at most 19 bytes ("YYYY-MM-DD HH:MM:SS"); the
+// commit time in seconds follows it in the same field
+const size_t REC_TIME = REC_TIMESTAMP + 20;
+
+const uint32_t HAS_DIFF_OBJECT = 1;
+const uint32_t HAS_SNAPSHOT_OBJECT = 2;
+const uint32_t HAS_TIME = 4;            // REC_TIME is set (records written before it was added lack it)
+const uint32_t HAS_BASE = 8;            // the diff is against an earlier version than the previous one,
+const int BASE_SHIFT = 8;               // (id - base) back, kept in the flags above BASE_SHIFT
+static_assert(VersionLog::MAX_BASE_DISTANCE < (1 << (32 - BASE_SHIFT)), "base distance must fit the flags");
+
+const uint32_t TIMES_ORDERED = 1;       // footer flag: no record's time is before the one ahead of it
+
+using BinaryIO::put32;
+using BinaryIO::put64;
+using BinaryIO::get32;
+using BinaryIO::get64;
+
+// Header: magic, format version, record size, log id, reserved, CRC
+void encodeHeader(unsigned char* p, uint64_t logId) {
+    std::memset(p, 0, VersionLog::HEADER_SIZE);
+    std::memcpy(p, HEADER_MAGIC, 8);
+    put32(p + 8, FORMAT_VERSION);
+    put32(p + 12, static_cast<uint32_t>(VersionLog::RECORD_SIZE));
+    put64(p + 16, logId);
+    put32(p + 28, Utils::crc32(p, 28));
+}
+
+// Footer: magic, record count, log id (ties it to the header), flags, CRC
+void encodeFooter(unsigned char* p, uint64_t count, uint64_t logId, bool timesOrdered) {
+    std::memset(p, 0, VersionLog::FOOTER_SIZE);
+    std::memcpy(p, FOOTER_MAGIC, 8);
+    put64(p + 8, count);
+    put64(p + 16, logId);
+    put32(p + 24, timesOrdered ? TIMES_ORDERED : 0);
+    put32(p + 28, Utils::crc32(p, 28));
+}
+
+bool frameValid(const unsigned char* p, const char* magic) {
+    return std::memcmp(p, magic, 8) == 0 && get32(p + 28) == Utils::crc32(p, 28);
+}
+
+bool encodeRecord(const Version& v, unsigned char* p) {
+    std::memset(p, 0, VersionLog::RECORD_SIZE);
+    Sha256::Digest digest;
+
+    put32(p + REC_ID, static_cast<uint32_t>(v.id));
+    put32(p + REC_KEYFRAME, static_cast<uint32_t>(v.keyframe));
+    std::memcpy(p + REC_TIMESTAMP, v.timestamp.data(), std::min(v.timestamp.size(), TIMESTAMP_BYTES));
+
+    if (!Sha256::fromHex(v.hash, digest)) return false;
+    std::memcpy(p + REC_HASH, digest.data(), digest.size());
+
+    uint32_t flags = 0;
+    if (!v.diffObject.empty()) {
+        if (!Sha256::fromHex(v.diffObject, digest)) return false;
+        std::memcpy(p + REC_DIFF, digest.data(), digest.size());
+        flags |= HAS_DIFF_OBJECT;
+    }
+    if (!v.snapshotObject.empty()) {
+        if (!Sha256::fromHex(v.snapshotObject, digest)) return false;
+        std::memcpy(p + REC_SNAPSHOT, digest.data(), digest.size());
+        flags |= HAS_SNAPSHOT_OBJECT;
+    }
+    if (v.base >= 0) {
+        uint32_t distance = static_cast<uint32_t>(v.id - v.base);
+        if (v.base >= v.id || distance > static_cast<uint32_t>(VersionLog::MAX_BASE_DISTANCE)) return false;
+        flags |= HAS_BASE | distance << BASE_SHIFT;
+    }
+    int64_t seconds = 0;
+    if (v.timestamp.size() < REC_TIME - REC_TIMESTAMP && Utils::parseTimestamp(v.timestamp, seconds) &&
+        seconds >= 0 && seconds <= 0xFFFFFFFFLL) {
+        put32(p + REC_TIME, static_cast<uint32_t>(seconds));
+        flags |= HAS_TIME;
+    }
+    put32(p + REC_FLAGS, flags);
+    put32(p + REC_CRC, Utils::crc32(p, REC_CRC));
+    return true;
+}
+
+// Commit time of a record in seconds (0 if its timestamp does not parse)
+int64_t recordTime(const unsigned char* p) {
+    if (get32(p + REC_FLAGS) & HAS_TIME) return get32(p + REC_TIME);
+    const char* ts = reinterpret_cast<const char*>(p + REC_TIMESTAMP);
+    int64_t seconds = 0;
+    return Utils::parseTimestamp(std::string_view(ts, strnlen(ts, TIMESTAMP_BYTES)), seconds) ? seconds : 0;
+}
+
+bool recordValid(const unsigned char* p, size_t index) {
+    return get32(p + REC_CRC) == Utils::crc32(p, REC_CRC) && get32(p + REC_ID) == index;
+}
+
+Version decodeRecord(const unsigned char* p) {
+    Sha256::Digest digest;
+    Version v;
+    v.id = static_cast<int>(get32(p + REC_ID));
+    v.keyframe = static_cast<int>(get32(p + REC_KEYFRAME));
+
+    const char* ts = reinterpret_cast<const char*>(p + REC_TIMESTAMP);
+    v.timestamp.assign(ts, strnlen(ts, TIMESTAMP_BYTES));
+
+    std::memcpy(digest.data(), p + REC_HASH, digest.size());
+    v.hash = Sha256::toHex(digest);
+
+    uint32_t flags = get32(p + REC_FLAGS);
+    if (flags & HAS_DIFF_OBJECT) {
+        std::memcpy(digest.data(), p + REC_DIFF, digest.size());
+        v.diffObject = Sha256::toHex(digest);
+    }
+    if (flags & HAS_SNAPSHOT_OBJECT) {
+        std::memcpy(digest.data(), p + REC_SNAPSHOT, digest.size());
+        v.snapshotObject = Sha256::toHex(digest);
+    }
+    if (flags & HAS_BASE) v.base = v.id - static_cast<int>(flags >> BASE_SHIFT);
+    return v;
+}
+
+// What a mapped log holds: its identity, how many records are usable,
+// whether the footer confirmed that count (false after an interrupted
+// write), and whether their times never go backwards
+struct LogState {
+    uint64_t logId = 0;
+    size_t count = 0;
+    bool clean = false;
+    bool timesOrdered = false;
+};
+
+bool inspect(const MappedFile& file, LogState& state) {
+    const unsigned char* base = reinterpret_cast<const unsigned char*>(file.data());
+    size_t size = file.size();
+    if (size < VersionLog::HEADER_SIZE || !frameValid(base, HEADER_MAGIC)) return false;
+    if (get32(base + 8) != FORMAT_VERSION || get32(base + 12) != VersionLog::RECORD_SIZE) return false;
+    state.logId = get64(base + 16);
+
+    if (size >= VersionLog::HEADER_SIZE + VersionLog::FOOTER_SIZE) {
+        const unsigned char* footer = base + size - VersionLog::FOOTER_SIZE;
+        uint64_t count = get64(footer + 8);
+        if (frameValid(footer, FOOTER_MAGIC) && get64(footer + 16) == state.logId &&
+            VersionLog::HEADER_SIZE + count * VersionLog::RECORD_SIZE + VersionLog::FOOTER_SIZE == size) {
+            state.count = static_cast<size_t>(count);
+            state.clean = true;
+            state.timesOrdered = (get32(footer + 24) & TIMES_ORDERED) != 0;
+            return true;
+        }
+    }
+
+    // No trustworthy footer: keep every record that still checks out
+    state.count = 0;
+    state.clean = false;
+    state.timesOrdered = true;
+    int64_t last = std::numeric_limits<int64_t>::min();
+    while (VersionLog::HEADER_SIZE + (state.count + 1) * VersionLog::RECORD_SIZE <= size &&
+           recordValid(base + VersionLog::HEADER_SIZE + state.count * VersionLog::RECORD_SIZE, state.count)) {
+        int64_t time = recordTime(base + VersionLog::HEADER_SIZE + state.count * VersionLog::RECORD_SIZE);
+        if (time < last) state.timesOrdered = false;
+        last = time;
+        ++state.count;
+    }
+    return true;
+}
+
+uint64_t newLogId() {
+    std::random_device rd;
+    uint64_t id = (uint64_t(rd()) << 32) ^ rd();
+    id ^= static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    return id ? id : 1;
+}
+
+} // namespace
+
+VersionLog::VersionLog(const std::string& path) : path(path) {
+}
+
+bool VersionLog::exists() const {
+    return Utils::fileExists(path);
+}
+
+bool VersionLog::create() {
+    if (exists()) return true;
+    return rewrite({});
+}
+
+bool VersionLog::load(std::vector<Version>& versions) {
+    TRACE_SCOPE("VersionLog::load");
+    MappedFile file;
+    LogState state;
+    if (!file.open(path) || !inspect(file, state)) return false;
+
+    if (!state.clean) {
+        std::cerr << "Warning: " << path << " ends in an incomplete write; using the first "
+                  << state.count << " versions.\n";
+    }
+
+    // Records never change once written, so only the tail is new, unless
+    // the file is a different log altogether
+    if (state.logId != loadedLogId || versions.size() > state.count) {
+        versions.clear();
+    }
+    versions.reserve(state.count);
+
+    const unsigned char* base = reinterpret_cast<const unsigned char*>(file.data());
+    for (size_t i = versions.size(); i < state.count; ++i) {
+        versions.push_back(decodeRecord(base + HEADER_SIZE + i * RECORD_SIZE));
+    }
+    loadedLogId = state.logId;
+    return true;
+}
+
+size_t VersionLog::count() const {
+    MappedFile file;
+    LogState state;
+    if (!file.open(path) || !inspect(file, state)) return 0;
+    return state.count;
+}
+
+bool VersionLog::read(size_t index, Version& version) const {
+    MappedFile file;
+    LogState state;
+    if (!file.open(path) || !inspect(file, state) || index >= state.count) return false;
+
+    const unsigned char* record = reinterpret_cast<const unsigned char*>(file.data()) +
+                                  HEADER_SIZE + index * RECORD_SIZE;
+    if (!recordValid(record, index)) return false;
+    version = decodeRecord(record);
+    return true;
+}
+
+bool VersionLog::query(const LogQuery& query, std::vector<Version>& matches, size_t& total) const {
+    TRACE_SCOPE("VersionLog::query");
+    matches.clear();
+    total = 0;
+    MappedFile file;
+    LogState state;
+    if (!file.open(path) || !inspect(file, state)) return false;
+    total = state.count;
+
+    const unsigned char* records = reinterpret_cast<const unsigned char*>(file.data()) + HEADER_SIZE;
+    auto timeAt = [&](size_t i) { return recordTime(records + i * RECORD_SIZE); };
+    // First index in [low, high) whose time fails `before`
+    auto search = [&](size_t low, size_t high, auto before) {
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            if (before(timeAt(middle))) low = middle + 1;
+            else high = middle;
+        }
+        return low;
+    };
+
+    size_t first = static_cast<size_t>(std::max(query.first, 0));
+    size_t end = query.last < 0 ? state.count : std::min(state.count, static_cast<size_t>(query.last) + 1);
+    if (first >= end) return true;
+
+    // Times that go backwards somewhere (a clock step, a DST change, a
+    // timestamp that did not parse) rule out the binary search: check each
+    // record's time instead
+    bool window = query.since != std::numeric_limits<int64_t>::min() ||
+                  query.until != std::numeric_limits<int64_t>::max();
+    if (window && !state.timesOrdered) {
+        std::vector<size_t> inWindow;
+        for (size_t i = first; i < end; ++i) {
+            int64_t time = timeAt(i);
+            if (time >= query.since && time <= query.until) inWindow.push_back(i);
+        }
+        size_t skip = query.limit > 0 && inWindow.size() > query.limit ? inWindow.size() - query.limit : 0;
+        matches.reserve(inWindow.size() - skip);
+        for (size_t i = skip; i < inWindow.size(); ++i) {
+            matches.push_back(decodeRecord(records + inWindow[i] * RECORD_SIZE));
+        }
+        return true;
+    }
+    if (query.since != std::numeric_limits<int64_t>::min()) {
+        first = search(first, end, [&](int64_t t) { return t < query.since; });
+    }
+    if (query.until != std::numeric_limits<int64_t>::max()) {
+        end = search(first, end, [&](int64_t t) { return t <= query.until; });
+    }
+    if (query.limit > 0 && end - first > query.limit) first = end - query.limit;
+
+    matches.reserve(end - first);
+    for (size_t i = first; i < end; ++i) matches.push_back(decodeRecord(records + i * RECORD_SIZE));
+    return true;
+}
+
+bool VersionLog::append(const Version& version) {
+    return append(std::vector<Version>{version});
+}
+
+bool VersionLog::append(const std::vector<Version>& batch) {
+    if (batch.empty()) return true;
+    TRACE_SCOPE("VersionLog::append");
+
+    LogState state;
+    size_t fileBytes = 0;
+    int64_t lastTime = std::numeric_limits<int64_t>::min();
+    {
+        MappedFile file;
+        if (!file.open(path) || !inspect(file, state)) {
+            std::cerr << "Error: " << path << " is missing or not a version log.\n";
+            return false;
+        }
+        fileBytes = file.size();
+        if (state.count > 0) {
+            lastTime = recordTime(reinterpret_cast<const unsigned char*>(file.data()) + HEADER_SIZE +
+                                  (state.count - 1) * RECORD_SIZE);
+        }
+    }
+
+    // New records plus a footer that replaces the old one
+    std::string tail(batch.size() * RECORD_SIZE + FOOTER_SIZE, '\0');
+    unsigned char* p = reinterpret_cast<unsigned char*>(&tail[0]);
+    for (size_t i = 0; i < batch.size(); ++i, p += RECORD_SIZE) {
+        const Version& version = batch[i];
+        if (version.id < 0 || static_cast<size_t>(version.id) != state.count + i) {
+            std::cerr << "Error: version " << version.id << " does not follow the "
+                      << state.count + i << " versions in " << path << ".\n";
+            return false;
+        }
+        if (!encodeRecord(version, p)) {
+            std::cerr << "Error: version " << version.id << " has a malformed hash or object id.\n";
+            return false;
+        }
+        int64_t time = recordTime(p);
+        if (time < lastTime) state.timesOrdered = false;
+        lastTime = time;
+    }
+    encodeFooter(p, state.count + batch.size(), state.logId, state.timesOrdered);
+
+    size_t offset = HEADER_SIZE + state.count * RECORD_SIZE;
+    {
+        std::fstream out(path, std::ios::in | std::ios::out | std::ios::binary);
+        if (!out.is_open()) return false;
+        TRACE_COUNT(FilesOpened, 1);
+        out.seekp(static_cast<std::streamoff>(offset));
+        out.write(tail.data(), tail.size());
+        TRACE_COUNT(BytesWritten, tail.size());
+        out.flush();
+        if (!out) return false;
+    }
+
+    // Drop whatever an interrupted append left past the new footer
+    size_t newBytes = offset + tail.size();
+    if (fileBytes > newBytes) {
+        std::error_code ec;
+        std::filesystem::resize_file(path, newBytes, ec);
+        if (ec) return false;
+    }
+    return true;
+}
+
+bool VersionLog::rewrite(const std::vector<Version>& versions) {
+    std::string content(HEADER_SIZE + versions.size() * RECORD_SIZE + FOOTER_SIZE, '\0');
+    unsigned char* p = reinterpret_cast<unsigned char*>(&content[0]);
+
+    uint64_t logId = newLogId();
+    encodeHeader(p, logId);
+    bool timesOrdered = true;
+    int64_t lastTime = std::numeric_limits<int64_t>::min();
+    for (size_t i = 0; i < versions.size(); ++i) {
+        unsigned char* record = p + HEADER_SIZE + i * RECORD_SIZE;
+        if (versions[i].id != (int)i || !encodeRecord(versions[i], record)) {
+            std::cerr << "Error: cannot encode version " << versions[i].id << " for " << path << ".\n";
+            return false;
+        }
+        int64_t time = recordTime(record);
+        if (time < lastTime) timesOrdered = false;
+        lastTime = time;
+    }
+    encodeFooter(p + content.size() - FOOTER_SIZE, versions.size(), logId, timesOrdered);
+
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!out.is_open()) return false;
+        TRACE_COUNT(FilesOpened, 1);
+        out.write(content.data(), content.size());
+        TRACE_COUNT(BytesWritten, content.size());
+        if (!out) return false;
+    }
+    // A rewrite drops records (repack names new objects, recovery cuts off
+    // the unconfirmed tail), so the new log is on disk before it replaces the old
+    std::error_code ec;
+    if (!Utils::syncFile(tmpPath)) {
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    Utils::syncDirectory(std::filesystem::path(path).parent_path().string());
+    return true;
+}
+
+bool VersionLog::encode(const Version& version, std::string& record) {
+    record.assign(RECORD_SIZE, '\0');
+    return encodeRecord(version, reinterpret_cast<unsigned char*>(&record[0]));
+}
+
+bool VersionLog::decode(std::string_view record, Version& version) {
+    if (record.size() != RECORD_SIZE) return false;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(record.data());
+    if (!recordValid(p, get32(p + REC_ID))) return false;
+    version = decodeRecord(p);
+    return true;
+}
+
+const std::string& VersionLog::getPath() const {
+    return path;
+}
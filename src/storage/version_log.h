@@ -0,0 +1,76 @@
+#pragma once
+#include "../core/version.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Append-only binary log of version metadata (<repo>/versions.log).
+//
+// Layout: a 32-byte header, one fixed-size record per version, and a 32-byte
+// footer holding the record count. Every part carries a CRC-32. Committing
+// overwrites the old footer with the new record followed by a new footer, so
+// existing records are never rewritten. Version i lives at
+// header + i * RECORD_SIZE, which makes random access O(1).
+//
+// Each record keeps its commit time twice: as the text `log` prints and as
+// seconds since the epoch, for time-window queries. These find the window
+// by binary search while the footer says no time goes backwards (a clock
+// step or DST change can break that), else by checking every record. A
+// record whose diff repack based on an earlier version than the previous
+// one also names that version (in its flags).
+//
+// If a write is interrupted, the footer no longer matches. Loading then keeps
+// the longest run of valid records, and the next append truncates the rest.
+class VersionLog {
+public:
+    static const size_t HEADER_SIZE = 32;
+    static const size_t RECORD_SIZE = 136;
+    static const size_t FOOTER_SIZE = 32;
+    static const int MAX_BASE_DISTANCE = (1 << 24) - 1;   // how far back a record's delta base may be
+
+    explicit VersionLog(const std::string& path);
+
+    bool exists() const;
+
+    // Write an empty log (no-op if one already exists)
+    bool create();
+
+    // Bring `versions` up to date with the file. Records already loaded from
+    // the same log are kept and only newer ones are decoded; if the log was
+    // replaced (rewrite) since the last load, everything is read again.
+    // Returns false if the file is missing or not a version log.
+    bool load(std::vector<Version>& versions);
+
+    // Number of records in the file, and record i decoded on its own
+    size_t count() const;
+    bool read(size_t index, Version& version) const;
+
+    // The versions matching `query`, oldest first, decoded without touching
+    // the rest of the log: the time window is found by binary search over
+    // the records' commit times (which never decrease along the log), so
+    // the cost depends on how many versions match, not how many exist.
+    // `total` is the number of records. False if the file is not a version log.
+    bool query(const LogQuery& query, std::vector<Version>& matches, size_t& total) const;
+
+    // Append one version; its id must equal the current record count
+    bool append(const Version& version);
+
+    // Append consecutive versions with a single write and one new footer
+    bool append(const std::vector<Version>& batch);
+
+    // Replace the whole log atomically (temporary file, flushed, + rename)
+    bool rewrite(const std::vector<Version>& versions);
+
+    // One record as the log stores it, and back (false: malformed, or the
+    // record's checksum does not match)
+    static bool encode(const Version& version, std::string& record);
+    static bool decode(std::string_view record, Version& version);
+
+    const std::string& getPath() const;
+
+private:
+    std::string path;
+    uint64_t loadedLogId = 0;   // identity of the log `load` last read from
+};
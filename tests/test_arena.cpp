@@ -0,0 +1,170 @@
+// Arena behaviour, and the allocation counts of the hot paths with and
+// without it. Global operator new is replaced here to count heap
+// allocations, so this test is its own executable.
+
+#include "../src/core/arena.h"
+#include "../src/core/diff.h"
+#include "../src/core/patch.h"
+#include "../src/core/utils.h"
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+static size_t heapAllocations = 0;
+
+void* operator new(size_t size) {
+    ++heapAllocations;
+    if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc();
+}
+
+// std::pmr::new_delete_resource() goes through the aligned forms
+void* operator new(size_t size, std::align_val_t alignment) {
+    ++heapAllocations;
+    size_t align = static_cast<size_t>(alignment);
+    if (void* p = std::aligned_alloc(align, (size + align - 1) / align * align)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+// A chain of versions, each a few scattered edits away from the previous
+static std::vector<std::string> makeVersions(size_t count, size_t lines) {
+    std::vector<std::string> versions;
+    std::vector<std::string> current;
+    for (size_t i = 0; i < lines; ++i) current.push_back("line " + std::to_string(i) + " of the document");
+    unsigned seed = 7;
+    auto next = [&]() { seed = seed * 1103515245 + 12345; return (seed >> 16) & 0x7fff; };
+    for (size_t v = 0; v < count; ++v) {
+        for (int e = 0; e < 5; ++e) {
+            size_t at = next() % current.size();
+            if (e % 2 == 0) current[at] = "edited in version " + std::to_string(v);
+            else current.insert(current.begin() + at, "inserted in version " + std::to_string(v));
+        }
+        std::string text;
+        for (const auto& line : current) text += line + "\n";
+        versions.push_back(text);
+    }
+    return versions;
+}
+
+void testArenaBasics() {
+    Arena arena(256);
+    for (size_t alignment : {1, 2, 8, 16, 64}) {
+        void* p = arena.allocate(3, alignment);
+        assert(reinterpret_cast<uintptr_t>(p) % alignment == 0);
+    }
+    // Larger than any block so far
+    char* big = static_cast<char*>(arena.allocate(10000, 8));
+    big[0] = big[9999] = 'x';
+    assert(arena.blocksAllocated() >= 2);
+
+    // After a reset the round fits in one block; further rounds allocate nothing
+    arena.reset();
+    size_t blocks = arena.blocksAllocated();
+    for (int round = 0; round < 10; ++round) {
+        char* small = static_cast<char*>(arena.allocate(3, 1));
+        char* large = static_cast<char*>(arena.allocate(10000, 8));
+        assert(small != large);
+        arena.reset();
+    }
+    assert(arena.blocksAllocated() == blocks);
+
+    std::pmr::vector<int> values(&arena);
+    for (int i = 0; i < 1000; ++i) values.push_back(i);
+    assert(values[999] == 999);
+    std::cout << "testArenaBasics passed.\n";
+}
+
+void testReplayAllocations() {
+    std::vector<std::string> versions = makeVersions(100, 2000);
+    std::vector<std::string> diffs;
+    std::string previous;
+    for (const auto& text : versions) {
+        diffs.push_back(Diff::generateText(previous, text));
+        previous = text;
+    }
+
+    // Before: a fresh text and fresh line indexes per step
+    size_t start = heapAllocations;
+    std::string text;
+    for (const auto& diff : diffs) text = Patch::applyDiff(text, diff);
+    size_t before = heapAllocations - start;
+    assert(text == versions.back());
+
+    // After: one arena reset per step, two buffers swapped
+    start = heapAllocations;
+    Arena scratch;
+    std::string current, next;
+    for (const auto& diff : diffs) {
+        scratch.reset();
+        Patch::applyDiff(current, diff, next, &scratch);
+        current.swap(next);
+    }
+    size_t after = heapAllocations - start;
+    assert(current == versions.back());
+
+    std::cout << "Replaying " << diffs.size() << " versions: " << before << " allocations before, "
+              << after << " with an arena\n";
+    assert(after * 4 < before);
+    std::cout << "testReplayAllocations passed.\n";
+}
+
+void testDiffAllocations() {
+    std::vector<std::string> versions = makeVersions(50, 2000);
+
+    size_t start = heapAllocations;
+    size_t bytesBefore = 0;
+    for (size_t i = 1; i < versions.size(); ++i) {
+        bytesBefore += Diff::generateText(versions[i - 1], versions[i]).size();
+    }
+    size_t before = heapAllocations - start;
+
+    start = heapAllocations;
+    Arena scratch;
+    std::string out;
+    size_t bytesAfter = 0;
+    for (size_t i = 1; i < versions.size(); ++i) {
+        scratch.reset();
+        out.clear();
+        Diff::generateText(versions[i - 1], versions[i], out, &scratch);
+        bytesAfter += out.size();
+        assert(out == Diff::generateText(versions[i - 1], versions[i]));
+    }
+    size_t after = heapAllocations - start;
+    // The check above allocates too; take its share out
+    start = heapAllocations;
+    for (size_t i = 1; i < versions.size(); ++i) Diff::generateText(versions[i - 1], versions[i]);
+    after -= heapAllocations - start;
+    assert(bytesAfter == bytesBefore);
+
+    std::cout << "Diffing " << versions.size() - 1 << " versions: " << before << " allocations before, "
+              << after << " with an arena\n";
+    assert(after * 4 < before);
+    std::cout << "testDiffAllocations passed.\n";
+}
+
+int main() {
+    testArenaBasics();
+    testReplayAllocations();
+    testDiffAllocations();
+    return 0;
+}
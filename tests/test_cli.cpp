@@ -0,0 +1,141 @@
+#include "../src/cli/commands.h"
+#include "../src/cli/output_capture.h"
+#include <cassert>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+void testOutputCapture() {
+    OutputCapture::install();
+    std::string out, err, otherOut, otherErr;
+    std::thread other([&] {
+        OutputCapture::Scope capture(otherOut, otherErr);
+        std::cout << "from the other thread\n";
+    });
+    {
+        OutputCapture::Scope capture(out, err);
+        std::cout << "to out " << 42 << "\n";
+        std::cerr << "to err\n";
+    }
+    other.join();
+    OutputCapture::release();
+
+    assert(out == "to out 42\n");
+    assert(err == "to err\n");
+    assert(otherOut == "from the other thread\n" && otherErr.empty());
+    std::cout << "testOutputCapture passed.\n";
+}
+
+void testAcrossRepos() {
+    const std::string root = "./test_cli_repos";
+    if (fs::exists(root)) fs::remove_all(root);
+    fs::create_directories(root);
+
+    // Repos of very different depth; the list order is kept in the output
+    std::vector<int> depths = {200, 3, 50, 1, 120, 7};
+    std::ostringstream quiet;
+    std::streambuf* saved = std::cout.rdbuf(quiet.rdbuf());
+    for (size_t r = 0; r < depths.size(); ++r) {
+        Repo repo(root + "/user" + std::to_string(r));
+        repo.init();
+        std::string text;
+        for (int i = 0; i < depths[r]; ++i) {
+            text += "entry " + std::to_string(i) + "\n";
+            repo.commit(text);
+        }
+    }
+    std::cout.rdbuf(saved);
+
+    std::vector<std::string> paths = CLI::expandRepoList(root + "/user*," + root + "/missing");
+    assert(paths.size() == depths.size());
+
+    Command verify;
+    verify.name = "verify";
+    std::ostringstream out;
+    saved = std::cout.rdbuf(out.rdbuf());
+    bool ok = CLI::executeAcrossRepos(paths, verify, RepoOptions(), 3);
+    std::cout.rdbuf(saved);
+    assert(ok);
+
+    std::string report = out.str();
+    size_t at = 0;
+    for (size_t r = 0; r < depths.size(); ++r) {
+        size_t header = report.find("==> " + paths[r] + " <==", at);
+        assert(header != std::string::npos);
+        size_t line = report.find("Verified " + std::to_string(depths[r]) + " versions: OK", header);
+        assert(line != std::string::npos);
+        at = line;
+    }
+    assert(report.find("verify: 6 repositories in") != std::string::npos);
+    assert(report.find("repos/s, 3 threads)") != std::string::npos);
+
+    // Commands that change or need a single repository are refused
+    Command commit;
+    commit.name = "commit";
+    std::ostringstream err;
+    saved = std::cerr.rdbuf(err.rdbuf());
+    assert(!CLI::executeAcrossRepos(paths, commit, RepoOptions(), 2));
+    std::cerr.rdbuf(saved);
+
+    fs::remove_all(root);
+    std::cout << "testAcrossRepos passed.\n";
+}
+
+// The options given reach every repository: here the passphrase of
+// encrypted repositories, which verify cannot read without it
+void testAcrossReposOptions() {
+    const std::string root = "./test_cli_options";
+    if (fs::exists(root)) fs::remove_all(root);
+    fs::create_directories(root);
+    unsetenv("DSA_PASSPHRASE");
+
+    std::vector<std::string> paths;
+    std::ostringstream quiet;
+    std::streambuf* saved = std::cout.rdbuf(quiet.rdbuf());
+    for (int r = 0; r < 3; ++r) {
+        paths.push_back(root + "/user" + std::to_string(r));
+        Repo repo(paths.back());
+        repo.init();
+        repo.setPassphrase("secret");
+        assert(repo.enableEncryption(1000));
+        repo.commit("one\n");
+        repo.commit("one\ntwo\n");
+    }
+    std::cout.rdbuf(saved);
+
+    Command verify;
+    verify.name = "verify";
+    std::ostringstream out, err;
+    saved = std::cout.rdbuf(out.rdbuf());
+    std::streambuf* savedErr = std::cerr.rdbuf(err.rdbuf());
+    bool withoutPassphrase = CLI::executeAcrossRepos(paths, verify, RepoOptions(), 2);
+    RepoOptions options;
+    options.passphrase = "secret";
+    out.str("");
+    bool withPassphrase = CLI::executeAcrossRepos(paths, verify, options, 2);
+    std::cout.rdbuf(saved);
+    std::cerr.rdbuf(savedErr);
+
+    assert(!withoutPassphrase);
+    assert(withPassphrase);
+    size_t at = 0;
+    for (size_t r = 0; r < paths.size(); ++r) {
+        at = out.str().find("Verified 2 versions: OK", at);
+        assert(at != std::string::npos);
+        ++at;
+    }
+
+    fs::remove_all(root);
+    std::cout << "testAcrossReposOptions passed.\n";
+}
+
+int main() {
+    testOutputCapture();
+    testAcrossRepos();
+    testAcrossReposOptions();
+    return 0;
+}
@@ -1,17 +1,236 @@
 #include "../src/core/crypto.h"
+#include "../src/core/sha256.h"
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <iostream>
+#include <string>
 
-void testCrypto() {
-    std::string text = "hello world";
-    std::string encrypted = Crypto::encrypt(text, "key");
-    std::string decrypted = Crypto::decrypt(encrypted, "key");
+static std::string fromHex(const std::string& hex) {
+    std::string out;
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) out += static_cast<char>(std::stoi(hex.substr(i, 2), nullptr, 16));
+    return out;
+}
+
+static std::string toHex(const unsigned char* data, size_t length) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    for (size_t i = 0; i < length; ++i) {
+        out += digits[data[i] >> 4];
+        out += digits[data[i] & 15];
+    }
+    return out;
+}
+
+static Crypto::Key keyFromHex(const std::string& hex) {
+    Crypto::Key key;
+    std::string bytes = fromHex(hex);
+    std::memcpy(key.data(), bytes.data(), key.size());
+    return key;
+}
+
+static const std::string SUNSCREEN =
+    "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, "
+    "sunscreen would be it.";
+
+void testChaCha20() {
+    // RFC 8439 2.3.2 (one block) and 2.4.2 (encryption), on every code path
+    Crypto::Key key = keyFromHex("000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f");
+    std::string blockNonce = fromHex("000000090000004a00000000");
+    std::string nonce = fromHex("000000000000004a00000000");
+    for (const char* impl : {"portable", "sse2", "avx2"}) {
+        if (!Crypto::useImplementation(impl)) continue;
+        unsigned char zeros[64] = {0}, out[64];
+        Crypto::chacha20(key, reinterpret_cast<const unsigned char*>(blockNonce.data()), 1, zeros, out, 64);
+        assert(toHex(out, 64) ==
+               "10f1e7e4d13b5915500fdd1fa32071c4c7d1f4c733c068030422aa9ac3d46c4e"
+               "d2826446079faa0914c2d705d98b02a2b5129cd1de164eb9cbd083e8a2503c4e");
+
+        std::string cipher(SUNSCREEN.size(), '\0');
+        Crypto::chacha20(key, reinterpret_cast<const unsigned char*>(nonce.data()), 1,
+                         reinterpret_cast<const unsigned char*>(SUNSCREEN.data()),
+                         reinterpret_cast<unsigned char*>(&cipher[0]), SUNSCREEN.size());
+        assert(toHex(reinterpret_cast<const unsigned char*>(cipher.data()), cipher.size()) ==
+               "6e2e359a2568f98041ba0728dd0d6981e97e7aec1d4360c20a27afccfd9fae0b"
+               "f91b65c5524733ab8f593dabcd62b3571639d624e65152ab8f530c359f0861d8"
+               "07ca0dbf500d6a6156a38e088a22b65e52bc514d16ccf806818ce91ab7793736"
+               "5af90bbf74a35be6b40b8eedf2785e42874d");
+    }
+
+    // The vector paths agree with the portable one at every length and
+    // starting counter (partial groups and a partial last block)
+    std::string data(3000, '\0');
+    for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<char>(i * 7 + 3);
+    for (size_t length : {0, 1, 63, 64, 65, 255, 256, 257, 511, 512, 513, 1000, 3000}) {
+        std::string expected(length, '\0'), actual(length, '\0');
+        const unsigned char* in = reinterpret_cast<const unsigned char*>(data.data());
+        Crypto::useImplementation("portable");
+        Crypto::chacha20(key, reinterpret_cast<const unsigned char*>(nonce.data()), 7, in,
+                         reinterpret_cast<unsigned char*>(&expected[0]), length);
+        for (const char* impl : {"sse2", "avx2"}) {
+            if (!Crypto::useImplementation(impl)) continue;
+            Crypto::chacha20(key, reinterpret_cast<const unsigned char*>(nonce.data()), 7, in,
+                             reinterpret_cast<unsigned char*>(&actual[0]), length);
+            assert(actual == expected);
+        }
+    }
+    for (const char* impl : {"avx2", "sse2", "portable"}) {
+        if (Crypto::useImplementation(impl)) break;
+    }
+    std::cout << "testChaCha20 passed (" << Crypto::implementation() << ").\n";
+}
+
+void testPoly1305() {
+    // RFC 8439 2.5.2, fed whole and in uneven pieces
+    std::string key = fromHex("85d6be7857556d337f4452fe42d506a80103808afb0db2fd4abff6af4149f51b");
+    std::string message = "Cryptographic Forum Research Group";
+    for (size_t piece : {message.size(), size_t(1), size_t(5), size_t(16), size_t(17)}) {
+        Crypto::Poly1305 mac(reinterpret_cast<const unsigned char*>(key.data()));
+        for (size_t at = 0; at < message.size(); at += piece) {
+            size_t n = std::min(piece, message.size() - at);
+            mac.update(reinterpret_cast<const unsigned char*>(message.data()) + at, n);
+        }
+        unsigned char tag[16];
+        mac.finish(tag);
+        assert(toHex(tag, 16) == "a8061dc1305136c6c22b8baf0c0127a9");
+    }
+    std::cout << "testPoly1305 passed.\n";
+}
+
+void testAead() {
+    // RFC 8439 2.8.2
+    Crypto::Key key = keyFromHex("808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f");
+    std::string nonce = fromHex("070000004041424344454647");
+    std::string aad = fromHex("50515253c0c1c2c3c4c5c6c7");
+    const unsigned char* n = reinterpret_cast<const unsigned char*>(nonce.data());
+
+    std::string cipher(SUNSCREEN.size(), '\0');
+    unsigned char tag[16];
+    Crypto::seal(key, n, aad, reinterpret_cast<const unsigned char*>(SUNSCREEN.data()),
+                 reinterpret_cast<unsigned char*>(&cipher[0]), SUNSCREEN.size(), tag);
+    assert(toHex(reinterpret_cast<const unsigned char*>(cipher.data()), cipher.size()) ==
+           "d31a8d34648e60db7b86afbc53ef7ec2a4aded51296e08fea9e2b5a736ee62d6"
+           "3dbea45e8ca9671282fafb69da92728b1a71de0a9e060b2905d6a5b67ecd3b36"
+           "92ddbd7f2d778b8c9803aee328091b58fab324e4fad675945585808b4831d7bc"
+           "3ff4def08e4b7a9de576d26586cec64b6116");
+    assert(toHex(tag, 16) == "1ae10b594f09e26a7e902ecbd0600691");
+
+    std::string plain(cipher.size(), '\0');
+    assert(Crypto::open(key, n, aad, reinterpret_cast<const unsigned char*>(cipher.data()),
+                        reinterpret_cast<unsigned char*>(&plain[0]), cipher.size(), tag));
+    assert(plain == SUNSCREEN);
+
+    cipher[10] ^= 1;
+    assert(!Crypto::open(key, n, aad, reinterpret_cast<const unsigned char*>(cipher.data()),
+                         reinterpret_cast<unsigned char*>(&plain[0]), cipher.size(), tag));
+    std::cout << "testAead passed.\n";
+}
+
+void testPbkdf2() {
+    // RFC 4231 test case 2
+    auto mac = Crypto::hmacSha256("Jefe", "what do ya want for nothing?");
+    assert(toHex(mac.data(), mac.size()) == "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+
+    // PBKDF2-HMAC-SHA256 (RFC 7914 section 11, and the common c = 1/2/4096 set)
+    unsigned char out[64];
+    Crypto::pbkdf2Sha256("passwd", "salt", 1, out, 64);
+    assert(toHex(out, 64) ==
+           "55ac046e56e3089fec1691c22544b605f94185216dde0465e68b9d57c20dacbc"
+           "49ca9cccf179b645991664b39d77ef317c71b845b1e30bd509112041d3a19783");
+    Crypto::pbkdf2Sha256("password", "salt", 1, out, 32);
+    assert(toHex(out, 32) == "120fb6cffcf8b32c43e7225256c4f837a86548c92ccc35480805987cb70be17b");
+    Crypto::pbkdf2Sha256("password", "salt", 2, out, 32);
+    assert(toHex(out, 32) == "ae4d0c95af6b46d32d0adff928f06dd02a303f8ef3c251dfd6e2d85a95474c43");
+    Crypto::pbkdf2Sha256("password", "salt", 4096, out, 32);
+    assert(toHex(out, 32) == "c5e478d59288c841aa530db6845c4c8d962893a001ce4e11a4963873aa98134a");
+    std::cout << "testPbkdf2 passed.\n";
+}
+
+void testStreamFormat() {
+    Crypto::Key key = Crypto::deriveKey("correct horse", "repository salt", 10);
+    Crypto::Key other = Crypto::deriveKey("wrong horse", "repository salt", 10);
+    const size_t C = Crypto::CHUNK_BYTES;
+
+    for (size_t size : {size_t(0), size_t(1), C - 1, C, C + 1, 3 * C, 3 * C + 17}) {
+        std::string text(size, '\0');
+        for (size_t i = 0; i < size; ++i) text[i] = static_cast<char>('a' + i % 26);
+
+        std::string stored = Crypto::encrypt(text, key);
+        assert(Crypto::isEncrypted(stored));
+        assert(Crypto::plaintextSize(stored.size()) == size);
+        std::string back;
+        assert(Crypto::decrypt(stored, key, back) && back == text);
+        assert(!Crypto::decrypt(stored, other, back));
+
+        // Piece by piece, in pieces that do not line up with chunks
+        unsigned char salt[Crypto::SALT_BYTES] = {1, 2, 3};
+        Crypto::Encryptor whole(key, salt), pieces(key, salt);
+        std::string a = whole.header(), b = pieces.header();
+        whole.update(text, a);
+        whole.finish(a);
+        for (size_t at = 0; at < size; at += 10007) pieces.update(std::string_view(text).substr(at, 10007), b);
+        pieces.finish(b);
+        assert(a == b);
+
+        Crypto::Decryptor decryptor(key);
+        std::string streamed;
+        for (size_t at = 0; at < b.size(); at += 4099) {
+            assert(decryptor.update(std::string_view(b).substr(at, 4099), streamed));
+        }
+        assert(decryptor.finish(streamed) && streamed == text);
+
+        // Two encryptions of the same text differ (random per-object salt)
+        assert(Crypto::encrypt(text, key) != stored);
+
+        // A flipped bit, a dropped last chunk or a cut tail is refused
+        std::string damaged = stored;
+        damaged[damaged.size() / 2 + Crypto::HEADER_BYTES / 2] ^= 0x20;
+        assert(!Crypto::decrypt(damaged, key, back));
+        if (size > C) {
+            std::string cut = stored.substr(0, Crypto::HEADER_BYTES + C + Crypto::TAG_BYTES);
+            assert(!Crypto::decrypt(cut, key, back));
+        }
+        assert(!Crypto::decrypt(stored.substr(0, stored.size() - 1), key, back));
+    }
+    std::cout << "testStreamFormat passed.\n";
+}
+
+void testSha256() {
+    // FIPS 180-2 examples, on both the accelerated and the portable path
+    for (bool accelerate : {true, false}) {
+        Sha256::useAcceleration(accelerate);
+        assert(Sha256::hex("") == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+        assert(Sha256::hex("abc") == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+        assert(Sha256::hex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq") ==
+               "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+
+        // one million 'a', fed in uneven pieces
+        std::string chunk(9973, 'a');
+        Sha256::Hasher hasher;
+        size_t remaining = 1000000;
+        while (remaining > 0) {
+            size_t n = remaining < chunk.size() ? remaining : chunk.size();
+            hasher.update(chunk.data(), n);
+            remaining -= n;
+        }
+        assert(Sha256::toHex(hasher.finish()) ==
+               "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+    }
+    Sha256::useAcceleration(true);
+
+    Sha256::Digest d;
+    assert(Sha256::fromHex(Sha256::hex("abc"), d) && d == Sha256::digest("abc"));
+    assert(!Sha256::fromHex("xyz", d));
 
-    assert(decrypted == text);
-    std::cout << "testCrypto passed.\n";
+    std::cout << "testSha256 passed (accelerated: " << (Sha256::accelerated() ? "yes" : "no") << ").\n";
 }
 
 int main() {
-    testCrypto();
+    testChaCha20();
+    testPoly1305();
+    testAead();
+    testPbkdf2();
+    testStreamFormat();
+    testSha256();
     return 0;
 }
\ No newline at end of file
@@ -1,6 +1,14 @@
+#include "../src/core/delta.h"
 #include "../src/core/diff.h"
+#include "../src/core/patch.h"
+#include "../src/core/thread_pool.h"
+#include "../src/core/utils.h"
 #include <cassert>
+#include <cstring>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
 
 void testDiff() {
     std::string oldText = "line1\nline2\nline3";
@@ -9,14 +17,241 @@ void testDiff() {
     auto diff = Diff::generate(oldText, newText);
 
     assert(!diff.empty());
-    assert(diff[0] == "- line2");
-    assert(diff[1] == "+ line2 changed");
-    assert(diff[2] == "+ line4");
+    assert(diff[0] == "@@ -1,3 +1,4 @@");
+    assert(diff[1] == "  line1");
+    assert(diff[2] == "- line2");
+    assert(diff[3] == "+ line2 changed");
+    assert(diff[4] == "  line3");
+    assert(diff[5] == "+ line4");
 
     std::cout << "testDiff passed.\n";
 }
 
+void testInsertNearTop() {
+    // One inserted line must not turn the rest of the file into -/+ pairs
+    std::string oldText;
+    for (int i = 0; i < 1000; ++i) oldText += "line " + std::to_string(i) + "\n";
+    std::string newText = "line 0\ninserted\n" + oldText.substr(oldText.find('\n') + 1);
+
+    auto diff = Diff::generate(oldText, newText);
+    assert(diff.size() == 1 + 1 + 1 + 3); // header, 1 lead, 1 insert, 3 trail
+    assert(diff[0] == "@@ -1,4 +1,5 @@");
+    assert(diff[2] == "+ inserted");
+
+    auto edits = Diff::computeEdits(Utils::splitLines(oldText), Utils::splitLines(newText));
+    assert(edits.size() == 3);
+    assert(edits[1].op == Diff::Op::Insert && edits[1].oldStart == 1 && edits[1].length == 1);
+
+    std::cout << "testInsertNearTop passed.\n";
+}
+
+void testApplyRoundTrip() {
+    std::string oldText = "a\nb\nc\nd\ne\nf\ng\nh\ni\nj\nk\nl\n";
+    std::string newText = "x\na\nc\nd\ne\nf\ng\nH\ni\nj\nk\nl\nm\n";
+
+    std::string diffText = Utils::joinLines(Diff::generate(oldText, newText, 1));
+    assert(Patch::applyDiff(oldText, diffText) == newText);
+    assert(Patch::applyDiff(newText, Utils::joinLines(Diff::generate(newText, oldText))) == oldText);
+    assert(Patch::applyDiff("", Utils::joinLines(Diff::generate("", newText))) == newText);
+    assert(Patch::applyDiff(oldText, Utils::joinLines(Diff::generate(oldText, ""))) == "");
+    assert(Diff::generate(oldText, oldText).empty());
+
+    // Headerless diffs written by older versions still apply
+    assert(Patch::applyDiff("", "+ first\n+ second\n") == "first\nsecond\n");
+
+    std::cout << "testApplyRoundTrip passed.\n";
+}
+
+void testGenerateText() {
+    // The single-string form commit uses must match the per-line form
+    std::string oldText = "keep\nold one\nkeep\nkeep\nkeep\nkeep\nkeep\nkeep\nold two\n";
+    std::string newText = "keep\nnew one\nkeep\nkeep\nkeep\nkeep\nkeep\nkeep\nnew two\nextra";
+    std::string text = Diff::generateText(oldText, newText);
+    assert(text == Utils::joinLines(Diff::generate(oldText, newText)));
+    assert(Patch::applyDiff(oldText, text) == Utils::joinLines(Utils::splitLines(newText)));
+    assert(Diff::generateText(oldText, oldText).empty());
+
+    std::cout << "testGenerateText passed.\n";
+}
+
+void testParallelDiff() {
+    // Large enough to be split into several regions: numbered lines (unique,
+    // so usable as anchors) mixed with repeated ones, edited throughout
+    std::string oldText, newText;
+    for (int i = 0; i < 60000; ++i) {
+        std::string line = (i % 3 == 0) ? "repeated\n" : "line " + std::to_string(i) + "\n";
+        oldText += line;
+        if (i % 997 == 0) continue;                               // deleted
+        if (i % 1301 == 0) newText += "inserted " + std::to_string(i) + "\n";
+        newText += (i % 1709 == 0) ? "changed " + std::to_string(i) + "\n" : line;
+    }
+    std::vector<std::string_view> oldLines = Utils::splitLineViews(oldText);
+    std::vector<std::string_view> newLines = Utils::splitLineViews(newText);
+
+    ThreadPool one(1), three(3), eight(8);
+    std::string diff = Diff::generateTextParallel(oldText, newText, one);
+    assert(Patch::applyDiff(oldText, diff) == newText);
+    assert(Diff::generateTextParallel(oldText, newText, three) == diff);
+    assert(Diff::generateTextParallel(oldText, newText, eight) == diff);
+
+    // The script covers both sides exactly once, in order
+    size_t oldPos = 0, newPos = 0;
+    for (const Diff::Edit& edit : Diff::computeEditsParallel(oldLines, newLines, three)) {
+        assert(edit.oldStart == oldPos && edit.newStart == newPos && edit.length > 0);
+        if (edit.op != Diff::Op::Insert) oldPos += edit.length;
+        if (edit.op != Diff::Op::Delete) newPos += edit.length;
+    }
+    assert(oldPos == oldLines.size() && newPos == newLines.size());
+
+    // Small inputs take the sequential path unchanged
+    std::string smallOld = "a\nb\nc\nd\n", smallNew = "a\nc\nd\ne\n";
+    assert(Diff::generateTextParallel(smallOld, smallNew, three) == Diff::generateText(smallOld, smallNew));
+    assert(Diff::generateTextParallel(oldText, oldText, three).empty());
+
+    std::cout << "testParallelDiff passed.\n";
+}
+
+// Reads `text` in pieces of at most `piece` bytes
+static Diff::ReadFn pieceReader(const std::string& text, size_t& pos, size_t piece) {
+    return [&text, &pos, piece](char* buffer, size_t capacity) {
+        size_t n = std::min({capacity, piece, text.size() - pos});
+        std::memcpy(buffer, text.data() + pos, n);
+        pos += n;
+        return n;
+    };
+}
+
+void testStreamDiff() {
+    std::string oldText, newText;
+    for (int i = 0; i < 3000; ++i) {
+        std::string line = (i % 4 == 0) ? "common\n" : "line " + std::to_string(i) + "\n";
+        oldText += line;
+        if (i % 211 == 0) continue;
+        if (i % 307 == 0) {
+            for (int k = 0; k < 40; ++k) newText += "block " + std::to_string(i) + "." + std::to_string(k) + "\n";
+        }
+        newText += line;
+    }
+    newText += "last line without newline";
+    const std::string expected = Utils::joinLines(Utils::splitLines(newText));
+
+    // One window: the same diff as generateText
+    size_t oldPos = 0, newPos = 0;
+    std::ostringstream whole;
+    Diff::StreamStats stats;
+    assert(Diff::generateStream(pieceReader(oldText, oldPos, 4096), oldText.size(),
+                                pieceReader(newText, newPos, 4096), newText.size(),
+                                whole, 1 << 20, stats));
+    assert(whole.str() == Diff::generateText(oldText, newText));
+    assert(stats.windows == 1 && stats.oldLines == 3000);
+
+    // Small windows: many rounds, hunks split, but the diff still applies
+    for (size_t window : {64, 1000, 8192}) {
+        oldPos = newPos = 0;
+        std::ostringstream out;
+        assert(Diff::generateStream(pieceReader(oldText, oldPos, 97), oldText.size(),
+                                    pieceReader(newText, newPos, 97), newText.size(),
+                                    out, window, stats));
+        assert(stats.windows > 1);
+        assert(Patch::applyDiff(oldText, out.str()) == expected);
+    }
+
+    // Unrelated texts and empty sides
+    std::string other = "x\ny\nz\n";
+    for (const auto& pair : {std::make_pair(oldText, other), std::make_pair(std::string(), oldText),
+                             std::make_pair(oldText, std::string())}) {
+        oldPos = newPos = 0;
+        std::ostringstream out;
+        assert(Diff::generateStream(pieceReader(pair.first, oldPos, 512), pair.first.size(),
+                                    pieceReader(pair.second, newPos, 512), pair.second.size(),
+                                    out, 256, stats));
+        assert(Patch::applyDiff(pair.first, out.str()) == pair.second);
+    }
+
+    std::cout << "testStreamDiff passed.\n";
+}
+
+void testDeltaComposition() {
+    // A random chain of edits; composing its diffs must give the same net
+    // change as diffing the first and last texts
+    std::vector<std::string> lines;
+    for (int i = 0; i < 2000; ++i) lines.push_back("line " + std::to_string(i));
+    auto join = [](const std::vector<std::string>& v) {
+        std::string text;
+        for (const auto& line : v) text += line + "\n";
+        return text;
+    };
+
+    unsigned seed = 12345;
+    auto next = [&seed]() { seed = seed * 1103515245 + 12345; return (seed >> 8) & 0xFFFF; };
+    std::vector<std::string> texts = {join(lines)};
+    std::vector<std::string> diffs;
+    for (int step = 0; step < 40; ++step) {
+        for (int k = 0; k < 5; ++k) {
+            size_t at = next() % (lines.size() + 1);
+            switch (next() % 3) {
+            case 0: lines.insert(lines.begin() + at, "added " + std::to_string(step) + "." + std::to_string(k)); break;
+            case 1: if (at < lines.size()) lines.erase(lines.begin() + at); break;
+            default: if (at < lines.size()) lines[at] += " edited"; break;
+            }
+        }
+        if (step == 20) lines.push_back("line 7");   // a deleted line added back
+        texts.push_back(join(lines));
+        diffs.push_back(Diff::generateText(texts[texts.size() - 2], texts.back()));
+    }
+
+    std::vector<std::string_view> baseLines = Utils::splitLineViews(texts[0]);
+    Delta::Composition composition(baseLines.size());
+    for (size_t i = 0; i < diffs.size(); ++i) {
+        assert(composition.apply(diffs[i]));
+        std::vector<std::string_view> composed = composition.lines(baseLines);
+        assert(Utils::joinLines(composed) == texts[i + 1]);
+        assert(composition.lineCount() == composed.size());
+
+        std::vector<Diff::Edit> edits = Delta::netEdits(composition, baseLines, composed);
+        std::string forward, backward;
+        Diff::appendHunks(forward, edits, baseLines, composed);
+        Diff::appendHunks(backward, Delta::invert(edits), composed, baseLines);
+        assert(Patch::applyDiff(texts[0], forward) == texts[i + 1]);
+        assert(Patch::applyDiff(texts[i + 1], backward) == texts[0]);
+    }
+    // Far fewer pieces than lines: only the edited places are split
+    assert(composition.pieces().size() < 600);
+
+    // The headerless format carries no positions and is refused
+    assert(!composition.apply("+ new line\n- old line\n"));
+    std::cout << "testDeltaComposition passed.\n";
+}
+
+void testSingleLineChange() {
+    // One line replaced between equal context: the smallest case bisect
+    // sees (one old line against one new)
+    std::string oldText = "a\nb\nc\n";
+    std::string newText = "a\nX\nc\n";
+    std::string text = Diff::generateText(oldText, newText);
+    assert(text == "@@ -1,3 +1,3 @@\n  a\n- b\n+ X\n  c\n");
+    assert(Patch::applyDiff(oldText, text) == newText);
+
+    // At either end, and without context
+    assert(Patch::applyDiff("b\nc\n", Diff::generateText("b\nc\n", "X\nc\n")) == "X\nc\n");
+    assert(Patch::applyDiff("a\nb\n", Diff::generateText("a\nb\n", "a\nX\n")) == "a\nX\n");
+    assert(Patch::applyDiff("b\n", Diff::generateText("b\n", "X\n")) == "X\n");
+    for (size_t context : {0, 1, 3}) {
+        std::string hunks = Utils::joinLines(Diff::generate(oldText, newText, context));
+        assert(Patch::applyDiff(oldText, hunks) == newText);
+    }
+
+    std::cout << "testSingleLineChange passed.\n";
+}
+
 int main() {
     testDiff();
+    testInsertNearTop();
+    testApplyRoundTrip();
+    testGenerateText();
+    testSingleLineChange();
+    testParallelDiff();
+    testStreamDiff();
+    testDeltaComposition();
     return 0;
-}
\ No newline at end of file
+}
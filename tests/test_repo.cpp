@@ -1,9 +1,29 @@
 #include "../src/core/repo.h"
+#include "../src/core/patch.h"
 #include "../src/core/utils.h"
+#include "../src/core/diff.h"
+#include "../src/storage/binary_io.h"
+#include "../src/storage/journal.h"
+#include "../src/storage/mapped_file.h"
+#include "../src/storage/metadata.h"
+#include "../src/storage/pack.h"
+#include "../src/storage/search_index.h"
+#include "../src/storage/version_log.h"
+#include <algorithm>
+#include <chrono>
 #include <cassert>
+#include <ctime>
+#include <limits>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <filesystem>
+#include <mutex>
+#include <thread>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 namespace fs = std::filesystem;
 
@@ -33,7 +53,1445 @@ void testRepo() {
     std::cout << "testRepo passed.\n";
 }
 
+void testKeyframes() {
+    std::string repoPath = "./test_repo_keyframes";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+
+    Repo repo(repoPath);
+    KeyframePolicy policy;
+    policy.interval = 3;
+    policy.maxChainBytes = 0;
+    repo.setKeyframePolicy(policy);
+    repo.init();
+
+    std::string text;
+    std::vector<std::string> texts;
+    for (int i = 0; i < 8; ++i) {
+        text += "line " + std::to_string(i) + "\n";
+        repo.commit(text);
+        texts.push_back(text);
+    }
+
+    // Snapshots every 3 versions, none for the others
+    const auto& versions = repo.getVersions();
+    for (const auto& v : versions) {
+        bool keyframe = v.id > 0 && v.id % 3 == 0;
+        assert(v.snapshotObject.empty() != keyframe);
+        assert(v.keyframe == v.id - v.id % 3);
+    }
+    assert(repo.getStore().get(versions[6].snapshotObject) == texts[6]);
+
+    // Reconstruction must not depend on diffs older than the keyframe
+    fs::remove(repo.getStore().pathFor(versions[1].diffObject));
+    repo.getCache().clear();
+    assert(repo.getLatestText() == text);
+
+    fs::remove_all(repoPath);
+    std::cout << "testKeyframes passed.\n";
+}
+
+// --keyframe-bytes counts each diff as the object store holds it
+void testKeyframeBytes() {
+    std::string repoPath = "./test_repo_keyframe_bytes";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+
+    Repo repo(repoPath);
+    KeyframePolicy policy;
+    policy.interval = 0;
+    policy.maxChainBytes = 400;
+    repo.setKeyframePolicy(policy);
+    std::ostringstream quiet;
+    std::streambuf* saved = std::cout.rdbuf(quiet.rdbuf());
+    repo.init();
+    std::string text;
+    for (int i = 0; i < 40; ++i) {
+        for (int j = 0; j < 4; ++j) text += "record " + std::to_string(i) + " field " + std::to_string(j) + " of the same row\n";
+        repo.commit(text);
+    }
+    std::cout.rdbuf(saved);
+
+    // A keyframe starts wherever the chain would have passed the limit
+    const auto& versions = repo.getVersions();
+    size_t chainBytes = 0, keyframes = 0;
+    for (size_t i = 1; i < versions.size(); ++i) {
+        size_t stored = repo.getStore().size(versions[i].diffObject);
+        bool keyframe = !versions[i].snapshotObject.empty();
+        assert(keyframe == (chainBytes + stored > policy.maxChainBytes));
+        chainBytes = keyframe ? 0 : chainBytes + stored;
+        keyframes += keyframe;
+    }
+    assert(keyframes > 0);
+
+    fs::remove_all(repoPath);
+    std::cout << "testKeyframeBytes passed.\n";
+}
+
+void testReconstructionCache() {
+    std::string repoPath = "./test_repo_cache";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+
+    std::vector<std::string> texts;
+    {
+        Repo writer(repoPath);
+        writer.setKeyframePolicy(KeyframePolicy{0, 0});
+        writer.init();
+        std::string text;
+        for (int i = 0; i < 10; ++i) {
+            text += "entry " + std::to_string(i) + "\n";
+            writer.commit(text);
+            texts.push_back(text);
+        }
+    }
+
+    Repo repo(repoPath);
+    repo.log();   // loads versions into a fresh cache
+    const auto& versions = repo.getVersions();
+
+    for (int i = 0; i <= 5; ++i) {
+        assert(Patch::reconstructVersion(repo, versions[i]) == texts[i]);
+    }
+    // Walking forward only needs the next diff once the previous version is cached
+    for (int i = 0; i <= 5; ++i) fs::remove(repo.getStore().pathFor(versions[i].diffObject));
+    assert(Patch::reconstructVersion(repo, versions[6]) == texts[6]);
+    assert(Patch::reconstructVersion(repo, versions[3]) == texts[3]);
+
+    VersionCache::Stats stats = repo.getCache().stats();
+    assert(stats.misses == 7);
+    assert(stats.hits == 1);
+    assert(stats.evictions == 0);
+
+    // A tiny capacity keeps only the most recent entries
+    repo.getCache().setCapacity(texts[9].size() + texts[8].size());
+    assert(Patch::reconstructVersion(repo, versions[9]) == texts[9]);
+    stats = repo.getCache().stats();
+    assert(stats.evictions > 0);
+    assert(stats.bytes <= texts[9].size() + texts[8].size());
+
+    fs::remove_all(repoPath);
+    std::cout << "testReconstructionCache passed.\n";
+}
+
+void testObjectDedup() {
+    std::string repoPath = "./test_repo_objects";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+
+    Repo repo(repoPath);
+    repo.setKeyframePolicy(KeyframePolicy{1, 0});
+    repo.init();
+
+    auto countObjects = [&]() {
+        size_t n = 0;
+        for (const auto& entry : fs::recursive_directory_iterator(repoPath + "/objects")) {
+            if (entry.is_regular_file()) ++n;
+        }
+        return n;
+    };
+
+    repo.commit("alpha\n");
+    repo.commit("beta\n");
+    repo.commit("gamma\n");
+    size_t before = countObjects();
+
+    // Re-committing older content reuses its snapshot object
+    repo.commit("beta\n");
+    const auto& versions = repo.getVersions();
+    assert(versions.size() == 4);
+    assert(versions[3].hash == versions[1].hash);
+    assert(versions[3].snapshotObject == versions[1].snapshotObject);
+    assert(countObjects() == before + 1);   // only the new diff
+
+    // Committing the same content again writes nothing at all
+    repo.commit("beta\n");
+    assert(repo.getVersions().size() == 4);
+    assert(countObjects() == before + 1);
+
+    // Objects are keyed by the SHA-256 of their content
+    const ObjectStore& store = repo.getStore();
+    assert(versions[1].snapshotObject == Utils::hashString("beta\n"));
+    assert(store.has(versions[1].snapshotObject));
+    assert(store.get(versions[1].snapshotObject) == "beta\n");
+    assert(!store.has(Utils::hashString("never stored")));
+
+    fs::remove_all(repoPath);
+    std::cout << "testObjectDedup passed.\n";
+}
+
+void testMappedFile() {
+    std::string dir = "./test_repo_mapped";
+    if (fs::exists(dir)) fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    std::string big;
+    for (int i = 0; i < 20000; ++i) big += "mapped line " + std::to_string(i) + "\n";
+    std::ofstream(dir + "/big.txt") << big;
+    std::ofstream(dir + "/empty.txt");
+
+    MappedFile file(dir + "/big.txt");
+    assert(file.isOpen());
+    assert(file.view() == big);
+
+    // Moving hands the mapping over without copying
+    MappedFile moved(std::move(file));
+    assert(!file.isOpen());
+    assert(moved.view() == big);
+
+    MappedFile empty(dir + "/empty.txt");
+    assert(empty.isOpen() && empty.size() == 0);
+
+    MappedFile missing;
+    assert(!missing.open(dir + "/missing.txt"));
+
+#ifndef _WIN32
+    // A pipe cannot be mapped and goes through the buffered path
+    int fds[2];
+    assert(pipe(fds) == 0);
+    std::string piped = "from\na pipe\n";
+    assert(write(fds[1], piped.data(), piped.size()) == (ssize_t)piped.size());
+    close(fds[1]);
+    MappedFile pipeFile("/dev/fd/" + std::to_string(fds[0]));
+    assert(pipeFile.isOpen() && !pipeFile.isMapped());
+    assert(pipeFile.view() == piped);
+    close(fds[0]);
+#endif
+
+    // Commit straight from a mapping and read it back through the object store
+    Repo repo(dir + "/repo");
+    repo.init();
+    repo.commit(moved.view());
+    assert(repo.getLatestText() == big);
+
+    fs::remove_all(dir);
+    std::cout << "testMappedFile passed.\n";
+}
+
+void testVersionLog() {
+    std::string repoPath = "./test_repo_log";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+
+    Repo repo(repoPath);
+    repo.init();
+    for (int i = 0; i < 5; ++i) {
+        repo.commit("line " + std::to_string(i) + "\n");
+    }
+
+    // One fixed-size record per version between header and footer
+    std::string logPath = repoPath + "/versions.log";
+    assert(!fs::exists(repoPath + "/versions.txt"));
+    assert(Utils::fileSize(logPath) ==
+           VersionLog::HEADER_SIZE + 5 * VersionLog::RECORD_SIZE + VersionLog::FOOTER_SIZE);
+
+    VersionLog log(logPath);
+    assert(log.count() == 5);
+    Version third;
+    assert(log.read(3, third));
+    const Version& expected = repo.getVersions()[3];
+    assert(third.id == 3 && third.hash == expected.hash && third.timestamp == expected.timestamp);
+    assert(third.diffObject == expected.diffObject && third.keyframe == expected.keyframe);
+    assert(!log.read(5, third));
+
+    // A torn append leaves junk after the footer; the records survive and
+    // the next commit cuts the junk off
+    std::ofstream(logPath, std::ios::app | std::ios::binary) << "partial record";
+    Repo reopened(repoPath);
+    reopened.commit("line 5\n");
+    assert(reopened.getVersions().size() == 6);
+    assert(log.count() == 6);
+    assert(Utils::fileSize(logPath) ==
+           VersionLog::HEADER_SIZE + 6 * VersionLog::RECORD_SIZE + VersionLog::FOOTER_SIZE);
+    assert(reopened.getLatestText() == "line 5\n");
+
+    fs::remove_all(repoPath);
+    std::cout << "testVersionLog passed.\n";
+}
+
+void testVersionsTxtMigration() {
+    std::string repoPath = "./test_repo_migrate";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+    fs::create_directories(repoPath);
+
+    // A repository from before the object store: loose diff files and the
+    // old placeholder hashes in versions.txt
+    std::vector<std::string> texts = {"a\nb\n", "a\nB\n", "a\nB\nc\n"};
+    std::vector<Version> legacy;
+    std::string previous;
+    for (int i = 0; i < 3; ++i) {
+        Version v;
+        v.id = i;
+        v.timestamp = "2024-01-0" + std::to_string(i + 1) + " 12:00:00";
+        v.diffPath = repoPath + "/diff_" + std::to_string(i) + ".txt";
+        v.hash = std::to_string(123456 + i);
+        Utils::writeFile(v.diffPath, Utils::joinLines(Diff::generate(previous, texts[i])));
+        previous = texts[i];
+        legacy.push_back(v);
+    }
+    Metadata::saveMetadata(repoPath + "/versions.txt", legacy);
+
+    Repo repo(repoPath);
+    assert(repo.getLatestText() == texts[2]);
+    assert(fs::exists(repoPath + "/versions.log"));
+    assert(!fs::exists(repoPath + "/versions.txt"));
+    assert(fs::exists(repoPath + "/versions.txt.migrated"));
+
+    const auto& versions = repo.getVersions();
+    assert(versions.size() == 3);
+    for (int i = 0; i < 3; ++i) {
+        assert(versions[i].hash == Utils::hashString(texts[i]));
+        assert(versions[i].diffPath.empty() && repo.getStore().has(versions[i].diffObject));
+        assert(versions[i].timestamp == legacy[i].timestamp);
+    }
+
+    // Migration runs once; afterwards commits append to the log
+    Repo again(repoPath);
+    again.commit(texts[0]);
+    assert(again.getVersions().size() == 4);
+
+    fs::remove_all(repoPath);
+    std::cout << "testVersionsTxtMigration passed.\n";
+}
+
+void testRepack() {
+    std::string repoPath = "./test_repo_pack";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+
+    Repo repo(repoPath);
+    KeyframePolicy policy;
+    policy.interval = 4;
+    repo.setKeyframePolicy(policy);
+    repo.init();
+
+    std::vector<std::string> texts;
+    std::string text;
+    for (int i = 0; i < 12; ++i) {
+        text += "entry " + std::to_string(i) + "\n";
+        texts.push_back(text);
+        repo.commit(text);
+    }
+
+    auto looseFiles = [&]() {
+        size_t count = 0;
+        for (const auto& entry : fs::recursive_directory_iterator(repoPath + "/objects")) {
+            if (entry.is_regular_file() && entry.path().filename() != "pack") ++count;
+        }
+        return count;
+    };
+    assert(looseFiles() > 0);
+
+    repo.repack();
+    assert(looseFiles() == 0);
+    assert(fs::exists(repoPath + "/objects/pack"));
+
+    // Every version comes back out of the pack, through the version index
+    Pack pack(repoPath + "/objects/pack");
+    assert(pack.open());
+    assert(pack.versionCount() == 12);
+    Repo reopened(repoPath);
+    reopened.getLatestText();
+    const auto& versions = reopened.getVersions();
+    for (int i = 0; i < 12; ++i) {
+        std::string_view stored;
+        assert(pack.find(versions[i].diffObject, stored, i));
+        reopened.getCache().clear();
+        assert(Patch::reconstructVersion(reopened, versions[i]) == texts[i]);
+    }
+
+    // New commits go to loose files until the next repack folds them in
+    text += "after repack\n";
+    repo.commit(text);
+    assert(looseFiles() > 0);
+    assert(repo.getLatestText() == text);
+    repo.repack();
+    assert(looseFiles() == 0);
+    repo.getCache().clear();
+    assert(repo.getLatestText() == text);
+    assert(pack.open() && pack.versionCount() == 13);
+
+    fs::remove_all(repoPath);
+    std::cout << "testRepack passed.\n";
+}
+
+void testCompressedObjects() {
+    std::string repoPath = "./test_repo_compress";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+
+    Repo repo(repoPath);
+    repo.init();
+    const ObjectStore& store = repo.getStore();
+
+    std::string text;
+    for (int i = 0; i < 400; ++i) text += "log entry " + std::to_string(i % 20) + ": all systems nominal\n";
+    repo.commit(text);
+    const Version& first = repo.getVersions()[0];
+    assert(store.codecOf(first.diffObject) == ObjectStore::Codec::LZ);
+    assert(store.size(first.diffObject) < text.size() / 4);
+    assert(store.get(first.diffObject) == repo.readDiff(first));
+
+    // An object from before compression has no header and still reads back
+    std::string legacyText = "plain object\n";
+    std::string legacyId = Utils::hashString(legacyText);
+    fs::create_directories(repoPath + "/objects/" + legacyId.substr(0, 2));
+    std::ofstream(store.pathFor(legacyId)) << legacyText;
+    assert(store.codecOf(legacyId) == ObjectStore::Codec::Raw);
+    assert(store.get(legacyId) == legacyText);
+
+    // Many small edits; repack trains a dictionary and re-encodes with it
+    std::vector<std::string> texts = {text};
+    for (int i = 0; i < 30; ++i) {
+        text += "status " + std::to_string(i) + ": checked the backup job, all systems nominal\n";
+        texts.push_back(text);
+        repo.commit(text);
+    }
+    repo.repack();
+    assert(store.hasDictionary());
+    assert(store.get(legacyId) == legacyText);
+
+    Repo reopened(repoPath);
+    reopened.getLatestText();
+    const auto& versions = reopened.getVersions();
+    size_t dictionaryCoded = 0;
+    for (size_t i = 0; i < versions.size(); ++i) {
+        if (reopened.getStore().codecOf(versions[i].diffObject) == ObjectStore::Codec::LZDictionary) {
+            ++dictionaryCoded;
+        }
+        reopened.getCache().clear();
+        assert(Patch::reconstructVersion(reopened, versions[i]) == texts[i]);
+    }
+    assert(dictionaryCoded > 0);
+
+    fs::remove_all(repoPath);
+    std::cout << "testCompressedObjects passed.\n";
+}
+
+void testHeadSnapshot() {
+    std::string repoPath = "./test_repo_head";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+
+    std::string text;
+    for (int i = 0; i < 2000; ++i) text += "paragraph " + std::to_string(i) + " of a long document\n";
+    {
+        Repo repo(repoPath);
+        repo.init();
+        repo.commit(text);
+    }
+    assert(fs::exists(repoPath + "/HEAD"));
+
+    // A fresh Repo (a new CLI run) diffs against HEAD: the stored delta is
+    // a small hunk, not the whole file
+    std::string edited = text + "one more line\n";
+    {
+        Repo repo(repoPath);
+        repo.setCompression(false);
+        repo.commit(edited);
+        const Version& v = repo.getVersions().back();
+        assert(repo.readDiff(v).size() < 200);
+        repo.getCache().clear();
+        assert(Patch::reconstructVersion(repo, v) == edited);
+    }
+
+    // A HEAD that no longer matches its hash is ignored and rebuilt
+    {
+        std::ofstream head(repoPath + "/HEAD", std::ios::app | std::ios::binary);
+        head << "tampered";
+    }
+    std::string third = "first line\n" + edited;
+    {
+        Repo repo(repoPath);
+        repo.commit(third);
+        const Version& v = repo.getVersions().back();
+        assert(repo.readDiff(v).size() < 200);
+        repo.getCache().clear();
+        assert(Patch::reconstructVersion(repo, v) == third);
+    }
+    {
+        Repo repo(repoPath);
+        assert(repo.getLatestText() == third);
+    }
+
+    fs::remove_all(repoPath);
+    std::cout << "testHeadSnapshot passed.\n";
+}
+
+void testCommitBatch() {
+    std::string repoPath = "./test_repo_batch";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+
+    std::vector<std::string> revisions;
+    std::vector<std::string> expected = {"before the batch\n"};
+    std::string text;
+    for (int i = 0; i < 150; ++i) {
+        text += "entry " + std::to_string(i) + "\n";
+        revisions.push_back(text);
+        expected.push_back(text);
+        if (i == 40) revisions.push_back(text);   // unchanged revision is skipped
+    }
+
+    {
+        Repo repo(repoPath);
+        repo.init();
+        repo.commit("before the batch\n");
+        size_t next = 0;
+        size_t committed = repo.commitBatch([&](std::string& out) {
+            if (next == revisions.size()) return false;
+            out = revisions[next++];
+            return true;
+        });
+        assert(committed == 150);
+        assert(repo.getVersions().size() == 151);
+    }
+
+    // Everything reached disk: a fresh Repo sees the whole history
+    Repo reopened(repoPath);
+    assert(reopened.getLatestText() == revisions.back());
+    const auto& versions = reopened.getVersions();
+    assert(versions.size() == 151);
+    for (size_t i = 0; i < versions.size(); i += 10) {
+        reopened.getCache().clear();
+        assert(Patch::reconstructVersion(reopened, versions[i]) == expected[i]);
+    }
+
+    // An empty batch changes nothing
+    assert(reopened.commitBatch([](std::string&) { return false; }) == 0);
+    assert(Repo(repoPath).getLatestText() == revisions.back());
+
+    fs::remove_all(repoPath);
+    std::cout << "testCommitBatch passed.\n";
+}
+
+void testVerifyAndStats() {
+    std::string repoPath = "./test_repo_verify";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+
+    std::string text;
+    {
+        Repo repo(repoPath);
+        KeyframePolicy policy;
+        policy.interval = 8;
+        repo.setKeyframePolicy(policy);
+        repo.init();
+        for (int i = 0; i < 30; ++i) {
+            text += "row " + std::to_string(i) + "\n";
+            repo.commit(text);
+        }
+    }
+
+    std::ostringstream captured;
+    std::streambuf* saved = std::cout.rdbuf(captured.rdbuf());
+    bool ok = Repo(repoPath).verify();
+    Repo(repoPath).stats();
+    std::cout.rdbuf(saved);
+    assert(ok);
+    assert(captured.str().find("Verified 30 versions: OK") != std::string::npos);
+    assert(captured.str().find("Versions: 30 (3 snapshots, longest delta chain 8)") != std::string::npos);
+
+    // Damage one diff object: verify names the version and fails
+    Repo repo(repoPath);
+    repo.getLatestText();
+    const Version& damaged = repo.getVersions()[13];
+    std::string objectPath = repo.getStore().pathFor(damaged.diffObject);
+    std::ofstream(objectPath, std::ios::binary | std::ios::trunc) << "not an object";
+
+    captured.str("");
+    saved = std::cout.rdbuf(captured.rdbuf());
+    std::streambuf* savedErr = std::cerr.rdbuf(captured.rdbuf());
+    ok = Repo(repoPath).verify();
+    std::cout.rdbuf(saved);
+    std::cerr.rdbuf(savedErr);
+    assert(!ok);
+    assert(captured.str().find("version 13: diff object") != std::string::npos);
+    // Version 16's snapshot is intact, so the damage is not reported past it
+    assert(captured.str().find("version 17") == std::string::npos);
+
+    fs::remove_all(repoPath);
+    std::cout << "testVerifyAndStats passed.\n";
+}
+
+void testStreamingCommit() {
+    std::string repoPath = "./test_repo_stream";
+    std::string inputPath = "./test_repo_stream_input.txt";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+
+    // About 3 MB, so a 1 MB window (the smallest) takes several rounds
+    std::string text;
+    for (int i = 0; i < 60000; ++i) text += "record " + std::to_string(i) + " with some payload text\n";
+    std::string edited;
+    for (size_t start = 0, i = 0; start < text.size(); ++i) {
+        size_t end = text.find('\n', start) + 1;
+        if (i % 5000 != 7) edited.append(text, start, end - start);
+        if (i % 7000 == 3) edited += "inserted line " + std::to_string(i) + "\n";
+        start = end;
+    }
+
+    std::ostringstream captured;
+    std::streambuf* saved = std::cout.rdbuf(captured.rdbuf());
+    {
+        Repo repo(repoPath);
+        repo.init();
+        repo.setMemoryBudget(4 * 1024 * 1024);
+        assert(repo.exceedsMemoryBudget(text.size()));
+        assert(!repo.exceedsMemoryBudget(1000));
+
+        std::ofstream(inputPath, std::ios::binary) << text;
+        repo.commitStreaming(inputPath);
+        std::ofstream(inputPath, std::ios::binary) << edited;
+        repo.commitStreaming(inputPath);
+        repo.commitStreaming(inputPath);   // unchanged: nothing committed
+        assert(repo.getVersions().size() == 2);
+        assert(repo.getStore().codecOf(repo.getVersions()[0].diffObject) == ObjectStore::Codec::LZBlocks);
+    }
+    std::cout.rdbuf(saved);
+    assert(captured.str().find("windows of 1 MB") != std::string::npos);
+    assert(captured.str().find("nothing committed") != std::string::npos);
+
+    // The history replays to the same texts, and HEAD serves the next
+    // in-memory commit
+    {
+        Repo repo(repoPath);
+        assert(repo.getLatestText() == edited);
+        const auto& versions = repo.getVersions();
+        assert(Patch::reconstructVersion(repo, versions[0]) == text);
+        repo.getCache().clear();
+        assert(Patch::reconstructVersion(repo, versions[1]) == edited);
+        assert(repo.readDiff(versions[1]).size() < 10000);
+
+        saved = std::cout.rdbuf(captured.rdbuf());
+        repo.commit(edited + "tail\n");
+        assert(repo.verify());
+        std::cout.rdbuf(saved);
+        assert(repo.readDiff(repo.getVersions().back()).size() < 200);
+    }
+
+    fs::remove_all(repoPath);
+    fs::remove(inputPath);
+    std::cout << "testStreamingCommit passed.\n";
+}
+
+// True if `needle` appears in any file under `dir`
+static bool anyFileContains(const std::string& dir, const std::string& needle) {
+    for (const auto& entry : fs::recursive_directory_iterator(dir)) {
+        if (entry.is_regular_file() && Utils::readFile(entry.path().string()).find(needle) != std::string::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void testEncryptedRepo() {
+    std::string repoPath = "./test_repo_encrypted";
+    std::string inputPath = "./test_repo_encrypted_input.txt";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+
+    std::string first, second, third;
+    for (int i = 0; i < 30000; ++i) first += "confidential line " + std::to_string(i) + "\n";
+    second = first + "confidential addendum\n";
+    third = "confidential preface\n" + second;
+
+    std::ostringstream captured;
+    std::streambuf* savedOut = std::cout.rdbuf(captured.rdbuf());
+    std::streambuf* savedErr = std::cerr.rdbuf(captured.rdbuf());
+    {
+        // A plain version first, then encryption switched on
+        Repo repo(repoPath);
+        repo.init();
+        repo.setCompression(false);    // plain objects would show their text
+        repo.commit(first);
+        assert(!repo.isEncrypted());
+        assert(!repo.enableEncryption(1000));   // no passphrase
+        repo.setPassphrase("open sesame");
+        assert(repo.enableEncryption(1000));
+        assert(repo.isEncrypted() && !repo.enableEncryption(1000));
+        assert(Utils::readFile(repoPath + "/HEAD").find("confidential") == std::string::npos);
+
+        repo.commit(second);
+        repo.setMemoryBudget(1024 * 1024);
+        std::ofstream(inputPath, std::ios::binary) << third;
+        repo.commitStreaming(inputPath);
+        assert(repo.getVersions().size() == 3);
+        assert(repo.verify());
+
+        // Only version 0's objects, from before, are still readable on disk;
+        // repack encrypts them too
+        repo.repack();
+        assert(!anyFileContains(repoPath, "confidential"));
+    }
+
+    {
+        Repo locked(repoPath);
+        assert(locked.getLatestText().empty());
+        Repo wrong(repoPath);
+        wrong.setPassphrase("open barley");
+        assert(wrong.getLatestText().empty() && wrong.getVersions().empty());
+    }
+    std::cout.rdbuf(savedOut);
+    std::cerr.rdbuf(savedErr);
+    assert(captured.str().find("wrong passphrase") != std::string::npos);
+
+    {
+        Repo repo(repoPath);
+        repo.setPassphrase("open sesame");
+        assert(repo.getLatestText() == third);
+        const auto& versions = repo.getVersions();
+        assert(Patch::reconstructVersion(repo, versions[0]) == first);
+        repo.getCache().clear();
+        assert(Patch::reconstructVersion(repo, versions[1]) == second);
+        savedOut = std::cout.rdbuf(captured.rdbuf());
+        assert(repo.verify());
+        std::cout.rdbuf(savedOut);
+    }
+
+    fs::remove_all(repoPath);
+    fs::remove(inputPath);
+    std::cout << "testEncryptedRepo passed.\n";
+}
+
+void testLogQueries() {
+    std::string repoPath = "./test_repo_logquery";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+    fs::create_directories(repoPath);
+
+    // 1000 versions an hour apart, written straight into the version log
+    int64_t start = 0;
+    assert(Utils::parseTimestamp("2024-03-01 00:00:00", start));
+    assert(Utils::parseTimestamp("2024-03-01", start) && !Utils::parseTimestamp("March", start));
+    std::vector<Version> versions;
+    for (int i = 0; i < 1000; ++i) {
+        Version v;
+        v.id = i;
+        std::time_t t = static_cast<std::time_t>(start + i * 3600);
+        char text[32];
+        std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", std::localtime(&t));
+        v.timestamp = text;
+        v.hash = Utils::hashString(std::to_string(i));
+        v.diffObject = v.hash;
+        v.keyframe = 0;
+        versions.push_back(v);
+    }
+    VersionLog log(repoPath + "/versions.log");
+    assert(log.rewrite(versions));
+
+    auto ids = [&](const LogQuery& query) {
+        std::vector<Version> matches;
+        size_t total = 0;
+        assert(log.query(query, matches, total) && total == 1000);
+        std::vector<int> result;
+        for (const auto& v : matches) result.push_back(v.id);
+        return result;
+    };
+
+    LogQuery latest;
+    latest.limit = 20;
+    std::vector<int> got = ids(latest);
+    assert(got.size() == 20 && got.front() == 980 && got.back() == 999);
+
+    LogQuery range;
+    range.first = 10;
+    range.last = 14;
+    assert((ids(range) == std::vector<int>{10, 11, 12, 13, 14}));
+    range.last = 5000;
+    assert(ids(range).size() == 990);
+
+    // Both ends of a time window are inclusive
+    LogQuery window;
+    window.since = start + 100 * 3600;
+    window.until = start + 102 * 3600;
+    assert((ids(window) == std::vector<int>{100, 101, 102}));
+    window.since += 1;
+    assert((ids(window) == std::vector<int>{101, 102}));
+    window.limit = 1;
+    assert((ids(window) == std::vector<int>{102}));
+    window.since = start + 5000 * 3600;
+    window.until = std::numeric_limits<int64_t>::max();
+    assert(ids(window).empty());
+
+    // After the clock went back two hours (version 500 is stamped before
+    // 499) and a timestamp that does not parse, windows still find every
+    // match
+    std::vector<Version> stepped = versions;
+    for (int i = 500; i < 1000; ++i) {
+        std::time_t t = static_cast<std::time_t>(start + (i - 2) * 3600);
+        char text[32];
+        std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", std::localtime(&t));
+        stepped[i].timestamp = text;
+    }
+    stepped[800].timestamp = "unknown";
+    assert(log.rewrite(stepped));
+    window = LogQuery();
+    window.since = start + 497 * 3600;
+    window.until = start + 498 * 3600;
+    assert((ids(window) == std::vector<int>{497, 498, 500}));
+    window.limit = 2;
+    assert((ids(window) == std::vector<int>{498, 500}));
+    window = LogQuery();
+    window.since = start + 900 * 3600;
+    assert(ids(window).size() == 98);
+
+    // Appending a time before the last one turns the scan on as well
+    assert(log.rewrite(versions));
+    Version late = versions.back();
+    late.id = 1000;
+    late.timestamp = versions[10].timestamp;
+    assert(log.append(late));
+    window = LogQuery();
+    window.since = start + 10 * 3600;
+    window.until = start + 10 * 3600;
+    std::vector<Version> matches;
+    size_t total = 0;
+    assert(log.query(window, matches, total) && total == 1001);
+    assert(matches.size() == 2 && matches[0].id == 10 && matches[1].id == 1000);
+    assert(log.rewrite(versions));
+
+    // Through Repo::log
+    std::ostringstream captured;
+    std::streambuf* saved = std::cout.rdbuf(captured.rdbuf());
+    Repo(repoPath).log(latest);
+    std::cout.rdbuf(saved);
+    assert(captured.str().find("Version 980\n") != std::string::npos);
+    assert(captured.str().find("Version 979\n") == std::string::npos);
+    assert(captured.str().find("Showing 20 of 1000 versions.") != std::string::npos);
+
+    fs::remove_all(repoPath);
+    std::cout << "testLogQueries passed.\n";
+}
+
+void testComposedDiff() {
+    std::string repoPath = "./test_repo_compose";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+
+    // A large text with small edits: the chain is far smaller than the text
+    std::vector<std::string> texts;
+    std::string text;
+    for (int i = 0; i < 20000; ++i) text += "row " + std::to_string(i) + " of the ledger\n";
+    std::ostringstream captured;
+    std::streambuf* saved = std::cout.rdbuf(captured.rdbuf());
+    {
+        Repo repo(repoPath);
+        repo.setKeyframePolicy(KeyframePolicy{8, 0});
+        repo.init();
+        for (int v = 0; v < 30; ++v) {
+            size_t at = text.find("row " + std::to_string(v * 500 + 7) + " ");
+            text.insert(at, "edit " + std::to_string(v) + "\n");
+            if (v % 3 == 0) text.erase(text.find("row " + std::to_string(v * 100 + 1) + " "), 4);
+            repo.commit(text);
+            texts.push_back(text);
+        }
+    }
+    std::cout.rdbuf(saved);
+
+    Repo repo(repoPath);
+    for (auto [a, b] : {std::pair<int, int>{2, 27}, {27, 2}, {8, 9}, {0, 29}, {15, 15}}) {
+        std::string hunks;
+        bool composed = false;
+        assert(repo.diffVersions(a, b, hunks, composed));
+        assert(composed || a == b);
+        assert(Patch::applyDiff(texts[a], hunks) == texts[b]);
+    }
+
+    // Where the chain outweighs the text, both versions are rebuilt instead
+    std::string small = "a\nb\n";
+    saved = std::cout.rdbuf(captured.rdbuf());
+    for (int v = 0; v < 10; ++v) {
+        small += "line " + std::to_string(v) + "\n";
+        repo.commit(small);
+    }
+    std::cout.rdbuf(saved);
+    std::string hunks;
+    bool composed = true;
+    assert(repo.diffVersions(0, 39, hunks, composed) && !composed);
+    assert(Patch::applyDiff(texts[0], hunks) == small);
+
+    fs::remove_all(repoPath);
+    std::cout << "testComposedDiff passed.\n";
+}
+
+void testBlame() {
+    std::string repoPath = "./test_repo_blame";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+
+    // Every line names the version that added it, and no line repeats, so
+    // the expected origin of each line can be read off the text
+    std::vector<std::string> lines;
+    int serial = 0;
+    auto line = [&](int version) { return std::to_string(version) + " line " + std::to_string(serial++); };
+    std::ostringstream captured;
+    std::streambuf* saved = std::cout.rdbuf(captured.rdbuf());
+    {
+        Repo repo(repoPath);
+        repo.setKeyframePolicy(KeyframePolicy{5, 0});
+        repo.init();
+        for (int i = 0; i < 200; ++i) lines.push_back(line(0));
+        repo.commit(Utils::joinLines(lines));
+        for (int v = 1; v < 30; ++v) {
+            lines.insert(lines.begin() + (v * 37) % lines.size(), line(v));
+            lines[(v * 53) % lines.size()] = line(v);
+            if (v % 4 == 0) lines.erase(lines.begin() + (v * 11) % lines.size(), lines.begin() + (v * 11) % lines.size() + 3);
+            repo.commit(Utils::joinLines(lines));
+        }
+    }
+    std::cout.rdbuf(saved);
+
+    auto check = [](const std::vector<int>& origins, const std::vector<std::string>& text) {
+        assert(origins.size() == text.size());
+        for (size_t i = 0; i < text.size(); ++i) assert(origins[i] == std::stoi(text[i]));
+    };
+    Repo repo(repoPath);
+    std::vector<int> origins;
+    std::vector<std::string> text;
+    assert(repo.annotate(29, origins, text));
+    assert(text == lines);
+    check(origins, text);
+
+    // Earlier versions, and a later one continued from the cached 12
+    assert(repo.annotate(12, origins, text));
+    check(origins, text);
+    assert(fs::exists(repoPath + "/blame/12") && fs::exists(repoPath + "/blame/29"));
+    fs::remove(repoPath + "/blame/29");
+    assert(repo.annotate(20, origins, text));
+    check(origins, text);
+    assert(repo.annotate(0, origins, text));
+    assert(text.size() == 200 && std::count(origins.begin(), origins.end(), 0) == 200);
+    std::streambuf* savedErr = std::cerr.rdbuf(captured.rdbuf());
+    assert(!repo.annotate(30, origins, text));
+    std::cerr.rdbuf(savedErr);
+
+    // A damaged cache entry is passed over
+    Utils::writeFile(repoPath + "/blame/20", "DSABLAME1 20 0000\n0 5\n");
+    assert(repo.annotate(25, origins, text));
+    check(origins, text);
+
+    // Only the requested lines are printed
+    saved = std::cout.rdbuf(captured.rdbuf());
+    captured.str("");
+    repo.blame(29, 3, 4);
+    std::cout.rdbuf(saved);
+    std::string out = captured.str();
+    assert(out.find("lines 3-4 of " + std::to_string(lines.size())) != std::string::npos);
+    assert(out.find(lines[2]) != std::string::npos && out.find(lines[3]) != std::string::npos);
+    assert(out.find(lines[4]) == std::string::npos);
+
+    fs::remove_all(repoPath);
+    std::cout << "testBlame passed.\n";
+}
+
+void testSearch() {
+    std::string repoPath = "./test_repo_search";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+
+    // A first version large enough that its postings are merged into
+    // terms.dat, then small edits whose postings stay in the tail
+    std::vector<std::string> lines, texts;
+    for (int i = 0; i < 12000; ++i) lines.push_back("entry " + std::to_string(i) + " of the catalogue");
+    std::ostringstream captured;
+    std::streambuf* saved = std::cout.rdbuf(captured.rdbuf());
+    {
+        Repo repo(repoPath);
+        repo.init();
+        for (int v = 0; v < 25; ++v) {
+            if (v > 0) {
+                lines[(v * 311) % lines.size()] = "revised entry " + std::to_string(v) + " needle";
+                lines.insert(lines.begin() + (v * 97) % lines.size(), "inserted at " + std::to_string(v));
+                if (v % 5 == 0) lines.erase(lines.begin() + v * 13, lines.begin() + v * 13 + 4);
+            }
+            texts.push_back(Utils::joinLines(lines));
+            repo.commit(texts.back());
+        }
+    }
+    std::cout.rdbuf(saved);
+    assert(fs::file_size(repoPath + "/search/terms.dat") > 0);
+
+    // Versions found through the index equal those a scan of every text finds
+    auto check = [&](const std::string& pattern) {
+        SearchIndex index(repoPath + "/search");
+        std::vector<SearchIndex::Match> matches;
+        assert(index.open() && index.version() == 24 && index.find(pattern, matches));
+        std::vector<bool> found(texts.size(), false);
+        for (const auto& m : matches) {
+            assert(m.text.find(pattern) != std::string::npos);
+            uint32_t last = m.last == SearchIndex::OPEN ? 24 : m.last;
+            for (uint32_t v = m.first; v <= last; ++v) found[v] = true;
+        }
+        for (size_t v = 0; v < texts.size(); ++v) {
+            bool expected = false;
+            for (std::string_view line : Utils::splitLineViews(texts[v])) {
+                expected = expected || line.find(pattern) != std::string_view::npos;
+            }
+            assert(found[v] == expected);
+        }
+        return matches.size();
+    };
+    assert(check("entry 5 of") == 1);
+    assert(check("revised entry 7 ") == 1);
+    assert(check("needle") == 24);
+    assert(check("inserted at 1") == 11);
+    assert(check("entry 13") > 1);
+    assert(check("no such line") == 0);
+    check("y");
+
+    // A repository without an index gets one when first searched
+    fs::remove_all(repoPath + "/search");
+    Repo repo(repoPath);
+    saved = std::cout.rdbuf(captured.rdbuf());
+    captured.str("");
+    repo.search("revised entry 3 ");
+    std::cout.rdbuf(saved);
+    assert(captured.str().find("found in 1 line, in versions 3-") != std::string::npos);
+    check("needle");
+
+    fs::remove_all(repoPath);
+    std::cout << "testSearch passed.\n";
+}
+
+void testDeltaBases() {
+    std::string repoPath = "./test_repo_bases";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+
+    // Experiments that are reverted: every other version is the base text
+    // again, and each experiment is closer to the one before it than to
+    // the base text between them
+    std::vector<std::string> lines, texts;
+    for (int i = 0; i < 300; ++i) lines.push_back("setting " + std::to_string(i) + " = default");
+    const std::vector<std::string> original = lines;
+    std::vector<std::string> experiment = lines;
+    std::ostringstream captured;
+    std::streambuf* saved = std::cout.rdbuf(captured.rdbuf());
+    Repo repo(repoPath);
+    repo.init();
+    for (int v = 0; v < 40; ++v) {
+        if (v % 2 == 1) {
+            for (int k = 0; k < 4; ++k) experiment[(v * 31 + k * 71) % experiment.size()] = "tuned " + std::to_string(v) + "." + std::to_string(k);
+            lines = experiment;
+        } else {
+            lines = original;
+        }
+        texts.push_back(Utils::joinLines(lines));
+        repo.commit(texts.back());
+    }
+    repo.repack(RepackOptions{0, 50});
+    size_t unchanged = fs::file_size(repoPath + "/objects/pack");
+    repo.repack(RepackOptions{10, 50});
+    std::cout.rdbuf(saved);
+
+    // Smaller, with most versions on a base other than the previous one,
+    // and every version rebuilt and verified through its new base
+    assert(fs::file_size(repoPath + "/objects/pack") < unchanged);
+    Repo reopened(repoPath);
+    reopened.getLatestText();
+    const auto& versions = reopened.getVersions();
+    assert(std::count_if(versions.begin(), versions.end(), [](const Version& v) { return v.base >= 0; }) >= 30);
+    for (size_t i = 0; i < texts.size(); ++i) {
+        reopened.getCache().clear();
+        assert(Patch::reconstructVersion(reopened, versions[i]) == texts[i]);
+    }
+    saved = std::cout.rdbuf(captured.rdbuf());
+    assert(reopened.verify());
+    std::cout.rdbuf(saved);
+
+    // diff, blame and search read the deltas against the previous version
+    for (auto [a, b] : {std::pair<int, int>{3, 36}, {36, 3}, {10, 11}, {0, 39}}) {
+        std::string hunks;
+        bool composed = false;
+        assert(reopened.diffVersions(a, b, hunks, composed));
+        assert(Patch::applyDiff(texts[a], hunks) == texts[b]);
+    }
+    std::vector<int> origins;
+    std::vector<std::string> text;
+    assert(reopened.annotate(38, origins, text) && Utils::joinLines(text) == texts[38]);
+    assert(reopened.annotate(37, origins, text) && Utils::joinLines(text) == texts[37]);
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i].rfind("tuned 37.", 0) == 0) assert(origins[i] == 37);
+        if (text[i] == original[i]) assert(origins[i] == 0 || origins[i] % 2 == 0);
+    }
+    fs::remove_all(repoPath + "/search");
+    saved = std::cout.rdbuf(captured.rdbuf());
+    captured.str("");
+    reopened.search("tuned 37.2");
+    std::cout.rdbuf(saved);
+    assert(captured.str().find("found in 2 lines, in versions 37, 39\n") != std::string::npos);
+
+    // A depth limit shorter than the chains adds snapshots to keep to it
+    saved = std::cout.rdbuf(captured.rdbuf());
+    reopened.repack(RepackOptions{10, 3});
+    std::cout.rdbuf(saved);
+    Repo limited(repoPath);
+    limited.getLatestText();
+    const auto& rebased = limited.getVersions();
+    std::vector<int> depth(rebased.size());
+    for (size_t i = 0; i < rebased.size(); ++i) {
+        bool snapshot = !rebased[i].snapshotObject.empty();
+        depth[i] = i > 0 && snapshot ? 0 : 1 + (rebased[i].base >= 0 ? depth[rebased[i].base] : i > 0 ? depth[i - 1] : 0);
+        assert(depth[i] <= 3);
+        limited.getCache().clear();
+        assert(Patch::reconstructVersion(limited, rebased[i]) == texts[i]);
+    }
+    saved = std::cout.rdbuf(captured.rdbuf());
+    assert(limited.verify());
+    std::cout.rdbuf(saved);
+
+    fs::remove_all(repoPath);
+    std::cout << "testDeltaBases passed.\n";
+}
+
+// Make a journal look as if it was written before the last reboot
+static void rebootJournal(const std::string& path) {
+    unsigned char header[Journal::HEADER_SIZE];
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    header[8] ^= 0xFF;
+    BinaryIO::put32(header + 28, Utils::crc32(header, 28));
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+}
+
+void testDurability() {
+    std::string repoPath = "./test_repo_durability";
+    std::vector<std::string> texts;
+    std::string text;
+    for (int i = 0; i < 12; ++i) {
+        text += "line " + std::to_string(i) + "\n";
+        texts.push_back(text);
+    }
+
+    // Every level commits the same history; only batch (the default, and
+    // the last here) keeps a journal
+    for (Durability level : {Durability::None, Durability::Strict, Durability::Batch}) {
+        if (fs::exists(repoPath)) fs::remove_all(repoPath);
+        std::ostringstream captured;
+        std::streambuf* saved = std::cout.rdbuf(captured.rdbuf());
+        {
+            Repo repo(repoPath);
+            repo.setDurability(level);
+            repo.init();
+            for (const auto& t : texts) repo.commit(t);
+        }
+        Repo reopened(repoPath);
+        reopened.setDurability(level);
+        assert(reopened.getLatestText() == texts.back());
+        for (size_t i = 0; i < texts.size(); ++i) {
+            reopened.getCache().clear();
+            assert(Patch::reconstructVersion(reopened, reopened.getVersions()[i]) == texts[i]);
+        }
+        assert(reopened.verify());
+        std::cout.rdbuf(saved);
+        assert(fs::exists(repoPath + "/journal") == (level == Durability::Batch));
+    }
+
+    // A crash that lost the last log record and the content of an object:
+    // both come back from the journal
+    std::vector<Version> history;
+    {
+        Repo repo(repoPath);
+        repo.getLatestText();
+        history = repo.getVersions();
+    }
+    VersionLog log(repoPath + "/versions.log");
+    assert(log.rewrite(std::vector<Version>(history.begin(), history.end() - 1)));
+    std::string damagedPath = Repo(repoPath).getStore().pathFor(history[11].diffObject);
+    std::ofstream(damagedPath, std::ios::binary | std::ios::trunc).close();
+    rebootJournal(repoPath + "/journal");
+
+    std::ostringstream captured;
+    std::streambuf* savedOut = std::cout.rdbuf(captured.rdbuf());
+    std::streambuf* savedErr = std::cerr.rdbuf(captured.rdbuf());
+    {
+        Repo recovered(repoPath);
+        assert(recovered.getLatestText() == texts.back());
+        assert(recovered.getVersions().size() == texts.size());
+        assert(recovered.verify());
+    }
+    assert(captured.str().find("1 versions and 1 objects restored") != std::string::npos);
+
+    // A record the journal never saw (written, say, by a batch commit that
+    // did not finish) is dropped after a reboot: nothing reported it committed
+    Version unfinished = history.back();
+    unfinished.id = (int)history.size();
+    unfinished.keyframe = unfinished.id;
+    unfinished.snapshotObject = unfinished.hash;
+    assert(log.append(unfinished));
+    rebootJournal(repoPath + "/journal");
+    {
+        Repo recovered(repoPath);
+        recovered.getLatestText();
+        assert(recovered.getVersions().size() == texts.size());
+    }
+    assert(captured.str().find("1 unfinished versions dropped") != std::string::npos);
+
+    // Without a reboot, a record the log lacks is appended again
+    {
+        Repo repo(repoPath);
+        repo.commit(texts.back() + "one more\n");
+    }
+    assert(log.rewrite(std::vector<Version>(history.begin(), history.end())));
+    {
+        Repo recovered(repoPath);
+        assert(recovered.getLatestText() == texts.back() + "one more\n");
+        assert(recovered.verify());
+    }
+    std::cout.rdbuf(savedOut);
+    std::cerr.rdbuf(savedErr);
+
+    // Group commit: writers that sync at once share flushes, and every
+    // entry reads back in order
+    std::string journalPath = repoPath + "/journal.test";
+    Journal journal(journalPath);
+    assert(journal.reset(5));
+    const int threads = 8, perThread = 25;
+    std::mutex appendLock;
+    int nextId = 5;
+    std::vector<std::thread> writers;
+    for (int t = 0; t < threads; ++t) {
+        writers.emplace_back([&, t] {
+            for (int i = 0; i < perThread; ++i) {
+                Journal::Entry entry;
+                uint64_t ticket = 0;
+                {
+                    std::lock_guard<std::mutex> guard(appendLock);
+                    std::string content = "writer " + std::to_string(t) + " entry " + std::to_string(i) + "\n";
+                    entry.version.id = nextId++;
+                    entry.version.keyframe = 0;
+                    entry.version.timestamp = "2024-01-01 00:00:00";
+                    entry.version.hash = Utils::hashString(content);
+                    entry.version.diffObject = entry.version.hash;
+                    entry.objects.push_back(content);
+                    assert(journal.append(entry, ticket));
+                }
+                assert(journal.sync(ticket));
+            }
+        });
+    }
+    for (auto& writer : writers) writer.join();
+    assert(journal.syncCount() > 0 && journal.syncCount() <= (uint64_t)(threads * perThread));
+
+    std::vector<Journal::Entry> entries;
+    size_t checkpoint = 0;
+    bool sameBoot = false;
+    assert(journal.read(entries, checkpoint, sameBoot));
+    assert(checkpoint == 5 && entries.size() == (size_t)(threads * perThread));
+    for (size_t i = 0; i < entries.size(); ++i) {
+        assert(entries[i].version.id == (int)(5 + i));
+        assert(Utils::hashString(entries[i].objects[0]) == entries[i].version.diffObject);
+    }
+
+    // An entry cut short ends the journal
+    fs::resize_file(journalPath, fs::file_size(journalPath) - 3);
+    assert(journal.read(entries, checkpoint, sameBoot));
+    assert(entries.size() == (size_t)(threads * perThread) - 1);
+
+    fs::remove_all(repoPath);
+    std::cout << "testDurability passed.\n";
+}
+
+void testUnterminatedText() {
+    std::string repoPath = "./test_repo_unterminated";
+    std::string inputPath = "./test_repo_unterminated_input.txt";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+
+    // Texts without a final newline are stored, hashed and rebuilt with one
+    std::ostringstream captured;
+    std::streambuf* saved = std::cout.rdbuf(captured.rdbuf());
+    {
+        Repo repo(repoPath);
+        repo.init();
+        repo.commit("a\nb");
+        repo.commit("a\nX\nb\n");
+        repo.commit("a\nX");
+        repo.commit("a\nX\n");    // the same text as the last commit
+        std::ofstream(inputPath, std::ios::binary) << "streamed\nno newline";
+        repo.commitStreaming(inputPath);
+        size_t next = 0;
+        repo.commitBatch([&](std::string& text) {
+            if (next++ == 2) return false;
+            text = next == 1 ? "batch" : "batch\n";
+            return true;
+        });
+    }
+    std::cout.rdbuf(saved);
+    assert(captured.str().find("nothing committed") != std::string::npos);
+    assert(!fs::exists(repoPath + "/commit.input.tmp"));
+
+    std::vector<std::string> expected = {"a\nb\n", "a\nX\nb\n", "a\nX\n", "streamed\nno newline\n", "batch\n"};
+    Repo repo(repoPath);
+    assert(repo.getLatestText() == expected.back());
+    const auto& versions = repo.getVersions();
+    assert(versions.size() == expected.size());
+    for (size_t i = 0; i < versions.size(); ++i) {
+        assert(versions[i].hash == Utils::hashString(expected[i]));
+        repo.getCache().clear();
+        assert(Patch::reconstructVersion(repo, versions[i]) == expected[i]);
+    }
+
+    // So replay agrees with every hash
+    std::ostringstream report;
+    saved = std::cout.rdbuf(report.rdbuf());
+    bool verified = repo.verify();
+    std::cout.rdbuf(saved);
+    assert(verified && report.str().find("does not match") == std::string::npos);
+
+    fs::remove_all(repoPath);
+    fs::remove(inputPath);
+    std::cout << "testUnterminatedText passed.\n";
+}
+
+void testRollbackUnchanged() {
+    std::string repoPath = "./test_repo_rollback";
+    std::string outputPath = "./test_repo_rollback_output.txt";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+
+    std::ostringstream captured;
+    std::streambuf* saved = std::cout.rdbuf(captured.rdbuf());
+    Repo repo(repoPath);
+    repo.init();
+    assert(repo.commit("one\n"));
+    assert(repo.commit("one\ntwo\n"));
+    assert(!repo.commit("one\ntwo\n"));
+
+    // Rolling back to the current version commits nothing, and says so
+    captured.str("");
+    repo.rollback(1, outputPath);
+    std::string unchanged = captured.str();
+    captured.str("");
+    repo.rollback(0, outputPath);
+    std::string rolledBack = captured.str();
+    std::cout.rdbuf(saved);
+
+    assert(unchanged.find("nothing committed") != std::string::npos);
+    assert(unchanged.find("Rollback committed successfully") == std::string::npos);
+    assert(rolledBack.find("Rollback committed successfully") != std::string::npos);
+    assert(repo.getVersions().size() == 3 && repo.getLatestText() == "one\n");
+
+    fs::remove_all(repoPath);
+    fs::remove(outputPath);
+    std::cout << "testRollbackUnchanged passed.\n";
+}
+
+// Writers through separate Repo instances (as separate processes would
+// be) take turns on the lock file instead of writing the same log slot
+void testConcurrentWriters() {
+    std::string repoPath = "./test_repo_writers";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+
+    // A failed stream drops output from every thread without writing to a
+    // shared buffer
+    std::cout.setstate(std::ios::failbit);
+    Repo(repoPath).init();
+    const int writers = 4, perWriter = 15;
+    std::vector<std::thread> threads;
+    for (int w = 0; w < writers; ++w) {
+        threads.emplace_back([&, w] {
+            Repo repo(repoPath);
+            for (int i = 0; i < perWriter; ++i) {
+                assert(repo.commit("writer " + std::to_string(w) + " commit " + std::to_string(i) + "\n"));
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    Repo repo(repoPath);
+    bool verified = repo.verify();
+    std::cout.clear();
+    assert(verified);
+    assert(repo.getVersions().size() == (size_t)(writers * perWriter));
+
+    fs::remove_all(repoPath);
+    std::cout << "testConcurrentWriters passed.\n";
+}
+
+void testUnreadableLog() {
+    std::string repoPath = "./test_repo_unreadable";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+
+    std::ostringstream captured;
+    std::streambuf* saved = std::cout.rdbuf(captured.rdbuf());
+    std::streambuf* savedErr = std::cerr.rdbuf(captured.rdbuf());
+    {
+        Repo repo(repoPath);
+        repo.init();
+        repo.commit("one\n");
+    }
+    // A damaged log stops the command instead of letting it run on an empty history
+    std::ofstream(repoPath + "/versions.log", std::ios::binary | std::ios::trunc) << "not a version log";
+    Repo repo(repoPath);
+    repo.commit("two\n");
+    assert(repo.getLatestText().empty());
+    assert(!repo.verify());
+    std::cout.rdbuf(saved);
+    std::cerr.rdbuf(savedErr);
+    assert(captured.str().find("not a readable version log") != std::string::npos);
+    assert(captured.str().find("Committed version 0") != std::string::npos);
+    assert(captured.str().find("Committed version 1") == std::string::npos);
+    assert(captured.str().find("Verified") == std::string::npos);
+
+    fs::remove_all(repoPath);
+    std::cout << "testUnreadableLog passed.\n";
+}
+
+void testHeadRebuiltOnce() {
+    std::string repoPath = "./test_repo_head_rebuild";
+    std::string headPath = repoPath + "/HEAD";
+    if (fs::exists(repoPath)) fs::remove_all(repoPath);
+
+    std::ostringstream captured;
+    std::streambuf* saved = std::cout.rdbuf(captured.rdbuf());
+    {
+        Repo repo(repoPath);
+        repo.init();
+        repo.commit("a\nb\n");
+        repo.commit("a\nX");
+    }
+    std::cout.rdbuf(saved);
+
+    // After HEAD is lost, the first command rebuilds and saves it; later
+    // ones load it as it is instead of replaying the history again
+    fs::remove(headPath);
+    assert(Repo(repoPath).getLatestText() == "a\nX\n");
+    assert(fs::exists(headPath));
+    auto stamp = fs::last_write_time(headPath) - std::chrono::hours(1);
+    fs::last_write_time(headPath, stamp);
+    for (int i = 0; i < 3; ++i) {
+        Repo repo(repoPath);
+        assert(repo.getLatestText() == "a\nX\n");
+        assert(fs::last_write_time(headPath) == stamp);
+    }
+
+    // Streaming commits read the previous text from that HEAD
+    std::string inputPath = "./test_repo_head_rebuild_input.txt";
+    std::ofstream(inputPath, std::ios::binary) << "a\nX\nY\n";
+    saved = std::cout.rdbuf(captured.rdbuf());
+    {
+        Repo repo(repoPath);
+        repo.commitStreaming(inputPath);
+        assert(repo.getVersions().size() == 3);
+    }
+    std::cout.rdbuf(saved);
+    assert(Repo(repoPath).getLatestText() == "a\nX\nY\n");
+
+    fs::remove(inputPath);
+    fs::remove_all(repoPath);
+    std::cout << "testHeadRebuiltOnce passed.\n";
+}
+
 int main() {
     testRepo();
+    testKeyframes();
+    testKeyframeBytes();
+    testReconstructionCache();
+    testObjectDedup();
+    testMappedFile();
+    testVersionLog();
+    testUnreadableLog();
+    testVersionsTxtMigration();
+    testRepack();
+    testCompressedObjects();
+    testHeadSnapshot();
+    testHeadRebuiltOnce();
+    testCommitBatch();
+    testUnterminatedText();
+    testRollbackUnchanged();
+    testConcurrentWriters();
+    testVerifyAndStats();
+    testStreamingCommit();
+    testEncryptedRepo();
+    testLogQueries();
+    testComposedDiff();
+    testBlame();
+    testSearch();
+    testDeltaBases();
+    testDurability();
     return 0;
 }
@@ -0,0 +1,124 @@
+#include "../src/api/server.h"
+#include "../src/core/utils.h"
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+static Command makeCommand(const std::string& name, std::vector<std::string> args = {}) {
+    Command cmd;
+    cmd.name = name;
+    cmd.args = std::move(args);
+    return cmd;
+}
+
+void testServer() {
+    const std::string socketPath = "./test_server.sock";
+    const std::string repoA = "./test_server_a";
+    const std::string repoB = "./test_server_b";
+    for (const auto& path : {repoA, repoB}) {
+        if (fs::exists(path)) fs::remove_all(path);
+    }
+
+    Server server(socketPath, RepoOptions(), 2);
+    assert(server.start());
+    std::thread loop([&server] { server.run(); });
+
+    // A second server on the same socket is refused
+    {
+        Server other(socketPath, RepoOptions(), 1);
+        assert(!other.start());
+    }
+
+    // One connection carries several requests; relative paths resolve
+    // against the client's directory
+    std::string out, err;
+    Server::Client client(socketPath);
+    assert(client.request(repoA, makeCommand("init"), out, err));
+    assert(out.find("Repository initialized") != std::string::npos);
+
+    std::ofstream("./test_server_input.txt") << "alpha\nbeta\n";
+    assert(client.request(repoA, makeCommand("commit", {"test_server_input.txt"}), out, err));
+    assert(out.find("Committed version 0") != std::string::npos && err.empty());
+    std::ofstream("./test_server_input.txt") << "alpha\nbeta\ngamma\n";
+    assert(client.request(repoA, makeCommand("commit", {"test_server_input.txt"}), out, err));
+    assert(out.find("Committed version 1") != std::string::npos);
+
+    assert(client.request(repoA, makeCommand("checkout", {"0"}), out, err));
+    assert(out.find("alpha\nbeta\n====") != std::string::npos);
+    assert(client.request(repoA, makeCommand("checkout", {"9"}), out, err));
+    assert(err.find("Invalid version ID") != std::string::npos);
+
+    // Requests from other threads, on another repository, run alongside
+    std::thread other([&] {
+        Server::Client second(socketPath);
+        std::string o, e;
+        assert(second.request(repoB, makeCommand("init"), o, e));
+        for (int i = 0; i < 20; ++i) {
+            std::string file = "./test_server_b_input.txt";
+            std::ofstream(file) << "line " << i << "\n";
+            assert(second.request(repoB, makeCommand("commit", {file}), o, e));
+        }
+        assert(second.request(repoB, makeCommand("log"), o, e));
+        assert(o.find("Version 19") != std::string::npos);
+    });
+    for (int i = 0; i < 20; ++i) {
+        assert(client.request(repoA, makeCommand("log"), out, err));
+        assert(out.find("Version 1") != std::string::npos && out.find("Version 2") == std::string::npos);
+    }
+    other.join();
+
+    // Padded listings on two repositories at once keep their own layout
+    std::string blameOut, searchOut;
+    assert(client.request(repoA, makeCommand("blame", {"1"}), blameOut, err));
+    assert(blameOut.find("0 1  alpha\n0 2  beta\n1 3  gamma\n") != std::string::npos);
+    {
+        Server::Client second(socketPath);
+        assert(second.request(repoB, makeCommand("search", {"line"}), searchOut, err));
+    }
+    assert(searchOut.find("19          line 19\n") != std::string::npos);
+    std::thread searcher([&] {
+        Server::Client second(socketPath);
+        std::string o, e;
+        for (int i = 0; i < 50; ++i) {
+            assert(second.request(repoB, makeCommand("search", {"line"}), o, e));
+            assert(o == searchOut);
+        }
+    });
+    for (int i = 0; i < 50; ++i) {
+        assert(client.request(repoA, makeCommand("blame", {"1"}), out, err));
+        assert(out == blameOut);
+    }
+    searcher.join();
+
+    // The server's stdin is not the client's
+    assert(client.request(repoA, makeCommand("commit-batch", {"-"}), out, err));
+    assert(err.find("cannot run through a server") != std::string::npos);
+
+    // What the server committed is on disk for direct use
+    assert(Repo(repoA).getLatestText() == "alpha\nbeta\ngamma\n");
+    assert(server.requestsServed() >= 149);
+
+    client.close();
+    server.stop();
+    loop.join();
+    assert(!fs::exists(socketPath));
+    assert(!client.request(repoA, makeCommand("log"), out, err));
+
+    for (const auto& path : {repoA, repoB}) fs::remove_all(path);
+    fs::remove("./test_server_input.txt");
+    fs::remove("./test_server_b_input.txt");
+    std::cout << "testServer passed.\n";
+}
+
+int main() {
+#ifdef _WIN32
+    std::cout << "testServer skipped (no Unix-domain sockets).\n";
+#else
+    testServer();
+#endif
+    return 0;
+}
@@ -1,6 +1,15 @@
+#include "../src/core/compress.h"
+#include "../src/core/thread_pool.h"
+#include "../src/core/trace.h"
 #include "../src/core/utils.h"
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <thread>
 
 void testUtils() {
     std::string text = "line1\nline2\nline3";
@@ -17,7 +26,200 @@ void testUtils() {
     std::cout << "testUtils passed.\n";
 }
 
+// What splitLines did before it was built on splitLineViews
+static std::vector<std::string> getlineSplit(const std::string& text) {
+    std::vector<std::string> lines;
+    std::stringstream ss(text);
+    std::string line;
+    while (std::getline(ss, line)) lines.push_back(line);
+    return lines;
+}
+
+void testSplitLineViews() {
+    // Must agree with splitLines (std::getline semantics) on every scanner
+    std::string longLine(1000, 'x');
+    std::vector<std::string> inputs = {
+        "", "\n", "a", "a\n", "a\nb", "a\nb\n", "\n\nx\n\n", "crlf\r\nline\r\n",
+        longLine + "\n" + longLine, std::string(70, '\n') + "tail"
+    };
+    std::string many;
+    for (int i = 0; i < 500; ++i) many += std::string(i % 37, 'a' + i % 26) + "\n";
+    inputs.push_back(many);
+
+    for (const char* scanner : {"memchr", "sse2", "avx2"}) {
+        if (!Utils::useLineScanner(scanner)) continue;
+        assert(std::string(Utils::lineScanner()) == scanner);
+        for (const auto& text : inputs) {
+            std::vector<std::string> expected = getlineSplit(text);
+            assert(Utils::splitLines(text) == expected);
+            std::vector<std::string_view> views = Utils::splitLineViews(text);
+            assert(views.size() == expected.size());
+            for (size_t i = 0; i < views.size(); ++i) {
+                assert(views[i] == expected[i]);
+            }
+        }
+    }
+    assert(!Utils::useLineScanner("bogus"));
+
+    std::cout << "testSplitLineViews passed.\n";
+}
+
+void testCompress() {
+    std::vector<std::string> inputs = {"", "a", "abcd", std::string(10000, 'x'), "abcabcabcabcabcabc\n"};
+    std::string prose;
+    for (int i = 0; i < 2000; ++i) prose += "note " + std::to_string(i % 50) + ": meeting moved to thursday\n";
+    inputs.push_back(prose);
+    std::string noise;
+    unsigned seed = 7;
+    for (int i = 0; i < 5000; ++i) {
+        seed = seed * 1103515245 + 12345;
+        noise.push_back(static_cast<char>(seed >> 16));
+    }
+    inputs.push_back(noise);
+
+    for (const auto& input : inputs) {
+        std::string block = Compress::compress(input);
+        std::string out;
+        assert(Compress::decompress(block, input.size(), out));
+        assert(out == input);
+    }
+    assert(Compress::compress(prose).size() < prose.size() / 10);
+
+    // Wrong size or a cut-off block is rejected, not overrun
+    std::string block = Compress::compress(prose), out;
+    assert(!Compress::decompress(block, prose.size() + 1, out));
+    assert(!Compress::decompress(block.substr(0, block.size() / 2), prose.size(), out));
+
+    // A dictionary lets a small input refer to text it has never seen itself
+    std::vector<std::string> samples;
+    for (int i = 0; i < 20; ++i) {
+        samples.push_back("@@ -1,2 +1,2 @@\n  shared context line for every diff\n- old " +
+                          std::to_string(i) + "\n+ new " + std::to_string(i) + "\n");
+    }
+    std::string dictionary = Compress::trainDictionary(samples);
+    assert(dictionary.find("shared context line for every diff") != std::string::npos);
+    std::string small = "@@ -1,2 +1,2 @@\n  shared context line for every diff\n- old 99\n+ new 99\n";
+    std::string withDictionary = Compress::compress(small, dictionary);
+    assert(withDictionary.size() < Compress::compress(small).size());
+    assert(Compress::decompress(withDictionary, small.size(), out, dictionary) && out == small);
+    assert(!Compress::decompress(withDictionary, small.size(), out) || out != small);
+
+    std::cout << "testCompress passed.\n";
+}
+
+void testThreadPool() {
+    ThreadPool pool(4);
+    assert(pool.size() == 4);
+
+    // Every task runs exactly once, including tasks submitted by tasks
+    std::vector<std::atomic<int>> runs(1000);
+    for (int i = 0; i < 100; ++i) {
+        pool.submit([&pool, &runs, i] {
+            for (int j = 0; j < 10; ++j) {
+                pool.submit([&runs, i, j] { ++runs[i * 10 + j]; });
+            }
+        });
+    }
+    pool.wait();
+    for (auto& count : runs) assert(count == 1);
+
+    // One slow task does not hold back the others queued behind it on its
+    // worker: idle workers steal them
+    std::atomic<int> quick{0};
+    std::atomic<bool> release{false};
+    pool.submit([&] {
+        for (int i = 0; i < 40; ++i) pool.submit([&] { ++quick; });
+        while (!release) std::this_thread::yield();
+    });
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (quick < 40 && std::chrono::steady_clock::now() < deadline) std::this_thread::yield();
+    assert(quick == 40);
+    assert(pool.steals() > 0);
+    release = true;
+    pool.wait();
+
+    // wait() from inside a task helps run the queue instead of deadlocking
+    std::atomic<int> nested{0};
+    pool.submit([&] {
+        for (int i = 0; i < 20; ++i) pool.submit([&] { ++nested; });
+        pool.wait();
+    });
+    pool.wait();
+    assert(nested == 20);
+
+    std::cout << "testThreadPool passed.\n";
+}
+
+void testExpandGlob() {
+    namespace fs = std::filesystem;
+    const std::string root = "./test_glob";
+    if (fs::exists(root)) fs::remove_all(root);
+    for (const char* dir : {"alice/repo", "bob/repo", "carol/other", ".hidden/repo"}) {
+        fs::create_directories(root + "/" + dir);
+    }
+    std::ofstream(root + "/notes.txt") << "x";
+
+    assert(Utils::wildcardMatch("*", "anything"));
+    assert(Utils::wildcardMatch("a*e", "alice"));
+    assert(Utils::wildcardMatch("b?b", "bob"));
+    assert(!Utils::wildcardMatch("a*x", "alice"));
+
+    std::vector<std::string> repos = Utils::expandGlob(root + "/*/repo");
+    assert(repos.size() == 2);
+    assert(repos[0] == root + "/alice/repo" && repos[1] == root + "/bob/repo");
+    assert(Utils::expandGlob(root + "/*.txt").size() == 1);
+    assert(Utils::expandGlob(root + "/.h*/repo").size() == 1);
+    assert(Utils::expandGlob(root + "/nobody/repo").empty());
+    assert(Utils::expandGlob(root + "/alice/repo").size() == 1);
+
+    fs::remove_all(root);
+    std::cout << "testExpandGlob passed.\n";
+}
+
+void testTrace() {
+    const std::string path = "./test_trace.txt";
+    const std::string tracePath = "./test_trace.json";
+    const std::string text = "one\ntwo\nthree\n";
+
+    // Off: probes record nothing
+    Trace::reset();
+    Utils::writeFile(path, text);
+    Utils::splitLineViews(Utils::readFile(path));
+    assert(Trace::counter(Trace::BytesRead) == 0 && Trace::counter(Trace::LinesProcessed) == 0);
+
+    Trace::enable(true);
+    Utils::writeFile(path, text);
+    std::string back = Utils::readFile(path);
+    assert(Utils::splitLineViews(back).size() == 3);
+    Trace::disable();
+    assert(Trace::counter(Trace::FilesOpened) == 2);
+    assert(Trace::counter(Trace::BytesWritten) == text.size());
+    assert(Trace::counter(Trace::BytesRead) == text.size());
+    assert(Trace::counter(Trace::LinesProcessed) == 3);
+
+    std::ostringstream summary;
+    Trace::printSummary(summary);
+    assert(summary.str().find("Utils::readFile") != std::string::npos);
+    assert(summary.str().find("Utils::splitLines") != std::string::npos);
+
+    assert(Trace::writeChromeTrace(tracePath));
+    std::string json = Utils::readFile(tracePath);
+    assert(json.find("\"traceEvents\"") != std::string::npos);
+    assert(json.find("\"name\":\"Utils::writeFile\",\"cat\":\"dsa\",\"ph\":\"X\"") != std::string::npos);
+    assert(json.find("\"lines processed\":3") != std::string::npos);
+
+    Trace::reset();
+    std::remove(path.c_str());
+    std::remove(tracePath.c_str());
+    std::cout << "testTrace passed.\n";
+}
+
 int main() {
     testUtils();
+    testSplitLineViews();
+    testCompress();
+    testThreadPool();
+    testExpandGlob();
+    testTrace();
     return 0;
 }